@@ -21,6 +21,20 @@ def find_component_in_list_by_name(name, component_list, subaction_path=None, id
     return None
 
 
+def path_hash_value(path):
+    """64 bit FNV-1a hash of a path, must match oxr_path_hash."""
+    h = 0xcbf29ce484222325
+    for byte in path.encode("utf-8"):
+        h ^= byte
+        h = (h * 0x100000001b3) & 0xffffffffffffffff
+    return h
+
+
+def path_hash(path):
+    """The hash of a path as a C literal."""
+    return f"0x{path_hash_value(path):016x}ULL"
+
+
 def steamvr_subpath_name(steamvr_path, subpath_type):
     if subpath_type == "pose":
         return steamvr_path.replace("/input/", "/pose/")
@@ -702,6 +716,7 @@ def generate_bindings_c(file, b):
         f.write(f'\t{{ // profile_template\n')
         f.write(f'\t\t.name = {profile.monado_device_enum},\n')
         f.write(f'\t\t.path = "{profile.name}",\n')
+        f.write(f'\t\t.path_hash = {path_hash(profile.name)},\n')
         f.write(f'\t\t.localized_name = "{profile.localized_name}",\n')
         f.write(f'\t\t.steamvr_input_profile_path = "{fname}",\n')
         f.write(f'\t\t.steamvr_controller_type = "{controller_type}",\n')
@@ -719,6 +734,7 @@ def generate_bindings_c(file, b):
 
             f.write(f'\t\t\t{{ // binding_template {idx}\n')
             f.write(f'\t\t\t\t.subaction_path = "{component.subaction_path}",\n')
+            f.write(f'\t\t\t\t.subaction_path_hash = {path_hash(component.subaction_path)},\n')
             f.write(f'\t\t\t\t.steamvr_path = "{steamvr_path}",\n')
             f.write(
                 f'\t\t\t\t.localized_name = "{component.subpath_localized_name}",\n')
@@ -728,6 +744,10 @@ def generate_bindings_c(file, b):
                 f.write(f'\t\t\t\t\t"{path}",\n')
             f.write('\t\t\t\t\tNULL\n')
             f.write('\t\t\t\t}, // /array of paths\n')
+            f.write('\t\t\t\t.path_hashes = (const uint64_t[]){ // array of path hashes\n')
+            for path in component.get_full_openxr_paths():
+                f.write(f'\t\t\t\t\t{path_hash(path)},\n')
+            f.write('\t\t\t\t}, // /array of path hashes\n')
 
             # print("component", component.__dict__)
 
@@ -760,6 +780,19 @@ def generate_bindings_c(file, b):
 
         f.write('\t\t}, // /array of binding_template\n')
 
+        # Sorted by hash, then binding so the first match is the first binding.
+        lookup = []
+        for idx, component in enumerate(profile.components):
+            for path_idx, path in enumerate(component.get_full_openxr_paths()):
+                lookup.append((path_hash_value(path), idx, path_idx))
+        lookup.sort()
+
+        f.write(f'\t\t.path_lookup_count = {len(lookup)},\n')
+        f.write('\t\t.path_lookup = (const struct binding_path_lookup[]){ // array of binding_path_lookup\n')
+        for hash_value, idx, path_idx in lookup:
+            f.write(f'\t\t\t{{0x{hash_value:016x}ULL, {idx}, {path_idx}}},\n')
+        f.write('\t\t}, // /array of binding_path_lookup\n')
+
         dpads = []
         for idx, identifier in enumerate(profile.identifiers):
             if identifier.dpad:
@@ -778,10 +811,15 @@ def generate_bindings_c(file, b):
             for idx, identifier in enumerate(dpads):
                 f.write('\t\t\t{\n')
                 f.write(f'\t\t\t\t.subaction_path = "{identifier.subaction_path}",\n')
+                f.write(f'\t\t\t\t.subaction_path_hash = {path_hash(identifier.subaction_path)},\n')
                 f.write('\t\t\t\t.paths = {\n')
                 for path in identifier.dpad.paths:
                     f.write(f'\t\t\t\t\t"{path}",\n')
                 f.write('\t\t\t\t},\n')
+                f.write('\t\t\t\t.path_hashes = (const uint64_t[]){\n')
+                for path in identifier.dpad.paths:
+                    f.write(f'\t\t\t\t\t{path_hash(path)},\n')
+                f.write('\t\t\t\t},\n')
                 f.write(f'\t\t\t\t.position = {identifier.dpad.position_component.monado_binding},\n')
                 if identifier.dpad.activate_component:
                     f.write(f'\t\t\t\t.activate = {identifier.dpad.activate_component.monado_binding},\n')
@@ -806,6 +844,49 @@ def generate_bindings_c(file, b):
 
     f.write('}; // /array of profile_template\n\n')
 
+    # First template for each device name, like a linear search would find.
+    first_template = {}
+    for idx, profile in enumerate(b.profiles):
+        first_template.setdefault(profile.monado_device_enum, idx)
+
+    f.write('int\n')
+    f.write('oxr_bindings_profile_template_index(enum xrt_device_name name)\n')
+    f.write('{\n')
+    f.write('\tswitch (name) {\n')
+    for device_enum, idx in first_template.items():
+        f.write(f'\tcase {device_enum}: return {idx};\n')
+    f.write('\tdefault: return -1;\n')
+    f.write('\t}\n')
+    f.write('}\n\n')
+
+    f.write('''const struct binding_path_lookup *
+oxr_bindings_find_path_lookup(const struct profile_template *templ, uint64_t hash, size_t *out_count)
+{
+\tconst struct binding_path_lookup *lookup = templ->path_lookup;
+\tsize_t low = 0;
+\tsize_t high = templ->path_lookup_count;
+
+\t// Lower bound, the first entry with a hash not less than the given one.
+\twhile (low < high) {
+\t\tsize_t mid = low + (high - low) / 2;
+\t\tif (lookup[mid].hash < hash) {
+\t\t\tlow = mid + 1;
+\t\t} else {
+\t\t\thigh = mid;
+\t\t}
+\t}
+
+\tsize_t count = 0;
+\twhile (low + count < templ->path_lookup_count && lookup[low + count].hash == hash) {
+\t\tcount++;
+\t}
+
+\t*out_count = count;
+\treturn count > 0 ? &lookup[low] : NULL;
+}
+
+''')
+
     inputs = set()
     outputs = set()
     for profile in b.profiles:
@@ -874,6 +955,7 @@ static const struct oxr_bindings_path_cache internal_path_cache = {{
 \t\t{{
 \t\t\t.path_cache = &profile_templates[{profile_index}].path_cache,
 \t\t\t.path_cache_name = &profile_templates[{profile_index}].path,
+\t\t\t.path_cache_hash = &profile_templates[{profile_index}].path_hash,
 \t\t}},\n''')
         profile_index += 1
     f.write(f'''\t}}
@@ -913,6 +995,8 @@ struct oxr_bindings_path_cache_element {{
     XrPath *path_cache;
     //! Pointer to char*
     const char **path_cache_name;
+    //! Pointer to the precomputed hash of the name
+    const uint64_t *path_cache_hash;
 }};
 
 struct oxr_bindings_path_cache {{
@@ -947,7 +1031,9 @@ enum oxr_dpad_binding_point
 struct dpad_emulation
 {{
 \tconst char *subaction_path;
+\tuint64_t subaction_path_hash;
 \tconst char *paths[PATHS_PER_BINDING_TEMPLATE];
+\tconst uint64_t *path_hashes;
 \tenum xrt_input_name position;
 \tenum xrt_input_name activate; // Can be zero
 }};
@@ -955,14 +1041,28 @@ struct dpad_emulation
 struct binding_template
 {{
 \tconst char *subaction_path;
+\tuint64_t subaction_path_hash;
 \tconst char *steamvr_path;
 \tconst char *localized_name;
 \tconst char *paths[PATHS_PER_BINDING_TEMPLATE];
+\t// Precomputed oxr_path_hash of each of the paths.
+\tconst uint64_t *path_hashes;
 \tenum xrt_input_name input;
 \tenum xrt_input_name dpad_activate;
 \tenum xrt_output_name output;
 }};
 
+/*!
+ * Maps the hash of a binding path to where it is in the profile, see
+ * @ref oxr_bindings_find_path_lookup.
+ */
+struct binding_path_lookup
+{{
+\tuint64_t hash;
+\tuint16_t binding_index;
+\tuint16_t path_index;
+}};
+
 typedef bool (*path_verify_fn_t)(const struct oxr_extension_status *extensions, XrVersion openxr_version, const char *, size_t);
 typedef void (*ext_verify_fn_t)(const struct oxr_extension_status *extensions, XrVersion openxr_version, bool *out_supported, bool *out_enabled);
 
@@ -970,6 +1070,7 @@ struct profile_template
 {{
 \tenum xrt_device_name name;
 \tconst char *path;
+\tuint64_t path_hash;
 \tconst char *localized_name;
 \tconst char *steamvr_input_profile_path;
 \tconst char *steamvr_controller_type;
@@ -977,6 +1078,9 @@ struct profile_template
 \tsize_t binding_count;
 \tstruct dpad_emulation *dpads;
 \tsize_t dpad_count;
+\t// All binding paths sorted by their hash.
+\tconst struct binding_path_lookup *path_lookup;
+\tsize_t path_lookup_count;
 \tstruct {{
 \t\tstruct {{
 \t\t\tuint32_t major;
@@ -997,6 +1101,20 @@ extern struct profile_template profile_templates[OXR_BINDINGS_PROFILE_TEMPLATE_C
 
 ''')
 
+    f.write('/*!\n')
+    f.write(' * Index of the first profile template for the device name, -1 if none.\n')
+    f.write(' */\n')
+    f.write('int\n')
+    f.write('oxr_bindings_profile_template_index(enum xrt_device_name name);\n\n')
+
+    f.write('/*!\n')
+    f.write(' * Find the binding paths of the template with the given oxr_path_hash,\n')
+    f.write(' * returns the first of @p out_count entries or NULL. Hashes can collide so\n')
+    f.write(' * callers compare the paths of the bindings.\n')
+    f.write(' */\n')
+    f.write('const struct binding_path_lookup *\n')
+    f.write('oxr_bindings_find_path_lookup(const struct profile_template *templ, uint64_t hash, size_t *out_count);\n\n')
+
     f.write('const char *\n')
     f.write('xrt_input_name_string(enum xrt_input_name input);\n\n')
 
@@ -13,6 +13,7 @@
 #include "m_relation_history.h"
 
 #include "math/m_api.h"
+#include "math/m_eigen_interop.hpp"
 #include "math/m_predict.h"
 #include "math/m_vec3.h"
 #include "os/os_time.h"
@@ -22,8 +23,14 @@
 #include "os/os_threading.h"
 #include "util/u_template_historybuf.hpp"
 
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <Eigen/Geometry>
+
 #include <memory>
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstring>
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,6 +40,8 @@
 
 using namespace xrt::auxiliary::util;
 namespace os = xrt::auxiliary::os;
+using xrt::auxiliary::math::map_quat;
+using xrt::auxiliary::math::map_vec3;
 
 struct relation_history_entry
 {
@@ -42,20 +51,603 @@ struct relation_history_entry
 
 static constexpr size_t BufLen = 4096;
 
+namespace {
+
+/*!
+ * Ring of relation entries with a single writer and any number of readers
+ * that never block, a seqlock over the write position.
+ *
+ * The writer bumps @p seq to odd before writing the slot of entry `h` and
+ * to even after, so `seq / 2` is the number of published entries. Readers
+ * only look at the newest `BufLen - 1` entries, so the slot being written
+ * is never one they read, and afterwards check that the writer hasn't
+ * lapped around to one of the slots they did read; if it has they retry.
+ *
+ * Slots are stored as relaxed atomic words so torn reads are harmless,
+ * just thrown away, instead of being a data race.
+ */
+class SingleWriterRing
+{
+public:
+	static constexpr size_t EntryWords = sizeof(relation_history_entry) / sizeof(uint64_t);
+	static_assert(sizeof(relation_history_entry) % sizeof(uint64_t) == 0, "Entry must be whole words");
+	static_assert(offsetof(relation_history_entry, timestamp) % sizeof(uint64_t) == 0, "Bad alignment");
+
+	/*!
+	 * Index range of readable entries, `lo` inclusive `hi` exclusive.
+	 */
+	struct Range
+	{
+		uint64_t lo;
+		uint64_t hi;
+
+		bool
+		empty() const
+		{
+			return lo >= hi;
+		}
+	};
+
+	//! Only called from the writer.
+	void
+	push(const relation_history_entry &rhe)
+	{
+		uint64_t h = mSeq.load(std::memory_order_relaxed) / 2;
+
+		mSeq.store(h * 2 + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		uint64_t words[EntryWords];
+		memcpy(words, &rhe, sizeof(rhe));
+		Slot &slot = mSlots[h % BufLen];
+		for (size_t i = 0; i < EntryWords; i++) {
+			slot.words[i].store(words[i], std::memory_order_relaxed);
+		}
+
+		mSeq.store(h * 2 + 2, std::memory_order_release);
+		mLast = rhe.timestamp;
+		mHasLast = true;
+	}
+
+	//! Only called from the writer, the writer's view of the newest timestamp.
+	bool
+	accepts(int64_t timestamp) const
+	{
+		return !mHasLast || timestamp > mLast;
+	}
+
+	//! Only called from the writer.
+	void
+	clear()
+	{
+		uint64_t h = mSeq.load(std::memory_order_relaxed) / 2;
+		mOldest.store(h, std::memory_order_release);
+		mHasLast = false;
+	}
+
+	/*!
+	 * Run @p func with the currently readable range, retrying until it
+	 * was run without the writer overwriting anything it could have read.
+	 * The function must only copy entries out, anything it reads may be
+	 * garbage on a run that gets retried.
+	 */
+	template <typename Func>
+	void
+	read(Func &&func) const
+	{
+		while (true) {
+			uint64_t s1 = mSeq.load(std::memory_order_acquire);
+			uint64_t oldest = mOldest.load(std::memory_order_acquire);
+			uint64_t hi = s1 / 2;
+			uint64_t lo = hi > BufLen - 1 ? hi - (BufLen - 1) : 0;
+			lo = std::max(lo, std::min(oldest, hi));
+
+			func(Range{lo, hi});
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t s2 = mSeq.load(std::memory_order_relaxed);
+			uint64_t oldest2 = mOldest.load(std::memory_order_relaxed);
+
+			// Highest entry index the writer has touched since we started.
+			bool lapped = s2 > 0 && (s2 - 1) / 2 >= lo + BufLen;
+			if (!lapped && oldest == oldest2) {
+				return;
+			}
+		}
+	}
+
+	relation_history_entry
+	load(uint64_t index) const
+	{
+		const Slot &slot = mSlots[index % BufLen];
+		uint64_t words[EntryWords];
+		for (size_t i = 0; i < EntryWords; i++) {
+			words[i] = slot.words[i].load(std::memory_order_relaxed);
+		}
+
+		relation_history_entry rhe;
+		memcpy(&rhe, words, sizeof(rhe));
+		return rhe;
+	}
+
+	int64_t
+	load_timestamp(uint64_t index) const
+	{
+		constexpr size_t word = offsetof(relation_history_entry, timestamp) / sizeof(uint64_t);
+		return (int64_t)mSlots[index % BufLen].words[word].load(std::memory_order_relaxed);
+	}
+
+	/*!
+	 * First index in @p range whose timestamp is not less than @p timestamp, or `range.hi`.
+	 */
+	uint64_t
+	lower_bound(Range range, int64_t timestamp) const
+	{
+		uint64_t first = range.lo;
+		uint64_t count = range.hi - range.lo;
+		while (count > 0) {
+			uint64_t step = count / 2;
+			uint64_t it = first + step;
+			if (load_timestamp(it) < timestamp) {
+				first = it + 1;
+				count -= step + 1;
+			} else {
+				count = step;
+			}
+		}
+		return first;
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> words[EntryWords];
+	};
+
+	std::atomic<uint64_t> mSeq{0};
+	std::atomic<uint64_t> mOldest{0};
+	Slot mSlots[BufLen] = {};
+
+	// Writer only state.
+	int64_t mLast{0};
+	bool mHasLast{false};
+};
+
+} // namespace
+
 struct m_relation_history
 {
-	HistoryBuffer<struct relation_history_entry, BufLen> impl;
+	//! Set if created with @ref m_relation_history_create, protected by @p mutex.
+	std::unique_ptr<HistoryBuffer<struct relation_history_entry, BufLen>> impl;
 	mutable os::Mutex mutex;
+
+	//! Set if created with @ref m_relation_history_create_single_writer, then used instead of the above.
+	std::unique_ptr<SingleWriterRing> ring;
+
+	std::atomic<m_relation_history_interpolation> interpolation{M_RELATION_HISTORY_INTERPOLATION_LINEAR};
+	std::atomic<m_relation_history_prediction> prediction{M_RELATION_HISTORY_PREDICTION_LAST_SAMPLE};
+	std::atomic<uint32_t> prediction_samples{6};
 };
 
+/*!
+ * The settings for one @ref m_relation_history_get call, loaded once so
+ * they don't change halfway through.
+ */
+struct relation_history_modes
+{
+	enum m_relation_history_interpolation interpolation;
+	enum m_relation_history_prediction prediction;
+	uint32_t prediction_samples;
+};
+
+/*!
+ * Weight of a velocity sample against a pose sample in the least squares fit,
+ * in seconds. That is the pose noise over the velocity noise, for tracked
+ * headsets around 0.2mm over 2cm/s and 0.05 degrees over 1 degree/s.
+ */
+static constexpr double kLinearVelocityWeightS = 0.01;
+static constexpr double kAngularVelocityWeightS = 0.05;
+
+/*!
+ * Pulls the fitted acceleration towards zero, a prior of about 5m/s^2 against
+ * the pose noise above, without it a few noisy samples make the quadratic
+ * term blow up at longer horizons.
+ */
+static constexpr double kAccelerationDamping = 0.00004;
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static void
+predict_from(const relation_history_entry &rhe, int64_t at_timestamp_ns, struct xrt_space_relation *out_relation)
+{
+	int64_t diff_prediction_ns = at_timestamp_ns - rhe.timestamp;
+	double delta_s = time_ns_to_s(diff_prediction_ns);
+
+	m_predict_relation(&rhe.relation, delta_s, out_relation);
+}
+
+static void
+interpolate_between(const relation_history_entry &predecessor,
+                    const relation_history_entry &successor,
+                    int64_t at_timestamp_ns,
+                    struct xrt_space_relation *out_relation)
+{
+	int64_t diff_before = static_cast<int64_t>(at_timestamp_ns) - predecessor.timestamp;
+	int64_t diff_after = static_cast<int64_t>(successor.timestamp) - at_timestamp_ns;
+
+	float amount_to_lerp = (float)diff_before / (float)(diff_before + diff_after);
+
+	// Copy intersection of relation flags
+	xrt_space_relation result{};
+	result.relation_flags = (enum xrt_space_relation_flags)(predecessor.relation.relation_flags &
+	                                                        successor.relation.relation_flags);
+	// First-order implementation - lerp between the before and after
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_POSITION_VALID_BIT)) {
+		result.pose.position =
+		    m_vec3_lerp(predecessor.relation.pose.position, successor.relation.pose.position, amount_to_lerp);
+	}
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT)) {
+
+		math_quat_slerp(&predecessor.relation.pose.orientation, &successor.relation.pose.orientation,
+		                amount_to_lerp, &result.pose.orientation);
+	}
+
+	//! @todo Does interpolating the velocities make any sense?
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT)) {
+		result.angular_velocity = m_vec3_lerp(predecessor.relation.angular_velocity,
+		                                      successor.relation.angular_velocity, amount_to_lerp);
+	}
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT)) {
+		result.linear_velocity = m_vec3_lerp(predecessor.relation.linear_velocity,
+		                                     successor.relation.linear_velocity, amount_to_lerp);
+	}
+	*out_relation = result;
+}
+
+/*!
+ * Cubic Hermite interpolation, the velocities are the tangents at each end.
+ * Starts out as the linear version and replaces position and orientation
+ * where both ends have valid velocities.
+ */
+static void
+interpolate_hermite(const relation_history_entry &predecessor,
+                    const relation_history_entry &successor,
+                    int64_t at_timestamp_ns,
+                    struct xrt_space_relation *out_relation)
+{
+	interpolate_between(predecessor, successor, at_timestamp_ns, out_relation);
+
+	float dt = (float)time_ns_to_s(successor.timestamp - predecessor.timestamp);
+	float s = (float)time_ns_to_s(at_timestamp_ns - predecessor.timestamp) / dt;
+	float s2 = s * s;
+	float s3 = s2 * s;
+
+	// Hermite basis functions and their derivatives.
+	float h00 = 2 * s3 - 3 * s2 + 1;
+	float h10 = s3 - 2 * s2 + s;
+	float h01 = -2 * s3 + 3 * s2;
+	float h11 = s3 - s2;
+	float dh00 = 6 * s2 - 6 * s;
+	float dh10 = 3 * s2 - 4 * s + 1;
+	float dh01 = -6 * s2 + 6 * s;
+	float dh11 = 3 * s2 - 2 * s;
+
+	const xrt_space_relation &a = predecessor.relation;
+	const xrt_space_relation &b = successor.relation;
+	enum xrt_space_relation_flags flags = out_relation->relation_flags;
+
+	if ((flags & XRT_SPACE_RELATION_POSITION_VALID_BIT) != 0 &&
+	    (flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT) != 0) {
+		out_relation->pose.position = a.pose.position * h00 + a.linear_velocity * (h10 * dt) +
+		                              b.pose.position * h01 + b.linear_velocity * (h11 * dt);
+
+		out_relation->linear_velocity = a.pose.position * (dh00 / dt) + a.linear_velocity * dh10 +
+		                                b.pose.position * (dh01 / dt) + b.linear_velocity * dh11;
+	}
+
+	/*
+	 * There is no closed form cubic on rotations, so integrate each end's
+	 * angular velocity towards the timestamp and blend the two with the
+	 * Hermite weight. Exact for constant angular velocity and, like the
+	 * position spline, matches both ends' velocities.
+	 */
+	if ((flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT) != 0 &&
+	    (flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT) != 0 && s > 0 && s < 1) {
+		struct xrt_vec3 half_rot_a = a.angular_velocity * (0.5f * s * dt);
+		struct xrt_vec3 half_rot_b = b.angular_velocity * (-0.5f * (1 - s) * dt);
+
+		struct xrt_quat delta_a;
+		struct xrt_quat delta_b;
+		math_quat_exp(&half_rot_a, &delta_a);
+		math_quat_exp(&half_rot_b, &delta_b);
+
+		// Angular velocities are in the base space, so the increments go on the left.
+		struct xrt_quat from_a;
+		struct xrt_quat from_b;
+		math_quat_rotate(&delta_a, &a.pose.orientation, &from_a);
+		math_quat_rotate(&delta_b, &b.pose.orientation, &from_b);
+
+		math_quat_slerp(&from_a, &from_b, h01, &out_relation->pose.orientation);
+	}
+}
+
+static void
+interpolate(const relation_history_modes &modes,
+            const relation_history_entry &predecessor,
+            const relation_history_entry &successor,
+            int64_t at_timestamp_ns,
+            struct xrt_space_relation *out_relation)
+{
+	switch (modes.interpolation) {
+	case M_RELATION_HISTORY_INTERPOLATION_HERMITE:
+		interpolate_hermite(predecessor, successor, at_timestamp_ns, out_relation);
+		break;
+	case M_RELATION_HISTORY_INTERPOLATION_LINEAR:
+	default: interpolate_between(predecessor, successor, at_timestamp_ns, out_relation); break;
+	}
+}
+
+/*!
+ * Fit `x(t) = x0 + v*t + a*t^2/2` to samples of x and of its derivative v,
+ * with t in seconds relative to the newest entry. Returns false if there
+ * is not enough to fit to.
+ */
+class ConstantAccelerationFit
+{
+public:
+	explicit ConstantAccelerationFit(double velocity_weight_s) : mVelocityWeightS(velocity_weight_s) {}
+
+	void
+	add_value(double t, const Eigen::Vector3d &value)
+	{
+		Eigen::Vector3d row(1, t, 0.5 * t * t);
+		add_row(row, value);
+		mValues++;
+	}
+
+	void
+	add_derivative(double t, const Eigen::Vector3d &derivative)
+	{
+		Eigen::Vector3d row(0, mVelocityWeightS, mVelocityWeightS * t);
+		add_row(row, derivative * mVelocityWeightS);
+	}
+
+	bool
+	solve(Eigen::Matrix3d &out_coeffs)
+	{
+		// Need two values to pin down the velocity, the damping keeps the acceleration sane.
+		if (mValues < 2) {
+			return false;
+		}
+
+		Eigen::Matrix3d ata = mAtA;
+		ata(2, 2) += kAccelerationDamping * kAccelerationDamping;
+
+		Eigen::LDLT<Eigen::Matrix3d> ldlt(ata);
+		if (ldlt.info() != Eigen::Success) {
+			return false;
+		}
+
+		out_coeffs = ldlt.solve(mAtB);
+		return out_coeffs.allFinite();
+	}
+
+private:
+	void
+	add_row(const Eigen::Vector3d &row, const Eigen::Vector3d &rhs)
+	{
+		mAtA += row * row.transpose();
+		mAtB += row * rhs.transpose();
+	}
+
+	double mVelocityWeightS;
+	Eigen::Matrix3d mAtA{Eigen::Matrix3d::Zero()};
+	//! One column per axis.
+	Eigen::Matrix3d mAtB{Eigen::Matrix3d::Zero()};
+	uint32_t mValues{0};
+};
+
+/*!
+ * Least squares prediction over @p count entries, oldest first. Orientations
+ * are fitted as rotation vectors relative to the newest one, which is fine
+ * over the short windows this gets used with.
+ */
+static void
+predict_least_squares(const relation_history_entry *entries,
+                      size_t count,
+                      int64_t at_timestamp_ns,
+                      struct xrt_space_relation *out_relation)
+{
+	const relation_history_entry &newest = entries[count - 1];
+
+	// Start from the normal prediction, for the fallback and any part we can't fit.
+	predict_from(newest, at_timestamp_ns, out_relation);
+
+	ConstantAccelerationFit position(kLinearVelocityWeightS);
+	ConstantAccelerationFit orientation(kAngularVelocityWeightS);
+
+	Eigen::Quaterniond newest_inv = map_quat(newest.relation.pose.orientation).cast<double>().conjugate();
+
+	for (size_t i = 0; i < count; i++) {
+		const xrt_space_relation &rel = entries[i].relation;
+		double t = time_ns_to_s(entries[i].timestamp - newest.timestamp);
+
+		if ((rel.relation_flags & XRT_SPACE_RELATION_POSITION_VALID_BIT) != 0) {
+			position.add_value(t, map_vec3(rel.pose.position).cast<double>());
+		}
+		if ((rel.relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT) != 0) {
+			position.add_derivative(t, map_vec3(rel.linear_velocity).cast<double>());
+		}
+		if ((rel.relation_flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT) != 0) {
+			Eigen::Quaterniond q = map_quat(rel.pose.orientation).cast<double>() * newest_inv;
+			Eigen::AngleAxisd aa(q.normalized());
+			double angle = aa.angle() > M_PI ? aa.angle() - 2 * M_PI : aa.angle();
+			orientation.add_value(t, aa.axis() * angle);
+		}
+		if ((rel.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT) != 0) {
+			orientation.add_derivative(t, map_vec3(rel.angular_velocity).cast<double>());
+		}
+	}
+
+	double dt = time_ns_to_s(at_timestamp_ns - newest.timestamp);
+	Eigen::Vector3d at_value(1, dt, 0.5 * dt * dt);
+	Eigen::Vector3d at_derivative(0, 1, dt);
+	Eigen::Matrix3d coeffs;
+
+	int flags = newest.relation.relation_flags;
+
+	if ((flags & XRT_SPACE_RELATION_POSITION_VALID_BIT) != 0 && position.solve(coeffs)) {
+		map_vec3(out_relation->pose.position) = (coeffs.transpose() * at_value).cast<float>();
+		map_vec3(out_relation->linear_velocity) = (coeffs.transpose() * at_derivative).cast<float>();
+		flags |= XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT;
+	}
+
+	if ((flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT) != 0 && orientation.solve(coeffs)) {
+		Eigen::Vector3d rot = coeffs.transpose() * at_value;
+		Eigen::Quaterniond delta(Eigen::AngleAxisd(rot.norm(), rot.normalized()));
+		if (rot.norm() == 0) {
+			delta = Eigen::Quaterniond::Identity();
+		}
+
+		Eigen::Quaterniond q = delta * newest_inv.conjugate();
+		map_quat(out_relation->pose.orientation) = q.normalized().cast<float>();
+		map_vec3(out_relation->angular_velocity) = (coeffs.transpose() * at_derivative).cast<float>();
+		flags |= XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT;
+	}
+
+	out_relation->relation_flags = (enum xrt_space_relation_flags)flags;
+}
+
+/*!
+ * Predict past the newest of the @p count entries, oldest first.
+ */
+static void
+predict(const relation_history_modes &modes,
+        const relation_history_entry *entries,
+        size_t count,
+        int64_t at_timestamp_ns,
+        struct xrt_space_relation *out_relation)
+{
+	if (modes.prediction == M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES && count >= 3) {
+		predict_least_squares(entries, count, at_timestamp_ns, out_relation);
+	} else {
+		predict_from(entries[count - 1], at_timestamp_ns, out_relation);
+	}
+}
+
+static relation_history_modes
+load_modes(const struct m_relation_history *rh)
+{
+	relation_history_modes modes;
+	modes.interpolation = rh->interpolation.load(std::memory_order_relaxed);
+	modes.prediction = rh->prediction.load(std::memory_order_relaxed);
+	modes.prediction_samples = rh->prediction_samples.load(std::memory_order_relaxed);
+	return modes;
+}
+
+static enum m_relation_history_result
+get_single_writer(const SingleWriterRing &ring,
+                  const relation_history_modes &modes,
+                  int64_t at_timestamp_ns,
+                  struct xrt_space_relation *out_relation)
+{
+	enum m_relation_history_result ret = M_RELATION_HISTORY_RESULT_INVALID;
+	relation_history_entry entries[M_RELATION_HISTORY_MAX_PREDICTION_SAMPLES];
+	size_t count = 0;
+
+	// Only copy out what we need, the maths happens once we know the copies are good.
+	ring.read([&](SingleWriterRing::Range range) {
+		count = 0;
+		if (range.empty()) {
+			ret = M_RELATION_HISTORY_RESULT_INVALID;
+			return;
+		}
+
+		uint64_t it = ring.lower_bound(range, at_timestamp_ns);
+		if (it == range.hi) {
+			size_t wanted = 1;
+			if (modes.prediction == M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES) {
+				wanted = std::min<uint64_t>(modes.prediction_samples, range.hi - range.lo);
+			}
+			for (uint64_t i = range.hi - wanted; i < range.hi; i++) {
+				entries[count++] = ring.load(i);
+			}
+			ret = M_RELATION_HISTORY_RESULT_PREDICTED;
+			return;
+		}
+
+		entries[count++] = ring.load(it);
+		if (entries[0].timestamp == at_timestamp_ns) {
+			ret = M_RELATION_HISTORY_RESULT_EXACT;
+		} else if (it == range.lo) {
+			ret = M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED;
+		} else {
+			entries[count++] = entries[0];
+			entries[0] = ring.load(it - 1);
+			ret = M_RELATION_HISTORY_RESULT_INTERPOLATED;
+		}
+	});
+
+	switch (ret) {
+	case M_RELATION_HISTORY_RESULT_INVALID: *out_relation = {}; break;
+	case M_RELATION_HISTORY_RESULT_EXACT: *out_relation = entries[0].relation; break;
+	case M_RELATION_HISTORY_RESULT_PREDICTED: predict(modes, entries, count, at_timestamp_ns, out_relation); break;
+	case M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED:
+		predict_from(entries[0], at_timestamp_ns, out_relation);
+		break;
+	case M_RELATION_HISTORY_RESULT_INTERPOLATED:
+		interpolate(modes, entries[0], entries[1], at_timestamp_ns, out_relation);
+		break;
+	}
+
+	return ret;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
 
 void
 m_relation_history_create(struct m_relation_history **rh_ptr)
 {
 	auto ret = std::make_unique<m_relation_history>();
+	ret->impl = std::make_unique<HistoryBuffer<struct relation_history_entry, BufLen>>();
+	*rh_ptr = ret.release();
+}
+
+void
+m_relation_history_create_single_writer(struct m_relation_history **rh_ptr)
+{
+	auto ret = std::make_unique<m_relation_history>();
+	ret->ring = std::make_unique<SingleWriterRing>();
 	*rh_ptr = ret.release();
 }
 
+void
+m_relation_history_set_interpolation(struct m_relation_history *rh, enum m_relation_history_interpolation mode)
+{
+	rh->interpolation.store(mode, std::memory_order_relaxed);
+}
+
+void
+m_relation_history_set_prediction(struct m_relation_history *rh,
+                                  enum m_relation_history_prediction mode,
+                                  uint32_t num_samples)
+{
+	num_samples = std::clamp<uint32_t>(num_samples, 3, M_RELATION_HISTORY_MAX_PREDICTION_SAMPLES);
+
+	rh->prediction_samples.store(num_samples, std::memory_order_relaxed);
+	rh->prediction.store(mode, std::memory_order_relaxed);
+}
+
 bool
 m_relation_history_push(struct m_relation_history *rh, struct xrt_space_relation const *in_relation, int64_t timestamp)
 {
@@ -63,15 +655,25 @@ m_relation_history_push(struct m_relation_history *rh, struct xrt_space_relation
 	struct relation_history_entry rhe;
 	rhe.relation = *in_relation;
 	rhe.timestamp = timestamp;
+
+	if (rh->ring) {
+		// Same rule as below, only monotonically increasing timestamps.
+		if (!rh->ring->accepts(timestamp)) {
+			return false;
+		}
+		rh->ring->push(rhe);
+		return true;
+	}
+
 	bool ret = false;
 	std::unique_lock<os::Mutex> lock(rh->mutex);
 	try {
 		// if we aren't empty, we can compare against the latest timestamp.
-		if (rh->impl.empty() || rhe.timestamp > rh->impl.back().timestamp) {
+		if (rh->impl->empty() || rhe.timestamp > rh->impl->back().timestamp) {
 			// Everything explodes if the timestamps in relation_history aren't monotonically increasing. If
 			// we get a timestamp that's before the most recent timestamp in the buffer, don't put it
 			// in the history.
-			rh->impl.push_back(rhe);
+			rh->impl->push_back(rhe);
 			ret = true;
 		}
 	} catch (std::exception const &e) {
@@ -86,15 +688,26 @@ m_relation_history_get(const struct m_relation_history *rh,
                        struct xrt_space_relation *out_relation)
 {
 	XRT_TRACE_MARKER();
+
+	relation_history_modes modes = load_modes(rh);
+
+	if (rh->ring) {
+		if (at_timestamp_ns == 0) {
+			*out_relation = {};
+			return M_RELATION_HISTORY_RESULT_INVALID;
+		}
+		return get_single_writer(*rh->ring, modes, at_timestamp_ns, out_relation);
+	}
+
 	std::unique_lock<os::Mutex> lock(rh->mutex);
 	try {
-		if (rh->impl.empty() || at_timestamp_ns == 0) {
+		if (rh->impl->empty() || at_timestamp_ns == 0) {
 			// Do nothing. You push nothing to the buffer you get nothing from the buffer.
 			*out_relation = {};
 			return M_RELATION_HISTORY_RESULT_INVALID;
 		}
-		const auto b = rh->impl.begin();
-		const auto e = rh->impl.end();
+		const auto b = rh->impl->begin();
+		const auto e = rh->impl->end();
 
 		// Find the first element *not less than* our value. the lambda we pass is the comparison
 		// function, to compare against timestamps.
@@ -108,12 +721,17 @@ m_relation_history_get(const struct m_relation_history *rh,
 			// The desired timestamp is after what our buffer contains.
 			// (pose-prediction)
 			// Output flags match the most recent buffer entry.
-			int64_t diff_prediction_ns = static_cast<int64_t>(at_timestamp_ns) - rh->impl.back().timestamp;
-			double delta_s = time_ns_to_s(diff_prediction_ns);
+			U_LOG_T("Extrapolating %f s past the back of the buffer!",
+			        time_ns_to_s(at_timestamp_ns - rh->impl->back().timestamp));
 
-			U_LOG_T("Extrapolating %f s past the back of the buffer!", delta_s);
+			relation_history_entry entries[M_RELATION_HISTORY_MAX_PREDICTION_SAMPLES];
+			size_t count = 1;
+			if (modes.prediction == M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES) {
+				count = std::min<size_t>(modes.prediction_samples, rh->impl->size());
+			}
+			std::copy(e - count, e, entries);
 
-			m_predict_relation(&rh->impl.back().relation, delta_s, out_relation);
+			predict(modes, entries, count, at_timestamp_ns, out_relation);
 			return M_RELATION_HISTORY_RESULT_PREDICTED;
 		}
 		if (at_timestamp_ns == it->timestamp) {
@@ -128,50 +746,16 @@ m_relation_history_get(const struct m_relation_history *rh,
 			// The desired timestamp is before what our buffer contains.
 			// (an edge case where somebody asks for a really old pose and we do our best)
 			// Output flags are the same as the input flags for the history entry we use
-			int64_t diff_prediction_ns = static_cast<int64_t>(at_timestamp_ns) - rh->impl.front().timestamp;
-			double delta_s = time_ns_to_s(diff_prediction_ns);
-			U_LOG_T("Extrapolating %f s before the front of the buffer!", delta_s);
-			m_predict_relation(&rh->impl.front().relation, delta_s, out_relation);
+			U_LOG_T("Extrapolating %f s before the front of the buffer!",
+			        time_ns_to_s(at_timestamp_ns - rh->impl->front().timestamp));
+			predict_from(rh->impl->front(), at_timestamp_ns, out_relation);
 			return M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED;
 		}
 		U_LOG_T("Interpolating within buffer!");
 
 		// We precede *it and follow *(it - 1) (which we know exists because we already handled
 		// the it = begin() case)
-		const auto &predecessor = *(it - 1);
-		const auto &successor = *it;
-
-		// Do the thing.
-		int64_t diff_before = static_cast<int64_t>(at_timestamp_ns) - predecessor.timestamp;
-		int64_t diff_after = static_cast<int64_t>(successor.timestamp) - at_timestamp_ns;
-
-		float amount_to_lerp = (float)diff_before / (float)(diff_before + diff_after);
-
-		// Copy intersection of relation flags
-		xrt_space_relation result{};
-		result.relation_flags = (enum xrt_space_relation_flags)(predecessor.relation.relation_flags &
-		                                                        successor.relation.relation_flags);
-		// First-order implementation - lerp between the before and after
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_POSITION_VALID_BIT)) {
-			result.pose.position = m_vec3_lerp(predecessor.relation.pose.position,
-			                                   successor.relation.pose.position, amount_to_lerp);
-		}
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT)) {
-
-			math_quat_slerp(&predecessor.relation.pose.orientation, &successor.relation.pose.orientation,
-			                amount_to_lerp, &result.pose.orientation);
-		}
-
-		//! @todo Does interpolating the velocities make any sense?
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT)) {
-			result.angular_velocity = m_vec3_lerp(predecessor.relation.angular_velocity,
-			                                      successor.relation.angular_velocity, amount_to_lerp);
-		}
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT)) {
-			result.linear_velocity = m_vec3_lerp(predecessor.relation.linear_velocity,
-			                                     successor.relation.linear_velocity, amount_to_lerp);
-		}
-		*out_relation = result;
+		interpolate(modes, *(it - 1), *it, at_timestamp_ns, out_relation);
 		return M_RELATION_HISTORY_RESULT_INTERPOLATED;
 
 	} catch (std::exception const &e) {
@@ -232,27 +816,54 @@ m_relation_history_get_latest(const struct m_relation_history *rh,
                               int64_t *out_time_ns,
                               struct xrt_space_relation *out_relation)
 {
+	if (rh->ring) {
+		bool ret = false;
+		relation_history_entry rhe{};
+		rh->ring->read([&](SingleWriterRing::Range range) {
+			ret = !range.empty();
+			if (ret) {
+				rhe = rh->ring->load(range.hi - 1);
+			}
+		});
+		if (ret) {
+			*out_relation = rhe.relation;
+			*out_time_ns = rhe.timestamp;
+		}
+		return ret;
+	}
+
 	std::unique_lock<os::Mutex> lock(rh->mutex);
-	if (rh->impl.empty()) {
+	if (rh->impl->empty()) {
 		return false;
 	}
-	*out_relation = rh->impl.back().relation;
-	*out_time_ns = rh->impl.back().timestamp;
+	*out_relation = rh->impl->back().relation;
+	*out_time_ns = rh->impl->back().timestamp;
 	return true;
 }
 
 uint32_t
 m_relation_history_get_size(const struct m_relation_history *rh)
 {
+	if (rh->ring) {
+		uint32_t size = 0;
+		rh->ring->read([&](SingleWriterRing::Range range) { size = (uint32_t)(range.hi - range.lo); });
+		return size;
+	}
+
 	std::unique_lock<os::Mutex> lock(rh->mutex);
-	return (uint32_t)rh->impl.size();
+	return (uint32_t)rh->impl->size();
 }
 
 void
 m_relation_history_clear(struct m_relation_history *rh)
 {
+	if (rh->ring) {
+		rh->ring->clear();
+		return;
+	}
+
 	std::unique_lock<os::Mutex> lock(rh->mutex);
-	rh->impl.clear();
+	rh->impl->clear();
 }
 
 void
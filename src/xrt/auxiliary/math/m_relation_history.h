@@ -24,6 +24,9 @@ extern "C" {
  * and is safe for concurrent access from multiple threads.
  * (It is using a simple mutex, not a reader/writer lock, but that is fine until proven to be a bottleneck.)
  *
+ * When only one thread ever pushes, create it with @ref m_relation_history_create_single_writer instead, then
+ * readers never block and never make the writer wait.
+ *
  * @ingroup aux_util
  */
 struct m_relation_history;
@@ -42,6 +45,44 @@ enum m_relation_history_result
 	M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED, //!< The desired timestamp was older than the oldest entry
 };
 
+/*!
+ * How @ref m_relation_history_get fills in timestamps between two entries.
+ *
+ * @relates m_relation_history
+ */
+enum m_relation_history_interpolation
+{
+	//! Lerp and slerp between the two neighbours, the default.
+	M_RELATION_HISTORY_INTERPOLATION_LINEAR = 0,
+
+	/*!
+	 * Cubic Hermite spline using the velocities stored in the neighbours,
+	 * falls back to linear for the parts whose velocities are not valid.
+	 */
+	M_RELATION_HISTORY_INTERPOLATION_HERMITE,
+};
+
+/*!
+ * How @ref m_relation_history_get predicts past the newest entry.
+ *
+ * @relates m_relation_history
+ */
+enum m_relation_history_prediction
+{
+	//! Extrapolate the newest entry with its own velocities, the default.
+	M_RELATION_HISTORY_PREDICTION_LAST_SAMPLE = 0,
+
+	/*!
+	 * Fit a constant acceleration model to the newest entries, both poses
+	 * and any valid velocities, and extrapolate that. Smooths over noise
+	 * in single samples and picks up acceleration the last sample can't.
+	 */
+	M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES,
+};
+
+//! Most entries the least squares predictor will look at.
+#define M_RELATION_HISTORY_MAX_PREDICTION_SAMPLES (32)
+
 /*!
  * Creates an opaque relation_history object.
  *
@@ -50,6 +91,49 @@ enum m_relation_history_result
 void
 m_relation_history_create(struct m_relation_history **rh);
 
+/*!
+ * Creates an opaque relation_history object for a single writer.
+ *
+ * Same interface as one created with @ref m_relation_history_create, but
+ * @ref m_relation_history_push and @ref m_relation_history_clear must only
+ * ever be called from one thread at a time. In return all of the read
+ * functions are lock-free and never block the writer, they retry if the
+ * writer laps them which with the size of the history practically never
+ * happens.
+ *
+ * @public @memberof m_relation_history
+ */
+void
+m_relation_history_create_single_writer(struct m_relation_history **rh);
+
+/*!
+ * Selects how timestamps between entries are interpolated, safe to call at
+ * any time from any thread.
+ *
+ * @public @memberof m_relation_history
+ */
+void
+m_relation_history_set_interpolation(struct m_relation_history *rh, enum m_relation_history_interpolation mode);
+
+/*!
+ * Selects how timestamps past the newest entry are predicted, safe to call
+ * at any time from any thread.
+ *
+ * @param rh self
+ * @param mode Prediction mode.
+ * @param num_samples How many of the newest entries the least squares
+ *                    predictor fits to, clamped to between 3 and
+ *                    @ref M_RELATION_HISTORY_MAX_PREDICTION_SAMPLES,
+ *                    6 is a good start at 60-120Hz. Ignored by the
+ *                    other modes.
+ *
+ * @public @memberof m_relation_history
+ */
+void
+m_relation_history_set_prediction(struct m_relation_history *rh,
+                                  enum m_relation_history_prediction mode,
+                                  uint32_t num_samples);
+
 /*!
  * Pushes a new pose to the history.
  *
@@ -172,6 +256,24 @@ public:
 	operator=(RelationHistory &&) = delete;
 
 
+	/*!
+	 * @copydoc m_relation_history_set_interpolation
+	 */
+	void
+	set_interpolation(m_relation_history_interpolation mode) noexcept
+	{
+		m_relation_history_set_interpolation(mPtr, mode);
+	}
+
+	/*!
+	 * @copydoc m_relation_history_set_prediction
+	 */
+	void
+	set_prediction(m_relation_history_prediction mode, uint32_t num_samples) noexcept
+	{
+		m_relation_history_set_prediction(mPtr, mode, num_samples);
+	}
+
 	/*!
 	 * @copydoc m_relation_history_push
 	 */
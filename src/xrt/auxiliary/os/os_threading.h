@@ -61,6 +61,16 @@ struct os_mutex
 #endif
 };
 
+/*!
+ * Static initialiser for a process wide @ref os_mutex, for global state that
+ * has no place to call @ref os_mutex_init from. Such a mutex is never destroyed.
+ */
+#ifndef NDEBUG
+#define OS_MUTEX_INITIALIZER {PTHREAD_MUTEX_INITIALIZER, true, false}
+#else
+#define OS_MUTEX_INITIALIZER {PTHREAD_MUTEX_INITIALIZER}
+#endif
+
 /*!
  * Init.
  *
@@ -10,35 +10,64 @@
 #include "t_euroc_recorder.h"
 
 #include "os/os_time.h"
-#include "util/u_frame.h"
-#include "util/u_sink.h"
 #include "util/u_var.h"
 #include "util/u_debug.h"
 #include "xrt/xrt_defines.h"
 #include "xrt/xrt_tracking.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstring>
 #include <ctime>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <queue>
 #include <iomanip>
 
 #include <opencv2/imgcodecs.hpp>
 
 DEBUG_GET_ONCE_BOOL_OPTION(euroc_recorder_use_jpg, "EUROC_RECORDER_USE_JPG", false)
-
+//! One of png, jpg or pnm, pnm is uncompressed and the fastest to write.
+DEBUG_GET_ONCE_OPTION(euroc_recorder_image_format, "EUROC_RECORDER_IMAGE_FORMAT", NULL)
+//! Number of threads writing images, zero for one per camera.
+DEBUG_GET_ONCE_NUM_OPTION(euroc_recorder_threads, "EUROC_RECORDER_THREADS", 0)
+//! How many frames per camera can wait to be written before new ones are dropped.
+DEBUG_GET_ONCE_NUM_OPTION(euroc_recorder_queue_size, "EUROC_RECORDER_QUEUE_SIZE", 8)
+
+using std::condition_variable;
+using std::deque;
 using std::lock_guard;
 using std::mutex;
 using std::ofstream;
 using std::queue;
 using std::string;
+using std::thread;
 using std::to_string;
+using std::unique_lock;
 using std::vector;
 using std::filesystem::create_directories;
 
+enum euroc_recorder_image_format
+{
+	EUROC_RECORDER_IMAGE_PNG,
+	EUROC_RECORDER_IMAGE_JPG,
+	EUROC_RECORDER_IMAGE_PNM, //!< .pgm or .ppm depending on the frame format
+};
+
+//! A frame waiting to be written to disk by one of the workers.
+struct euroc_recorder_job
+{
+	struct xrt_frame *frame; //!< Reference held until written
+	int cam_index;
+	string img_path;
+};
+
 struct euroc_recorder
 {
 	struct xrt_frame_node node;
@@ -49,19 +78,32 @@ struct euroc_recorder
 	bool recording;                    //!< Whether samples are being recorded
 	struct u_var_button recording_btn; //!< UI button to start/stop `recording`
 
-	bool use_jpg; //! Whether or not we should save images as .jpg files
+	enum euroc_recorder_image_format image_format; //!< How images are saved
 
-	// Cloner sinks: copy frame to heap for quick release of the original
-	struct xrt_slam_sinks cloner_queues; //!< Queue sinks that write into cloner sinks
-	struct xrt_imu_sink cloner_imu_sink;
-	struct xrt_pose_sink cloner_gt_sink;
-	struct xrt_frame_sink cloner_sinks[XRT_TRACKING_MAX_SLAM_CAMS];
+	// Receiver sinks: the ones exposed to users, they only queue samples
+	struct xrt_slam_sinks receiver_sinks; //!< Public sinks pointing to the receivers below
+	struct xrt_imu_sink receiver_imu_sink;
+	struct xrt_pose_sink receiver_gt_sink;
+	struct xrt_frame_sink receiver_cam_sinks[XRT_TRACKING_MAX_SLAM_CAMS];
 
-	// Writer sinks: write copied frame to disk
-	struct xrt_slam_sinks writer_queues; //!< Queue sinks that write into writer sinks
+	// Writer sinks: write samples to the csv files
 	struct xrt_imu_sink writer_imu_sink;
 	struct xrt_pose_sink writer_gt_sink;
-	struct xrt_frame_sink writer_sinks[XRT_TRACKING_MAX_SLAM_CAMS];
+
+	// Image writing workers, frames are written to disk off the capture threads
+	vector<thread> workers{};
+	deque<euroc_recorder_job> jobs{}; //!< Frames waiting for a worker, at most `max_jobs` per camera
+	size_t max_jobs = 0;
+	//! How many of `jobs` are from each camera
+	size_t queued_jobs[XRT_TRACKING_MAX_SLAM_CAMS] = {};
+	int busy_workers = 0;         //!< Workers currently writing a frame
+	bool workers_running = false; //!< Cleared to make the workers exit once `jobs` is empty
+	mutex jobs_lock{};            //!< Lock for all of the worker fields
+	condition_variable jobs_cv{}; //!< Signaled on new jobs and when stopping
+	condition_variable idle_cv{}; //!< Signaled when a worker finishes a job
+
+	uint64_t dropped_frames[XRT_TRACKING_MAX_SLAM_CAMS] = {}; //!< Frames the workers couldn't keep up with
+	mutex csv_lock{}; //!< Lock for the csv streams, written from both capture and worker threads
 
 	queue<xrt_imu_sample> imu_queue{}; //!< IMU pushes get saved here and are delayed until left_frame pushes
 	mutex imu_queue_lock{};            //!< Lock for imu_queue
@@ -181,64 +223,100 @@ euroc_recorder_save_gt(xrt_pose_sink *sink, struct xrt_pose_sample *sample)
 	*er->gt_csv << o.w << "," << o.x << "," << o.y << "," << o.z << CSV_EOL;
 }
 
+static const char *
+euroc_recorder_get_extension(euroc_recorder *er, struct xrt_frame *frame)
+{
+	switch (er->image_format) {
+	case EUROC_RECORDER_IMAGE_JPG: return ".jpg";
+	case EUROC_RECORDER_IMAGE_PNM: return frame->format == XRT_FORMAT_L8 ? ".pgm" : ".ppm";
+	default: return ".png";
+	}
+}
+
 static void
-euroc_recorder_save_frame(euroc_recorder *er, struct xrt_frame *frame, int cam_index)
+euroc_recorder_write_image(euroc_recorder_job &job)
 {
-	string cam_name = "cam" + to_string(cam_index);
-	uint64_t ts = frame->timestamp;
+	struct xrt_frame *frame = job.frame;
 
 	assert(frame->format == XRT_FORMAT_L8 || frame->format == XRT_FORMAT_R8G8B8); // Only formats supported
 	auto img_type = frame->format == XRT_FORMAT_L8 ? CV_8UC1 : CV_8UC3;
-	string file_extension = er->use_jpg ? ".jpg" : ".png";
-	string filename = std::to_string(ts) + file_extension;
-	string img_path = er->path + "/mav0/" + cam_name + "/data/" + filename;
 	cv::Mat img{(int)frame->height, (int)frame->width, img_type, frame->data, frame->stride};
-	cv::imwrite(img_path, img);
 
-	*er->cams_csv[cam_index] << ts << "," << filename << CSV_EOL;
+	if (!cv::imwrite(job.img_path, img)) {
+		U_LOG_E("Failed to write '%s'", job.img_path.c_str());
+	}
 }
 
-#define DEFINE_SAVE_CAM(cam_id)                                                                                        \
-	extern "C" void euroc_recorder_save_cam##cam_id(struct xrt_frame_sink *sink, struct xrt_frame *frame)          \
-	{                                                                                                              \
-		euroc_recorder *er = container_of(sink, euroc_recorder, writer_sinks[cam_id]);                         \
-		if (cam_id == 0) {                                                                                     \
-			euroc_recorder_flush(er);                                                                      \
-		}                                                                                                      \
-		euroc_recorder_save_frame(er, frame, cam_id);                                                          \
+static void
+euroc_recorder_run_worker(euroc_recorder *er)
+{
+	unique_lock lock{er->jobs_lock};
+
+	while (true) {
+		er->jobs_cv.wait(lock, [er] { return !er->jobs.empty() || !er->workers_running; });
+
+		// Only exit once everything queued is written, the csv files already list them.
+		if (er->jobs.empty()) {
+			break;
+		}
+
+		euroc_recorder_job job = std::move(er->jobs.front());
+		er->jobs.pop_front();
+		er->queued_jobs[job.cam_index]--;
+		er->busy_workers++;
+		lock.unlock();
+
+		// Same cadence as before, write the IMU and GT samples along with cam0.
+		if (job.cam_index == 0) {
+			lock_guard csv_lock{er->csv_lock};
+			euroc_recorder_flush(er);
+		}
+
+		euroc_recorder_write_image(job);
+		xrt_frame_reference(&job.frame, NULL);
+
+		lock.lock();
+		er->busy_workers--;
+		er->idle_cv.notify_all();
 	}
+}
 
-DEFINE_SAVE_CAM(0)
-DEFINE_SAVE_CAM(1)
-DEFINE_SAVE_CAM(2)
-DEFINE_SAVE_CAM(3)
-DEFINE_SAVE_CAM(4)
+//! Wait for the workers to write all queued frames.
+static void
+euroc_recorder_wait_idle(euroc_recorder *er)
+{
+	unique_lock lock{er->jobs_lock};
+	er->idle_cv.wait(lock, [er] { return er->jobs.empty() && er->busy_workers == 0; });
+}
 
-//! Be sure to define the same number of defined functions as
-//! XRT_TRACKING_MAX_SLAM_CAMS and to add them to to euroc_recorder_save_cam
-static void (*euroc_recorder_save_cam[XRT_TRACKING_MAX_SLAM_CAMS])(struct xrt_frame_sink *sink,
-                                                                   struct xrt_frame *frame) = {
-    euroc_recorder_save_cam0, //
-    euroc_recorder_save_cam1, //
-    euroc_recorder_save_cam2, //
-    euroc_recorder_save_cam3, //
-    euroc_recorder_save_cam4, //
-};
+static void
+euroc_recorder_stop_workers(euroc_recorder *er)
+{
+	{
+		lock_guard lock{er->jobs_lock};
+		er->workers_running = false;
+	}
+	er->jobs_cv.notify_all();
+
+	for (thread &worker : er->workers) {
+		worker.join();
+	}
+	er->workers.clear();
+}
 
 
 /*
  *
- * Cloner sinks functionality
+ * Receiver sinks functionality
  *
  */
 
 extern "C" void
 euroc_recorder_receive_imu(xrt_imu_sink *sink, struct xrt_imu_sample *sample)
 {
-	// Contrary to frame sinks, we don't have separately threaded queues for IMU
-	// sinks so we use an std::queue to temporarily store IMU samples, later we
+	// We use an std::queue to temporarily store IMU samples, later the workers
 	// write them to disk when writing left frames.
-	euroc_recorder *er = container_of(sink, euroc_recorder, cloner_imu_sink);
+	euroc_recorder *er = container_of(sink, euroc_recorder, receiver_imu_sink);
 
 	if (!er->recording) {
 		return;
@@ -254,7 +332,7 @@ extern "C" void
 euroc_recorder_receive_gt(xrt_pose_sink *sink, struct xrt_pose_sample *sample)
 {
 	// This works similarly to euroc_recorder_receive_imu, read its comments
-	euroc_recorder *er = container_of(sink, euroc_recorder, cloner_gt_sink);
+	euroc_recorder *er = container_of(sink, euroc_recorder, receiver_gt_sink);
 
 	if (!er->recording) {
 		return;
@@ -268,25 +346,50 @@ euroc_recorder_receive_gt(xrt_pose_sink *sink, struct xrt_pose_sample *sample)
 
 
 static void
-euroc_recorder_receive_frame(euroc_recorder *er, struct xrt_frame *src_frame, int cam_index)
+euroc_recorder_receive_frame(euroc_recorder *er, struct xrt_frame *frame, int cam_index)
 {
 	if (!er->recording) {
 		return;
 	}
 
-	// Let's clone the frame so that we can release the src_frame quickly
-	xrt_frame *copy = nullptr;
-	u_frame_clone(src_frame, &copy);
+	uint64_t ts = frame->timestamp;
+	string filename = std::to_string(ts) + euroc_recorder_get_extension(er, frame);
+	string cam_name = "cam" + to_string(cam_index);
+
+	{
+		lock_guard lock{er->jobs_lock};
+
+		// Nobody would write or release it once the workers are stopped.
+		if (!er->workers_running) {
+			return;
+		}
 
-	xrt_sink_push_frame(er->writer_queues.cams[cam_index], copy);
+		// Drop instead of blocking the capture thread or holding on to too many of its frames.
+		if (er->queued_jobs[cam_index] >= er->max_jobs) {
+			er->dropped_frames[cam_index]++;
+			return;
+		}
+
+		// Keep a reference instead of copying, the queue bound limits how many are held.
+		euroc_recorder_job job{};
+		xrt_frame_reference(&job.frame, frame);
+		job.cam_index = cam_index;
+		job.img_path = er->path + "/mav0/" + cam_name + "/data/" + filename;
+		er->jobs.push_back(std::move(job));
+		er->queued_jobs[cam_index]++;
+	}
 
-	xrt_frame_reference(&copy, NULL);
+	er->jobs_cv.notify_one();
+
+	// Written here so the csv stays in capture order, whichever worker finishes first.
+	lock_guard csv_lock{er->csv_lock};
+	*er->cams_csv[cam_index] << ts << "," << filename << CSV_EOL;
 }
 
 #define DEFINE_RECEIVE_CAM(cam_id)                                                                                     \
 	extern "C" void euroc_recorder_receive_cam##cam_id(struct xrt_frame_sink *sink, struct xrt_frame *frame)       \
 	{                                                                                                              \
-		euroc_recorder *er = container_of(sink, euroc_recorder, cloner_sinks[cam_id]);                         \
+		euroc_recorder *er = container_of(sink, euroc_recorder, receiver_cam_sinks[cam_id]);                   \
 		euroc_recorder_receive_frame(er, frame, cam_id);                                                       \
 	}
 
@@ -316,12 +419,24 @@ static void (*euroc_recorder_receive_cam[XRT_TRACKING_MAX_SLAM_CAMS])(struct xrt
 
 extern "C" void
 euroc_recorder_node_break_apart(struct xrt_frame_node *node)
-{}
+{
+	struct euroc_recorder *er = container_of(node, struct euroc_recorder, node);
+
+	// Writes out what is queued and releases the frames before the sources go away.
+	euroc_recorder_stop_workers(er);
+}
 
 extern "C" void
 euroc_recorder_node_destroy(struct xrt_frame_node *node)
 {
 	struct euroc_recorder *er = container_of(node, struct euroc_recorder, node);
+
+	// The workers are stopped, release anything they didn't get to.
+	for (euroc_recorder_job &job : er->jobs) {
+		xrt_frame_reference(&job.frame, NULL);
+	}
+	er->jobs.clear();
+
 	delete er->imu_csv;
 	delete er->gt_csv;
 	for (int i = 0; i < er->cam_count; i++) {
@@ -351,42 +466,54 @@ euroc_recorder_create(struct xrt_frame_context *xfctx, const char *record_path,
 	xfn->destroy = euroc_recorder_node_destroy;
 	xrt_frame_context_add(xfctx, xfn);
 
-	er->use_jpg = debug_get_bool_option_euroc_recorder_use_jpg();
+	const char *image_format = debug_get_option_euroc_recorder_image_format();
+	if (image_format != nullptr && strcmp(image_format, "pnm") == 0) {
+		er->image_format = EUROC_RECORDER_IMAGE_PNM;
+	} else if ((image_format != nullptr && strcmp(image_format, "jpg") == 0) ||
+	           debug_get_bool_option_euroc_recorder_use_jpg()) {
+		er->image_format = EUROC_RECORDER_IMAGE_JPG;
+	} else {
+		er->image_format = EUROC_RECORDER_IMAGE_PNG;
+	}
 
 	// Setup sink pipeline
 
-	// We expose a "cloner" sink that will clone frames in memory so that original
-	// frames can be released as soon as possible. Not doing this could result in
-	// frame queues from the user being filled up. After that we write to disk. We
-	// also put queues between these to support sensors streaming on different
-	// threads.
-	// cloner_queue -> cloner_sink (clone ) -> writer_queue -> writer_sink (write to disk)
+	// The receiver sinks only queue a reference to the frame, so the capture
+	// threads are never blocked by encoding or disk IO. A pool of workers then
+	// writes them to disk. When the workers fall behind frames are dropped and
+	// counted, instead of the queue growing and holding on to more of the
+	// source's frames.
+	// receiver_sink (queue reference) -> worker (encode and write to disk)
 
-	er->cloner_queues.cam_count = er->cam_count;
-	er->writer_queues.cam_count = er->cam_count;
+	er->receiver_sinks.cam_count = er->cam_count;
 	for (int i = 0; i < er->cam_count; i++) {
 
-		// If any of these asserts failed see docs on euroc_recorder_receive/save_cam
+		// If this assert failed see docs on euroc_recorder_receive_cam
 		assert(euroc_recorder_receive_cam[ARRAY_SIZE(euroc_recorder_receive_cam) - 1] != nullptr);
-		assert(euroc_recorder_save_cam[ARRAY_SIZE(euroc_recorder_save_cam) - 1] != nullptr);
 
-		u_sink_queue_create(xfctx, 0, &er->cloner_sinks[i], &er->cloner_queues.cams[i]);
-		er->cloner_sinks[i].push_frame = euroc_recorder_receive_cam[i];
-		u_sink_queue_create(xfctx, 0, &er->writer_sinks[i], &er->writer_queues.cams[i]);
-		er->writer_sinks[i].push_frame = euroc_recorder_save_cam[i];
+		er->receiver_cam_sinks[i].push_frame = euroc_recorder_receive_cam[i];
+		er->receiver_sinks.cams[i] = &er->receiver_cam_sinks[i];
 	}
 
-	er->cloner_queues.imu = &er->cloner_imu_sink;
-	er->cloner_imu_sink.push_imu = euroc_recorder_receive_imu;
-	er->writer_queues.imu = nullptr; // We use a std::queue instead
+	er->receiver_sinks.imu = &er->receiver_imu_sink;
+	er->receiver_imu_sink.push_imu = euroc_recorder_receive_imu;
 	er->writer_imu_sink.push_imu = euroc_recorder_save_imu;
 
-	er->cloner_queues.gt = &er->cloner_gt_sink;
-	er->cloner_gt_sink.push_pose = euroc_recorder_receive_gt;
-	er->writer_queues.gt = nullptr; // We use a std::queue instead
+	er->receiver_sinks.gt = &er->receiver_gt_sink;
+	er->receiver_gt_sink.push_pose = euroc_recorder_receive_gt;
 	er->writer_gt_sink.push_pose = euroc_recorder_save_gt;
 
-	xrt_slam_sinks *public_sinks = &er->cloner_queues;
+	int64_t queue_size = debug_get_num_option_euroc_recorder_queue_size();
+	int64_t worker_count = debug_get_num_option_euroc_recorder_threads();
+	er->max_jobs = (size_t)std::max<int64_t>(queue_size, 1);
+	worker_count = worker_count > 0 ? worker_count : er->cam_count;
+
+	er->workers_running = true;
+	for (int64_t i = 0; i < worker_count; i++) {
+		er->workers.emplace_back(euroc_recorder_run_worker, er);
+	}
+
+	xrt_slam_sinks *public_sinks = &er->receiver_sinks;
 
 	if (record_from_start) {
 		euroc_recorder_start(public_sinks);
@@ -398,7 +525,7 @@ euroc_recorder_create(struct xrt_frame_context *xfctx, const char *record_path,
 extern "C" void
 euroc_recorder_start(struct xrt_slam_sinks *er_sinks)
 {
-	euroc_recorder *er = container_of(er_sinks, euroc_recorder, cloner_queues);
+	euroc_recorder *er = container_of(er_sinks, euroc_recorder, receiver_sinks);
 
 	if (er->recording) {
 		U_LOG_W("We are already recording; unable to start.");
@@ -413,6 +540,10 @@ euroc_recorder_start(struct xrt_slam_sinks *er_sinks)
 	string default_path = er->path_prefix + "_" + datetime;
 	er->path = default_path;
 
+	for (int i = 0; i < er->cam_count; i++) {
+		er->dropped_frames[i] = 0;
+	}
+
 	euroc_recorder_mkfiles(er);
 	er->recording = true;
 }
@@ -420,7 +551,7 @@ euroc_recorder_start(struct xrt_slam_sinks *er_sinks)
 extern "C" void
 euroc_recorder_stop(struct xrt_slam_sinks *er_sinks)
 {
-	euroc_recorder *er = container_of(er_sinks, euroc_recorder, cloner_queues);
+	euroc_recorder *er = container_of(er_sinks, euroc_recorder, receiver_sinks);
 
 	if (!er->recording) {
 		U_LOG_W("We are already not recording; unable to stop.");
@@ -429,7 +560,22 @@ euroc_recorder_stop(struct xrt_slam_sinks *er_sinks)
 
 	er->path = "";
 	er->recording = false;
-	euroc_recorder_flush(er);
+
+	// Let the workers finish writing the frames the csv files already list.
+	euroc_recorder_wait_idle(er);
+
+	{
+		lock_guard csv_lock{er->csv_lock};
+		euroc_recorder_flush(er);
+	}
+
+	uint64_t dropped = 0;
+	for (int i = 0; i < er->cam_count; i++) {
+		dropped += er->dropped_frames[i];
+	}
+	if (dropped > 0) {
+		U_LOG_W("Dropped %" PRIu64 " frames while recording, try EUROC_RECORDER_IMAGE_FORMAT=pnm.", dropped);
+	}
 }
 
 static void
@@ -438,10 +584,10 @@ euroc_recorder_btn_cb(void *ptr)
 	euroc_recorder *er = (euroc_recorder *)ptr;
 
 	if (er->recording) {
-		euroc_recorder_stop(&er->cloner_queues);
+		euroc_recorder_stop(&er->receiver_sinks);
 		(void)snprintf(er->recording_btn.label, sizeof(er->recording_btn.label), "Record EuRoC dataset");
 	} else {
-		euroc_recorder_start(&er->cloner_queues);
+		euroc_recorder_start(&er->receiver_sinks);
 		(void)snprintf(er->recording_btn.label, sizeof(er->recording_btn.label), "Stop recording");
 	}
 }
@@ -449,11 +595,16 @@ euroc_recorder_btn_cb(void *ptr)
 extern "C" void
 euroc_recorder_add_ui(struct xrt_slam_sinks *er_sinks, void *root, const char *prefix)
 {
-	euroc_recorder *er = container_of(er_sinks, euroc_recorder, cloner_queues);
+	euroc_recorder *er = container_of(er_sinks, euroc_recorder, receiver_sinks);
 	er->recording_btn.cb = euroc_recorder_btn_cb;
 	er->recording_btn.ptr = er;
 
 	char tmp[256];
 	(void)snprintf(tmp, sizeof(tmp), "%s%s", prefix, er->recording ? "Stop recording" : "Record EuRoC dataset");
 	u_var_add_button(root, &er->recording_btn, tmp);
+
+	for (int i = 0; i < er->cam_count; i++) {
+		(void)snprintf(tmp, sizeof(tmp), "%sDropped frames cam%d", prefix, i);
+		u_var_add_ro_u64(root, &er->dropped_frames[i], tmp);
+	}
 }
@@ -321,6 +321,8 @@ hsv_destroy(struct xrt_frame_node *node)
 		u_sink_debug_destroy(&f->usds[i]);
 	}
 
+	u_frame_pool_remove_user();
+
 	free(f);
 }
 
@@ -342,6 +344,8 @@ t_hsv_filter_create(struct xrt_frame_context *xfctx,
 
 	t_hsv_build_optimized_table(&f->params, &f->table);
 
+	u_frame_pool_add_user();
+
 	xrt_frame_context_add(xfctx, &f->node);
 
 	for (size_t i = 0; i < NUM_CHANNELS; i++) {
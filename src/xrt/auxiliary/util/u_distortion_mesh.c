@@ -12,6 +12,7 @@
 #include "util/u_frame.h"
 #include "util/u_debug.h"
 #include "util/u_format.h"
+#include "util/u_worker.h"
 #include "util/u_distortion_mesh.h"
 
 #include "math/m_vec2.h"
@@ -23,6 +24,10 @@
 
 
 DEBUG_GET_ONCE_NUM_OPTION(mesh_size, "XRT_MESH_SIZE", 64)
+DEBUG_GET_ONCE_NUM_OPTION(distortion_threads, "XRT_DISTORTION_THREADS", 4)
+
+//! Points given to each worker task, big enough that pushing the task is noise.
+#define POINTS_PER_TASK (2048)
 
 
 typedef bool (*func_calc)(struct xrt_device *xdev, uint32_t view, float u, float v, struct xrt_uv_triplet *result);
@@ -33,7 +38,56 @@ index_for(int row, int col, uint32_t stride, uint32_t offset)
 	return row * stride + col + offset;
 }
 
+/*!
+ * A range of points for one worker to compute.
+ */
+struct compute_task
+{
+	struct xrt_device *xdev;
+	uint32_t view;
+	uint32_t count;
+	const struct xrt_vec2 *uvs;
+	struct xrt_uv_triplet *results;
+	bool success;
+};
+
 static void
+compute_task_func(void *ptr)
+{
+	struct compute_task *task = (struct compute_task *)ptr;
+
+	task->success = xrt_device_compute_distortion_batch( //
+	    task->xdev,                                      // xdev
+	    task->view,                                      // view
+	    task->count,                                     // count
+	    task->uvs,                                       // uvs
+	    task->results);                                  // out_results
+}
+
+static bool
+compute_view(struct xrt_device *xdev,
+             struct u_worker_thread_pool *pool,
+             func_calc calc,
+             uint32_t view,
+             uint32_t count,
+             const struct xrt_vec2 *uvs,
+             struct xrt_uv_triplet *results)
+{
+	// Only the device's own function can be batched, it is spread out over threads if the device opts in.
+	if (calc == xdev->compute_distortion) {
+		return u_distortion_compute_points(xdev, pool, view, count, uvs, results);
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (!calc(xdev, view, uvs[i].x, uvs[i].y, &results[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool
 run_func(struct xrt_device *xdev, func_calc calc, struct xrt_hmd_parts *target, uint32_t num)
 {
 	assert(calc != NULL);
@@ -57,34 +111,55 @@ run_func(struct xrt_device *xdev, func_calc calc, struct xrt_hmd_parts *target,
 
 	float *verts = U_TYPED_ARRAY_CALLOC(float, float_count);
 
+	// The points are computed in one go per view, then copied into the vertices.
+	struct xrt_vec2 *uvs = U_TYPED_ARRAY_CALLOC(struct xrt_vec2, vertex_count_per_view);
+	struct xrt_uv_triplet *results = U_TYPED_ARRAY_CALLOC(struct xrt_uv_triplet, vertex_count_per_view);
+
+	for (uint32_t r = 0; r < vert_rows; r++) {
+		// This goes from 0 to 1.0 inclusive.
+		float v = (float)r / (float)cells_rows;
+
+		for (uint32_t c = 0; c < vert_cols; c++) {
+			// This goes from 0 to 1.0 inclusive.
+			float u = (float)c / (float)cells_cols;
+
+			uvs[r * vert_cols + c] = (struct xrt_vec2){u, v};
+		}
+	}
+
+	// Shared by all views, so the threads are only started once.
+	struct u_worker_thread_pool *pool = u_distortion_thread_pool_create();
+
 	// Setup the vertices for all views.
 	uint32_t i = 0;
 	for (uint32_t view = 0; view < view_count; view++) {
 		vertex_offsets[view] = i / stride_in_floats;
 
-		for (uint32_t r = 0; r < vert_rows; r++) {
-			// This goes from 0 to 1.0 inclusive.
-			float v = (float)r / (float)cells_rows;
-
-			for (uint32_t c = 0; c < vert_cols; c++) {
-				// This goes from 0 to 1.0 inclusive.
-				float u = (float)c / (float)cells_cols;
+		if (!compute_view(xdev, pool, calc, view, vertex_count_per_view, uvs, results)) {
+			// bail on error, without updating
+			// distortion.preferred
+			u_worker_thread_pool_reference(&pool, NULL);
+			free(verts);
+			free(uvs);
+			free(results);
+			return false;
+		}
 
-				// Make the position in the range of [-1, 1]
-				verts[i + 0] = u * 2.0f - 1.0f;
-				verts[i + 1] = v * 2.0f - 1.0f;
+		for (uint32_t k = 0; k < vertex_count_per_view; k++) {
+			// Make the position in the range of [-1, 1]
+			verts[i + 0] = uvs[k].x * 2.0f - 1.0f;
+			verts[i + 1] = uvs[k].y * 2.0f - 1.0f;
 
-				if (!calc(xdev, view, u, v, (struct xrt_uv_triplet *)&verts[i + 2])) {
-					// bail on error, without updating
-					// distortion.preferred
-					return;
-				}
+			*(struct xrt_uv_triplet *)&verts[i + 2] = results[k];
 
-				i += stride_in_floats;
-			}
+			i += stride_in_floats;
 		}
 	}
 
+	u_worker_thread_pool_reference(&pool, NULL);
+	free(uvs);
+	free(results);
+
 	uint32_t index_count_per_view = cells_rows * (vert_cols * 2 + 2);
 	uint32_t index_count_total = index_count_per_view * view_count;
 	int *indices = U_TYPED_ARRAY_CALLOC(int, index_count_total);
@@ -122,20 +197,13 @@ run_func(struct xrt_device *xdev, func_calc calc, struct xrt_hmd_parts *target,
 		target->distortion.mesh.index_counts[view] = index_count_per_view;
 		target->distortion.mesh.index_offsets[view] = index_offsets[view];
 	}
+
+	return true;
 }
 
-bool
-u_compute_distortion_vive(struct u_vive_values *values, float u, float v, struct xrt_uv_triplet *result)
+static inline void
+vive_point(const struct u_vive_values *val, struct xrt_vec2 factor, float u, float v, struct xrt_uv_triplet *result)
 {
-	// Reading the whole struct like this gives the compiler more opportunity to optimize.
-	const struct u_vive_values val = *values;
-
-	const float common_factor_value = 0.5f / (1.0f + val.grow_for_undistort);
-	const struct xrt_vec2 factor = {
-	    common_factor_value,
-	    common_factor_value * val.aspect_x_over_y,
-	};
-
 	// Results r/g/b.
 	struct xrt_vec2 tc[3] = {{0, 0}, {0, 0}, {0, 0}};
 
@@ -146,15 +214,15 @@ u_compute_distortion_vive(struct u_vive_values *values, float u, float v, struct
 		    2.f * v - 1.f,
 		};
 
-		texCoord.y /= val.aspect_x_over_y;
-		texCoord.x -= val.center[i].x;
-		texCoord.y -= val.center[i].y;
+		texCoord.y /= val->aspect_x_over_y;
+		texCoord.x -= val->center[i].x;
+		texCoord.y -= val->center[i].y;
 
 		float r2 = m_vec2_dot(texCoord, texCoord);
-		float k1 = val.coefficients[i][0];
-		float k2 = val.coefficients[i][1];
-		float k3 = val.coefficients[i][2];
-		float k4 = val.coefficients[i][3];
+		float k1 = val->coefficients[i][0];
+		float k2 = val->coefficients[i][1];
+		float k3 = val->coefficients[i][2];
+		float k4 = val->coefficients[i][3];
 
 		/*
 		 *                     1.0
@@ -174,13 +242,50 @@ u_compute_distortion_vive(struct u_vive_values *values, float u, float v, struct
 
 		struct xrt_vec2 offset = {0.5f, 0.5f};
 
-		tc[i].x = offset.x + (texCoord.x * d + val.center[i].x) * factor.x;
-		tc[i].y = offset.y + (texCoord.y * d + val.center[i].y) * factor.y;
+		tc[i].x = offset.x + (texCoord.x * d + val->center[i].x) * factor.x;
+		tc[i].y = offset.y + (texCoord.y * d + val->center[i].y) * factor.y;
 	}
 
 	result->r = tc[0];
 	result->g = tc[1];
 	result->b = tc[2];
+}
+
+static inline struct xrt_vec2
+vive_factor(const struct u_vive_values *val)
+{
+	const float common_factor_value = 0.5f / (1.0f + val->grow_for_undistort);
+	const struct xrt_vec2 factor = {
+	    common_factor_value,
+	    common_factor_value * val->aspect_x_over_y,
+	};
+
+	return factor;
+}
+
+bool
+u_compute_distortion_vive(struct u_vive_values *values, float u, float v, struct xrt_uv_triplet *result)
+{
+	// Reading the whole struct like this gives the compiler more opportunity to optimize.
+	const struct u_vive_values val = *values;
+
+	vive_point(&val, vive_factor(&val), u, v, result);
+
+	return true;
+}
+
+bool
+u_compute_distortion_vive_batch(struct u_vive_values *values,
+                                uint32_t count,
+                                const struct xrt_vec2 *uvs,
+                                struct xrt_uv_triplet *results)
+{
+	const struct u_vive_values val = *values;
+	const struct xrt_vec2 factor = vive_factor(&val);
+
+	for (uint32_t i = 0; i < count; i++) {
+		vive_point(&val, factor, uvs[i].x, uvs[i].y, &results[i]);
+	}
 
 	return true;
 }
@@ -195,8 +300,8 @@ u_compute_distortion_vive(struct u_vive_values *values, float u, float v, struct
 #define len m_vec2_len
 #define len_sqrd m_vec2_len_sqrd
 
-bool
-u_compute_distortion_panotools(struct u_panotools_values *values, float u, float v, struct xrt_uv_triplet *result)
+static inline void
+panotools_point(const struct u_panotools_values *values, float u, float v, struct xrt_uv_triplet *result)
 {
 	const struct u_panotools_values val = *values;
 
@@ -230,14 +335,32 @@ u_compute_distortion_panotools(struct u_panotools_values *values, float u, float
 	result->r = r_uv;
 	result->g = g_uv;
 	result->b = b_uv;
+}
+
+bool
+u_compute_distortion_panotools(struct u_panotools_values *values, float u, float v, struct xrt_uv_triplet *result)
+{
+	panotools_point(values, u, v, result);
 	return true;
 }
 
 bool
-u_compute_distortion_cardboard(struct u_cardboard_distortion_values *values,
-                               float u,
-                               float v,
-                               struct xrt_uv_triplet *result)
+u_compute_distortion_panotools_batch(struct u_panotools_values *values,
+                                     uint32_t count,
+                                     const struct xrt_vec2 *uvs,
+                                     struct xrt_uv_triplet *results)
+{
+	const struct u_panotools_values val = *values;
+
+	for (uint32_t i = 0; i < count; i++) {
+		panotools_point(&val, uvs[i].x, uvs[i].y, &results[i]);
+	}
+
+	return true;
+}
+
+static inline void
+cardboard_point(const struct u_cardboard_distortion_values *values, float u, float v, struct xrt_uv_triplet *result)
 {
 	struct xrt_vec2 uv = {u, v};
 	uv = sub(mul(uv, values->screen.size), values->screen.offset);
@@ -266,6 +389,30 @@ u_compute_distortion_cardboard(struct u_cardboard_distortion_values *values,
 	result->g.y = uv.y;
 	result->b.x = uv.x;
 	result->b.y = uv.y;
+}
+
+bool
+u_compute_distortion_cardboard(struct u_cardboard_distortion_values *values,
+                               float u,
+                               float v,
+                               struct xrt_uv_triplet *result)
+{
+	cardboard_point(values, u, v, result);
+	return true;
+}
+
+bool
+u_compute_distortion_cardboard_batch(struct u_cardboard_distortion_values *values,
+                                     uint32_t count,
+                                     const struct xrt_vec2 *uvs,
+                                     struct xrt_uv_triplet *results)
+{
+	const struct u_cardboard_distortion_values val = *values;
+
+	for (uint32_t i = 0; i < count; i++) {
+		cardboard_point(&val, uvs[i].x, uvs[i].y, &results[i]);
+	}
+
 	return true;
 }
 
@@ -290,8 +437,37 @@ u_ns_polyval2d(float X, float Y, float C[16])
 }
 
 
-bool
-u_compute_distortion_ns_p2d(struct u_ns_p2d_values *values, int view, float u, float v, struct xrt_uv_triplet *result)
+/*!
+ * The ray bounds only depend on the view, the batch function computes them
+ * once instead of doing four tanf calls per point.
+ */
+struct ns_p2d_bounds
+{
+	float left, right, up, down;
+};
+
+static inline struct ns_p2d_bounds
+ns_p2d_bounds(const struct u_ns_p2d_values *values, int view)
+{
+	struct xrt_fov fov = values->fov[view];
+
+	struct ns_p2d_bounds bounds = {
+	    .left = tanf(fov.angle_left),
+	    .right = tanf(fov.angle_right),
+	    .up = tanf(fov.angle_up),
+	    .down = tanf(fov.angle_down),
+	};
+
+	return bounds;
+}
+
+static inline void
+ns_p2d_point(struct u_ns_p2d_values *values,
+             int view,
+             struct ns_p2d_bounds bounds,
+             float u,
+             float v,
+             struct xrt_uv_triplet *result)
 {
 	// I think that OpenCV and Monado have different definitions of v coordinates, but not sure. if not,
 	// unexplainable
@@ -300,16 +476,9 @@ u_compute_distortion_ns_p2d(struct u_ns_p2d_values *values, int view, float u, f
 	float x_ray = u_ns_polyval2d(u, v, view ? values->x_coefficients_left : values->x_coefficients_right);
 	float y_ray = u_ns_polyval2d(u, v, view ? values->y_coefficients_left : values->y_coefficients_right);
 
-	struct xrt_fov fov = values->fov[view];
-
-	float left_ray_bound = tanf(fov.angle_left);
-	float right_ray_bound = tanf(fov.angle_right);
-	float up_ray_bound = tanf(fov.angle_up);
-	float down_ray_bound = tanf(fov.angle_down);
-
-	float u_eye = (float)math_map_ranges(x_ray, left_ray_bound, right_ray_bound, 0, 1);
+	float u_eye = (float)math_map_ranges(x_ray, bounds.left, bounds.right, 0, 1);
 
-	float v_eye = (float)math_map_ranges(y_ray, down_ray_bound, up_ray_bound, 0, 1);
+	float v_eye = (float)math_map_ranges(y_ray, bounds.down, bounds.up, 0, 1);
 
 	// boilerplate, put the UV coordinates in all the RGB slots
 	result->r.x = u_eye;
@@ -318,6 +487,28 @@ u_compute_distortion_ns_p2d(struct u_ns_p2d_values *values, int view, float u, f
 	result->g.y = v_eye;
 	result->b.x = u_eye;
 	result->b.y = v_eye;
+}
+
+bool
+u_compute_distortion_ns_p2d(struct u_ns_p2d_values *values, int view, float u, float v, struct xrt_uv_triplet *result)
+{
+	ns_p2d_point(values, view, ns_p2d_bounds(values, view), u, v, result);
+
+	return true;
+}
+
+bool
+u_compute_distortion_ns_p2d_batch(struct u_ns_p2d_values *values,
+                                  int view,
+                                  uint32_t count,
+                                  const struct xrt_vec2 *uvs,
+                                  struct xrt_uv_triplet *results)
+{
+	const struct ns_p2d_bounds bounds = ns_p2d_bounds(values, view);
+
+	for (uint32_t i = 0; i < count; i++) {
+		ns_p2d_point(values, view, bounds, uvs[i].x, uvs[i].y, &results[i]);
+	}
 
 	return true;
 }
@@ -485,3 +676,58 @@ u_distortion_mesh_fill_in_compute(struct xrt_device *xdev)
 
 	run_func(xdev, calc, target, num);
 }
+
+struct u_worker_thread_pool *
+u_distortion_thread_pool_create(void)
+{
+	int64_t thread_count = debug_get_num_option_distortion_threads();
+	if (thread_count <= 1) {
+		return NULL;
+	}
+
+	// The calling thread helps out while waiting, so start one less.
+	return u_worker_thread_pool_create((uint32_t)thread_count - 1, (uint32_t)thread_count, "Distortion");
+}
+
+bool
+u_distortion_compute_points(struct xrt_device *xdev,
+                            struct u_worker_thread_pool *pool,
+                            uint32_t view,
+                            uint32_t count,
+                            const struct xrt_vec2 *uvs,
+                            struct xrt_uv_triplet *out_results)
+{
+	uint32_t task_count = (count + POINTS_PER_TASK - 1) / POINTS_PER_TASK;
+
+	// Only devices that implement the batch function are thread safe.
+	if (pool == NULL || task_count <= 1 || xdev->compute_distortion_batch == NULL) {
+		return xrt_device_compute_distortion_batch(xdev, view, count, uvs, out_results);
+	}
+
+	struct u_worker_group *uwg = u_worker_group_create(pool);
+	struct compute_task *tasks = U_TYPED_ARRAY_CALLOC(struct compute_task, task_count);
+
+	for (uint32_t i = 0; i < task_count; i++) {
+		uint32_t first = i * POINTS_PER_TASK;
+
+		tasks[i].xdev = xdev;
+		tasks[i].view = view;
+		tasks[i].count = count - first < POINTS_PER_TASK ? count - first : POINTS_PER_TASK;
+		tasks[i].uvs = &uvs[first];
+		tasks[i].results = &out_results[first];
+
+		u_worker_group_push(uwg, compute_task_func, &tasks[i]);
+	}
+
+	u_worker_group_wait_all(uwg);
+
+	bool success = true;
+	for (uint32_t i = 0; i < task_count; i++) {
+		success = success && tasks[i].success;
+	}
+
+	free(tasks);
+	u_worker_group_reference(&uwg, NULL);
+
+	return success;
+}
@@ -21,6 +21,8 @@ extern "C" {
 #endif
 
 
+struct u_worker_thread_pool;
+
 /*
  *
  * Panotools distortion
@@ -54,6 +56,17 @@ struct u_panotools_values
 bool
 u_compute_distortion_panotools(struct u_panotools_values *values, float u, float v, struct xrt_uv_triplet *result);
 
+/*!
+ * Batch version of @ref u_compute_distortion_panotools.
+ *
+ * @ingroup aux_distortion
+ */
+bool
+u_compute_distortion_panotools_batch(struct u_panotools_values *values,
+                                     uint32_t count,
+                                     const struct xrt_vec2 *uvs,
+                                     struct xrt_uv_triplet *results);
+
 
 /*
  *
@@ -89,6 +102,17 @@ struct u_vive_values
 bool
 u_compute_distortion_vive(struct u_vive_values *values, float u, float v, struct xrt_uv_triplet *result);
 
+/*!
+ * Batch version of @ref u_compute_distortion_vive.
+ *
+ * @ingroup aux_distortion
+ */
+bool
+u_compute_distortion_vive_batch(struct u_vive_values *values,
+                                uint32_t count,
+                                const struct xrt_vec2 *uvs,
+                                struct xrt_uv_triplet *results);
+
 
 /*
  *
@@ -107,6 +131,17 @@ u_compute_distortion_cardboard(struct u_cardboard_distortion_values *values,
                                float v,
                                struct xrt_uv_triplet *result);
 
+/*!
+ * Batch version of @ref u_compute_distortion_cardboard.
+ *
+ * @ingroup aux_distortion
+ */
+bool
+u_compute_distortion_cardboard_batch(struct u_cardboard_distortion_values *values,
+                                     uint32_t count,
+                                     const struct xrt_vec2 *uvs,
+                                     struct xrt_uv_triplet *results);
+
 
 /*
  *
@@ -132,6 +167,19 @@ struct u_ns_p2d_values
 bool
 u_compute_distortion_ns_p2d(struct u_ns_p2d_values *values, int view, float u, float v, struct xrt_uv_triplet *result);
 
+/*!
+ * Batch version of @ref u_compute_distortion_ns_p2d, the view dependent ray
+ * bounds are only computed once.
+ *
+ * @ingroup aux_distortion
+ */
+bool
+u_compute_distortion_ns_p2d_batch(struct u_ns_p2d_values *values,
+                                  int view,
+                                  uint32_t count,
+                                  const struct xrt_vec2 *uvs,
+                                  struct xrt_uv_triplet *results);
+
 /*
  *
  * Values for Moshi Turner's North Star distortion correction.
@@ -219,6 +267,36 @@ u_distortion_mesh_fill_in_none(struct xrt_device *xdev);
 void
 u_distortion_mesh_set_none(struct xrt_device *xdev);
 
+/*!
+ * Creates the thread pool to give to @ref u_distortion_compute_points, sized
+ * by the `XRT_DISTORTION_THREADS` environment variable. Returns NULL if it is
+ * one or less, the points are then computed on the calling thread. Create it
+ * once for all views and release it with @ref u_worker_thread_pool_reference.
+ *
+ * @ingroup aux_distortion
+ */
+struct u_worker_thread_pool *
+u_distortion_thread_pool_create(void);
+
+/*!
+ * Computes the distortion for @p count points of one view, the points are
+ * split up over the threads of @p pool and given to
+ * @ref xrt_device_compute_distortion_batch. Used for both the mesh and the
+ * compute distortion images, @p pool may be NULL. Devices without
+ * @ref xrt_device::compute_distortion_batch are computed on the calling
+ * thread, they were never written to be called from several threads.
+ *
+ * @relatesalso xrt_device
+ * @ingroup aux_distortion
+ */
+bool
+u_distortion_compute_points(struct xrt_device *xdev,
+                            struct u_worker_thread_pool *pool,
+                            uint32_t view,
+                            uint32_t count,
+                            const struct xrt_vec2 *uvs,
+                            struct xrt_uv_triplet *out_results);
+
 
 #ifdef __cplusplus
 }
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "xrt/xrt_compiler.h"
+#include "xrt/xrt_config_os.h"
 
 #include <stdio.h>
 
@@ -19,6 +20,11 @@ extern "C" {
 #endif
 
 
+//! The config dir functions are only implemented on Linux.
+#ifdef XRT_OS_LINUX
+#define U_FILE_HAVE_CONFIG_DIR
+#endif
+
 ssize_t
 u_file_get_config_dir(char *out_path, size_t out_path_size);
 
@@ -0,0 +1,823 @@
+// Copyright 2019-2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Row kernels converting between pixel formats, with SIMD versions
+ *         picked at runtime.
+ * @ingroup aux_util
+ */
+
+#include "util/u_debug.h"
+#include "util/u_logging.h"
+#include "util/u_format_convert.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define HAVE_NEON_KERNELS
+#include <arm_neon.h>
+#endif
+
+
+DEBUG_GET_ONCE_OPTION(format_convert, "U_FORMAT_CONVERT", NULL)
+
+
+/*
+ *
+ * Scalar kernels, the reference for all others.
+ *
+ */
+
+static inline int
+clamp_to_byte(int v)
+{
+	if (v < 0) {
+		return 0;
+	}
+	if (v >= 255) {
+		return 255;
+	}
+	return v;
+}
+
+static inline uint32_t
+YUV444_to_RGBX8888(int y, int u, int v)
+{
+	int C = y - 16;
+	int D = u - 128;
+	int E = v - 128;
+
+	int R = clamp_to_byte((298 * C + 409 * E + 128) >> 8);
+	int G = clamp_to_byte((298 * C - 100 * D - 209 * E + 128) >> 8);
+	int B = clamp_to_byte((298 * C + 516 * D + 128) >> 8);
+
+	return B << 16 | G << 8 | R;
+}
+
+inline static void
+YUYV422_to_R8G8B8(const uint8_t *input, uint8_t *dst)
+{
+	uint8_t y0 = input[0];
+	uint8_t u = input[1];
+	uint8_t y1 = input[2];
+	uint8_t v = input[3];
+
+	uint32_t rgb1v = YUV444_to_RGBX8888(y0, u, v);
+	uint32_t rgb2v = YUV444_to_RGBX8888(y1, u, v);
+	uint8_t *rgb1 = (uint8_t *)&rgb1v;
+	uint8_t *rgb2 = (uint8_t *)&rgb2v;
+
+	dst[0] = rgb1[0];
+	dst[1] = rgb1[1];
+	dst[2] = rgb1[2];
+	dst[3] = rgb2[0];
+	dst[4] = rgb2[1];
+	dst[5] = rgb2[2];
+}
+
+inline static void
+UYVY422_to_R8G8B8(const uint8_t *input, uint8_t *dst)
+{
+	uint8_t u = input[0];
+	uint8_t y0 = input[1];
+	uint8_t v = input[2];
+	uint8_t y1 = input[3];
+
+	uint32_t rgb1v = YUV444_to_RGBX8888(y0, u, v);
+	uint32_t rgb2v = YUV444_to_RGBX8888(y1, u, v);
+	uint8_t *rgb1 = (uint8_t *)&rgb1v;
+	uint8_t *rgb2 = (uint8_t *)&rgb2v;
+
+	dst[0] = rgb1[0];
+	dst[1] = rgb1[1];
+	dst[2] = rgb1[2];
+	dst[3] = rgb2[0];
+	dst[4] = rgb2[1];
+	dst[5] = rgb2[2];
+}
+
+inline static void
+YUV444_to_R8G8B8(const uint8_t *input, uint8_t *dst)
+{
+	uint8_t y = input[0];
+	uint8_t u = input[1];
+	uint8_t v = input[2];
+
+	uint32_t rgbv = YUV444_to_RGBX8888(y, u, v);
+	uint8_t *rgb = (uint8_t *)&rgbv;
+
+	dst[0] = rgb[0];
+	dst[1] = rgb[1];
+	dst[2] = rgb[2];
+}
+
+static void
+scalar_L8_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x++) {
+		dst[x * 3 + 2] = dst[x * 3 + 1] = dst[x * 3 + 0] = src[x];
+	}
+}
+
+static void
+scalar_YUYV422_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x += 2) {
+		YUYV422_to_R8G8B8(src + (x * 2), dst + (x * 3));
+	}
+}
+
+static void
+scalar_YUYV422_to_L8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x++) {
+		dst[x] = src[x * 2];
+	}
+}
+
+static void
+scalar_UYVY422_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x += 2) {
+		UYVY422_to_R8G8B8(src + (x * 2), dst + (x * 3));
+	}
+}
+
+static void
+scalar_YUV888_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	for (uint32_t x = 0; x < w; x++) {
+		YUV444_to_R8G8B8(src + (x * 3), dst + (x * 3));
+	}
+}
+
+static void
+scalar_BAYER_GR8_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	const uint8_t *src0 = src;
+	const uint8_t *src1 = src + src_stride;
+
+	for (uint32_t x = 0; x < w; x++) {
+		uint8_t g0 = src0[0];
+		uint8_t r = src0[1];
+		uint8_t b = src1[0];
+		uint8_t g1 = src1[1];
+
+		dst[0] = r;
+		dst[1] = (g0 + g1) / 2;
+		dst[2] = b;
+
+		src0 += 2;
+		src1 += 2;
+		dst += 3;
+	}
+}
+
+static const struct u_format_convert_funcs scalar_funcs = {
+    .name = "scalar",
+    .L8_to_R8G8B8 = scalar_L8_to_R8G8B8,
+    .YUYV422_to_R8G8B8 = scalar_YUYV422_to_R8G8B8,
+    .YUYV422_to_L8 = scalar_YUYV422_to_L8,
+    .UYVY422_to_R8G8B8 = scalar_UYVY422_to_R8G8B8,
+    .YUV888_to_R8G8B8 = scalar_YUV888_to_R8G8B8,
+    .BAYER_GR8_to_R8G8B8 = scalar_BAYER_GR8_to_R8G8B8,
+};
+
+
+/*
+ *
+ * SSE4.1 and AVX2 kernels, they work on 16 pixels at a time and leave the
+ * rest of the row to the scalar kernels. Only the YUV math gains from the
+ * wider registers, the byte shuffles are shared.
+ *
+ */
+
+#ifdef HAVE_X86_KERNELS
+
+//! Makes pshufb write a zero.
+#define Z (0x80)
+
+//! Shuffles taking 16 R, G and B bytes to 48 interleaved bytes, per output chunk and channel.
+static const uint8_t shuffle_rgb_interleave[3][3][16] = {
+    {
+        {0, Z, Z, 1, Z, Z, 2, Z, Z, 3, Z, Z, 4, Z, Z, 5},
+        {Z, 0, Z, Z, 1, Z, Z, 2, Z, Z, 3, Z, Z, 4, Z, Z},
+        {Z, Z, 0, Z, Z, 1, Z, Z, 2, Z, Z, 3, Z, Z, 4, Z},
+    },
+    {
+        {Z, Z, 6, Z, Z, 7, Z, Z, 8, Z, Z, 9, Z, Z, 10, Z},
+        {5, Z, Z, 6, Z, Z, 7, Z, Z, 8, Z, Z, 9, Z, Z, 10},
+        {Z, 5, Z, Z, 6, Z, Z, 7, Z, Z, 8, Z, Z, 9, Z, Z},
+    },
+    {
+        {Z, 11, Z, Z, 12, Z, Z, 13, Z, Z, 14, Z, Z, 15, Z, Z},
+        {Z, Z, 11, Z, Z, 12, Z, Z, 13, Z, Z, 14, Z, Z, 15, Z},
+        {10, Z, Z, 11, Z, Z, 12, Z, Z, 13, Z, Z, 14, Z, Z, 15},
+    },
+};
+
+//! Shuffles taking 48 bytes of YUV888 to 16 Y, U and V bytes, per input chunk and channel.
+static const uint8_t shuffle_yuv888[3][3][16] = {
+    {
+        {0, 3, 6, 9, 12, 15, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z},
+        {1, 4, 7, 10, 13, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z},
+        {2, 5, 8, 11, 14, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z},
+    },
+    {
+        {Z, Z, Z, Z, Z, Z, 2, 5, 8, 11, 14, Z, Z, Z, Z, Z},
+        {Z, Z, Z, Z, Z, 0, 3, 6, 9, 12, 15, Z, Z, Z, Z, Z},
+        {Z, Z, Z, Z, Z, 1, 4, 7, 10, 13, Z, Z, Z, Z, Z, Z},
+    },
+    {
+        {Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 1, 4, 7, 10, 13},
+        {Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 2, 5, 8, 11, 14},
+        {Z, Z, Z, Z, Z, Z, Z, Z, Z, Z, 0, 3, 6, 9, 12, 15},
+    },
+};
+
+//! Shuffles taking 32 bytes of YUYV422 to 16 Y, U and V bytes, per input chunk and channel.
+static const uint8_t shuffle_yuyv422[2][3][16] = {
+    {
+        {0, 2, 4, 6, 8, 10, 12, 14, Z, Z, Z, Z, Z, Z, Z, Z},
+        {1, 1, 5, 5, 9, 9, 13, 13, Z, Z, Z, Z, Z, Z, Z, Z},
+        {3, 3, 7, 7, 11, 11, 15, 15, Z, Z, Z, Z, Z, Z, Z, Z},
+    },
+    {
+        {Z, Z, Z, Z, Z, Z, Z, Z, 0, 2, 4, 6, 8, 10, 12, 14},
+        {Z, Z, Z, Z, Z, Z, Z, Z, 1, 1, 5, 5, 9, 9, 13, 13},
+        {Z, Z, Z, Z, Z, Z, Z, Z, 3, 3, 7, 7, 11, 11, 15, 15},
+    },
+};
+
+//! Shuffles taking 32 bytes of UYVY422 to 16 Y, U and V bytes, per input chunk and channel.
+static const uint8_t shuffle_uyvy422[2][3][16] = {
+    {
+        {1, 3, 5, 7, 9, 11, 13, 15, Z, Z, Z, Z, Z, Z, Z, Z},
+        {0, 0, 4, 4, 8, 8, 12, 12, Z, Z, Z, Z, Z, Z, Z, Z},
+        {2, 2, 6, 6, 10, 10, 14, 14, Z, Z, Z, Z, Z, Z, Z, Z},
+    },
+    {
+        {Z, Z, Z, Z, Z, Z, Z, Z, 1, 3, 5, 7, 9, 11, 13, 15},
+        {Z, Z, Z, Z, Z, Z, Z, Z, 0, 0, 4, 4, 8, 8, 12, 12},
+        {Z, Z, Z, Z, Z, Z, Z, Z, 2, 2, 6, 6, 10, 10, 14, 14},
+    },
+};
+
+//! Shuffles taking 32 bytes to 16 even and 16 odd bytes, per input chunk.
+static const uint8_t shuffle_deinterleave2[2][2][16] = {
+    {
+        {0, 2, 4, 6, 8, 10, 12, 14, Z, Z, Z, Z, Z, Z, Z, Z},
+        {1, 3, 5, 7, 9, 11, 13, 15, Z, Z, Z, Z, Z, Z, Z, Z},
+    },
+    {
+        {Z, Z, Z, Z, Z, Z, Z, Z, 0, 2, 4, 6, 8, 10, 12, 14},
+        {Z, Z, Z, Z, Z, Z, Z, Z, 1, 3, 5, 7, 9, 11, 13, 15},
+    },
+};
+
+#undef Z
+
+TARGET_SSE41 static inline __m128i
+shuffle(__m128i a, const uint8_t *mask)
+{
+	return _mm_shuffle_epi8(a, _mm_loadu_si128((const __m128i *)mask));
+}
+
+TARGET_SSE41 static inline __m128i
+shuffle_or2(__m128i a, __m128i b, const uint8_t *mask_a, const uint8_t *mask_b)
+{
+	return _mm_or_si128(shuffle(a, mask_a), shuffle(b, mask_b));
+}
+
+TARGET_SSE41 static inline void
+store_rgb_16_sse41(uint8_t *dst, __m128i r, __m128i g, __m128i b)
+{
+	for (int j = 0; j < 3; j++) {
+		__m128i out = shuffle_or2(r, g, shuffle_rgb_interleave[j][0], shuffle_rgb_interleave[j][1]);
+		out = _mm_or_si128(out, shuffle(b, shuffle_rgb_interleave[j][2]));
+		_mm_storeu_si128((__m128i *)(dst + j * 16), out);
+	}
+}
+
+//! Loads 16 pixels of YUYV422 or UYVY422 depending on @p shuffle.
+TARGET_SSE41 static inline void
+load_yuv422_16_sse41(const uint8_t *src, const uint8_t shuffle[2][3][16], __m128i *y, __m128i *u, __m128i *v)
+{
+	__m128i a = _mm_loadu_si128((const __m128i *)src);
+	__m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+
+	*y = shuffle_or2(a, b, shuffle[0][0], shuffle[1][0]);
+	*u = shuffle_or2(a, b, shuffle[0][1], shuffle[1][1]);
+	*v = shuffle_or2(a, b, shuffle[0][2], shuffle[1][2]);
+}
+
+TARGET_SSE41 static inline void
+load_yuv888_16_sse41(const uint8_t *src, __m128i *y, __m128i *u, __m128i *v)
+{
+	__m128i in[3];
+	__m128i *out[3] = {y, u, v};
+
+	for (int j = 0; j < 3; j++) {
+		in[j] = _mm_loadu_si128((const __m128i *)(src + j * 16));
+	}
+
+	for (int c = 0; c < 3; c++) {
+		__m128i x = shuffle_or2(in[0], in[1], shuffle_yuv888[0][c], shuffle_yuv888[1][c]);
+		x = _mm_or_si128(x, shuffle(in[2], shuffle_yuv888[2][c]));
+		*out[c] = x;
+	}
+}
+
+/*!
+ * Same math as @ref YUV444_to_RGBX8888 on 16 pixels, in 32 bit lanes so
+ * nothing overflows, the saturating packs do the clamping.
+ */
+TARGET_SSE41 static inline void
+yuv_to_rgb_16_sse41(__m128i y, __m128i u, __m128i v, __m128i *out_r, __m128i *out_g, __m128i *out_b)
+{
+	__m128i r[4];
+	__m128i g[4];
+	__m128i b[4];
+
+	for (int i = 0; i < 4; i++) {
+		__m128i C = _mm_sub_epi32(_mm_cvtepu8_epi32(y), _mm_set1_epi32(16));
+		__m128i D = _mm_sub_epi32(_mm_cvtepu8_epi32(u), _mm_set1_epi32(128));
+		__m128i E = _mm_sub_epi32(_mm_cvtepu8_epi32(v), _mm_set1_epi32(128));
+
+		// 298 * C + 128, shared by all channels.
+		C = _mm_add_epi32(_mm_mullo_epi32(C, _mm_set1_epi32(298)), _mm_set1_epi32(128));
+
+		r[i] = _mm_add_epi32(C, _mm_mullo_epi32(E, _mm_set1_epi32(409)));
+		g[i] = _mm_sub_epi32(C, _mm_mullo_epi32(D, _mm_set1_epi32(100)));
+		g[i] = _mm_sub_epi32(g[i], _mm_mullo_epi32(E, _mm_set1_epi32(209)));
+		b[i] = _mm_add_epi32(C, _mm_mullo_epi32(D, _mm_set1_epi32(516)));
+
+		r[i] = _mm_srai_epi32(r[i], 8);
+		g[i] = _mm_srai_epi32(g[i], 8);
+		b[i] = _mm_srai_epi32(b[i], 8);
+
+		y = _mm_srli_si128(y, 4);
+		u = _mm_srli_si128(u, 4);
+		v = _mm_srli_si128(v, 4);
+	}
+
+	*out_r = _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(r[2], r[3]));
+	*out_g = _mm_packus_epi16(_mm_packs_epi32(g[0], g[1]), _mm_packs_epi32(g[2], g[3]));
+	*out_b = _mm_packus_epi16(_mm_packs_epi32(b[0], b[1]), _mm_packs_epi32(b[2], b[3]));
+}
+
+//! Packs 16 values in two registers of 32 bit lanes into bytes, in order.
+TARGET_AVX2 static inline __m128i
+pack_16_avx2(__m256i lo, __m256i hi)
+{
+	// The pack works per 128 bit lane, put the 64 bit halves back in order.
+	__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+
+	return _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+}
+
+TARGET_AVX2 static inline void
+yuv_to_rgb_8_avx2(__m128i y, __m128i u, __m128i v, __m256i *out_r, __m256i *out_g, __m256i *out_b)
+{
+	__m256i C = _mm256_sub_epi32(_mm256_cvtepu8_epi32(y), _mm256_set1_epi32(16));
+	__m256i D = _mm256_sub_epi32(_mm256_cvtepu8_epi32(u), _mm256_set1_epi32(128));
+	__m256i E = _mm256_sub_epi32(_mm256_cvtepu8_epi32(v), _mm256_set1_epi32(128));
+
+	// 298 * C + 128, shared by all channels.
+	C = _mm256_add_epi32(_mm256_mullo_epi32(C, _mm256_set1_epi32(298)), _mm256_set1_epi32(128));
+
+	__m256i r = _mm256_add_epi32(C, _mm256_mullo_epi32(E, _mm256_set1_epi32(409)));
+	__m256i g = _mm256_sub_epi32(C, _mm256_mullo_epi32(D, _mm256_set1_epi32(100)));
+	g = _mm256_sub_epi32(g, _mm256_mullo_epi32(E, _mm256_set1_epi32(209)));
+	__m256i b = _mm256_add_epi32(C, _mm256_mullo_epi32(D, _mm256_set1_epi32(516)));
+
+	*out_r = _mm256_srai_epi32(r, 8);
+	*out_g = _mm256_srai_epi32(g, 8);
+	*out_b = _mm256_srai_epi32(b, 8);
+}
+
+//! Same as @ref yuv_to_rgb_16_sse41 but with twice the lanes.
+TARGET_AVX2 static inline void
+yuv_to_rgb_16_avx2(__m128i y, __m128i u, __m128i v, __m128i *out_r, __m128i *out_g, __m128i *out_b)
+{
+	__m256i r[2];
+	__m256i g[2];
+	__m256i b[2];
+
+	yuv_to_rgb_8_avx2(y, u, v, &r[0], &g[0], &b[0]);
+	yuv_to_rgb_8_avx2(_mm_srli_si128(y, 8), _mm_srli_si128(u, 8), _mm_srli_si128(v, 8), &r[1], &g[1], &b[1]);
+
+	*out_r = pack_16_avx2(r[0], r[1]);
+	*out_g = pack_16_avx2(g[0], g[1]);
+	*out_b = pack_16_avx2(b[0], b[1]);
+}
+
+TARGET_SSE41 static void
+sse41_L8_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		__m128i l = _mm_loadu_si128((const __m128i *)(src + x));
+		store_rgb_16_sse41(dst + (x * 3), l, l, l);
+	}
+
+	scalar_L8_to_R8G8B8(src + x, src_stride, dst + (x * 3), w - x);
+}
+
+TARGET_SSE41 static void
+sse41_YUYV422_to_L8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + (x * 2)));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + (x * 2) + 16));
+		__m128i y = shuffle_or2(a, b, shuffle_yuyv422[0][0], shuffle_yuyv422[1][0]);
+		_mm_storeu_si128((__m128i *)(dst + x), y);
+	}
+
+	scalar_YUYV422_to_L8(src + (x * 2), src_stride, dst + x, w - x);
+}
+
+TARGET_SSE41 static void
+sse41_BAYER_GR8_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	const uint8_t *src0 = src;
+	const uint8_t *src1 = src + src_stride;
+
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		__m128i a0 = _mm_loadu_si128((const __m128i *)(src0 + (x * 2)));
+		__m128i a1 = _mm_loadu_si128((const __m128i *)(src0 + (x * 2) + 16));
+		__m128i b0 = _mm_loadu_si128((const __m128i *)(src1 + (x * 2)));
+		__m128i b1 = _mm_loadu_si128((const __m128i *)(src1 + (x * 2) + 16));
+
+		__m128i g0 = shuffle_or2(a0, a1, shuffle_deinterleave2[0][0], shuffle_deinterleave2[1][0]);
+		__m128i r = shuffle_or2(a0, a1, shuffle_deinterleave2[0][1], shuffle_deinterleave2[1][1]);
+		__m128i b = shuffle_or2(b0, b1, shuffle_deinterleave2[0][0], shuffle_deinterleave2[1][0]);
+		__m128i g1 = shuffle_or2(b0, b1, shuffle_deinterleave2[0][1], shuffle_deinterleave2[1][1]);
+
+		// (g0 + g1) / 2 rounding down, _mm_avg_epu8 rounds up.
+		__m128i half = _mm_and_si128(_mm_srli_epi16(_mm_xor_si128(g0, g1), 1), _mm_set1_epi8(0x7f));
+		__m128i g = _mm_add_epi8(_mm_and_si128(g0, g1), half);
+
+		store_rgb_16_sse41(dst + (x * 3), r, g, b);
+	}
+
+	scalar_BAYER_GR8_to_R8G8B8(src + (x * 2), src_stride, dst + (x * 3), w - x);
+}
+
+TARGET_SSE41 static void
+sse41_YUYV422_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		__m128i y, u, v, r, g, b;
+		load_yuv422_16_sse41(src + (x * 2), shuffle_yuyv422, &y, &u, &v);
+		yuv_to_rgb_16_sse41(y, u, v, &r, &g, &b);
+		store_rgb_16_sse41(dst + (x * 3), r, g, b);
+	}
+
+	scalar_YUYV422_to_R8G8B8(src + (x * 2), src_stride, dst + (x * 3), w - x);
+}
+
+TARGET_SSE41 static void
+sse41_UYVY422_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		__m128i y, u, v, r, g, b;
+		load_yuv422_16_sse41(src + (x * 2), shuffle_uyvy422, &y, &u, &v);
+		yuv_to_rgb_16_sse41(y, u, v, &r, &g, &b);
+		store_rgb_16_sse41(dst + (x * 3), r, g, b);
+	}
+
+	scalar_UYVY422_to_R8G8B8(src + (x * 2), src_stride, dst + (x * 3), w - x);
+}
+
+TARGET_SSE41 static void
+sse41_YUV888_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		__m128i y, u, v, r, g, b;
+		load_yuv888_16_sse41(src + (x * 3), &y, &u, &v);
+		yuv_to_rgb_16_sse41(y, u, v, &r, &g, &b);
+		store_rgb_16_sse41(dst + (x * 3), r, g, b);
+	}
+
+	scalar_YUV888_to_R8G8B8(src + (x * 3), src_stride, dst + (x * 3), w - x);
+}
+
+TARGET_AVX2 static void
+avx2_YUYV422_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		__m128i y, u, v, r, g, b;
+		load_yuv422_16_sse41(src + (x * 2), shuffle_yuyv422, &y, &u, &v);
+		yuv_to_rgb_16_avx2(y, u, v, &r, &g, &b);
+		store_rgb_16_sse41(dst + (x * 3), r, g, b);
+	}
+
+	scalar_YUYV422_to_R8G8B8(src + (x * 2), src_stride, dst + (x * 3), w - x);
+}
+
+TARGET_AVX2 static void
+avx2_UYVY422_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		__m128i y, u, v, r, g, b;
+		load_yuv422_16_sse41(src + (x * 2), shuffle_uyvy422, &y, &u, &v);
+		yuv_to_rgb_16_avx2(y, u, v, &r, &g, &b);
+		store_rgb_16_sse41(dst + (x * 3), r, g, b);
+	}
+
+	scalar_UYVY422_to_R8G8B8(src + (x * 2), src_stride, dst + (x * 3), w - x);
+}
+
+TARGET_AVX2 static void
+avx2_YUV888_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		__m128i y, u, v, r, g, b;
+		load_yuv888_16_sse41(src + (x * 3), &y, &u, &v);
+		yuv_to_rgb_16_avx2(y, u, v, &r, &g, &b);
+		store_rgb_16_sse41(dst + (x * 3), r, g, b);
+	}
+
+	scalar_YUV888_to_R8G8B8(src + (x * 3), src_stride, dst + (x * 3), w - x);
+}
+
+static const struct u_format_convert_funcs sse41_funcs = {
+    .name = "sse4.1",
+    .L8_to_R8G8B8 = sse41_L8_to_R8G8B8,
+    .YUYV422_to_R8G8B8 = sse41_YUYV422_to_R8G8B8,
+    .YUYV422_to_L8 = sse41_YUYV422_to_L8,
+    .UYVY422_to_R8G8B8 = sse41_UYVY422_to_R8G8B8,
+    .YUV888_to_R8G8B8 = sse41_YUV888_to_R8G8B8,
+    .BAYER_GR8_to_R8G8B8 = sse41_BAYER_GR8_to_R8G8B8,
+};
+
+static const struct u_format_convert_funcs avx2_funcs = {
+    .name = "avx2",
+    .L8_to_R8G8B8 = sse41_L8_to_R8G8B8,
+    .YUYV422_to_R8G8B8 = avx2_YUYV422_to_R8G8B8,
+    .YUYV422_to_L8 = sse41_YUYV422_to_L8,
+    .UYVY422_to_R8G8B8 = avx2_UYVY422_to_R8G8B8,
+    .YUV888_to_R8G8B8 = avx2_YUV888_to_R8G8B8,
+    .BAYER_GR8_to_R8G8B8 = sse41_BAYER_GR8_to_R8G8B8,
+};
+
+#endif // HAVE_X86_KERNELS
+
+
+/*
+ *
+ * NEON kernels, the structured loads and stores do all of the shuffling.
+ *
+ */
+
+#ifdef HAVE_NEON_KERNELS
+
+static inline uint8x8_t
+narrow_8_neon(int32x4_t lo, int32x4_t hi)
+{
+	int16x8_t x = vcombine_s16(vqmovn_s32(vshrq_n_s32(lo, 8)), vqmovn_s32(vshrq_n_s32(hi, 8)));
+
+	return vqmovun_s16(x);
+}
+
+//! Same math as @ref YUV444_to_RGBX8888 on 8 pixels, the saturating narrows do the clamping.
+static inline void
+yuv_to_rgb_8_neon(uint8x8_t y, uint8x8_t u, uint8x8_t v, uint8x8_t *out_r, uint8x8_t *out_g, uint8x8_t *out_b)
+{
+	// Wraps around as unsigned, correct when reinterpreted as signed.
+	int16x8_t C = vreinterpretq_s16_u16(vsubl_u8(y, vdup_n_u8(16)));
+	int16x8_t D = vreinterpretq_s16_u16(vsubl_u8(u, vdup_n_u8(128)));
+	int16x8_t E = vreinterpretq_s16_u16(vsubl_u8(v, vdup_n_u8(128)));
+
+	// 298 * C + 128, shared by all channels.
+	int32x4_t c_lo = vmlal_n_s16(vdupq_n_s32(128), vget_low_s16(C), 298);
+	int32x4_t c_hi = vmlal_n_s16(vdupq_n_s32(128), vget_high_s16(C), 298);
+
+	int32x4_t r_lo = vmlal_n_s16(c_lo, vget_low_s16(E), 409);
+	int32x4_t r_hi = vmlal_n_s16(c_hi, vget_high_s16(E), 409);
+	int32x4_t g_lo = vmlsl_n_s16(vmlsl_n_s16(c_lo, vget_low_s16(D), 100), vget_low_s16(E), 209);
+	int32x4_t g_hi = vmlsl_n_s16(vmlsl_n_s16(c_hi, vget_high_s16(D), 100), vget_high_s16(E), 209);
+	int32x4_t b_lo = vmlal_n_s16(c_lo, vget_low_s16(D), 516);
+	int32x4_t b_hi = vmlal_n_s16(c_hi, vget_high_s16(D), 516);
+
+	*out_r = narrow_8_neon(r_lo, r_hi);
+	*out_g = narrow_8_neon(g_lo, g_hi);
+	*out_b = narrow_8_neon(b_lo, b_hi);
+}
+
+//! Converts 8 pairs of pixels sharing U and V and stores them in order.
+static inline void
+yuv422_to_rgb_16_neon(uint8x8_t y0, uint8x8_t y1, uint8x8_t u, uint8x8_t v, uint8_t *dst)
+{
+	uint8x8_t r0, g0, b0, r1, g1, b1;
+	yuv_to_rgb_8_neon(y0, u, v, &r0, &g0, &b0);
+	yuv_to_rgb_8_neon(y1, u, v, &r1, &g1, &b1);
+
+	uint8x8x2_t r = vzip_u8(r0, r1);
+	uint8x8x2_t g = vzip_u8(g0, g1);
+	uint8x8x2_t b = vzip_u8(b0, b1);
+
+	uint8x16x3_t rgb = {{
+	    vcombine_u8(r.val[0], r.val[1]),
+	    vcombine_u8(g.val[0], g.val[1]),
+	    vcombine_u8(b.val[0], b.val[1]),
+	}};
+	vst3q_u8(dst, rgb);
+}
+
+static void
+neon_L8_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x16_t l = vld1q_u8(src + x);
+		uint8x16x3_t rgb = {{l, l, l}};
+		vst3q_u8(dst + (x * 3), rgb);
+	}
+
+	scalar_L8_to_R8G8B8(src + x, src_stride, dst + (x * 3), w - x);
+}
+
+static void
+neon_YUYV422_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x8x4_t yuyv = vld4_u8(src + (x * 2));
+		yuv422_to_rgb_16_neon(yuyv.val[0], yuyv.val[2], yuyv.val[1], yuyv.val[3], dst + (x * 3));
+	}
+
+	scalar_YUYV422_to_R8G8B8(src + (x * 2), src_stride, dst + (x * 3), w - x);
+}
+
+static void
+neon_YUYV422_to_L8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x16x2_t yuyv = vld2q_u8(src + (x * 2));
+		vst1q_u8(dst + x, yuyv.val[0]);
+	}
+
+	scalar_YUYV422_to_L8(src + (x * 2), src_stride, dst + x, w - x);
+}
+
+static void
+neon_UYVY422_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x8x4_t uyvy = vld4_u8(src + (x * 2));
+		yuv422_to_rgb_16_neon(uyvy.val[1], uyvy.val[3], uyvy.val[0], uyvy.val[2], dst + (x * 3));
+	}
+
+	scalar_UYVY422_to_R8G8B8(src + (x * 2), src_stride, dst + (x * 3), w - x);
+}
+
+static void
+neon_YUV888_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	uint32_t x = 0;
+	for (; x + 8 <= w; x += 8) {
+		uint8x8x3_t yuv = vld3_u8(src + (x * 3));
+		uint8x8x3_t rgb;
+		yuv_to_rgb_8_neon(yuv.val[0], yuv.val[1], yuv.val[2], &rgb.val[0], &rgb.val[1], &rgb.val[2]);
+		vst3_u8(dst + (x * 3), rgb);
+	}
+
+	scalar_YUV888_to_R8G8B8(src + (x * 3), src_stride, dst + (x * 3), w - x);
+}
+
+static void
+neon_BAYER_GR8_to_R8G8B8(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w)
+{
+	const uint8_t *src0 = src;
+	const uint8_t *src1 = src + src_stride;
+
+	uint32_t x = 0;
+	for (; x + 16 <= w; x += 16) {
+		uint8x16x2_t gr = vld2q_u8(src0 + (x * 2));
+		uint8x16x2_t bg = vld2q_u8(src1 + (x * 2));
+
+		// Halving add rounds down, like the scalar code.
+		uint8x16x3_t rgb = {{gr.val[1], vhaddq_u8(gr.val[0], bg.val[1]), bg.val[0]}};
+		vst3q_u8(dst + (x * 3), rgb);
+	}
+
+	scalar_BAYER_GR8_to_R8G8B8(src + (x * 2), src_stride, dst + (x * 3), w - x);
+}
+
+static const struct u_format_convert_funcs neon_funcs = {
+    .name = "neon",
+    .L8_to_R8G8B8 = neon_L8_to_R8G8B8,
+    .YUYV422_to_R8G8B8 = neon_YUYV422_to_R8G8B8,
+    .YUYV422_to_L8 = neon_YUYV422_to_L8,
+    .UYVY422_to_R8G8B8 = neon_UYVY422_to_R8G8B8,
+    .YUV888_to_R8G8B8 = neon_YUV888_to_R8G8B8,
+    .BAYER_GR8_to_R8G8B8 = neon_BAYER_GR8_to_R8G8B8,
+};
+
+#endif // HAVE_NEON_KERNELS
+
+
+/*
+ *
+ * Dispatch.
+ *
+ */
+
+/*!
+ * Implementations that are only used when asked for by name. The NEON
+ * kernels have not had their parity tests run on real hardware yet, so
+ * they need `U_FORMAT_CONVERT=neon`.
+ */
+static bool
+is_opt_in(enum u_format_convert_impl impl)
+{
+	return impl == U_FORMAT_CONVERT_IMPL_NEON;
+}
+
+//! Returns the first available implementation named @p name, or the fastest if NULL.
+static const struct u_format_convert_funcs *
+find_funcs(const char *name)
+{
+	for (int i = U_FORMAT_CONVERT_IMPL_COUNT - 1; i >= 0; i--) {
+		enum u_format_convert_impl impl = (enum u_format_convert_impl)i;
+		if (name == NULL && is_opt_in(impl)) {
+			continue;
+		}
+
+		const struct u_format_convert_funcs *funcs = u_format_convert_get_funcs(impl);
+		if (funcs != NULL && (name == NULL || strcmp(name, funcs->name) == 0)) {
+			return funcs;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+const struct u_format_convert_funcs *
+u_format_convert_get_funcs(enum u_format_convert_impl impl)
+{
+	switch (impl) {
+	case U_FORMAT_CONVERT_IMPL_SCALAR: return &scalar_funcs;
+#ifdef HAVE_X86_KERNELS
+	case U_FORMAT_CONVERT_IMPL_SSE41:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse4.1") ? &sse41_funcs : NULL;
+	case U_FORMAT_CONVERT_IMPL_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? &avx2_funcs : NULL;
+#endif
+#ifdef HAVE_NEON_KERNELS
+	case U_FORMAT_CONVERT_IMPL_NEON: return &neon_funcs;
+#endif
+	default: return NULL;
+	}
+}
+
+const struct u_format_convert_funcs *
+u_format_convert_get_best_funcs(void)
+{
+	// Always the same result, racing threads just do the work twice.
+	static const struct u_format_convert_funcs *best = NULL;
+	if (best != NULL) {
+		return best;
+	}
+
+	const char *forced = debug_get_option_format_convert();
+	const struct u_format_convert_funcs *funcs = find_funcs(forced);
+	if (funcs == NULL) {
+		U_LOG_W("U_FORMAT_CONVERT='%s' is not available, using the fastest kernels.", forced);
+		funcs = find_funcs(NULL);
+	}
+
+	U_LOG_D("Using the %s format conversion kernels.", funcs->name);
+
+	best = funcs;
+
+	return best;
+}
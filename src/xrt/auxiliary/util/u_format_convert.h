@@ -0,0 +1,89 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Row kernels converting between pixel formats, with SIMD versions
+ *         picked at runtime.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include "xrt/xrt_compiler.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * Converts one row of @p w destination pixels from @p src to @p dst,
+ * @p src_stride is the distance to the next source row and is only used by
+ * formats that read more than one source row per destination row.
+ *
+ * @ingroup aux_util
+ */
+typedef void (*u_format_convert_row_func_t)(const uint8_t *src, size_t src_stride, uint8_t *dst, uint32_t w);
+
+/*!
+ * The different implementations of the kernels, the scalar one is the
+ * reference that all others must match exactly.
+ *
+ * @ingroup aux_util
+ */
+enum u_format_convert_impl
+{
+	U_FORMAT_CONVERT_IMPL_SCALAR,
+	U_FORMAT_CONVERT_IMPL_SSE41,
+	U_FORMAT_CONVERT_IMPL_AVX2,
+	U_FORMAT_CONVERT_IMPL_NEON,
+	U_FORMAT_CONVERT_IMPL_COUNT,
+};
+
+/*!
+ * A set of row kernels, all with the same implementation.
+ *
+ * @ingroup aux_util
+ */
+struct u_format_convert_funcs
+{
+	//! Name of the implementation, also what @p U_FORMAT_CONVERT takes.
+	const char *name;
+
+	u_format_convert_row_func_t L8_to_R8G8B8;
+
+	//! @p w must be even for the YUYV422 and UYVY422 to R8G8B8 kernels.
+	u_format_convert_row_func_t YUYV422_to_R8G8B8;
+	u_format_convert_row_func_t YUYV422_to_L8;
+	u_format_convert_row_func_t UYVY422_to_R8G8B8;
+
+	u_format_convert_row_func_t YUV888_to_R8G8B8;
+
+	//! Reads two rows of @p w * 2 GRBG pixels, each 2x2 block becomes one pixel.
+	u_format_convert_row_func_t BAYER_GR8_to_R8G8B8;
+};
+
+/*!
+ * Get the kernels of the given implementation, returns NULL if it was not
+ * built in or the CPU doesn't support it.
+ *
+ * @ingroup aux_util
+ */
+const struct u_format_convert_funcs *
+u_format_convert_get_funcs(enum u_format_convert_impl impl);
+
+/*!
+ * Get the fastest kernels the CPU supports, the @p U_FORMAT_CONVERT
+ * environment variable can force a specific implementation by name. The
+ * NEON kernels are only used when forced.
+ *
+ * @ingroup aux_util
+ */
+const struct u_format_convert_funcs *
+u_format_convert_get_best_funcs(void);
+
+
+#ifdef __cplusplus
+}
+#endif
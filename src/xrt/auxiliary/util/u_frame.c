@@ -7,21 +7,235 @@
  * @ingroup aux_util
  */
 
+#include "xrt/xrt_config_os.h"
+
+#include "os/os_threading.h"
+
 #include "util/u_misc.h"
+#include "util/u_var.h"
+#include "util/u_debug.h"
 #include "util/u_frame.h"
 #include "util/u_format.h"
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef XRT_OS_WINDOWS
+#include <malloc.h>
+#endif
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(frame_pool, "U_FRAME_POOL", true)
+
+//! Frame data is page aligned, which also makes it cache line aligned.
+#define POOL_ALIGNMENT (4096)
+
+//! Size classes go from 4KiB to 64MiB in quarter steps between powers of two, bigger frames are never cached.
+#define POOL_MIN_SHIFT (12)
+#define POOL_MAX_SHIFT (26)
+#define POOL_STEPS (4)
+#define POOL_CLASS_COUNT ((POOL_MAX_SHIFT - POOL_MIN_SHIFT) * POOL_STEPS + 1)
+#define POOL_NO_CLASS (UINT32_MAX)
+
+//! Limits on how much is kept around for frames to come.
+#define POOL_MAX_CACHED_PER_CLASS (16)
+#define POOL_MAX_CACHED_BYTES ((uint64_t)256 * 1024 * 1024)
+
+
+/*!
+ * A frame allocated by the pool, returned to it when the reference count
+ * reaches zero.
+ */
+struct pooled_frame
+{
+	struct xrt_frame base;
+
+	//! Next frame in the free list of the size class.
+	struct pooled_frame *next;
+
+	//! Size class, or @ref POOL_NO_CLASS if too big to be cached.
+	uint32_t class_index;
+};
+
+/*!
+ * The process wide frame pool, returned frames are only kept while it has
+ * users so nothing stays cached once the frame graphs are gone.
+ */
+static struct
+{
+	struct os_mutex lock;
+
+	//! Number of @ref u_frame_pool_add_user calls not yet removed.
+	uint32_t users;
+
+	struct pooled_frame *free_lists[POOL_CLASS_COUNT];
+	uint32_t free_counts[POOL_CLASS_COUNT];
+
+	struct u_frame_pool_stats stats;
+} g_pool = {.lock = OS_MUTEX_INITIALIZER};
+
+
+/*
+ *
+ * Pool helpers.
+ *
+ */
+
+static inline void
+pool_lock(void)
+{
+	os_mutex_lock(&g_pool.lock);
+}
+
+static inline void
+pool_unlock(void)
+{
+	os_mutex_unlock(&g_pool.lock);
+}
+
+static size_t
+class_capacity(uint32_t class_index)
+{
+	if (class_index == 0) {
+		return (size_t)1 << POOL_MIN_SHIFT;
+	}
+
+	size_t base = (size_t)1 << (POOL_MIN_SHIFT + (class_index - 1) / POOL_STEPS);
+	size_t step = (class_index - 1) % POOL_STEPS + 1;
+
+	return base + step * (base / POOL_STEPS);
+}
 
+static uint32_t
+size_to_class(size_t size)
+{
+	for (uint32_t i = 0; i < POOL_CLASS_COUNT; i++) {
+		if (size <= class_capacity(i)) {
+			return i;
+		}
+	}
+
+	return POOL_NO_CLASS;
+}
+
+static uint8_t *
+aligned_data_alloc(size_t size)
+{
+#ifdef XRT_OS_WINDOWS
+	return (uint8_t *)_aligned_malloc(size, POOL_ALIGNMENT);
+#else
+	void *ptr = NULL;
+	if (posix_memalign(&ptr, POOL_ALIGNMENT, size) != 0) {
+		return NULL;
+	}
+	return (uint8_t *)ptr;
+#endif
+}
+
+static void
+aligned_data_free(uint8_t *data)
+{
+#ifdef XRT_OS_WINDOWS
+	_aligned_free(data);
+#else
+	free(data);
+#endif
+}
+
+static void
+pool_add_vars(void)
+{
+	u_var_add_root(&g_pool, "Frame pool", false);
+	u_var_add_ro_u64(&g_pool, &g_pool.stats.hits, "Hits");
+	u_var_add_ro_u64(&g_pool, &g_pool.stats.misses, "Misses");
+	u_var_add_ro_u64(&g_pool, &g_pool.stats.frames_in_use, "Frames in use");
+	u_var_add_ro_u64(&g_pool, &g_pool.stats.frames_cached, "Frames cached");
+	u_var_add_ro_u64(&g_pool, &g_pool.stats.bytes_cached, "Bytes cached");
+}
 
 static void
-free_one_off(struct xrt_frame *xf)
+free_pooled(struct xrt_frame *xf)
 {
 	assert(xf->reference.count == 0);
-	free(xf->data);
-	free(xf);
+
+	struct pooled_frame *pf = (struct pooled_frame *)xf;
+	uint32_t c = pf->class_index;
+	size_t capacity = c != POOL_NO_CLASS ? class_capacity(c) : 0;
+	bool cacheable = c != POOL_NO_CLASS && debug_get_bool_option_frame_pool();
+
+	pool_lock();
+
+	g_pool.stats.frames_in_use--;
+
+	bool keep = cacheable && g_pool.users > 0 && g_pool.free_counts[c] < POOL_MAX_CACHED_PER_CLASS &&
+	            g_pool.stats.bytes_cached + capacity <= POOL_MAX_CACHED_BYTES;
+
+	if (keep) {
+		pf->next = g_pool.free_lists[c];
+		g_pool.free_lists[c] = pf;
+		g_pool.free_counts[c]++;
+		g_pool.stats.frames_cached++;
+		g_pool.stats.bytes_cached += capacity;
+	}
+
+	pool_unlock();
+
+	if (!keep) {
+		aligned_data_free(pf->base.data);
+		free(pf);
+	}
+}
+
+/*!
+ * Gets a frame with at least @p size bytes of data from the pool, with all
+ * other fields zeroed and a reference count of zero.
+ */
+static struct xrt_frame *
+alloc_pooled(size_t size)
+{
+	uint32_t c = size_to_class(size);
+	struct pooled_frame *pf = NULL;
+
+	pool_lock();
+
+	if (c != POOL_NO_CLASS && g_pool.free_lists[c] != NULL) {
+		pf = g_pool.free_lists[c];
+		g_pool.free_lists[c] = pf->next;
+		g_pool.free_counts[c]--;
+		g_pool.stats.frames_cached--;
+		g_pool.stats.bytes_cached -= class_capacity(c);
+		g_pool.stats.hits++;
+	} else {
+		g_pool.stats.misses++;
+	}
+	g_pool.stats.frames_in_use++;
+
+	pool_unlock();
+
+	uint8_t *data = NULL;
+	if (pf != NULL) {
+		data = pf->base.data;
+		U_ZERO(pf);
+	} else {
+		pf = U_TYPED_CALLOC(struct pooled_frame);
+		data = aligned_data_alloc(c != POOL_NO_CLASS ? class_capacity(c) : size);
+	}
+
+	pf->class_index = c;
+	pf->base.data = data;
+	pf->base.destroy = free_pooled;
+
+	return &pf->base;
 }
 
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
 void
 u_frame_create_one_off(enum xrt_format f, uint32_t width, uint32_t height, struct xrt_frame **out_frame)
 {
@@ -29,32 +243,25 @@ u_frame_create_one_off(enum xrt_format f, uint32_t width, uint32_t height, struc
 	assert(height > 0);
 	assert(u_format_is_blocks(f));
 
-	struct xrt_frame *xf = U_TYPED_CALLOC(struct xrt_frame);
+	size_t stride = 0;
+	size_t size = 0;
+	u_format_size_for_dimensions(f, width, height, &stride, &size);
+
+	struct xrt_frame *xf = alloc_pooled(size);
 
 	xf->format = f;
 	xf->width = width;
 	xf->height = height;
-	xf->destroy = free_one_off;
-
-	u_format_size_for_dimensions(f, width, height, &xf->stride, &xf->size);
-
-	xf->data = (uint8_t *)realloc(xf->data, xf->size);
+	xf->stride = stride;
+	xf->size = size;
 
 	xrt_frame_reference(out_frame, xf);
 }
 
-static void
-free_clone(struct xrt_frame *xf)
-{
-	assert(xf->reference.count == 0);
-	free(xf->data);
-	free(xf);
-}
-
 void
 u_frame_clone(struct xrt_frame *to_copy, struct xrt_frame **out_frame)
 {
-	struct xrt_frame *xf = U_TYPED_CALLOC(struct xrt_frame);
+	struct xrt_frame *xf = alloc_pooled(to_copy->size);
 
 	// Explicitly only copy the fields we want
 	xf->width = to_copy->width;
@@ -70,15 +277,70 @@ u_frame_clone(struct xrt_frame *to_copy, struct xrt_frame **out_frame)
 	xf->source_sequence = to_copy->source_sequence;
 	xf->source_id = to_copy->source_id;
 
-	xf->destroy = free_clone;
-
-	xf->data = malloc(xf->size);
-
 	memcpy(xf->data, to_copy->data, xf->size);
 
 	xrt_frame_reference(out_frame, xf);
 }
 
+void
+u_frame_pool_get_stats(struct u_frame_pool_stats *out_stats)
+{
+	pool_lock();
+	*out_stats = g_pool.stats;
+	pool_unlock();
+}
+
+void
+u_frame_pool_add_user(void)
+{
+	pool_lock();
+	if (g_pool.users++ == 0) {
+		pool_add_vars();
+	}
+	pool_unlock();
+}
+
+void
+u_frame_pool_remove_user(void)
+{
+	pool_lock();
+	assert(g_pool.users > 0);
+	bool last = --g_pool.users == 0;
+	if (last) {
+		u_var_remove_root(&g_pool);
+	}
+	pool_unlock();
+
+	if (last) {
+		u_frame_pool_trim();
+	}
+}
+
+void
+u_frame_pool_trim(void)
+{
+	struct pooled_frame *lists[POOL_CLASS_COUNT];
+
+	pool_lock();
+	for (uint32_t i = 0; i < POOL_CLASS_COUNT; i++) {
+		lists[i] = g_pool.free_lists[i];
+		g_pool.free_lists[i] = NULL;
+		g_pool.free_counts[i] = 0;
+	}
+	g_pool.stats.frames_cached = 0;
+	g_pool.stats.bytes_cached = 0;
+	pool_unlock();
+
+	for (uint32_t i = 0; i < POOL_CLASS_COUNT; i++) {
+		while (lists[i] != NULL) {
+			struct pooled_frame *pf = lists[i];
+			lists[i] = pf->next;
+			aligned_data_free(pf->base.data);
+			free(pf);
+		}
+	}
+}
+
 static void
 free_roi(struct xrt_frame *xf)
 {
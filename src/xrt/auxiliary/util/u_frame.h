@@ -17,19 +17,66 @@ extern "C" {
 
 
 /*!
- * Creates a single non-pooled frame, when the reference reaches zero it is
- * freed.
+ * Statistics of the frame pool that @ref u_frame_create_one_off and
+ * @ref u_frame_clone allocate from.
+ */
+struct u_frame_pool_stats
+{
+	//! Frames that reused the data of a returned frame.
+	uint64_t hits;
+
+	//! Frames that needed a new allocation.
+	uint64_t misses;
+
+	//! Pooled frames currently referenced.
+	uint64_t frames_in_use;
+
+	//! Returned frames kept for reuse, and the size of their data.
+	uint64_t frames_cached;
+	uint64_t bytes_cached;
+};
+
+/*!
+ * Creates a single frame, when the reference reaches zero it is returned to
+ * the frame pool. The data is page aligned and not cleared.
  */
 void
 u_frame_create_one_off(enum xrt_format f, uint32_t width, uint32_t height, struct xrt_frame **out_frame);
 
 /*!
- * Clones a frame. The cloned frame is not freed when the original frame is freed; instead the cloned frame is freed
- * when its reference reaches zero.
+ * Clones a frame. The cloned frame is not freed when the original frame is freed; instead the cloned frame is returned
+ * to the frame pool when its reference reaches zero. The data is page aligned.
  */
 void
 u_frame_clone(struct xrt_frame *to_copy, struct xrt_frame **out_frame);
 
+/*!
+ * Get the statistics of the frame pool, also shown in the debug gui.
+ */
+void
+u_frame_pool_get_stats(struct u_frame_pool_stats *out_stats);
+
+/*!
+ * Register a user of the frame pool, returned frames are only kept for reuse
+ * while there is at least one. Frame nodes that allocate frames call this on
+ * creation and @ref u_frame_pool_remove_user when destroyed.
+ */
+void
+u_frame_pool_add_user(void);
+
+/*!
+ * Unregister a user of the frame pool, when the last one is removed all
+ * cached frames are freed.
+ */
+void
+u_frame_pool_remove_user(void);
+
+/*!
+ * Free all frames kept for reuse by the frame pool.
+ */
+void
+u_frame_pool_trim(void);
+
 /*!
  * Creates a frame out of a region of interest from @p original frame. Does not
  * duplicate data, increases @p original refcount instead.
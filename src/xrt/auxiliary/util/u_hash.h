@@ -0,0 +1,47 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Simple non-cryptographic hashing.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include "xrt/xrt_compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//! Starting value for @ref u_hash_fnv1a_64.
+#define U_HASH_FNV1A_64_INIT (0xcbf29ce484222325ULL)
+
+/*!
+ * Continues a 64 bit FNV-1a hash with @p size bytes of @p data, start with
+ * @ref U_HASH_FNV1A_64_INIT. The result never changes between platforms or
+ * releases, so it can be used for keys stored on disk or generated code.
+ *
+ * @ingroup aux_util
+ */
+static inline uint64_t
+u_hash_fnv1a_64(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,24 +7,69 @@
  * @ingroup aux_util
  */
 
+#include "os/os_time.h"
 #include "os/os_threading.h"
 
 #include "util/u_metrics.h"
 #include "util/u_debug.h"
+#include "util/u_time.h"
 
 #include "monado_metrics.pb.h"
 #include "pb_encode.h"
 
 #include <stdio.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #define VERSION_MAJOR 1
 #define VERSION_MINOR 1
 
+//! Number of records that can be waiting for the writer, must be a power of two.
+#define RING_SIZE (1024)
+
+//! How long the writer sleeps when it has drained the ring.
+#define WRITER_PERIOD_NS (U_TIME_1MS_IN_NS * 10)
+
+//! Encoded records are written to the file in blocks of this size.
+#define BLOCK_SIZE (64 * 1024)
+
+//! Largest encoded record, including the submessage header.
+#define MAX_RECORD_SIZE (monado_metrics_Record_size + 10)
+
+/*!
+ * A slot in the ring, @ref seq tells producers and the writer whose turn it
+ * is, the classic bounded queue with a sequence number per slot.
+ */
+struct ring_slot
+{
+	volatile uint32_t seq;
+	monado_metrics_Record record;
+};
+
 static FILE *g_file = NULL;
-static struct os_mutex g_file_mutex;
 static bool g_metrics_initialized = false;
 static bool g_metrics_early_flush = false;
 
+/*!
+ * Records go through this ring so the threads writing metrics, like the
+ * compositor, only copy the record and never encode, take a lock or do IO.
+ * Static so a late writer racing with close never touches freed memory.
+ */
+static struct ring_slot g_ring[RING_SIZE];
+
+//! Next slot to claim by producers.
+static volatile uint32_t g_ring_head = 0;
+
+//! Next slot to write for the writer thread, only touched by it.
+static uint32_t g_ring_tail = 0;
+
+//! Records dropped because the writer fell behind.
+static xrt_atomic_s32_t g_dropped = 0;
+
+static struct os_thread_helper g_writer;
+
 DEBUG_GET_ONCE_OPTION(metrics_file, "XRT_METRICS_FILE", NULL)
 DEBUG_GET_ONCE_BOOL_OPTION(metrics_early_flush, "XRT_METRICS_EARLY_FLUSH", false)
 
@@ -36,28 +81,153 @@ DEBUG_GET_ONCE_BOOL_OPTION(metrics_early_flush, "XRT_METRICS_EARLY_FLUSH", false
  *
  */
 
+static inline uint32_t
+load_acquire(volatile uint32_t *p)
+{
+#if defined(__GNUC__)
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER)
+	uint32_t ret = *p;
+	_ReadWriteBarrier();
+	return ret;
+#else
+#error "compiler not supported"
+#endif
+}
+
+static inline void
+store_release(volatile uint32_t *p, uint32_t value)
+{
+#if defined(__GNUC__)
+	__atomic_store_n(p, value, __ATOMIC_RELEASE);
+#elif defined(_MSC_VER)
+	_ReadWriteBarrier();
+	*p = value;
+#else
+#error "compiler not supported"
+#endif
+}
+
+static void
+ring_init(void)
+{
+	for (uint32_t i = 0; i < RING_SIZE; i++) {
+		g_ring[i].seq = i;
+	}
+
+	g_ring_head = 0;
+	g_ring_tail = 0;
+	g_dropped = 0;
+}
+
+/*!
+ * Called from any thread, never blocks.
+ */
 static void
 write_record(monado_metrics_Record *r)
 {
-	uint8_t buffer[monado_metrics_Record_size + 10]; // Including submessage
+	uint32_t pos = load_acquire(&g_ring_head);
+	struct ring_slot *slot;
+
+	while (true) {
+		slot = &g_ring[pos & (RING_SIZE - 1)];
+		int32_t diff = (int32_t)(load_acquire(&slot->seq) - pos);
+
+		if (diff < 0) {
+			// The writer hasn't gotten to this slot yet, full.
+			xrt_atomic_s32_inc_return(&g_dropped);
+			return;
+		}
+
+		if (diff > 0) {
+			// Another thread claimed it, try again.
+			pos = load_acquire(&g_ring_head);
+			continue;
+		}
+
+		uint32_t old = (uint32_t)xrt_atomic_s32_cmpxchg( //
+		    (xrt_atomic_s32_t *)&g_ring_head,          //
+		    (int32_t)pos,                              //
+		    (int32_t)(pos + 1));                       //
+		if (old == pos) {
+			break;
+		}
+		pos = old;
+	}
 
+	slot->record = *r;
 
-	pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
-	bool ret = pb_encode_submessage(&stream, &monado_metrics_Record_msg, r);
-	if (!ret) {
-		U_LOG_E("Failed to encode metrics message!");
-		return;
+	// Hand the slot over to the writer.
+	store_release(&slot->seq, pos + 1);
+}
+
+/*!
+ * Encodes all records in the ring and writes them in blocks, only called
+ * from the writer thread, or on close when it has stopped.
+ */
+static void
+drain(void)
+{
+	static uint8_t block[BLOCK_SIZE];
+	size_t block_used = 0;
+
+	while (true) {
+		struct ring_slot *slot = &g_ring[g_ring_tail & (RING_SIZE - 1)];
+		if (load_acquire(&slot->seq) != g_ring_tail + 1) {
+			break; // Empty.
+		}
+
+		if (block_used + MAX_RECORD_SIZE > sizeof(block)) {
+			fwrite(block, block_used, 1, g_file);
+			block_used = 0;
+		}
+
+		pb_ostream_t stream = pb_ostream_from_buffer(block + block_used, MAX_RECORD_SIZE);
+		bool ret = pb_encode_submessage(&stream, &monado_metrics_Record_msg, &slot->record);
+
+		// Free the slot for producers one lap later.
+		store_release(&slot->seq, g_ring_tail + RING_SIZE);
+		g_ring_tail++;
+
+		if (!ret) {
+			U_LOG_E("Failed to encode metrics message!");
+			continue;
+		}
+
+		block_used += stream.bytes_written;
 	}
 
-	os_mutex_lock(&g_file_mutex);
+	if (block_used == 0) {
+		return;
+	}
 
-	fwrite(buffer, stream.bytes_written, 1, g_file);
+	fwrite(block, block_used, 1, g_file);
 
 	if (g_metrics_early_flush) {
 		fflush(g_file);
 	}
+}
 
-	os_mutex_unlock(&g_file_mutex);
+static void *
+run_writer(void *ptr)
+{
+	int32_t reported_dropped = 0;
+
+	os_thread_helper_name(&g_writer, "Metrics Writer");
+
+	while (os_thread_helper_is_running(&g_writer)) {
+		drain();
+
+		int32_t dropped = g_dropped;
+		if (dropped != reported_dropped) {
+			U_LOG_W("Dropped %i metrics records, writer falling behind.", dropped - reported_dropped);
+			reported_dropped = dropped;
+		}
+
+		os_nanosleep(WRITER_PERIOD_NS);
+	}
+
+	return NULL;
 }
 
 static void
@@ -99,11 +269,29 @@ u_metrics_init(void)
 		return;
 	}
 
-	os_mutex_init(&g_file_mutex);
+	ring_init();
+
+	int ret = os_thread_helper_init(&g_writer);
+	if (ret < 0) {
+		U_LOG_E("Failed to init metrics writer thread!");
+		fclose(g_file);
+		g_file = NULL;
+		return;
+	}
 
-	g_metrics_initialized = true;
 	g_metrics_early_flush = debug_get_bool_option_metrics_early_flush();
 
+	ret = os_thread_helper_start(&g_writer, run_writer, NULL);
+	if (ret < 0) {
+		U_LOG_E("Failed to start metrics writer thread!");
+		os_thread_helper_destroy(&g_writer);
+		fclose(g_file);
+		g_file = NULL;
+		return;
+	}
+
+	g_metrics_initialized = true;
+
 	write_version(VERSION_MAJOR, VERSION_MINOR);
 
 	U_LOG_I("Opened metrics file: '%s'", str);
@@ -118,16 +306,22 @@ u_metrics_close(void)
 
 	U_LOG_I("Closing metrics file: '%s'", debug_get_option_metrics_file());
 
-	// At least try to avoid races.
-	os_mutex_lock(&g_file_mutex);
+	// Stop new records, at least try to avoid races.
+	g_metrics_initialized = false;
+
+	// Stops and waits for the writer thread.
+	os_thread_helper_destroy(&g_writer);
+
+	// Whatever the writer didn't get to.
+	drain();
+
+	if (g_dropped > 0) {
+		U_LOG_W("Dropped %i metrics records in total.", (int32_t)g_dropped);
+	}
+
 	fflush(g_file);
 	fclose(g_file);
 	g_file = NULL;
-	os_mutex_unlock(&g_file_mutex);
-
-	os_mutex_destroy(&g_file_mutex);
-
-	g_metrics_initialized = false;
 }
 
 bool
@@ -136,6 +330,12 @@ u_metrics_is_active(void)
 	return g_metrics_initialized;
 }
 
+uint32_t
+u_metrics_get_dropped_count(void)
+{
+	return (uint32_t)g_dropped;
+}
+
 void
 u_metrics_write_session_frame(struct u_metrics_session_frame *umsf)
 {
@@ -89,6 +89,13 @@ u_metrics_close(void);
 bool
 u_metrics_is_active(void);
 
+/*!
+ * Number of records dropped since init because the writer thread couldn't
+ * keep up, they are never allowed to block the thread writing them.
+ */
+uint32_t
+u_metrics_get_dropped_count(void);
+
 void
 u_metrics_write_session_frame(struct u_metrics_session_frame *umsf);
 
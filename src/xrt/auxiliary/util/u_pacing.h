@@ -744,6 +744,54 @@ u_pc_display_timing_create(int64_t estimated_frame_period_ns,
 xrt_result_t
 u_pc_fake_create(int64_t estimated_frame_period_ns, int64_t now_ns, struct u_pacing_compositor **out_upc);
 
+/*!
+ * Creates a new composition pacing helper for streaming targets.
+ *
+ * For targets that hand frames to a video encoder instead of a display, the
+ * phase of when the streamer wants frames is given through
+ * @ref u_pc_update_vblank_from_display_control, the frame period is learned
+ * from how far apart the phases are. Composite time is learned from
+ * @ref u_pc_info_gpu, encode and network/decode latency through
+ * @ref u_pc_stream_info_encode and @ref u_pc_stream_info_latency. Targets that
+ * have no latency feedback get the fixed `U_PACING_STREAM_LATENCY_MS`.
+ *
+ * @param[in]  estimated_frame_period_ns The frame period of the client display in nanoseconds.
+ * @param[in]  now_ns                    The current timestamp in nanoseconds, nominally from @ref os_monotonic_get_ns
+ * @param[out] out_upc                   The pointer to populate with the created compositor pacing helper
+ *
+ * @ingroup aux_pacing
+ * @see u_pacing_compositor
+ */
+xrt_result_t
+u_pc_stream_create(int64_t estimated_frame_period_ns, int64_t now_ns, struct u_pacing_compositor **out_upc);
+
+/*!
+ * Tell a pacer created with @ref u_pc_stream_create how long the encoder took.
+ *
+ * @param[in] upc        A pacer created with @ref u_pc_stream_create.
+ * @param[in] frame_id   The frame ID to record for.
+ * @param[in] present_ns When the frame was handed to the encoder.
+ * @param[in] encoded_ns When the encoder was done with the frame.
+ *
+ * @ingroup aux_pacing
+ */
+void
+u_pc_stream_info_encode(struct u_pacing_compositor *upc, int64_t frame_id, int64_t present_ns, int64_t encoded_ns);
+
+/*!
+ * Tell a pacer created with @ref u_pc_stream_create how long it took from the
+ * encoder being done until the frame was displayed on the client, this covers
+ * network transfer and decoding.
+ *
+ * @param[in] upc                   A pacer created with @ref u_pc_stream_create.
+ * @param[in] frame_id              The frame ID to record for.
+ * @param[in] encoded_to_display_ns Time from encoder done to display.
+ *
+ * @ingroup aux_pacing
+ */
+void
+u_pc_stream_info_latency(struct u_pacing_compositor *upc, int64_t frame_id, int64_t encoded_to_display_ns);
+
 /*!
  * Creates a new application pacing factory helper.
  *
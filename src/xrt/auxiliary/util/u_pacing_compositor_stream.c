@@ -0,0 +1,502 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Compositor pacing for streaming targets, driven by encoder feedback.
+ * @ingroup aux_util
+ */
+
+#include "os/os_time.h"
+
+#include "util/u_var.h"
+#include "util/u_time.h"
+#include "util/u_misc.h"
+#include "util/u_debug.h"
+#include "util/u_pacing.h"
+#include "util/u_metrics.h"
+#include "util/u_logging.h"
+#include "util/u_trace_marker.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <inttypes.h>
+
+
+/*
+ *
+ * Structs and defines.
+ *
+ */
+
+DEBUG_GET_ONCE_LOG_OPTION(log_level, "U_PACING_STREAM_LOG", U_LOGGING_WARN)
+DEBUG_GET_ONCE_FLOAT_OPTION(latency_ms, "U_PACING_STREAM_LATENCY_MS", 10.0f)
+DEBUG_GET_ONCE_FLOAT_OPTION(margin_ms, "U_PACING_STREAM_MARGIN_MS", 0.5f)
+
+#define UPC_LOG_T(...) U_LOG_IFL_T(debug_get_log_option_log_level(), __VA_ARGS__)
+#define UPC_LOG_D(...) U_LOG_IFL_D(debug_get_log_option_log_level(), __VA_ARGS__)
+#define UPC_LOG_I(...) U_LOG_IFL_I(debug_get_log_option_log_level(), __VA_ARGS__)
+
+// We keep track of this number of frames.
+#define FRAME_COUNT 16
+
+/*!
+ * Both gain values are powers of two fractions, same as the classic
+ * round-trip-time estimator, the mean reacts in ~8 frames and the deviation
+ * in ~4 frames.
+ */
+#define STAT_MEAN_GAIN (1.0 / 8.0)
+#define STAT_DEV_GAIN (1.0 / 4.0)
+
+/*
+ * Internal helper for keeping a smoothed estimate of a duration.
+ */
+struct duration_stat
+{
+	//! Smoothed mean in nanoseconds.
+	double mean_ns;
+
+	//! Smoothed mean absolute deviation in nanoseconds.
+	double dev_ns;
+
+	//! Has this received any samples.
+	bool valid;
+
+	//! Current estimate, mean plus deviations, exposed via u_var.
+	int64_t estimate_ns;
+};
+
+/*
+ * Internal helper for keeping track of frame data.
+ */
+struct frame
+{
+	//! An arbitrary id that identifies this frame. Set in `pc_predict`.
+	int64_t frame_id;
+
+	//! When should the compositor wake up. Set in `pc_predict`.
+	int64_t predicted_wake_up_time_ns;
+
+	//! When should the compositor hand the frame to the encoder.
+	int64_t predicted_present_time_ns;
+
+	//! When should the frame be displayed on the client.
+	int64_t predicted_display_time_ns;
+
+	//! When the compositor woke up, set in `pc_mark_point`.
+	int64_t when_woke_ns;
+
+	//! When the compositor completed submitting the work to the GPU, set in `pc_mark_point`.
+	int64_t when_submit_end_ns;
+
+	//! When the encoder finished with the frame, set in @ref u_pc_stream_info_encode.
+	int64_t when_encoded_ns;
+};
+
+/*!
+ * A pacer for targets that don't scan out to a display but hand frames to a
+ * video encoder, the frame then travels over the network and is decoded by a
+ * client that has its own display.
+ *
+ * The time line of a frame looks like this:
+ *
+ * ```
+ * wake_up -> composite -> present -> encode -> network + decode -> display
+ * ```
+ *
+ * Present here is when the frame is handed over to the encoder, the phase of
+ * which is given to us through @ref u_pc_update_vblank_from_display_control.
+ * The frame period is learned from how far apart those phases are, composite
+ * and encode time from feedback. Network and decode latency is only learned
+ * if the target can tell us, otherwise it stays at `U_PACING_STREAM_LATENCY_MS`.
+ */
+struct stream_timing
+{
+	struct u_pacing_compositor base;
+
+	//! The periodicity of the client display, learned from @ref period.
+	int64_t frame_period_ns;
+
+	//! What the target said the period is, observed periods must be close to it.
+	int64_t nominal_frame_period_ns;
+
+	//! Last known time the streamer wanted a frame, used as the phase.
+	int64_t last_present_time_ns;
+
+	//! Has @ref last_present_time_ns been given to us, or is it our guess.
+	bool got_phase;
+
+	//! Extra margin between the compositor being done and present.
+	int64_t margin_ns;
+
+	//! Time between two phases given to us, the observed present interval.
+	struct duration_stat period;
+
+	//! Wake up to GPU done.
+	struct duration_stat comp;
+
+	//! Present to encoder done.
+	struct duration_stat encode;
+
+	//! Encoder done to photons on the client, network and decode.
+	struct duration_stat latency;
+
+	//! This won't run out, trust me.
+	int64_t frame_id_generator;
+
+	//! Frames we keep track off.
+	struct frame frames[FRAME_COUNT];
+};
+
+
+/*
+ *
+ * Helper functions.
+ *
+ */
+
+static inline struct stream_timing *
+stream_timing(struct u_pacing_compositor *upc)
+{
+	return (struct stream_timing *)upc;
+}
+
+static void
+stat_init(struct duration_stat *s, int64_t initial_ns)
+{
+	s->mean_ns = (double)initial_ns;
+	s->dev_ns = 0.0;
+	s->valid = false;
+	s->estimate_ns = initial_ns;
+}
+
+static void
+stat_add(struct duration_stat *s, int64_t sample_ns, double deviations)
+{
+	if (sample_ns < 0) {
+		return;
+	}
+
+	double sample = (double)sample_ns;
+
+	if (!s->valid) {
+		// Seed with the first real sample, be pessimistic about the spread.
+		s->mean_ns = sample;
+		s->dev_ns = sample / 2.0;
+		s->valid = true;
+	} else {
+		double diff = sample - s->mean_ns;
+		s->dev_ns += STAT_DEV_GAIN * ((diff < 0 ? -diff : diff) - s->dev_ns);
+		s->mean_ns += STAT_MEAN_GAIN * diff;
+	}
+
+	s->estimate_ns = (int64_t)(s->mean_ns + deviations * s->dev_ns);
+}
+
+static struct frame *
+get_frame_or_null(struct stream_timing *st, int64_t frame_id)
+{
+	uint64_t index = (uint64_t)frame_id % FRAME_COUNT;
+	struct frame *f = &st->frames[index];
+
+	if (f->frame_id == frame_id) {
+		return f;
+	}
+	// Just drop it, info arrived too late.
+	return NULL;
+}
+
+static struct frame *
+get_new_frame(struct stream_timing *st)
+{
+	int64_t frame_id = st->frame_id_generator++;
+
+	uint64_t index = (uint64_t)frame_id % FRAME_COUNT;
+	struct frame *f = &st->frames[index];
+
+	U_ZERO(f);
+	f->frame_id = frame_id;
+
+	return f;
+}
+
+static int64_t
+get_comp_time(struct stream_timing *st)
+{
+	// Never give the compositor more than a full frame, it would never catch up.
+	int64_t comp_time_ns = st->comp.estimate_ns + st->margin_ns;
+	if (comp_time_ns > st->frame_period_ns) {
+		comp_time_ns = st->frame_period_ns;
+	}
+	return comp_time_ns;
+}
+
+static int64_t
+predict_next_frame_present_time(struct stream_timing *st, int64_t now_ns)
+{
+	int64_t time_needed_ns = get_comp_time(st);
+	int64_t earliest_ns = now_ns + time_needed_ns;
+	int64_t present_time_ns = st->last_present_time_ns;
+
+	// Jump straight to the right period, the phase might be old.
+	if (present_time_ns < earliest_ns) {
+		int64_t periods = (earliest_ns - present_time_ns + st->frame_period_ns - 1) / st->frame_period_ns;
+		present_time_ns += periods * st->frame_period_ns;
+	}
+
+	return present_time_ns;
+}
+
+static void
+add_stat_vars(struct stream_timing *st, struct duration_stat *s, const char *name)
+{
+	u_var_add_ro_i64(st, &s->estimate_ns, name);
+}
+
+
+/*
+ *
+ * Member functions.
+ *
+ */
+
+static void
+pc_predict(struct u_pacing_compositor *upc,
+           int64_t now_ns,
+           int64_t *out_frame_id,
+           int64_t *out_wake_up_time_ns,
+           int64_t *out_desired_present_time_ns,
+           int64_t *out_present_slop_ns,
+           int64_t *out_predicted_display_time_ns,
+           int64_t *out_predicted_display_period_ns,
+           int64_t *out_min_display_period_ns)
+{
+	struct stream_timing *st = stream_timing(upc);
+
+	struct frame *f = get_new_frame(st);
+
+	int64_t frame_id = f->frame_id;
+	int64_t desired_present_time_ns = predict_next_frame_present_time(st, now_ns);
+	int64_t wake_up_time_ns = desired_present_time_ns - get_comp_time(st);
+	int64_t predicted_display_time_ns =
+	    desired_present_time_ns + st->encode.estimate_ns + st->latency.estimate_ns;
+	int64_t present_slop_ns = U_TIME_HALF_MS_IN_NS;
+	int64_t predicted_display_period_ns = st->frame_period_ns;
+	int64_t min_display_period_ns = st->frame_period_ns;
+
+	// Set the frame info.
+	f->predicted_wake_up_time_ns = wake_up_time_ns;
+	f->predicted_present_time_ns = desired_present_time_ns;
+	f->predicted_display_time_ns = predicted_display_time_ns;
+
+	UPC_LOG_T("%" PRIi64 ": wake %.2fms present %.2fms display %.2fms", frame_id,
+	          time_ns_to_ms_f(wake_up_time_ns - now_ns), time_ns_to_ms_f(desired_present_time_ns - now_ns),
+	          time_ns_to_ms_f(predicted_display_time_ns - now_ns));
+
+	*out_frame_id = frame_id;
+	*out_wake_up_time_ns = wake_up_time_ns;
+	*out_desired_present_time_ns = desired_present_time_ns;
+	*out_present_slop_ns = present_slop_ns;
+	*out_predicted_display_time_ns = predicted_display_time_ns;
+	*out_predicted_display_period_ns = predicted_display_period_ns;
+	*out_min_display_period_ns = min_display_period_ns;
+
+	if (!u_metrics_is_active()) {
+		return;
+	}
+
+	struct u_metrics_system_frame umsf = {
+	    .frame_id = frame_id,
+	    .predicted_display_time_ns = predicted_display_time_ns,
+	    .predicted_display_period_ns = predicted_display_period_ns,
+	    .desired_present_time_ns = desired_present_time_ns,
+	    .wake_up_time_ns = wake_up_time_ns,
+	    .present_slop_ns = present_slop_ns,
+	};
+
+	u_metrics_write_system_frame(&umsf);
+}
+
+static void
+pc_mark_point(struct u_pacing_compositor *upc, enum u_timing_point point, int64_t frame_id, int64_t when_ns)
+{
+	struct stream_timing *st = stream_timing(upc);
+	struct frame *f = get_frame_or_null(st, frame_id);
+
+	// Just drop info if no frame found.
+	if (f == NULL) {
+		return;
+	}
+
+	switch (point) {
+	case U_TIMING_POINT_WAKE_UP: f->when_woke_ns = when_ns; break;
+	case U_TIMING_POINT_BEGIN: break;
+	case U_TIMING_POINT_SUBMIT_BEGIN: break;
+	case U_TIMING_POINT_SUBMIT_END: f->when_submit_end_ns = when_ns; break;
+	default: assert(false);
+	}
+}
+
+static void
+pc_info(struct u_pacing_compositor *upc,
+        int64_t frame_id,
+        int64_t desired_present_time_ns,
+        int64_t actual_present_time_ns,
+        int64_t earliest_present_time_ns,
+        int64_t present_margin_ns,
+        int64_t when_ns)
+{
+	// There is no display timing for streaming targets.
+}
+
+static void
+pc_info_gpu(
+    struct u_pacing_compositor *upc, int64_t frame_id, int64_t gpu_start_ns, int64_t gpu_end_ns, int64_t when_ns)
+{
+	struct stream_timing *st = stream_timing(upc);
+
+	struct frame *f = get_frame_or_null(st, frame_id);
+	if (f != NULL && f->when_woke_ns != 0) {
+		stat_add(&st->comp, gpu_end_ns - f->when_woke_ns, 2.0);
+	}
+
+	if (u_metrics_is_active()) {
+		struct u_metrics_system_gpu_info umgi = {
+		    .frame_id = frame_id,
+		    .gpu_start_ns = gpu_start_ns,
+		    .gpu_end_ns = gpu_end_ns,
+		    .when_ns = when_ns,
+		};
+
+		u_metrics_write_system_gpu_info(&umgi);
+	}
+
+#ifdef U_TRACE_TRACY
+	int64_t diff_ns = gpu_end_ns - gpu_start_ns;
+	TracyCPlot("Compositor GPU(ms)", time_ns_to_ms_f(diff_ns));
+#endif
+}
+
+static void
+pc_update_vblank_from_display_control(struct u_pacing_compositor *upc, int64_t last_vblank_ns)
+{
+	struct stream_timing *st = stream_timing(upc);
+
+	/*
+	 * The same phase is often given many times with a bit of noise, only
+	 * new ones tell us the period. Phases might also be skipped, so divide
+	 * by the number of periods between them.
+	 */
+	int64_t diff_ns = last_vblank_ns - st->last_present_time_ns;
+	if (st->got_phase && diff_ns > st->frame_period_ns / 2) {
+		int64_t periods = (diff_ns + st->frame_period_ns / 2) / st->frame_period_ns;
+		int64_t sample_ns = diff_ns / periods;
+
+		// Far off from what the target said, an old or reset phase.
+		int64_t max_off_ns = st->nominal_frame_period_ns / 4;
+		if (sample_ns > st->nominal_frame_period_ns - max_off_ns &&
+		    sample_ns < st->nominal_frame_period_ns + max_off_ns) {
+			stat_add(&st->period, sample_ns, 0.0);
+			st->frame_period_ns = st->period.estimate_ns;
+		}
+	}
+
+	// For streaming this is when the streamer wants the next frame.
+	st->last_present_time_ns = last_vblank_ns;
+	st->got_phase = true;
+}
+
+static void
+pc_update_present_offset(struct u_pacing_compositor *upc, int64_t frame_id, int64_t present_to_display_offset_ns)
+{
+	struct stream_timing *st = stream_timing(upc);
+
+	// Whole offset given, take out what we already know the encoder takes.
+	int64_t latency_ns = present_to_display_offset_ns - (int64_t)st->encode.mean_ns;
+	stat_add(&st->latency, latency_ns, 1.0);
+}
+
+static void
+pc_destroy(struct u_pacing_compositor *upc)
+{
+	struct stream_timing *st = stream_timing(upc);
+
+	u_var_remove_root(st);
+
+	free(st);
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+void
+u_pc_stream_info_encode(struct u_pacing_compositor *upc, int64_t frame_id, int64_t present_ns, int64_t encoded_ns)
+{
+	struct stream_timing *st = stream_timing(upc);
+
+	struct frame *f = get_frame_or_null(st, frame_id);
+	if (f != NULL) {
+		f->when_encoded_ns = encoded_ns;
+	}
+
+	stat_add(&st->encode, encoded_ns - present_ns, 2.0);
+}
+
+void
+u_pc_stream_info_latency(struct u_pacing_compositor *upc, int64_t frame_id, int64_t encoded_to_display_ns)
+{
+	struct stream_timing *st = stream_timing(upc);
+
+	(void)frame_id;
+
+	// The display time is a prediction, bias towards the mean.
+	stat_add(&st->latency, encoded_to_display_ns, 1.0);
+}
+
+xrt_result_t
+u_pc_stream_create(int64_t estimated_frame_period_ns, int64_t now_ns, struct u_pacing_compositor **out_upc)
+{
+	struct stream_timing *st = U_TYPED_CALLOC(struct stream_timing);
+	st->base.predict = pc_predict;
+	st->base.mark_point = pc_mark_point;
+	st->base.info = pc_info;
+	st->base.info_gpu = pc_info_gpu;
+	st->base.update_vblank_from_display_control = pc_update_vblank_from_display_control;
+	st->base.update_present_offset = pc_update_present_offset;
+	st->base.destroy = pc_destroy;
+	st->frame_period_ns = estimated_frame_period_ns;
+	st->nominal_frame_period_ns = estimated_frame_period_ns;
+	st->margin_ns = time_ms_f_to_ns(debug_get_float_option_margin_ms());
+
+	// To make sure the code can start from a non-zero frame id.
+	st->frame_id_generator = 5;
+
+	// Initial guesses until we have real data, encode is async to the compositor.
+	stat_init(&st->period, estimated_frame_period_ns);
+	stat_init(&st->comp, estimated_frame_period_ns / 5);
+	stat_init(&st->encode, estimated_frame_period_ns / 4);
+	stat_init(&st->latency, time_ms_f_to_ns(debug_get_float_option_latency_ms()));
+
+	// Make the next present time be in the future.
+	st->last_present_time_ns = now_ns + U_TIME_1MS_IN_NS * 50;
+
+	// U variable tracking.
+	u_var_add_root(st, "Compositor timing info (stream)", true);
+	u_var_add_ro_i64(st, &st->frame_period_ns, "Frame period(ns)");
+	u_var_add_ro_i64(st, &st->margin_ns, "Margin(ns)");
+	add_stat_vars(st, &st->period, "Observed present interval(ns)");
+	add_stat_vars(st, &st->comp, "Compositor time(ns)");
+	add_stat_vars(st, &st->encode, "Encode time(ns)");
+	add_stat_vars(st, &st->latency, "Network and decode latency(ns)");
+	u_var_add_ro_i64(st, &st->last_present_time_ns, "Last present time(ns)");
+
+	// Return value.
+	*out_upc = &st->base;
+
+	UPC_LOG_I("Created stream timing");
+
+	return XRT_SUCCESS;
+}
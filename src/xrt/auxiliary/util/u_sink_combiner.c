@@ -239,6 +239,7 @@ combiner_destroy(struct xrt_frame_node *node)
 	// Destroy resources.
 	pthread_mutex_destroy(&q->mutex);
 	pthread_cond_destroy(&q->cond);
+	u_frame_pool_remove_user();
 	free(q);
 }
 
@@ -275,6 +276,8 @@ u_sink_combiner_create(struct xrt_frame_context *xfctx,
 		return false;
 	}
 
+	u_frame_pool_add_user();
+
 	xrt_frame_context_add(xfctx, &q->node);
 
 
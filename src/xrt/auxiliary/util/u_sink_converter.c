@@ -9,12 +9,16 @@
  */
 
 #include "xrt/xrt_config_have.h"
+#include "os/os_threading.h"
+#include "util/u_debug.h"
 #include "util/u_logging.h"
 #include "util/u_misc.h"
 #include "util/u_sink.h"
 #include "util/u_frame.h"
 #include "util/u_format.h"
+#include "util/u_format_convert.h"
 #include "util/u_trace_marker.h"
+#include "util/u_worker.h"
 
 #include <stdio.h>
 
@@ -23,6 +27,13 @@
 #endif
 
 
+DEBUG_GET_ONCE_NUM_OPTION(converter_threads, "U_SINK_CONVERTER_THREADS", 4)
+DEBUG_GET_ONCE_NUM_OPTION(converter_parallel_min_pixels, "U_SINK_CONVERTER_PARALLEL_MIN_PIXELS", 512 * 1024)
+
+//! Upper limit of @p U_SINK_CONVERTER_THREADS, also the max number of row bands.
+#define MAX_THREADS (16)
+
+
 /*
  *
  * Structs
@@ -42,243 +53,281 @@ struct u_sink_converter
 	struct xrt_frame_sink *downstream;
 
 	enum xrt_format format;
+
+	//! Reference to the shared pool, held so that the last converter destroys it.
+	struct u_worker_thread_pool *pool;
+
+	//! Created on the first frame big enough to be converted in row bands.
+	struct u_worker_group *group;
+};
+
+/*!
+ * A band of rows converted by one task.
+ */
+struct convert_band
+{
+	u_format_convert_row_func_t func;
+	struct xrt_frame *dst_frame;
+	uint32_t w;
+	uint32_t first_row;
+	uint32_t row_count;
+	size_t stride;
+	const uint8_t *data;
+	uint32_t src_rows;
 };
 
+/*!
+ * The thread pool shared by all converters, only alive while a converter
+ * holds a reference to it. The lock only guards creating and destroying it.
+ */
+static struct
+{
+	struct os_mutex lock;
+	struct u_worker_thread_pool *pool;
+} g_shared = {.lock = OS_MUTEX_INITIALIZER};
+
 
 /*
  *
- * L8 functions.
+ * Shared thread pool.
  *
  */
 
 static void
-from_L8_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+shared_lock(void)
 {
-	SINK_TRACE_MARKER();
+	os_mutex_lock(&g_shared.lock);
+}
 
-	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x += 1) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
+static void
+shared_unlock(void)
+{
+	os_mutex_unlock(&g_shared.lock);
+}
 
-			src = src + (y * stride) + x;
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			dst[2] = dst[1] = dst[0] = src[0];
-		}
+static struct u_worker_thread_pool *
+shared_pool_get(uint32_t thread_count)
+{
+	struct u_worker_thread_pool *pool = NULL;
+
+	shared_lock();
+	if (g_shared.pool == NULL) {
+		// The thread converting the frame helps out while waiting, so start one less.
+		g_shared.pool = u_worker_thread_pool_create(thread_count - 1, thread_count, "Sink Converter");
+	} else {
+		xrt_reference_inc(&g_shared.pool->reference);
+	}
+	pool = g_shared.pool;
+	shared_unlock();
+
+	return pool;
+}
+
+static void
+shared_pool_put(struct u_worker_thread_pool *pool)
+{
+	shared_lock();
+	assert(pool == g_shared.pool);
+	if (xrt_reference_dec_and_is_zero(&pool->reference)) {
+		u_worker_thread_pool_destroy(pool);
+		g_shared.pool = NULL;
 	}
+	shared_unlock();
 }
 
 
 /*
  *
- * YUV functions.
+ * Row helpers.
  *
  */
 
-static inline int
-clamp_to_byte(int v)
+static void
+convert_band(struct convert_band *band)
 {
-	if (v < 0) {
-		return 0;
+	for (uint32_t y = band->first_row; y < band->first_row + band->row_count; y++) {
+		const uint8_t *src = band->data + (y * band->src_rows * band->stride);
+		uint8_t *dst = band->dst_frame->data + (y * band->dst_frame->stride);
+		band->func(src, band->stride, dst, band->w);
 	}
-	if (v >= 255) {
-		return 255;
-	}
-	return v;
 }
 
-static inline uint32_t
-YUV444_to_RGBX8888(int y, int u, int v)
+static void
+convert_band_task(void *ptr)
 {
-	int C = y - 16;
-	int D = u - 128;
-	int E = v - 128;
+	SINK_TRACE_IDENT(convert_band_task);
 
-	int R = clamp_to_byte((298 * C + 409 * E + 128) >> 8);
-	int G = clamp_to_byte((298 * C - 100 * D - 209 * E + 128) >> 8);
-	int B = clamp_to_byte((298 * C + 516 * D + 128) >> 8);
-
-	return B << 16 | G << 8 | R;
+	convert_band((struct convert_band *)ptr);
 }
 
-#undef USE_TABLE
-#ifdef USE_TABLE
-static uint32_t lookup_YUV_to_RGBX[256][256][256] = {0};
-
-static void
-generate_lookup_YUV_to_RGBX()
+//! Get the worker group, creating it if needed, returns NULL if running single threaded.
+static struct u_worker_group *
+get_group(struct u_sink_converter *s)
 {
-	if (lookup_YUV_to_RGBX[255][255][255] != 0) {
-		return;
+	if (s->group != NULL) {
+		return s->group;
 	}
 
-	int y;
-	int u;
-	int v;
+	int64_t thread_count = debug_get_num_option_converter_threads();
+	if (thread_count <= 1) {
+		return NULL;
+	}
+	if (thread_count > MAX_THREADS) {
+		thread_count = MAX_THREADS;
+	}
 
-	for (y = 0; y < 256; y++) {
-		for (u = 0; u < 256; u++) {
-			for (v = 0; v < 256; v++) {
-				lookup_YUV_to_RGBX[y][u][v] = YUV444_to_RGBX8888(y, u, v);
-			}
-		}
+	struct u_worker_thread_pool *pool = shared_pool_get((uint32_t)thread_count);
+	if (pool == NULL) {
+		return NULL;
 	}
-}
-#endif
 
-XRT_MAYBE_UNUSED inline static void
-YUYV422_to_R8G8B8X8(const uint8_t *input, uint32_t *rgb1, uint32_t *rgb2)
-{
-	uint8_t y0 = input[0];
-	uint8_t u = input[1];
-	uint8_t y1 = input[2];
-	uint8_t v = input[3];
+	s->group = u_worker_group_create(pool);
+	if (s->group == NULL) {
+		shared_pool_put(pool);
+		return NULL;
+	}
+	s->pool = pool;
 
-#ifdef USE_TABLE
-	*rgb1 = lookup_YUV_to_RGBX[y0][u][v];
-	*rgb2 = lookup_YUV_to_RGBX[y1][u][v];
-#else
-	*rgb1 = YUV444_to_RGBX8888(y0, u, v);
-	*rgb2 = YUV444_to_RGBX8888(y1, u, v);
-#endif
+	return s->group;
 }
 
-inline static void
-YUYV422_to_R8G8B8(const uint8_t *input, uint8_t *dst)
+/*!
+ * Runs the row kernel over the whole frame, @p src_rows is how many source
+ * rows each destination row is made from. Frames with enough pixels are
+ * split into bands of rows converted on the shared thread pool.
+ */
+static void
+convert_rows(struct u_sink_converter *s,
+             u_format_convert_row_func_t func,
+             struct xrt_frame *dst_frame,
+             uint32_t w,
+             uint32_t h,
+             size_t stride,
+             const uint8_t *data,
+             uint32_t src_rows)
 {
-	uint8_t y0 = input[0];
-	uint8_t u = input[1];
-	uint8_t y1 = input[2];
-	uint8_t v = input[3];
+	struct convert_band whole = {func, dst_frame, w, 0, h, stride, data, src_rows};
 
-#ifdef USE_TABLE
-	uint8_t *rgb1 = (uint8_t *)&lookup_YUV_to_RGBX[y0][u][v];
-	uint8_t *rgb2 = (uint8_t *)&lookup_YUV_to_RGBX[y1][u][v];
-#else
-	uint32_t rgb1v = YUV444_to_RGBX8888(y0, u, v);
-	uint32_t rgb2v = YUV444_to_RGBX8888(y1, u, v);
-	uint8_t *rgb1 = (uint8_t *)&rgb1v;
-	uint8_t *rgb2 = (uint8_t *)&rgb2v;
-#endif
+	uint64_t pixels = (uint64_t)w * h;
+	if (pixels < (uint64_t)debug_get_num_option_converter_parallel_min_pixels() || h < 2) {
+		convert_band(&whole);
+		return;
+	}
 
-	dst[0] = rgb1[0];
-	dst[1] = rgb1[1];
-	dst[2] = rgb1[2];
-	dst[3] = rgb2[0];
-	dst[4] = rgb2[1];
-	dst[5] = rgb2[2];
-}
-
-inline static void
-UYVY422_to_R8G8B8(const uint8_t *input, uint8_t *dst)
-{
-	uint8_t u = input[0];
-	uint8_t y0 = input[1];
-	uint8_t v = input[2];
-	uint8_t y1 = input[3];
-
-#ifdef USE_TABLE
-	uint8_t *rgb1 = (uint8_t *)&lookup_YUV_to_RGBX[y0][u][v];
-	uint8_t *rgb2 = (uint8_t *)&lookup_YUV_to_RGBX[y1][u][v];
-#else
-	uint32_t rgb1v = YUV444_to_RGBX8888(y0, u, v);
-	uint32_t rgb2v = YUV444_to_RGBX8888(y1, u, v);
-	uint8_t *rgb1 = (uint8_t *)&rgb1v;
-	uint8_t *rgb2 = (uint8_t *)&rgb2v;
-#endif
+	struct u_worker_group *group = get_group(s);
+	if (group == NULL) {
+		convert_band(&whole);
+		return;
+	}
+
+	uint32_t band_count = (uint32_t)debug_get_num_option_converter_threads();
+	if (band_count > MAX_THREADS) {
+		band_count = MAX_THREADS;
+	}
+	if (band_count > h) {
+		band_count = h;
+	}
 
-	dst[0] = rgb1[0];
-	dst[1] = rgb1[1];
-	dst[2] = rgb1[2];
-	dst[3] = rgb2[0];
-	dst[4] = rgb2[1];
-	dst[5] = rgb2[2];
+	struct convert_band bands[MAX_THREADS];
+	uint32_t first_row = 0;
+	for (uint32_t i = 0; i < band_count; i++) {
+		// Spread the remainder over the first bands.
+		uint32_t row_count = h / band_count + (i < h % band_count ? 1 : 0);
+
+		bands[i] = whole;
+		bands[i].first_row = first_row;
+		bands[i].row_count = row_count;
+		first_row += row_count;
+
+		u_worker_group_push(group, convert_band_task, &bands[i]);
+	}
+
+	u_worker_group_wait_all(group);
 }
 
-inline static void
-YUV444_to_R8G8B8(const uint8_t *input, uint8_t *dst)
+static inline const struct u_format_convert_funcs *
+funcs(void)
 {
-	uint8_t y = input[0];
-	uint8_t u = input[1];
-	uint8_t v = input[2];
+	return u_format_convert_get_best_funcs();
+}
 
-#ifdef USE_TABLE
-	uint8_t *rgb = (uint8_t *)&lookup_YUV_to_RGBX[y][u][v];
-#else
-	uint32_t rgbv = YUV444_to_RGBX8888(y, u, v);
-	uint8_t *rgb = (uint8_t *)&rgbv;
-#endif
 
-	dst[0] = rgb[0];
-	dst[1] = rgb[1];
-	dst[2] = rgb[2];
-}
+/*
+ *
+ * L8 functions.
+ *
+ */
 
 static void
-from_YUYV422_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_L8_to_R8G8B8(struct u_sink_converter *s,
+                  struct xrt_frame *dst_frame,
+                  uint32_t w,
+                  uint32_t h,
+                  size_t stride,
+                  const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x += 2) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
-
-			src = src + (y * stride) + (x * 2);
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			YUYV422_to_R8G8B8(src, dst);
-		}
-	}
+	convert_rows(s, funcs()->L8_to_R8G8B8, dst_frame, w, h, stride, data, 1);
 }
 
+
+/*
+ *
+ * YUV functions.
+ *
+ */
+
 static void
-from_YUYV422_to_L8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_YUYV422_to_R8G8B8(struct u_sink_converter *s,
+                       struct xrt_frame *dst_frame,
+                       uint32_t w,
+                       uint32_t h,
+                       size_t stride,
+                       const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	for (uint32_t y = 0; y < h; y++) {
-		const uint8_t *src = data + (y * stride);
-		uint8_t *dst = dst_frame->data + (y * dst_frame->stride);
-
-		for (uint32_t x = 0; x < w; x++) {
-			dst[x] = src[x * 2];
-		}
-	}
+	convert_rows(s, funcs()->YUYV422_to_R8G8B8, dst_frame, w, h, stride, data, 1);
 }
 
 static void
-from_UYVY422_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_YUYV422_to_L8(struct u_sink_converter *s,
+                   struct xrt_frame *dst_frame,
+                   uint32_t w,
+                   uint32_t h,
+                   size_t stride,
+                   const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x += 2) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
-
-			src = src + (y * stride) + (x * 2);
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			UYVY422_to_R8G8B8(src, dst);
-		}
-	}
+	convert_rows(s, funcs()->YUYV422_to_L8, dst_frame, w, h, stride, data, 1);
 }
 
-
 static void
-from_YUV888_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_UYVY422_to_R8G8B8(struct u_sink_converter *s,
+                       struct xrt_frame *dst_frame,
+                       uint32_t w,
+                       uint32_t h,
+                       size_t stride,
+                       const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x++) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
+	convert_rows(s, funcs()->UYVY422_to_R8G8B8, dst_frame, w, h, stride, data, 1);
+}
 
-			src = src + (y * stride) + (x * 3);
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			YUV444_to_R8G8B8(src, dst);
-		}
-	}
+static void
+from_YUV888_to_R8G8B8(struct u_sink_converter *s,
+                      struct xrt_frame *dst_frame,
+                      uint32_t w,
+                      uint32_t h,
+                      size_t stride,
+                      const uint8_t *data)
+{
+	SINK_TRACE_MARKER();
+
+	convert_rows(s, funcs()->YUV888_to_R8G8B8, dst_frame, w, h, stride, data, 1);
 }
 
 
@@ -398,36 +447,16 @@ from_MJPEG_to_YUV888(struct xrt_frame *dst_frame, size_t size, const uint8_t *da
  */
 
 static void
-from_BAYER_GR8_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_BAYER_GR8_to_R8G8B8(struct u_sink_converter *s,
+                         struct xrt_frame *dst_frame,
+                         uint32_t w,
+                         uint32_t h,
+                         size_t stride,
+                         const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
-	const uint8_t *src_data = data;
-	size_t src_stride = stride;
-
-	uint8_t *dst_data = dst_frame->data;
-	size_t dst_stride = dst_frame->stride;
-
-	for (uint32_t y = 0; y < h; y++) {
-		const uint8_t *src0 = src_data + (y * 2) * src_stride;
-		const uint8_t *src1 = src_data + (y * 2 + 1) * src_stride;
-		uint8_t *dst = dst_data + (y * dst_stride);
-
-		for (uint32_t x = 0; x < w; x++) {
-			uint8_t g0 = src0[0];
-			uint8_t r = src0[1];
-			uint8_t b = src1[0];
-			uint8_t g1 = src1[1];
-
-			dst[0] = r;
-			dst[1] = (g0 + g1) / 2;
-			dst[2] = b;
-
-			src0 += 2;
-			src1 += 2;
-			dst += 3;
-		}
-	}
+	convert_rows(s, funcs()->BAYER_GR8_to_R8G8B8, dst_frame, w, h, stride, data, 2);
 }
 
 
@@ -440,8 +469,7 @@ from_BAYER_GR8_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, si
 
 /*!
  * Creates a frame that the conversion should happen to, allows to set the size.
- *
- * @todo Allocate from a pool of frames.
+ * The frame comes from the frame pool, see @ref u_frame_create_one_off.
  */
 static bool
 create_frame_with_format_of_size(
@@ -490,7 +518,7 @@ convert_frame_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 		if (!create_frame_with_format(xf, XRT_FORMAT_L8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_L8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_YUYV422_to_L8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	default: U_LOG_E("Cannot convert from '%s' to L8!", u_format_str(xf->format)); return;
 	}
@@ -519,25 +547,25 @@ convert_frame_r8g8b8_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 		if (!create_frame_with_format_of_size(xf, w, h, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_BAYER_GR8_to_R8G8B8(converted, w, h, xf->stride, xf->data);
+		from_BAYER_GR8_to_R8G8B8(s, converted, w, h, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_YUYV422:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_YUYV422_to_R8G8B8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_UYVY422:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_UYVY422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_UYVY422_to_R8G8B8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_YUV888:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUV888_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_YUV888_to_R8G8B8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
@@ -593,19 +621,19 @@ convert_frame_r8g8b8_bayer_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_YUYV422_to_R8G8B8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_UYVY422:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_UYVY422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_UYVY422_to_R8G8B8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_YUV888:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUV888_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_YUV888_to_R8G8B8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
@@ -643,7 +671,7 @@ convert_frame_r8g8b8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_L8_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_L8_to_R8G8B8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_BAYER_GR8:;
 		uint32_t w = xf->width / 2;
@@ -651,25 +679,25 @@ convert_frame_r8g8b8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 		if (!create_frame_with_format_of_size(xf, w, h, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_BAYER_GR8_to_R8G8B8(converted, w, h, xf->stride, xf->data);
+		from_BAYER_GR8_to_R8G8B8(s, converted, w, h, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_YUYV422:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_YUYV422_to_R8G8B8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_UYVY422:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_UYVY422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_UYVY422_to_R8G8B8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 	case XRT_FORMAT_YUV888:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUV888_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		from_YUV888_to_R8G8B8(s, converted, xf->width, xf->height, xf->stride, xf->data);
 		break;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
@@ -812,7 +840,7 @@ convert_frame_bayer(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 		return;
 	}
 
-	from_BAYER_GR8_to_R8G8B8(converted, w, h, xf->stride, xf->data);
+	from_BAYER_GR8_to_R8G8B8(s, converted, w, h, xf->stride, xf->data);
 
 	s->downstream->push_frame(s->downstream, converted);
 
@@ -829,6 +857,15 @@ destroy(struct xrt_frame_node *node)
 {
 	struct u_sink_converter *s = container_of(node, struct u_sink_converter, node);
 
+	// Drop the group's pool reference first, so ours can be the last one.
+	u_worker_group_reference(&s->group, NULL);
+	if (s->pool != NULL) {
+		shared_pool_put(s->pool);
+		s->pool = NULL;
+	}
+
+	u_frame_pool_remove_user();
+
 	free(s);
 }
 
@@ -855,16 +892,14 @@ u_sink_create_format_converter(struct xrt_frame_context *xfctx,
 	default: U_LOG_E("Format '%s' not supported", u_format_str(format)); return;
 	}
 
-#ifdef USE_TABLE
-	generate_lookup_YUV_to_RGBX();
-#endif
-
 	struct u_sink_converter *s = U_TYPED_CALLOC(struct u_sink_converter);
 	s->base.push_frame = func;
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
 
+	u_frame_pool_add_user();
+
 	xrt_frame_context_add(xfctx, &s->node);
 
 	*out_xfs = &s->base;
@@ -883,9 +918,7 @@ u_sink_create_to_r8g8b8_or_l8(struct xrt_frame_context *xfctx,
 	s->node.destroy = destroy;
 	s->downstream = downstream;
 
-#ifdef USE_TABLE
-	generate_lookup_YUV_to_RGBX();
-#endif
+	u_frame_pool_add_user();
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -905,9 +938,7 @@ u_sink_create_to_r8g8b8_r8g8b8a8_r8g8b8x8_or_l8(struct xrt_frame_context *xfctx,
 	s->node.destroy = destroy;
 	s->downstream = downstream;
 
-#ifdef USE_TABLE
-	generate_lookup_YUV_to_RGBX();
-#endif
+	u_frame_pool_add_user();
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -927,6 +958,8 @@ u_sink_create_to_r8g8b8_bayer_or_l8(struct xrt_frame_context *xfctx,
 	s->node.destroy = destroy;
 	s->downstream = downstream;
 
+	u_frame_pool_add_user();
+
 	xrt_frame_context_add(xfctx, &s->node);
 
 	*out_xfs = &s->base;
@@ -945,6 +978,8 @@ u_sink_create_to_rgb_yuv_yuyv_uyvy_or_l8(struct xrt_frame_context *xfctx,
 	s->node.destroy = destroy;
 	s->downstream = downstream;
 
+	u_frame_pool_add_user();
+
 	xrt_frame_context_add(xfctx, &s->node);
 
 	*out_xfs = &s->base;
@@ -963,6 +998,8 @@ u_sink_create_to_yuv_yuyv_uyvy_or_l8(struct xrt_frame_context *xfctx,
 	s->node.destroy = destroy;
 	s->downstream = downstream;
 
+	u_frame_pool_add_user();
+
 	xrt_frame_context_add(xfctx, &s->node);
 
 	*out_xfs = &s->base;
@@ -981,6 +1018,8 @@ u_sink_create_to_yuv_or_yuyv(struct xrt_frame_context *xfctx,
 	s->node.destroy = destroy;
 	s->downstream = downstream;
 
+	u_frame_pool_add_user();
+
 	xrt_frame_context_add(xfctx, &s->node);
 
 	*out_xfs = &s->base;
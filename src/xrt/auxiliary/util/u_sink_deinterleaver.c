@@ -122,6 +122,8 @@ deinterleave_destroy(struct xrt_frame_node *node)
 {
 	struct u_sink_deinterleaver *de = container_of(node, struct u_sink_deinterleaver, node);
 
+	u_frame_pool_remove_user();
+
 	free(de);
 }
 
@@ -144,6 +146,8 @@ u_sink_deinterleaver_create(struct xrt_frame_context *xfctx,
 	de->node.destroy = deinterleave_destroy;
 	de->downstream = downstream;
 
+	u_frame_pool_add_user();
+
 	xrt_frame_context_add(xfctx, &de->node);
 
 	*out_xfs = &de->base;
@@ -33,6 +33,16 @@
  *
  */
 
+//! Max number of device poses kept in the pose cache.
+#define POSE_CACHE_SIZE (16)
+
+/*!
+ * How long poses are kept in the pose cache, long enough for an app to locate
+ * all of its spaces for a frame one by one but short enough that asking again
+ * at the same timestamp later gets a fresh pose from the device.
+ */
+#define POSE_CACHE_MAX_AGE_NS (U_TIME_1MS_IN_NS)
+
 /*!
  * Keeps track of what kind of space it is.
  */
@@ -74,6 +84,54 @@ struct u_space
 			struct xrt_pose pose;
 		} offset;
 	};
+
+	/*!
+	 * For null and offset spaces, the first pose or root space after this
+	 * one. Set on creation as the parent links never change and those two
+	 * types never change into other types, kept alive by @ref next.
+	 */
+	struct u_space *anchor;
+};
+
+/*!
+ * State for one locate call, all device poses are asked for at the same
+ * timestamp and looked up in the overseer's pose cache.
+ */
+struct u_space_locate
+{
+	struct u_space_overseer *uso;
+
+	int64_t at_timestamp_ns;
+
+	//! When the locate call started, used to age the pose cache.
+	int64_t now_ns;
+};
+
+/*!
+ * Device poses asked for at the last located timestamp, shared between
+ * locate calls as apps often locate many spaces one by one at the same
+ * timestamp. Keyed on the device input and not the space, so any number of
+ * spaces on the same input share one entry.
+ */
+struct u_space_pose_cache
+{
+	//! Protects this struct, locate calls only hold the graph's read lock.
+	pthread_mutex_t mutex;
+
+	//! Timestamp that the poses are at.
+	int64_t at_timestamp_ns;
+
+	//! When the first pose was added, see @ref POSE_CACHE_MAX_AGE_NS.
+	int64_t filled_ns;
+
+	struct
+	{
+		struct xrt_device *xdev;
+		enum xrt_input_name name;
+		struct xrt_space_relation relation;
+	} poses[POSE_CACHE_SIZE];
+
+	uint32_t pose_count;
 };
 
 /*!
@@ -86,6 +144,12 @@ struct u_space_overseer
 	//! Main graph lock.
 	pthread_rwlock_t lock;
 
+	/*!
+	 * Cached device poses, emptied when the graph or any offset changes
+	 * while holding the write lock on @ref lock.
+	 */
+	struct u_space_pose_cache pose_cache;
+
 	//! Map from xdev to space, each entry holds a reference.
 	struct u_hashmap_int *xdev_map;
 
@@ -304,6 +368,127 @@ notify_ref_space_usage_device(struct u_space_overseer *uso, enum xrt_reference_s
 }
 
 
+/*
+ *
+ * Locate helpers.
+ *
+ */
+
+/*!
+ * Collapse a null or offset space and the ones after it into one pose, returns
+ * the pose or root space that the pose is relative to.
+ */
+static struct u_space *
+collapse_offsets_read_locked(struct u_space *space, struct xrt_pose *out_pose)
+{
+	assert(space->type == U_SPACE_TYPE_NULL || space->type == U_SPACE_TYPE_OFFSET);
+
+	struct xrt_pose pose = XRT_POSE_IDENTITY;
+	if (space->type == U_SPACE_TYPE_OFFSET) {
+		pose = space->offset.pose;
+	}
+
+	// Almost always a single space, same order as the relation chain after that.
+	for (struct u_space *it = space->next; it != space->anchor; it = it->next) {
+		if (it->type == U_SPACE_TYPE_OFFSET) {
+			math_pose_transform(&it->offset.pose, &pose, &pose);
+		}
+	}
+
+	*out_pose = pose;
+
+	return space->anchor;
+}
+
+static inline void
+u_space_locate_init(struct u_space_locate *usl, struct u_space_overseer *uso, int64_t at_timestamp_ns)
+{
+	usl->uso = uso;
+	usl->at_timestamp_ns = at_timestamp_ns;
+	usl->now_ns = os_monotonic_get_ns();
+}
+
+/*!
+ * Empty the pose cache, called when a space is created or relinked and with
+ * the write lock held when an offset changes.
+ */
+static void
+pose_cache_invalidate(struct u_space_overseer *uso)
+{
+	pthread_mutex_lock(&uso->pose_cache.mutex);
+	uso->pose_cache.pose_count = 0;
+	pthread_mutex_unlock(&uso->pose_cache.mutex);
+}
+
+static inline bool
+pose_cache_is_current(const struct u_space_pose_cache *cache, const struct u_space_locate *usl)
+{
+	return cache->pose_count > 0 &&                          //
+	       cache->at_timestamp_ns == usl->at_timestamp_ns && //
+	       usl->now_ns - cache->filled_ns < POSE_CACHE_MAX_AGE_NS;
+}
+
+static bool
+pose_cache_find_locked(const struct u_space_pose_cache *cache,
+                       struct xrt_device *xdev,
+                       enum xrt_input_name name,
+                       struct xrt_space_relation *out_relation)
+{
+	for (uint32_t i = 0; i < cache->pose_count; i++) {
+		if (cache->poses[i].xdev == xdev && cache->poses[i].name == name) {
+			*out_relation = cache->poses[i].relation;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*!
+ * Get the pose of a pose space's device input, only asks the device once per
+ * input and timestamp while the pose cache holds it.
+ */
+static void
+get_device_pose_read_locked(struct u_space_locate *usl, struct u_space *space, struct xrt_space_relation *out_relation)
+{
+	assert(space->pose.xdev != NULL);
+	assert(space->pose.xname != 0);
+
+	struct u_space_pose_cache *cache = &usl->uso->pose_cache;
+	struct xrt_device *xdev = space->pose.xdev;
+	enum xrt_input_name name = space->pose.xname;
+
+	pthread_mutex_lock(&cache->mutex);
+	bool hit = pose_cache_is_current(cache, usl) && pose_cache_find_locked(cache, xdev, name, out_relation);
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (hit) {
+		return;
+	}
+
+	// Don't hold the mutex while the device works, other threads may locate.
+	xrt_device_get_tracked_pose(xdev, name, usl->at_timestamp_ns, out_relation);
+
+	pthread_mutex_lock(&cache->mutex);
+
+	if (!pose_cache_is_current(cache, usl)) {
+		cache->at_timestamp_ns = usl->at_timestamp_ns;
+		cache->filled_ns = usl->now_ns;
+		cache->pose_count = 0;
+	}
+
+	struct xrt_space_relation unused;
+	if (cache->pose_count < POSE_CACHE_SIZE && !pose_cache_find_locked(cache, xdev, name, &unused)) {
+		cache->poses[cache->pose_count].xdev = xdev;
+		cache->poses[cache->pose_count].name = name;
+		cache->poses[cache->pose_count].relation = *out_relation;
+		cache->pose_count++;
+	}
+
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+
 /*
  *
  * Graph traversing functions.
@@ -314,63 +499,64 @@ notify_ref_space_usage_device(struct u_space_overseer *uso, enum xrt_reference_s
  * For each space, push the relation of that space and then traverse by calling
  * @p push_then_traverse again with the parent space. That means traverse goes
  * from a leaf space to a the root space, relations are pushed in the same
- * order.
+ * order. Runs of null and offset spaces are pushed as one collapsed pose.
  */
 static void
-push_then_traverse(struct xrt_relation_chain *xrc, struct u_space *space, int64_t at_timestamp_ns)
+push_then_traverse(struct u_space_locate *usl, struct xrt_relation_chain *xrc, struct u_space *space)
 {
 	switch (space->type) {
-	case U_SPACE_TYPE_NULL: break; // No-op
+	case U_SPACE_TYPE_NULL:
+	case U_SPACE_TYPE_OFFSET: {
+		struct xrt_pose pose;
+		struct u_space *anchor = collapse_offsets_read_locked(space, &pose);
+		m_relation_chain_push_pose_if_not_identity(xrc, &pose);
+
+		// The anchor is never a null or offset space.
+		push_then_traverse(usl, xrc, anchor);
+		return;
+	}
 	case U_SPACE_TYPE_POSE: {
-		assert(space->pose.xdev != NULL);
-		assert(space->pose.xname != 0);
-
 		struct xrt_space_relation xsr;
-		xrt_device_get_tracked_pose(space->pose.xdev, space->pose.xname, at_timestamp_ns, &xsr);
+		get_device_pose_read_locked(usl, space, &xsr);
 		m_relation_chain_push_relation(xrc, &xsr);
 	} break;
-	case U_SPACE_TYPE_OFFSET: m_relation_chain_push_pose_if_not_identity(xrc, &space->offset.pose); break;
 	case U_SPACE_TYPE_ROOT: return; // Stops the traversing.
 	}
 
 	// Please tail-call optimise this miss compiler.
 	assert(space->next != NULL);
-	push_then_traverse(xrc, space->next, at_timestamp_ns);
+	push_then_traverse(usl, xrc, space->next);
 }
 
 /*!
  * For each space, traverse by calling @p traverse_then_push_inverse again with
  * the parent space then push the inverse of the relation of that. That means
  * traverse goes from a leaf space to a the root space, relations are pushed in
- * the reversed order.
+ * the reversed order. Runs of null and offset spaces are pushed as one
+ * collapsed pose.
  */
 static void
-traverse_then_push_inverse(struct xrt_relation_chain *xrc, struct u_space *space, int64_t at_timestamp_ns)
+traverse_then_push_inverse(struct u_space_locate *usl, struct xrt_relation_chain *xrc, struct u_space *space)
 {
-	// Done traversing.
 	switch (space->type) {
-	case U_SPACE_TYPE_NULL: break;
-	case U_SPACE_TYPE_POSE: break;
-	case U_SPACE_TYPE_OFFSET: break;
-	case U_SPACE_TYPE_ROOT: return; // Stops the traversing.
-	}
+	case U_SPACE_TYPE_NULL:
+	case U_SPACE_TYPE_OFFSET: {
+		struct xrt_pose pose;
+		struct u_space *anchor = collapse_offsets_read_locked(space, &pose);
 
-	// Can't tail-call optimise this one :(
-	assert(space->next != NULL);
-	traverse_then_push_inverse(xrc, space->next, at_timestamp_ns);
-
-	switch (space->type) {
-	case U_SPACE_TYPE_NULL: break; // No-op
+		traverse_then_push_inverse(usl, xrc, anchor);
+		m_relation_chain_push_inverted_pose_if_not_identity(xrc, &pose);
+	} break;
 	case U_SPACE_TYPE_POSE: {
-		assert(space->pose.xdev != NULL);
-		assert(space->pose.xname != 0);
+		// Can't tail-call optimise this one :(
+		assert(space->next != NULL);
+		traverse_then_push_inverse(usl, xrc, space->next);
 
 		struct xrt_space_relation xsr;
-		xrt_device_get_tracked_pose(space->pose.xdev, space->pose.xname, at_timestamp_ns, &xsr);
+		get_device_pose_read_locked(usl, space, &xsr);
 		m_relation_chain_push_inverted_relation(xrc, &xsr);
 	} break;
-	case U_SPACE_TYPE_OFFSET: m_relation_chain_push_inverted_pose_if_not_identity(xrc, &space->offset.pose); break;
-	case U_SPACE_TYPE_ROOT: assert(false); // Should not get here.
+	case U_SPACE_TYPE_ROOT: return; // Stops the traversing.
 	}
 }
 
@@ -385,8 +571,11 @@ build_relation_chain_read_locked(struct u_space_overseer *uso,
 	assert(base != NULL);
 	assert(target != NULL);
 
-	push_then_traverse(xrc, target, at_timestamp_ns);
-	traverse_then_push_inverse(xrc, base, at_timestamp_ns);
+	struct u_space_locate usl;
+	u_space_locate_init(&usl, uso, at_timestamp_ns);
+
+	push_then_traverse(&usl, xrc, target);
+	traverse_then_push_inverse(&usl, xrc, base);
 }
 
 static void
@@ -457,6 +646,11 @@ create_space(enum u_space_type type, struct u_space *parent)
 
 	u_space_reference(&us->next, parent);
 
+	if (type == U_SPACE_TYPE_NULL || type == U_SPACE_TYPE_OFFSET) {
+		bool parent_is_offset = parent->type == U_SPACE_TYPE_NULL || parent->type == U_SPACE_TYPE_OFFSET;
+		us->anchor = parent_is_offset ? parent->anchor : parent;
+	}
+
 	return us;
 }
 
@@ -497,6 +691,8 @@ create_offset_space(struct xrt_space_overseer *xso,
 		us->offset.pose = *offset;
 	}
 
+	pose_cache_invalidate(u_space_overseer(xso));
+
 	// Created with one references.
 	*out_space = &us->base;
 
@@ -526,6 +722,8 @@ create_pose_space(struct xrt_space_overseer *xso,
 	us->pose.xdev = xdev;
 	us->pose.xname = name;
 
+	pose_cache_invalidate(uso);
+
 	// Created with one references.
 	*out_space = &us->base;
 
@@ -602,10 +800,20 @@ locate_spaces(struct xrt_space_overseer *xso,
 
 	struct u_space *ubase_space = u_space(base_space);
 
+	// The base part of the chain is the same for all spaces, only build it once.
+	struct u_space_locate usl;
+	u_space_locate_init(&usl, uso, at_timestamp_ns);
+	struct xrt_relation_chain base_xrc = {0};
+
+	pthread_rwlock_rdlock(&uso->lock);
+
+	traverse_then_push_inverse(&usl, &base_xrc, ubase_space);
+	m_relation_chain_push_inverted_pose_if_not_identity(&base_xrc, base_offset);
+
 	for (uint32_t i = 0; i < space_count; i++) {
 		// spaces are allowed to be NULL
 		if (spaces[i] == NULL) {
-			out_relations->relation_flags = XRT_SPACE_RELATION_BITMASK_NONE;
+			out_relations[i].relation_flags = XRT_SPACE_RELATION_BITMASK_NONE;
 			continue;
 		}
 
@@ -626,15 +834,21 @@ locate_spaces(struct xrt_space_overseer *xso,
 		// crude optimization: If locating a space in itself, we don't actually need to locate the space itself.
 		// only the offsets need to be applied.
 		if (spaces[i] != base_space) {
-			build_relation_chain(uso, &xrc, ubase_space, uspace, at_timestamp_ns);
-		}
+			push_then_traverse(&usl, &xrc, uspace);
 
-		m_relation_chain_push_inverted_pose_if_not_identity(&xrc, base_offset);
+			for (uint32_t k = 0; k < base_xrc.step_count; k++) {
+				m_relation_chain_push_relation(&xrc, &base_xrc.steps[k]);
+			}
+		} else {
+			m_relation_chain_push_inverted_pose_if_not_identity(&xrc, base_offset);
+		}
 
 		// For base_space =~= space (approx equals).
 		special_resolve(&xrc, &out_relations[i]);
 	}
 
+	pthread_rwlock_unlock(&uso->lock);
+
 	return XRT_SUCCESS;
 }
 
@@ -797,6 +1011,7 @@ recenter_local_spaces(struct xrt_space_overseer *xso)
 	// Update the offsets.
 	update_offset_write_locked(ulocal, &local_offset);
 	update_offset_write_locked(ulocal_floor, &local_floor_offset);
+	pose_cache_invalidate(uso);
 
 	// Push the events.
 	union xrt_session_event xse = XRT_STRUCT_INIT;
@@ -916,7 +1131,8 @@ set_tracking_origin_offset(struct xrt_space_overseer *xso,
 	struct u_space_overseer *uso = u_space_overseer(xso);
 	xrt_result_t xret = XRT_SUCCESS;
 
-	pthread_rwlock_rdlock(&uso->lock);
+	// Changes the offset, so the full lock.
+	pthread_rwlock_wrlock(&uso->lock);
 
 	struct u_space *us = find_xto_space_read_locked(uso, xto);
 	if (!space_is_offset_compatible(us)) {
@@ -925,6 +1141,7 @@ set_tracking_origin_offset(struct xrt_space_overseer *xso,
 	}
 
 	update_offset_write_locked(us, offset);
+	pose_cache_invalidate(uso);
 
 unlock:
 	pthread_rwlock_unlock(&uso->lock);
@@ -995,6 +1212,7 @@ set_reference_space_offset(struct xrt_space_overseer *xso,
 
 	update_offset_write_locked(us, offset);
 	update_offset_write_locked(ufloor, &floor);
+	pose_cache_invalidate(uso);
 
 	// Push the events.
 	union xrt_session_event xse = XRT_STRUCT_INIT;
@@ -1060,6 +1278,7 @@ destroy(struct xrt_space_overseer *xso)
 		xrt_space_reference(xslocalfloor_ptr, NULL);
 	}
 
+	pthread_mutex_destroy(&uso->pose_cache.mutex);
 	pthread_rwlock_destroy(&uso->lock);
 
 	free(uso);
@@ -1097,6 +1316,9 @@ u_space_overseer_create(struct xrt_session_event_sink *broadcast)
 	ret = pthread_rwlock_init(&uso->lock, NULL);
 	assert(ret == 0);
 
+	ret = pthread_mutex_init(&uso->pose_cache.mutex, NULL);
+	assert(ret == 0);
+
 	ret = u_hashmap_int_create(&uso->xdev_map);
 	assert(ret == 0);
 
@@ -1193,6 +1415,8 @@ u_space_overseer_create_null_space(struct u_space_overseer *uso, struct xrt_spac
 	struct u_space *uparent = u_space(parent);
 	struct u_space *us = create_space(U_SPACE_TYPE_NULL, uparent);
 
+	pose_cache_invalidate(uso);
+
 	// Created with one references.
 	*out_space = &us->base;
 }
@@ -1214,6 +1438,7 @@ u_space_overseer_link_space_to_device(struct u_space_overseer *uso, struct xrt_s
 	xrt_space_reference(&new_space, xs);
 
 	u_hashmap_int_insert(uso->xdev_map, (uint64_t)(intptr_t)xdev, new_space);
+	pose_cache_invalidate(uso);
 
 	pthread_rwlock_unlock(&uso->lock);
 
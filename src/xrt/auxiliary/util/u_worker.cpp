@@ -2,14 +2,883 @@
 // SPDX-License-Identifier: BSL-1.0
 /*!
  * @file
- * @brief  C++ wrappers for workers.
+ * @brief  Work-stealing worker pool and C++ wrappers for workers.
  * @author Jakob Bornecrantz <jakob@collabora.com>
  *
  * @ingroup aux_util
  */
 
+#include "xrt/xrt_config_os.h"
+
+#include "os/os_threading.h"
+
+#include "util/u_misc.h"
+#include "util/u_debug.h"
+#include "util/u_logging.h"
+#include "util/u_worker.h"
 #include "util/u_worker.hpp"
+#include "util/u_trace_marker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+
+#if defined(XRT_OS_LINUX)
+#include <sched.h>
+#elif defined(XRT_OS_WINDOWS)
+#include <windows.h>
+#endif
+
+
+/*!
+ * Pin worker thread N to CPU N, modulo the number of CPUs. Helps caches when
+ * the pool is the main user of the CPUs, hurts when it isn't.
+ */
+DEBUG_GET_ONCE_BOOL_OPTION(worker_affinity, "U_WORKER_AFFINITY", false)
+
+/*!
+ * Size of the lock-free queue tasks pushed from outside the pool go into,
+ * more than this spill into a locked queue.
+ */
+#define INJECT_QUEUE_SIZE (256)
+
+//! Start size of the per thread deques, they grow as needed.
+#define LOCAL_DEQUE_START_SIZE (64)
+
+//! How many times an idle worker looks for work before going to sleep.
+#define IDLE_SPIN_COUNT (32)
+
+
+namespace {
+
+struct group;
+struct pool;
+struct worker;
+
+struct task
+{
+	//! Group this task was submitted from.
+	group *g;
+
+	//! Function.
+	u_worker_group_func_t func;
+
+	//! Function data.
+	void *data;
+};
+
+/*!
+ * Chase-Lev work-stealing deque, the owning thread pushes and pops at the
+ * bottom while other threads steal from the top. Holds pointers so that
+ * stealing threads never read a partially written task.
+ */
+class LocalDeque
+{
+public:
+	LocalDeque()
+	{
+		mArrays.emplace_back(new Array(LOCAL_DEQUE_START_SIZE));
+		mArray.store(mArrays.back().get(), std::memory_order_relaxed);
+	}
+
+	//! Only called by the owning thread.
+	void
+	push(task *t)
+	{
+		int64_t b = mBottom.load(std::memory_order_relaxed);
+		int64_t top = mTop.load(std::memory_order_acquire);
+		Array *a = mArray.load(std::memory_order_relaxed);
+
+		if (b - top > (int64_t)a->size - 1) {
+			a = grow(a, b, top);
+		}
+
+		a->put(b, t);
+		std::atomic_thread_fence(std::memory_order_release);
+		mBottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	//! Only called by the owning thread.
+	task *
+	pop()
+	{
+		int64_t b = mBottom.load(std::memory_order_relaxed) - 1;
+		Array *a = mArray.load(std::memory_order_relaxed);
+		mBottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = mTop.load(std::memory_order_relaxed);
+
+		if (top > b) {
+			// Empty.
+			mBottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		task *t = a->get(b);
+		if (top != b) {
+			return t;
+		}
+
+		// Last one, race against thieves for it.
+		if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+		                                  std::memory_order_relaxed)) {
+			t = nullptr;
+		}
+		mBottom.store(b + 1, std::memory_order_relaxed);
+
+		return t;
+	}
+
+	//! Called by any thread.
+	task *
+	steal()
+	{
+		int64_t top = mTop.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = mBottom.load(std::memory_order_acquire);
+
+		if (top >= b) {
+			return nullptr;
+		}
+
+		Array *a = mArray.load(std::memory_order_acquire);
+		task *t = a->get(top);
+
+		// Lost to another thief or the owner, the caller moves on.
+		if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+		                                  std::memory_order_relaxed)) {
+			return nullptr;
+		}
+
+		return t;
+	}
+
+	bool
+	looks_empty() const
+	{
+		return mTop.load(std::memory_order_relaxed) >= mBottom.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Array
+	{
+		explicit Array(size_t size_) : size(size_), slots(new std::atomic<task *>[size_]) {}
+
+		task *
+		get(int64_t i) const
+		{
+			return slots[i & (size - 1)].load(std::memory_order_relaxed);
+		}
+
+		void
+		put(int64_t i, task *t)
+		{
+			slots[i & (size - 1)].store(t, std::memory_order_relaxed);
+		}
+
+		size_t size;
+		std::unique_ptr<std::atomic<task *>[]> slots;
+	};
+
+	Array *
+	grow(Array *old, int64_t b, int64_t top)
+	{
+		Array *a = new Array(old->size * 2);
+		for (int64_t i = top; i < b; i++) {
+			a->put(i, old->get(i));
+		}
+
+		// Thieves may still be reading the old array, keep it until destroyed.
+		mArrays.emplace_back(a);
+		mArray.store(a, std::memory_order_release);
+
+		return a;
+	}
+
+	std::atomic<int64_t> mTop{0};
+	std::atomic<int64_t> mBottom{0};
+	std::atomic<Array *> mArray{nullptr};
+
+	//! Owned by the owning thread.
+	std::vector<std::unique_ptr<Array>> mArrays;
+};
+
+/*!
+ * Bounded lock-free multi producer multi consumer queue, for tasks pushed by
+ * threads outside of the pool, by Dmitry Vyukov.
+ */
+class InjectQueue
+{
+public:
+	InjectQueue()
+	{
+		for (size_t i = 0; i < INJECT_QUEUE_SIZE; i++) {
+			mCells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	bool
+	push(const task &t)
+	{
+		size_t pos = mPushPos.load(std::memory_order_relaxed);
+		Cell *cell;
+
+		while (true) {
+			cell = &mCells[pos & (INJECT_QUEUE_SIZE - 1)];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+			if (diff == 0) {
+				if (mPushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				// Full.
+				return false;
+			} else {
+				pos = mPushPos.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->t = t;
+		cell->seq.store(pos + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	bool
+	pop(task &out_task)
+	{
+		size_t pos = mPopPos.load(std::memory_order_relaxed);
+		Cell *cell;
+
+		while (true) {
+			cell = &mCells[pos & (INJECT_QUEUE_SIZE - 1)];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+			if (diff == 0) {
+				if (mPopPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				// Empty.
+				return false;
+			} else {
+				pos = mPopPos.load(std::memory_order_relaxed);
+			}
+		}
+
+		out_task = cell->t;
+		cell->seq.store(pos + INJECT_QUEUE_SIZE, std::memory_order_release);
+
+		return true;
+	}
+
+	bool
+	looks_empty() const
+	{
+		return mPopPos.load(std::memory_order_relaxed) >= mPushPos.load(std::memory_order_relaxed);
+	}
+
+private:
+	static_assert((INJECT_QUEUE_SIZE & (INJECT_QUEUE_SIZE - 1)) == 0, "Must be a power of two");
+
+	struct alignas(64) Cell
+	{
+		std::atomic<size_t> seq;
+		task t;
+	};
+
+	Cell mCells[INJECT_QUEUE_SIZE];
+
+	alignas(64) std::atomic<size_t> mPushPos{0};
+	alignas(64) std::atomic<size_t> mPopPos{0};
+};
+
+struct worker
+{
+	//! Pool this thread belongs to.
+	pool *p;
+
+	//! Index in the pool, used for affinity and picking victims.
+	uint32_t index;
+
+	// Native thread.
+	struct os_thread thread;
+
+	//! Tasks pushed by tasks running on this thread.
+	LocalDeque deque;
+
+	//! Thread name.
+	char name[64];
+};
+
+struct pool
+{
+	struct u_worker_thread_pool base;
+
+	//! Tasks pushed from outside of the pool.
+	InjectQueue inject;
+
+	struct
+	{
+		std::mutex mutex;
+		std::deque<task> tasks;
+
+		//! Checked without taking the lock.
+		std::atomic<size_t> count{0};
+	} overflow; //!< When the inject queue is full, never capped.
+
+	/*!
+	 * How many more threads may work, starts at the starting worker count.
+	 * Threads waiting on a group that can't help give theirs to the pool.
+	 */
+	std::atomic<int32_t> permits{0};
+
+	struct
+	{
+		std::mutex mutex;
+		std::condition_variable cond;
+
+		//! Bumped to wake workers, changed with the mutex held.
+		std::atomic<uint64_t> epoch{0};
+
+		//! Workers sleeping or about to.
+		std::atomic<uint32_t> count{0};
+	} sleeping; //!< For idle worker threads.
+
+	//! The worker threads.
+	std::vector<std::unique_ptr<worker>> threads;
+
+	//! Is the pool up and running?
+	std::atomic<bool> running{true};
+
+	//! Prefix to use for thread names.
+	char prefix[32];
+};
+
+struct group
+{
+	//! Base struct has to come first.
+	struct u_worker_group base;
+
+	//! Pointer to poll of threads.
+	struct u_worker_thread_pool *uwtp;
+
+	//! Number of tasks that is pending or being worked on in this group.
+	std::atomic<size_t> current_submitted_tasks_count{0};
+
+	struct
+	{
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::atomic<uint32_t> count{0};
+	} waiting; //!< For wait_all
+};
+
+//! The worker thread we are running on, if any.
+thread_local worker *tl_current_thread = nullptr;
+
+
+/*
+ *
+ * Helper functions.
+ *
+ */
+
+inline group *
+to_group(struct u_worker_group *uwg)
+{
+	return reinterpret_cast<group *>(uwg);
+}
+
+inline pool *
+to_pool(struct u_worker_thread_pool *uwtp)
+{
+	return reinterpret_cast<pool *>(uwtp);
+}
+
+void
+set_affinity(uint32_t index)
+{
+	uint32_t cpu_count = std::thread::hardware_concurrency();
+	if (cpu_count == 0) {
+		return;
+	}
+
+	uint32_t cpu = index % cpu_count;
+
+#if defined(XRT_OS_LINUX)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+		U_LOG_W("Failed to pin worker thread to CPU %u", cpu);
+	}
+#elif defined(XRT_OS_WINDOWS)
+	if (cpu < sizeof(DWORD_PTR) * 8) {
+		SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+	}
+#else
+	(void)cpu;
+#endif
+}
+
+
+/*
+ *
+ * Internal pool functions.
+ *
+ */
+
+bool
+pool_has_work(pool *p)
+{
+	if (!p->inject.looks_empty() || p->overflow.count.load(std::memory_order_relaxed) > 0) {
+		return true;
+	}
+
+	for (auto &t : p->threads) {
+		if (!t->deque.looks_empty()) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+pool_wake_worker(pool *p, bool all)
+{
+	// Pairs with the increment of the sleeping count in thread_sleep.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (p->sleeping.count.load(std::memory_order_relaxed) == 0) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(p->sleeping.mutex);
+		p->sleeping.epoch.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (all) {
+		p->sleeping.cond.notify_all();
+	} else {
+		p->sleeping.cond.notify_one();
+	}
+}
+
+bool
+pool_try_acquire_permit(pool *p)
+{
+	int32_t permits = p->permits.load(std::memory_order_relaxed);
+	while (permits > 0) {
+		if (p->permits.compare_exchange_weak(permits, permits - 1, std::memory_order_acquire,
+		                                     std::memory_order_relaxed)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+pool_push_task(pool *p, const task &t)
+{
+	worker *current = tl_current_thread;
+
+	// Tasks pushing tasks keep them local, others steal if they have time.
+	if (current != nullptr && current->p == p) {
+		current->deque.push(new task(t));
+	} else if (!p->inject.push(t)) {
+		std::lock_guard<std::mutex> lock(p->overflow.mutex);
+		p->overflow.tasks.push_back(t);
+		p->overflow.count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	pool_wake_worker(p, false);
+}
+
+bool
+pool_find_task(pool *p, worker *current, task &out_task)
+{
+	if (current != nullptr && current->p == p) {
+		task *t = current->deque.pop();
+		if (t != nullptr) {
+			out_task = *t;
+			delete t;
+			return true;
+		}
+	}
+
+	if (p->inject.pop(out_task)) {
+		return true;
+	}
+
+	if (p->overflow.count.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock(p->overflow.mutex);
+		if (!p->overflow.tasks.empty()) {
+			out_task = p->overflow.tasks.front();
+			p->overflow.tasks.pop_front();
+			p->overflow.count.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// Steal, start after ourselves so thieves spread out.
+	size_t count = p->threads.size();
+	size_t start = current != nullptr ? current->index + 1 : 0;
+	for (size_t i = 0; i < count; i++) {
+		worker *victim = p->threads[(start + i) % count].get();
+		if (victim == current) {
+			continue;
+		}
+
+		task *t = victim->deque.steal();
+		if (t != nullptr) {
+			out_task = *t;
+			delete t;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+pool_requeue_task(pool *p, const task &t)
+{
+	if (!p->inject.push(t)) {
+		std::lock_guard<std::mutex> lock(p->overflow.mutex);
+		p->overflow.tasks.push_back(t);
+		p->overflow.count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+/*!
+ * Like pool_find_task but only finds tasks of group @p g, so threads waiting
+ * on a group never end up running tasks of other groups. Doesn't steal, the
+ * group's tasks on other deques are already close to being worked on.
+ */
+bool
+pool_find_group_task(pool *p, worker *current, group *g, task &out_task)
+{
+	// Tasks pushed by the waiting task are at the bottom, put back others.
+	if (current != nullptr && current->p == p) {
+		task *t = current->deque.pop();
+		if (t != nullptr && t->g == g) {
+			out_task = *t;
+			delete t;
+			return true;
+		}
+		if (t != nullptr) {
+			current->deque.push(t);
+		}
+	}
+
+	// Can't peek, so give a task of another group back and stop helping.
+	if (p->inject.pop(out_task)) {
+		if (out_task.g == g) {
+			return true;
+		}
+		pool_requeue_task(p, out_task);
+		return false;
+	}
+
+	if (p->overflow.count.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock(p->overflow.mutex);
+		auto it = std::find_if(p->overflow.tasks.begin(), p->overflow.tasks.end(),
+		                       [g](const task &t) { return t.g == g; });
+		if (it != p->overflow.tasks.end()) {
+			out_task = *it;
+			p->overflow.tasks.erase(it);
+			p->overflow.count.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ *
+ * Thread group functions.
+ *
+ */
+
+void
+group_task_done(group *g)
+{
+	if (g->current_submitted_tasks_count.fetch_sub(1, std::memory_order_seq_cst) != 1) {
+		return;
+	}
+
+	// Pairs with the increment of the waiting count in group_wait.
+	if (g->waiting.count.load(std::memory_order_seq_cst) == 0) {
+		return;
+	}
+
+	{
+		// Makes sure the waiter is either waiting or will see the count.
+		std::lock_guard<std::mutex> lock(g->waiting.mutex);
+	}
+	g->waiting.cond.notify_all();
+}
+
+void
+run_task(const task &t)
+{
+	// Keep the group alive, it may be destroyed as soon as the count drops.
+	group *g = t.g;
+
+	t.func(t.data);
+
+	group_task_done(g);
+}
+
+void
+group_wait(pool *p, group *g)
+{
+	// Give our permit to the pool, so another thread can work instead.
+	p->permits.fetch_add(1, std::memory_order_release);
+	pool_wake_worker(p, true);
+
+	g->waiting.count.fetch_add(1, std::memory_order_seq_cst);
+
+	{
+		std::unique_lock<std::mutex> lock(g->waiting.mutex);
+		g->waiting.cond.wait(
+		    lock, [&] { return g->current_submitted_tasks_count.load(std::memory_order_seq_cst) == 0; });
+	}
+
+	g->waiting.count.fetch_sub(1, std::memory_order_relaxed);
+
+	// Take it back.
+	p->permits.fetch_sub(1, std::memory_order_acquire);
+}
+
+
+/*
+ *
+ * Thread internal functions.
+ *
+ */
+
+void
+thread_sleep(pool *p)
+{
+	uint64_t epoch = p->sleeping.epoch.load(std::memory_order_relaxed);
+
+	// Pairs with the fence in pool_wake_worker.
+	p->sleeping.count.fetch_add(1, std::memory_order_seq_cst);
+
+	bool can_work = pool_has_work(p) && p->permits.load(std::memory_order_relaxed) > 0;
+	if (!can_work && p->running.load(std::memory_order_relaxed)) {
+		std::unique_lock<std::mutex> lock(p->sleeping.mutex);
+		p->sleeping.cond.wait(lock, [&] {
+			return p->sleeping.epoch.load(std::memory_order_relaxed) != epoch ||
+			       !p->running.load(std::memory_order_relaxed);
+		});
+	}
+
+	p->sleeping.count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void *
+run_func(void *ptr)
+{
+	worker *t = static_cast<worker *>(ptr);
+	pool *p = t->p;
+
+	snprintf(t->name, sizeof(t->name), "%s: Worker", p->prefix);
+	U_TRACE_SET_THREAD_NAME(t->name);
 
+	if (debug_get_bool_option_worker_affinity()) {
+		set_affinity(t->index);
+	}
+
+	tl_current_thread = t;
+
+	while (p->running.load(std::memory_order_relaxed)) {
+		if (pool_try_acquire_permit(p)) {
+			task next;
+			int idle = 0;
+
+			// Keep the permit while there is work, spin a little first.
+			while (idle < IDLE_SPIN_COUNT && p->running.load(std::memory_order_relaxed)) {
+				if (!pool_find_task(p, t, next)) {
+					idle++;
+					std::this_thread::yield();
+					continue;
+				}
+
+				idle = 0;
+				run_task(next);
+			}
+
+			p->permits.fetch_add(1, std::memory_order_release);
+
+			// Work might have come in after we looked, without anybody woken.
+			if (pool_has_work(p)) {
+				continue;
+			}
+		}
+
+		thread_sleep(p);
+	}
+
+	tl_current_thread = nullptr;
+
+	return NULL;
+}
+
+} // namespace
+
+
+/*
+ *
+ * 'Exported' thread pool functions.
+ *
+ */
+
+extern "C" struct u_worker_thread_pool *
+u_worker_thread_pool_create(uint32_t starting_worker_count, uint32_t thread_count, const char *prefix)
+{
+	XRT_TRACE_MARKER();
+
+	assert(starting_worker_count < thread_count);
+	if (starting_worker_count >= thread_count) {
+		return NULL;
+	}
+
+	pool *p = new pool();
+	p->base.reference.count = 1;
+	p->permits.store((int32_t)starting_worker_count, std::memory_order_relaxed);
+	snprintf(p->prefix, sizeof(p->prefix), "%s", prefix);
+
+	// Create them all first, threads look at each other when stealing.
+	for (uint32_t i = 0; i < thread_count; i++) {
+		p->threads.emplace_back(new worker());
+		worker *t = p->threads.back().get();
+		t->p = p;
+		t->index = i;
+		os_thread_init(&t->thread);
+	}
+
+	for (auto &t : p->threads) {
+		os_thread_start(&t->thread, run_func, t.get());
+	}
+
+	return &p->base;
+}
+
+extern "C" void
+u_worker_thread_pool_destroy(struct u_worker_thread_pool *uwtp)
+{
+	XRT_TRACE_MARKER();
+
+	pool *p = to_pool(uwtp);
+
+	{
+		std::lock_guard<std::mutex> lock(p->sleeping.mutex);
+		p->running.store(false, std::memory_order_relaxed);
+	}
+	p->sleeping.cond.notify_all();
+
+	// Wait for all threads.
+	for (auto &t : p->threads) {
+		os_thread_join(&t->thread);
+		os_thread_destroy(&t->thread);
+	}
+
+	delete p;
+}
+
+
+/*
+ *
+ * 'Exported' group functions.
+ *
+ */
+
+extern "C" struct u_worker_group *
+u_worker_group_create(struct u_worker_thread_pool *uwtp)
+{
+	XRT_TRACE_MARKER();
+
+	group *g = new group();
+	g->base.reference.count = 1;
+	u_worker_thread_pool_reference(&g->uwtp, uwtp);
+
+	return &g->base;
+}
+
+extern "C" void
+u_worker_group_push(struct u_worker_group *uwg, u_worker_group_func_t f, void *data)
+{
+	XRT_TRACE_MARKER();
+
+	group *g = to_group(uwg);
+	pool *p = to_pool(g->uwtp);
+
+	g->current_submitted_tasks_count.fetch_add(1, std::memory_order_relaxed);
+
+	pool_push_task(p, task{g, f, data});
+}
+
+extern "C" void
+u_worker_group_wait_all(struct u_worker_group *uwg)
+{
+	XRT_TRACE_MARKER();
+
+	group *g = to_group(uwg);
+	pool *p = to_pool(g->uwtp);
+	worker *current = tl_current_thread;
+
+	while (g->current_submitted_tasks_count.load(std::memory_order_acquire) > 0) {
+		// Help out with our own tasks instead of just waiting, saves waking up a worker.
+		task next;
+		if (pool_find_group_task(p, current, g, next)) {
+			run_task(next);
+			continue;
+		}
+
+		// Our tasks are being worked on by other threads.
+		group_wait(p, g);
+	}
+}
+
+extern "C" void
+u_worker_group_destroy(struct u_worker_group *uwg)
+{
+	XRT_TRACE_MARKER();
+
+	group *g = to_group(uwg);
+	assert(g->base.reference.count == 0);
+
+	u_worker_group_wait_all(uwg);
+
+	u_worker_thread_pool_reference(&g->uwtp, NULL);
+
+	delete g;
+}
+
+
+/*
+ *
+ * C++ wrappers.
+ *
+ */
 
 void
 xrt::auxiliary::util::TaskCollection::cCallback(void *data_ptr)
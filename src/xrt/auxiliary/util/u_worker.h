@@ -27,6 +27,10 @@ extern "C" {
 /*!
  * A worker pool, can shared between multiple groups worker pool.
  *
+ * Work-stealing, tasks pushed by tasks go onto the pushing thread's own deque
+ * where idle threads steal them from, other tasks go into a shared lock-free
+ * queue. Setting U_WORKER_AFFINITY pins each thread to a CPU.
+ *
  * @ingroup aux_util
  */
 struct u_worker_thread_pool
@@ -119,7 +123,8 @@ struct u_worker_group *
 u_worker_group_create(struct u_worker_thread_pool *uwtp);
 
 /*!
- * Push a new task to worker group.
+ * Push a new task to worker group, never blocks and there is no limit on the
+ * number of pushed tasks.
  *
  * @ingroup aux_util
  */
@@ -127,8 +132,9 @@ void
 u_worker_group_push(struct u_worker_group *uwg, u_worker_group_func_t f, void *data);
 
 /*!
- * Wait for all pushed tasks to be completed, "donates" this thread to the
- * shared thread pool.
+ * Wait for all pushed tasks to be completed, runs tasks of this group on this
+ * thread while waiting, when there are none left to run it "donates" this
+ * thread to the shared thread pool.
  *
  * @ingroup aux_util
  */
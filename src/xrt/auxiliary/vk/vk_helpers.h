@@ -348,6 +348,7 @@ struct vk_bundle
 
 	PFN_vkCreatePipelineCache vkCreatePipelineCache;
 	PFN_vkDestroyPipelineCache vkDestroyPipelineCache;
+	PFN_vkGetPipelineCacheData vkGetPipelineCacheData;
 
 	PFN_vkResetDescriptorPool vkResetDescriptorPool;
 	PFN_vkCreateDescriptorPool vkCreateDescriptorPool;
@@ -1416,6 +1417,44 @@ vk_create_compute_pipeline(struct vk_bundle *vk,
                            VkPipeline *out_compute_pipeline);
 
 
+/*
+ *
+ * Pipeline cache helpers, in the vk_pipeline_cache.c file.
+ *
+ */
+
+/*!
+ * Creates a pipeline cache with the data saved by @ref vk_save_pipeline_cache
+ * under the same @p name. The file name includes the vendor, device and
+ * pipeline cache UUID, so a different GPU or driver starts with an empty cache.
+ * Files that fail the header or checksum validation are ignored. Can be
+ * turned off with the `XRT_VK_PIPELINE_CACHE` environment variable.
+ *
+ * Does error logging.
+ *
+ * @param      vk                 Vulkan bundle.
+ * @param      name               Name of the user, part of the file name.
+ * @param[out] out_pipeline_cache The new pipeline cache.
+ * @param[out] out_loaded         Optional, set if the cache was loaded from disk.
+ */
+VkResult
+vk_create_pipeline_cache_from_file(struct vk_bundle *vk,
+                                   const char *name,
+                                   VkPipelineCache *out_pipeline_cache,
+                                   bool *out_loaded);
+
+/*!
+ * Writes the contents of @p pipeline_cache to disk for the next
+ * @ref vk_create_pipeline_cache_from_file with the same @p name. Writes to a
+ * temporary file and renames it over the old one, so readers never see a
+ * partial file.
+ *
+ * Does error logging.
+ */
+void
+vk_save_pipeline_cache(struct vk_bundle *vk, const char *name, VkPipelineCache pipeline_cache);
+
+
 /*
  *
  * Compositor buffer and swapchain image flags helpers, in the vk_compositor_flags.c file.
@@ -0,0 +1,334 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Pipeline cache saved to and loaded from disk.
+ *
+ * @ingroup aux_vk
+ */
+
+#include "util/u_misc.h"
+#include "util/u_file.h"
+#include "util/u_hash.h"
+#include "util/u_debug.h"
+
+#include "vk/vk_helpers.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(vk_pipeline_cache, "XRT_VK_PIPELINE_CACHE", true)
+
+#define CACHE_SUBPATH "vk_pipeline_cache"
+#define CACHE_MAGIC (0x4650434d) // "MCPF"
+#define CACHE_VERSION (1)
+
+//! Anything bigger than this is not from us.
+#define CACHE_MAX_DATA_SIZE (64 * 1024 * 1024)
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+
+/*!
+ * Written before the data returned by vkGetPipelineCacheData.
+ */
+struct cache_file_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendor_id;
+	uint32_t device_id;
+	uint32_t driver_version;
+	uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+	uint32_t padding;
+	uint64_t data_size;
+	uint64_t data_hash;
+};
+
+/*!
+ * Same layout as VkPipelineCacheHeaderVersionOne, which older headers lack.
+ */
+struct vk_data_header
+{
+	uint32_t header_size;
+	uint32_t header_version;
+	uint32_t vendor_id;
+	uint32_t device_id;
+	uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+};
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static VkResult
+create_pipeline_cache(struct vk_bundle *vk, const void *data, size_t size, VkPipelineCache *out_pipeline_cache)
+{
+	VkPipelineCacheCreateInfo pipeline_cache_info = {
+	    .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+	    .initialDataSize = size,
+	    .pInitialData = data,
+	};
+
+	return vk->vkCreatePipelineCache( //
+	    vk->device,                   // device
+	    &pipeline_cache_info,         // pCreateInfo
+	    NULL,                         // pAllocator
+	    out_pipeline_cache);          // pPipelineCache
+}
+
+#ifdef U_FILE_HAVE_CONFIG_DIR
+
+/*!
+ * Checksum stored in the header to catch truncated or corrupt files, gives
+ * the same values as the FNV-1a this file used before so old files load.
+ */
+static inline uint64_t
+hash_data(const void *data, size_t size)
+{
+	return u_hash_fnv1a_64(U_HASH_FNV1A_64_INIT, data, size);
+}
+
+static void
+fill_header(struct vk_bundle *vk, struct cache_file_header *out_header)
+{
+	VkPhysicalDeviceProperties pdp;
+	vk->vkGetPhysicalDeviceProperties(vk->physical_device, &pdp);
+
+	U_ZERO(out_header);
+	out_header->magic = CACHE_MAGIC;
+	out_header->version = CACHE_VERSION;
+	out_header->vendor_id = pdp.vendorID;
+	out_header->device_id = pdp.deviceID;
+	out_header->driver_version = pdp.driverVersion;
+	memcpy(out_header->pipeline_cache_uuid, pdp.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+static void
+make_filename(const struct cache_file_header *header, const char *name, char *out_filename, size_t size)
+{
+	char uuid[VK_UUID_SIZE * 2 + 1];
+	for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+		snprintf(&uuid[i * 2], 3, "%02x", header->pipeline_cache_uuid[i]);
+	}
+
+	snprintf(out_filename, size, "%s-%04x-%04x-%s.bin", name, header->vendor_id, header->device_id, uuid);
+}
+
+/*!
+ * Also checks the header Vulkan puts at the start of the data, the driver
+ * should do that as well but broken data has crashed drivers before.
+ */
+static bool
+is_data_valid(const struct cache_file_header *expected, const void *data, size_t size)
+{
+	struct vk_data_header vk_header;
+	if (size < sizeof(vk_header)) {
+		return false;
+	}
+
+	memcpy(&vk_header, data, sizeof(vk_header));
+
+	return vk_header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+	       vk_header.vendor_id == expected->vendor_id && vk_header.device_id == expected->device_id &&
+	       memcmp(vk_header.pipeline_cache_uuid, expected->pipeline_cache_uuid, VK_UUID_SIZE) == 0;
+}
+
+static void *
+read_data(struct vk_bundle *vk, const struct cache_file_header *expected, const char *filename, size_t *out_size)
+{
+	FILE *file = u_file_open_file_in_config_dir_subpath(CACHE_SUBPATH, filename, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+
+	struct cache_file_header header;
+	void *data = NULL;
+
+	if (fread(&header, sizeof(header), 1, file) != 1) {
+		goto err_close;
+	}
+
+	// The data hash is the only field not known up front.
+	struct cache_file_header compare = *expected;
+	compare.data_size = header.data_size;
+	compare.data_hash = header.data_hash;
+
+	if (memcmp(&header, &compare, sizeof(header)) != 0) {
+		VK_DEBUG(vk, "Pipeline cache '%s' is for another device or driver, ignoring.", filename);
+		goto err_close;
+	}
+
+	if (header.data_size == 0 || header.data_size > CACHE_MAX_DATA_SIZE) {
+		goto err_close;
+	}
+
+	data = malloc(header.data_size);
+	if (data == NULL || fread(data, header.data_size, 1, file) != 1) {
+		goto err_close;
+	}
+
+	if (hash_data(data, header.data_size) != header.data_hash ||
+	    !is_data_valid(expected, data, header.data_size)) {
+		VK_WARN(vk, "Pipeline cache '%s' is corrupt, ignoring.", filename);
+		goto err_close;
+	}
+
+	fclose(file);
+
+	*out_size = header.data_size;
+
+	return data;
+
+err_close:
+	free(data);
+	fclose(file);
+
+	return NULL;
+}
+
+static bool
+get_path(const char *filename, char *out_path, size_t size)
+{
+	char dir[PATH_MAX];
+	int ret = u_file_get_config_dir(dir, sizeof(dir));
+	if (ret < 0 || ret >= (int)sizeof(dir)) {
+		return false;
+	}
+
+	ret = snprintf(out_path, size, "%s/%s/%s", dir, CACHE_SUBPATH, filename);
+
+	return ret > 0 && ret < (int)size;
+}
+
+#endif // U_FILE_HAVE_CONFIG_DIR
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+VkResult
+vk_create_pipeline_cache_from_file(struct vk_bundle *vk,
+                                   const char *name,
+                                   VkPipelineCache *out_pipeline_cache,
+                                   bool *out_loaded)
+{
+	VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+	bool loaded = false;
+	VkResult ret;
+
+#ifdef U_FILE_HAVE_CONFIG_DIR
+	if (debug_get_bool_option_vk_pipeline_cache()) {
+		struct cache_file_header expected;
+		fill_header(vk, &expected);
+
+		char filename[256];
+		make_filename(&expected, name, filename, sizeof(filename));
+
+		size_t size = 0;
+		void *data = read_data(vk, &expected, filename, &size);
+		if (data != NULL) {
+			ret = create_pipeline_cache(vk, data, size, &pipeline_cache);
+			loaded = ret == VK_SUCCESS;
+			free(data);
+
+			VK_DEBUG(vk, "Loaded pipeline cache '%s' (%u bytes): %s", filename, (uint32_t)size,
+			         vk_result_string(ret));
+		}
+	}
+#endif
+
+	// Nothing on disk or the driver didn't like it, start empty.
+	if (!loaded) {
+		ret = create_pipeline_cache(vk, NULL, 0, &pipeline_cache);
+		if (ret != VK_SUCCESS) {
+			VK_ERROR(vk, "vkCreatePipelineCache failed: %s", vk_result_string(ret));
+			return ret;
+		}
+	}
+
+	*out_pipeline_cache = pipeline_cache;
+	if (out_loaded != NULL) {
+		*out_loaded = loaded;
+	}
+
+	return VK_SUCCESS;
+}
+
+void
+vk_save_pipeline_cache(struct vk_bundle *vk, const char *name, VkPipelineCache pipeline_cache)
+{
+	if (pipeline_cache == VK_NULL_HANDLE || !debug_get_bool_option_vk_pipeline_cache()) {
+		return;
+	}
+
+#ifdef U_FILE_HAVE_CONFIG_DIR
+	struct cache_file_header header;
+	fill_header(vk, &header);
+
+	size_t size = 0;
+	VkResult ret = vk->vkGetPipelineCacheData(vk->device, pipeline_cache, &size, NULL);
+	if (ret != VK_SUCCESS || size == 0 || size > CACHE_MAX_DATA_SIZE) {
+		VK_WARN(vk, "vkGetPipelineCacheData: %s, size %u", vk_result_string(ret), (uint32_t)size);
+		return;
+	}
+
+	void *data = malloc(size);
+	ret = vk->vkGetPipelineCacheData(vk->device, pipeline_cache, &size, data);
+	if (ret != VK_SUCCESS) {
+		VK_WARN(vk, "vkGetPipelineCacheData: %s", vk_result_string(ret));
+		free(data);
+		return;
+	}
+
+	header.data_size = size;
+	header.data_hash = hash_data(data, size);
+
+	char filename[256];
+	char tmp_filename[sizeof(filename) + 4];
+	make_filename(&header, name, filename, sizeof(filename));
+	snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+
+	FILE *file = u_file_open_file_in_config_dir_subpath(CACHE_SUBPATH, tmp_filename, "wb");
+	if (file == NULL) {
+		VK_WARN(vk, "Could not open '%s' for writing.", tmp_filename);
+		free(data);
+		return;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data, size, 1, file) == 1;
+	ok = fclose(file) == 0 && ok;
+	free(data);
+
+	char path[PATH_MAX];
+	char tmp_path[PATH_MAX];
+	if (!get_path(filename, path, sizeof(path)) || !get_path(tmp_filename, tmp_path, sizeof(tmp_path))) {
+		return;
+	}
+
+	if (!ok) {
+		VK_WARN(vk, "Failed to write pipeline cache '%s'.", tmp_filename);
+		remove(tmp_path);
+		return;
+	}
+
+	// Atomic on POSIX, readers see either the old or the new file.
+	if (rename(tmp_path, path) != 0) {
+		VK_WARN(vk, "Failed to rename '%s' to '%s'.", tmp_path, path);
+		remove(tmp_path);
+		return;
+	}
+
+	VK_DEBUG(vk, "Saved pipeline cache '%s' (%u bytes).", filename, (uint32_t)size);
+#endif
+}
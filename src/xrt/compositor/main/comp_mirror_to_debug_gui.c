@@ -318,7 +318,12 @@ comp_mirror_init(struct comp_mirror_to_debug_gui *m,
 
 	VK_NAME_DESCRIPTOR_POOL(vk, m->blit.descriptor_pool, "comp_mirror_to_debug_ui blit descriptor pool");
 
-	C(vk_create_pipeline_cache(vk, &m->blit.pipeline_cache));
+	bool pipeline_cache_loaded = false;
+	C(vk_create_pipeline_cache_from_file( //
+	    vk,                               // vk_bundle
+	    "mirror_to_debug_gui",            // name
+	    &m->blit.pipeline_cache,          // out_pipeline_cache
+	    &pipeline_cache_loaded));         // out_loaded
 
 	VK_NAME_PIPELINE_CACHE(vk, m->blit.pipeline_cache, "comp_mirror_to_debug_ui blit pipeline cache");
 
@@ -344,6 +349,11 @@ comp_mirror_init(struct comp_mirror_to_debug_gui *m,
 
 	VK_NAME_PIPELINE(vk, m->blit.pipeline, "comp_mirror_to_debug_ui blit pipeline");
 
+	// The only pipeline is created above, so save right away.
+	if (!pipeline_cache_loaded) {
+		vk_save_pipeline_cache(vk, "mirror_to_debug_gui", m->blit.pipeline_cache);
+	}
+
 	return VK_SUCCESS;
 }
 
@@ -760,11 +760,13 @@ renderer_acquire_swapchain_image(struct comp_renderer *r)
 
 		/* Acquire image again to silence validation error */
 		ret = comp_target_acquire(r->c->target, &buffer_index);
-		if (ret != VK_SUCCESS) {
-			COMP_ERROR(r->c, "comp_target_acquire: %s", vk_result_string(ret));
-		}
-	} else if (ret != VK_SUCCESS) {
+	}
+
+	// Suboptimal still hands us an image, it has to be presented.
+	if (ret != VK_SUCCESS && ret != VK_SUBOPTIMAL_KHR) {
+		// Leave acquired_buffer invalid, the frame will be skipped and we retry on the next one.
 		COMP_ERROR(r->c, "comp_target_acquire: %s", vk_result_string(ret));
+		return;
 	}
 
 	r->acquired_buffer = buffer_index;
@@ -1122,6 +1124,18 @@ comp_renderer_draw(struct comp_renderer *r)
 		renderer_acquire_swapchain_image(r);
 	}
 
+	// No image to render to (target timed out or is gone) - skip rendering.
+	if (r->acquired_buffer < 0) {
+		// Need to emulate rendering for the timing.
+		//! @todo This should be discard.
+		comp_target_mark_submit_begin(ct, c->frame.rendering.id, os_monotonic_get_ns());
+		comp_target_mark_submit_end(ct, c->frame.rendering.id, os_monotonic_get_ns());
+
+		// Clear the rendering frame.
+		comp_frame_clear_locked(&c->frame.rendering);
+		return XRT_SUCCESS;
+	}
+
 	comp_target_update_timings(ct);
 
 	// Hardcoded for now.
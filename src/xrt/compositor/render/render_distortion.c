@@ -7,16 +7,52 @@
  * @ingroup comp_render
  */
 
+#include "xrt/xrt_config_os.h"
 #include "xrt/xrt_device.h"
 
 #include "math/m_api.h"
 #include "math/m_matrix_2x2.h"
 #include "math/m_vec2.h"
 
+#include "util/u_misc.h"
+#include "util/u_file.h"
+#include "util/u_hash.h"
+#include "util/u_debug.h"
+#include "util/u_worker.h"
+#include "util/u_distortion_mesh.h"
+
 #include "vk/vk_mini_helpers.h"
 
 #include "render/render_interface.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifdef U_FILE_HAVE_CONFIG_DIR
+#include <dirent.h>
+#include <limits.h>
+#include <utime.h>
+#include <sys/stat.h>
+#endif
+
+
+/*!
+ * Keep the generated distortion images in the config dir, see
+ * @ref make_cache_key for what goes into the file name.
+ */
+DEBUG_GET_ONCE_BOOL_OPTION(distortion_cache, "XRT_DISTORTION_CACHE", true)
+
+#define DISTORTION_CACHE_SUBPATH "distortion"
+#define DISTORTION_CACHE_MAGIC (0x54534944) // "DIST"
+#define DISTORTION_CACHE_VERSION (1)
+
+//! Number of points per side of the grid hashed into the cache key.
+#define DISTORTION_CACHE_PROBES (8)
+
+//! Files kept in the cache, each is about 400KiB, the least recently used are removed first.
+#define DISTORTION_CACHE_MAX_FILES (16)
+
 
 /*
  *
@@ -190,9 +226,271 @@ struct tan_angles_transforms
 	struct xrt_vec2 scale;
 };
 
+/*!
+ * Written first in the cache files.
+ */
+struct distortion_cache_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t dimensions;
+	uint32_t padding;
+	uint64_t key;
+};
+
+/*!
+ * The distortion functions are opaque, so the key is made from the device,
+ * the view setup and the distortion sampled at a coarse grid of points. Any
+ * change to the distortion parameters shows up in the sampled values.
+ */
+static uint64_t
+make_cache_key(struct xrt_device *xdev, uint32_t view, bool pre_rotate, const struct xrt_matrix_2x2 *rot)
+{
+	uint64_t hash = U_HASH_FNV1A_64_INIT;
+	uint32_t dimensions = RENDER_DISTORTION_IMAGE_DIMENSIONS;
+	uint8_t rotated = pre_rotate ? 1 : 0;
+
+	hash = u_hash_fnv1a_64(hash, &dimensions, sizeof(dimensions));
+	hash = u_hash_fnv1a_64(hash, &view, sizeof(view));
+	hash = u_hash_fnv1a_64(hash, &rotated, sizeof(rotated));
+	hash = u_hash_fnv1a_64(hash, rot, sizeof(*rot));
+	hash = u_hash_fnv1a_64(hash, xdev->str, strnlen(xdev->str, XRT_DEVICE_NAME_LEN));
+	hash = u_hash_fnv1a_64(hash, xdev->serial, strnlen(xdev->serial, XRT_DEVICE_NAME_LEN));
+	hash = u_hash_fnv1a_64(hash, &xdev->hmd->distortion.fov[view], sizeof(struct xrt_fov));
+
+	struct xrt_vec2 uvs[DISTORTION_CACHE_PROBES * DISTORTION_CACHE_PROBES];
+	struct xrt_uv_triplet results[ARRAY_SIZE(uvs)];
+
+	for (uint32_t row = 0; row < DISTORTION_CACHE_PROBES; row++) {
+		for (uint32_t col = 0; col < DISTORTION_CACHE_PROBES; col++) {
+			struct xrt_vec2 uv = {
+			    (float)col / (DISTORTION_CACHE_PROBES - 1),
+			    (float)row / (DISTORTION_CACHE_PROBES - 1),
+			};
+			uvs[row * DISTORTION_CACHE_PROBES + col] = uv;
+		}
+	}
+
+	U_ZERO_ARRAY(results);
+	xrt_device_compute_distortion_batch(xdev, view, ARRAY_SIZE(uvs), uvs, results);
+
+	return u_hash_fnv1a_64(hash, results, sizeof(results));
+}
+
+#ifdef U_FILE_HAVE_CONFIG_DIR
+
+static bool
+get_cache_path(const char *filename, char *out_path, size_t size)
+{
+	char dir[PATH_MAX];
+	int ret = u_file_get_config_dir(dir, sizeof(dir));
+	if (ret < 0 || ret >= (int)sizeof(dir)) {
+		return false;
+	}
+
+	ret = snprintf(out_path, size, "%s/%s/%s", dir, DISTORTION_CACHE_SUBPATH, filename);
+
+	return ret > 0 && ret < (int)size;
+}
+
+/*!
+ * Remove the least recently used files until at most
+ * @ref DISTORTION_CACHE_MAX_FILES are left, reads touch the files.
+ */
+static void
+trim_cache(void)
+{
+	char dir_path[PATH_MAX];
+	if (!get_cache_path("", dir_path, sizeof(dir_path))) {
+		return;
+	}
+
+	while (true) {
+		DIR *dir = opendir(dir_path);
+		if (dir == NULL) {
+			return;
+		}
+
+		uint32_t count = 0;
+		time_t oldest_time = 0;
+		char oldest_path[PATH_MAX] = {0};
+
+		struct dirent *entry = NULL;
+		while ((entry = readdir(dir)) != NULL) {
+			size_t len = strlen(entry->d_name);
+			if (len < 4 || strcmp(&entry->d_name[len - 4], ".bin") != 0) {
+				continue;
+			}
+
+			char path[PATH_MAX];
+			struct stat st;
+			if (!get_cache_path(entry->d_name, path, sizeof(path)) || stat(path, &st) != 0) {
+				continue;
+			}
+
+			if (count++ == 0 || st.st_mtime < oldest_time) {
+				oldest_time = st.st_mtime;
+				snprintf(oldest_path, sizeof(oldest_path), "%s", path);
+			}
+		}
+
+		closedir(dir);
+
+		if (count <= DISTORTION_CACHE_MAX_FILES || remove(oldest_path) != 0) {
+			return;
+		}
+	}
+}
+
+static bool
+read_cache(uint64_t key, struct texture *r, struct texture *g, struct texture *b)
+{
+	char filename[32];
+	snprintf(filename, sizeof(filename), "%016" PRIx64 ".bin", key);
+
+	FILE *file = u_file_open_file_in_config_dir_subpath(DISTORTION_CACHE_SUBPATH, filename, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	struct distortion_cache_header header = {0};
+	bool ok = fread(&header, sizeof(header), 1, file) == 1;
+	ok = ok && header.magic == DISTORTION_CACHE_MAGIC && header.version == DISTORTION_CACHE_VERSION;
+	ok = ok && header.dimensions == RENDER_DISTORTION_IMAGE_DIMENSIONS && header.key == key;
+	ok = ok && fread(r, sizeof(*r), 1, file) == 1;
+	ok = ok && fread(g, sizeof(*g), 1, file) == 1;
+	ok = ok && fread(b, sizeof(*b), 1, file) == 1;
+
+	fclose(file);
+
+	// Mark as recently used so trimming keeps it.
+	char path[PATH_MAX];
+	if (ok && get_cache_path(filename, path, sizeof(path))) {
+		utime(path, NULL);
+	}
+
+	return ok;
+}
+
+static void
+write_cache(uint64_t key, const struct texture *r, const struct texture *g, const struct texture *b)
+{
+	char filename[32];
+	char tmp_filename[sizeof(filename) + 4];
+	snprintf(filename, sizeof(filename), "%016" PRIx64 ".bin", key);
+	snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+
+	FILE *file = u_file_open_file_in_config_dir_subpath(DISTORTION_CACHE_SUBPATH, tmp_filename, "wb");
+	if (file == NULL) {
+		return;
+	}
+
+	struct distortion_cache_header header = {
+	    .magic = DISTORTION_CACHE_MAGIC,
+	    .version = DISTORTION_CACHE_VERSION,
+	    .dimensions = RENDER_DISTORTION_IMAGE_DIMENSIONS,
+	    .key = key,
+	};
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(r, sizeof(*r), 1, file) == 1;
+	ok = ok && fwrite(g, sizeof(*g), 1, file) == 1;
+	ok = ok && fwrite(b, sizeof(*b), 1, file) == 1;
+	ok = fclose(file) == 0 && ok;
+
+	char path[PATH_MAX];
+	char tmp_path[PATH_MAX];
+	if (!get_cache_path(filename, path, sizeof(path)) || //
+	    !get_cache_path(tmp_filename, tmp_path, sizeof(tmp_path))) {
+		return;
+	}
+
+	// Same as the pipeline cache, readers see either no file or a whole one.
+	if (!ok || rename(tmp_path, path) != 0) {
+		remove(tmp_path);
+		return;
+	}
+
+	trim_cache();
+}
+
+#else
+
+static bool
+read_cache(uint64_t key, struct texture *r, struct texture *g, struct texture *b)
+{
+	return false;
+}
+
+static void
+write_cache(uint64_t key, const struct texture *r, const struct texture *g, const struct texture *b)
+{
+	// Noop
+}
+
+#endif // U_FILE_HAVE_CONFIG_DIR
+
+static bool
+compute_distortion_images(struct xrt_device *xdev,
+                          struct u_worker_thread_pool **pool,
+                          uint32_t view,
+                          const struct xrt_matrix_2x2 *rot,
+                          struct texture *r,
+                          struct texture *g,
+                          struct texture *b)
+{
+	const uint32_t dim = RENDER_DISTORTION_IMAGE_DIMENSIONS;
+	const uint32_t count = dim * dim;
+	const double dim_minus_one_f64 = dim - 1;
+
+	struct xrt_vec2 *uvs = U_TYPED_ARRAY_CALLOC(struct xrt_vec2, count);
+	struct xrt_uv_triplet *results = U_TYPED_ARRAY_CALLOC(struct xrt_uv_triplet, count);
+
+	for (uint32_t row = 0; row < dim; row++) {
+		// This goes from 0 to 1.0 inclusive.
+		float v = (float)(row / dim_minus_one_f64);
+
+		for (uint32_t col = 0; col < dim; col++) {
+			// This goes from 0 to 1.0 inclusive.
+			float u = (float)(col / dim_minus_one_f64);
+
+			// These need to go from -0.5 to 0.5 for the rotation
+			struct xrt_vec2 uv = {u - 0.5f, v - 0.5f};
+			m_mat2x2_transform_vec2(rot, &uv, &uv);
+			uv.x += 0.5f;
+			uv.y += 0.5f;
+
+			uvs[row * dim + col] = uv;
+		}
+	}
+
+	// Only started when a view isn't in the cache, then shared by all views.
+	if (*pool == NULL) {
+		*pool = u_distortion_thread_pool_create();
+	}
+
+	bool ok = u_distortion_compute_points(xdev, *pool, view, count, uvs, results);
+
+	for (uint32_t row = 0; row < dim; row++) {
+		for (uint32_t col = 0; col < dim; col++) {
+			const struct xrt_uv_triplet *result = &results[row * dim + col];
+
+			r->pixels[row][col] = result->r;
+			g->pixels[row][col] = result->g;
+			b->pixels[row][col] = result->b;
+		}
+	}
+
+	free(uvs);
+	free(results);
+
+	return ok;
+}
+
 XRT_CHECK_RESULT static VkResult
 create_and_fill_in_distortion_buffer_for_view(struct vk_bundle *vk,
                                               struct xrt_device *xdev,
+                                              struct u_worker_thread_pool **pool,
                                               struct render_buffer *r_buffer,
                                               struct render_buffer *g_buffer,
                                               struct render_buffer *b_buffer,
@@ -240,29 +538,17 @@ create_and_fill_in_distortion_buffer_for_view(struct vk_bundle *vk,
 	struct texture *g = g_buffer->mapped;
 	struct texture *b = b_buffer->mapped;
 
-	const double dim_minus_one_f64 = RENDER_DISTORTION_IMAGE_DIMENSIONS - 1;
+	bool use_cache = debug_get_bool_option_distortion_cache();
+	uint64_t key = 0;
 
-	for (int row = 0; row < RENDER_DISTORTION_IMAGE_DIMENSIONS; row++) {
-		// This goes from 0 to 1.0 inclusive.
-		float v = (float)(row / dim_minus_one_f64);
-
-		for (int col = 0; col < RENDER_DISTORTION_IMAGE_DIMENSIONS; col++) {
-			// This goes from 0 to 1.0 inclusive.
-			float u = (float)(col / dim_minus_one_f64);
-
-			// These need to go from -0.5 to 0.5 for the rotation
-			struct xrt_vec2 uv = {u - 0.5f, v - 0.5f};
-			m_mat2x2_transform_vec2(&rot, &uv, &uv);
-			uv.x += 0.5f;
-			uv.y += 0.5f;
-
-			struct xrt_uv_triplet result;
-			xrt_device_compute_distortion(xdev, view, uv.x, uv.y, &result);
+	if (use_cache) {
+		key = make_cache_key(xdev, view, pre_rotate, &rot);
+	}
 
-			r->pixels[row][col] = result.r;
-			g->pixels[row][col] = result.g;
-			b->pixels[row][col] = result.b;
-		}
+	if (use_cache && read_cache(key, r, g, b)) {
+		VK_DEBUG(vk, "Distortion images for view %u loaded from cache %016" PRIx64, view, key);
+	} else if (compute_distortion_images(xdev, pool, view, &rot, r, g, b) && use_cache) {
+		write_cache(key, r, g, b);
 	}
 
 	render_buffer_unmap(vk, r_buffer);
@@ -290,6 +576,7 @@ render_distortion_buffer_init(struct render_resources *r,
 	VkImage images[RENDER_DISTORTION_IMAGES_SIZE];
 	VkImageView image_views[RENDER_DISTORTION_IMAGES_SIZE];
 	VkCommandBuffer upload_buffer = VK_NULL_HANDLE;
+	struct u_worker_thread_pool *compute_pool = NULL;
 	VkResult ret;
 
 
@@ -307,11 +594,17 @@ render_distortion_buffer_init(struct render_resources *r,
 	 * view_count=3,RRRGGGBBB
 	 */
 	for (uint32_t i = 0; i < r->view_count; ++i) {
-		ret = create_and_fill_in_distortion_buffer_for_view(vk, xdev, &bufs[i], &bufs[r->view_count + i],
+		ret = create_and_fill_in_distortion_buffer_for_view(vk, xdev, &compute_pool, &bufs[i],
+		                                                    &bufs[r->view_count + i],
 		                                                    &bufs[2 * r->view_count + i], i, pre_rotate);
+		if (ret != VK_SUCCESS) {
+			u_worker_thread_pool_reference(&compute_pool, NULL);
+		}
 		VK_CHK_WITH_GOTO(ret, "create_and_fill_in_distortion_buffer_for_view", err_resources);
 	}
 
+	u_worker_thread_pool_reference(&compute_pool, NULL);
+
 	/*
 	 * Command submission.
 	 */
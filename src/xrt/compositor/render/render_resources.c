@@ -14,6 +14,11 @@
 #include "math/m_matrix_2x2.h"
 #include "math/m_vec2.h"
 
+#include "os/os_time.h"
+
+#include "util/u_time.h"
+#include "util/u_pretty_print.h"
+
 #include "vk/vk_mini_helpers.h"
 
 #include "render/render_interface.h"
@@ -22,6 +27,70 @@
 #include <stdio.h>
 
 
+//! Name of the pipeline cache file in the config dir.
+#define PIPELINE_CACHE_NAME "render"
+
+//! Max number of steps @ref init_timing keeps track of.
+#define INIT_TIMING_MAX_STEPS (12)
+
+
+/*
+ *
+ * Init timing.
+ *
+ */
+
+/*!
+ * Where the time in @ref render_resources_init goes, printed when done.
+ */
+struct init_timing
+{
+	int64_t start_ns;
+	int64_t last_ns;
+	uint32_t count;
+	const char *names[INIT_TIMING_MAX_STEPS];
+	int64_t durations_ns[INIT_TIMING_MAX_STEPS];
+};
+
+static void
+init_timing_begin(struct init_timing *t)
+{
+	U_ZERO(t);
+	t->start_ns = os_monotonic_get_ns();
+	t->last_ns = t->start_ns;
+}
+
+static void
+init_timing_step(struct init_timing *t, const char *name)
+{
+	int64_t now_ns = os_monotonic_get_ns();
+
+	if (t->count < INIT_TIMING_MAX_STEPS) {
+		t->names[t->count] = name;
+		t->durations_ns[t->count] = now_ns - t->last_ns;
+		t->count++;
+	}
+
+	t->last_ns = now_ns;
+}
+
+static void
+init_timing_log(struct init_timing *t, bool pipeline_cache_loaded)
+{
+	struct u_pp_sink_stack_only sink;
+	u_pp_delegate_t dg = u_pp_sink_stack_only_init(&sink);
+
+	u_pp(dg, "New renderer initialized in %.2fms (pipeline cache %s):", time_ns_to_ms_f(t->last_ns - t->start_ns),
+	     pipeline_cache_loaded ? "loaded" : "cold");
+
+	for (uint32_t i = 0; i < t->count; i++) {
+		u_pp(dg, "\n\t%-28s %7.2fms", t->names[i], time_ns_to_ms_f(t->durations_ns[i]));
+	}
+
+	U_LOG_I("%s", sink.buffer);
+}
+
+
 /*
  *
  * Gfx shared
@@ -514,6 +583,9 @@ render_resources_init(struct render_resources *r,
 	VkResult ret;
 	bool bret;
 
+	struct init_timing timing;
+	init_timing_begin(&timing);
+
 	/*
 	 * Main pointers.
 	 */
@@ -605,6 +677,8 @@ render_resources_init(struct render_resources *r,
 
 	VK_NAME_COMMAND_POOL(vk, r->cmd_pool, "render_resources command pool");
 
+	init_timing_step(&timing, "samplers and command pools");
+
 
 	/*
 	 * Mock, used as a default image empty image.
@@ -665,16 +739,21 @@ render_resources_init(struct render_resources *r,
 		// No need to wait, submit waits on the fence.
 	}
 
+	init_timing_step(&timing, "mock image");
+
 
 	/*
 	 * Shared
 	 */
 
-	ret = vk_create_pipeline_cache(vk, &r->pipeline_cache);
-	VK_CHK_WITH_RET(ret, "vk_create_pipeline_cache", false);
+	bool pipeline_cache_loaded = false;
+	ret = vk_create_pipeline_cache_from_file(vk, PIPELINE_CACHE_NAME, &r->pipeline_cache, &pipeline_cache_loaded);
+	VK_CHK_WITH_RET(ret, "vk_create_pipeline_cache_from_file", false);
 
 	VK_NAME_PIPELINE_CACHE(vk, r->pipeline_cache, "render_resources pipeline cache");
 
+	init_timing_step(&timing, "pipeline cache");
+
 	VkCommandBufferAllocateInfo cmd_buffer_info = {
 	    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
 	    .commandPool = r->cmd_pool,
@@ -820,6 +899,8 @@ render_resources_init(struct render_resources *r,
 		return false;
 	}
 
+	init_timing_step(&timing, "gfx and mesh");
+
 
 	/*
 	 * Compute static.
@@ -851,6 +932,9 @@ render_resources_init(struct render_resources *r,
 
 	VK_NAME_DESCRIPTOR_POOL(vk, r->compute.descriptor_pool, "render_resources compute descriptor pool");
 
+	init_timing_step(&timing, "compute static");
+
+
 	/*
 	 * Layer pipeline
 	 */
@@ -930,6 +1014,8 @@ render_resources_init(struct render_resources *r,
 		VK_CHK_WITH_RET(ret, "render_buffer_map", false);
 	}
 
+	init_timing_step(&timing, "compute layer pipelines");
+
 
 	/*
 	 * Distortion pipeline
@@ -1004,6 +1090,8 @@ render_resources_init(struct render_resources *r,
 	    &r->compute.distortion.ubo); // buffer
 	VK_CHK_WITH_RET(ret, "render_buffer_map", false);
 
+	init_timing_step(&timing, "compute distortion pipelines");
+
 
 	/*
 	 * Clear pipeline.
@@ -1036,6 +1124,8 @@ render_resources_init(struct render_resources *r,
 	    &r->compute.clear.ubo); // buffer
 	VK_CHK_WITH_RET(ret, "render_buffer_map", false);
 
+	init_timing_step(&timing, "compute clear pipeline");
+
 
 	/*
 	 * Compute distortion textures, not created until later.
@@ -1077,7 +1167,15 @@ render_resources_init(struct render_resources *r,
 	 * Done
 	 */
 
-	U_LOG_I("New renderer initialized!");
+	init_timing_step(&timing, "timestamp pool");
+
+	// Nothing was loaded, save now so a crash later doesn't lose the compute pipelines.
+	if (!pipeline_cache_loaded) {
+		vk_save_pipeline_cache(vk, PIPELINE_CACHE_NAME, r->pipeline_cache);
+		init_timing_step(&timing, "pipeline cache save");
+	}
+
+	init_timing_log(&timing, pipeline_cache_loaded);
 
 	return true;
 }
@@ -1109,6 +1207,8 @@ render_resources_close(struct render_resources *r)
 
 	D(DescriptorSetLayout, r->mesh.descriptor_set_layout);
 	D(PipelineLayout, r->mesh.pipeline_layout);
+	// Also has all of the gfx pipelines created after init by now.
+	vk_save_pipeline_cache(vk, PIPELINE_CACHE_NAME, r->pipeline_cache);
 	D(PipelineCache, r->pipeline_cache);
 	D(QueryPool, r->query_pool);
 	render_buffer_close(vk, &r->mesh.vbo);
@@ -20,6 +20,7 @@
 
 #include "math/m_relation_history.h"
 #include "math/m_api.h"
+#include "math/m_clock_tracking.h"
 #include "math/m_mathinclude.h" // IWYU pragma: keep
 
 #include "util/u_debug.h"
@@ -55,6 +56,21 @@ struct alvr_hmd
 	// has built-in mutex so thread safe
 	struct m_relation_history *relation_hist;
 
+	//! Maps the headset clock onto the monotonic clock, only touched from the tracking callback.
+	struct m_clock_windowed_skew_tracker *clock_tracker;
+
+	//! Estimated offset from the headset clock to the monotonic clock, for u_var.
+	int64_t hw2mono_ns;
+
+	//! Smoothed arrival delay on top of the estimated offset, for u_var.
+	int64_t clock_delay_ns;
+
+	//! Arrival delay of the previous sample, only touched from the tracking callback.
+	int64_t last_delay_ns;
+
+	//! Smoothed change in arrival delay between samples (RFC 3550 interarrival jitter), for u_var.
+	int64_t clock_jitter_ns;
+
 	std::mutex viewMutex;
 	std::array<xrt_pose, 2> viewPoses;
 };
@@ -68,6 +84,13 @@ alvr_hmd(struct xrt_device *xdev)
 }
 
 DEBUG_GET_ONCE_LOG_OPTION(alvr_log, "ALVR_LOG", U_LOGGING_DEBUG)
+DEBUG_GET_ONCE_NUM_OPTION(alvr_prediction_samples, "ALVR_PREDICTION_SAMPLES", 0)
+
+/*!
+ * Number of tracking samples the clock skew is estimated over, a bit more
+ * than a second of tracking at the headset's usual rates.
+ */
+#define ALVR_CLOCK_WINDOW_SAMPLES 256
 
 #define HMD_TRACE(hmd, ...) U_LOG_XDEV_IFL_T(&hmd->base, hmd->log_level, __VA_ARGS__)
 #define HMD_DEBUG(hmd, ...) U_LOG_XDEV_IFL_D(&hmd->base, hmd->log_level, __VA_ARGS__)
@@ -85,6 +108,11 @@ alvr_hmd_destroy(struct xrt_device *xdev)
 
 	m_relation_history_destroy(&hmd->relation_hist);
 
+	if (hmd->clock_tracker != NULL) {
+		m_clock_windowed_skew_tracker_destroy(hmd->clock_tracker);
+		hmd->clock_tracker = NULL;
+	}
+
 	u_device_free(&hmd->base);
 }
 
@@ -243,7 +271,21 @@ alvr_hmd_create(void)
 	snprintf(hmd->base.str, XRT_DEVICE_NAME_LEN, "Alvr HMD");
 	snprintf(hmd->base.serial, XRT_DEVICE_NAME_LEN, "Alvr HMD S/N");
 
-	m_relation_history_create(&hmd->relation_hist);
+	// Only the tracking callback pushes after creation, readers never wait on it.
+	m_relation_history_create_single_writer(&hmd->relation_hist);
+
+	/*
+	 * Streaming predicts a long way ahead, optionally fit over a few samples
+	 * with Hermite interpolation. Off by default until it has been measured
+	 * on real headsets, 0 or less only uses the newest sample.
+	 */
+	int prediction_samples = (int)debug_get_num_option_alvr_prediction_samples();
+	if (prediction_samples > 0) {
+		m_relation_history_set_interpolation(hmd->relation_hist, M_RELATION_HISTORY_INTERPOLATION_HERMITE);
+		m_relation_history_set_prediction(hmd->relation_hist, M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES,
+		                                  (uint32_t)prediction_samples);
+	}
+	hmd->clock_tracker = m_clock_windowed_skew_tracker_alloc(ALVR_CLOCK_WINDOW_SAMPLES);
 
 	hmd->base.name = XRT_DEVICE_GENERIC_HMD;
 	hmd->base.device_type = XRT_DEVICE_TYPE_HMD;
@@ -286,19 +328,44 @@ alvr_hmd_create(void)
 	// Setup variable tracker: Optional but useful for debugging
 	u_var_add_root(hmd, "ALVR HMD", true);
 	u_var_add_log_level(hmd, &hmd->log_level, "log_level");
+	u_var_add_ro_i64(hmd, &hmd->hw2mono_ns, "Headset to monotonic clock offset(ns)");
+	u_var_add_ro_i64(hmd, &hmd->clock_delay_ns, "Tracking arrival delay(ns)");
+	u_var_add_ro_i64(hmd, &hmd->clock_jitter_ns, "Tracking arrival jitter(ns)");
 
 	auto tracking_cb = [hmd](u64 ts_ns, AlvrDeviceMotion hmd_mot) {
 		auto xrel = xrt_rel_from_alvr_mot(hmd_mot);
 
 		int64_t xrt_now = os_monotonic_get_ns();
-		// static int64_t delta = std::abs(xrt_now - (int64_t)ts_ns);
-		// HMD_ERROR(hmd, "delta %lu", delta);
-
-		// HMD_ERROR(hmd, "got a tracking callback woo %f, %f, %f, %lu", xrel.pose.position.x,
-		//           xrel.pose.orientation.x, xrel.linear_velocity.x, ts_ns);
-
-		// TODO: Fix, actually measure latency
-		m_relation_history_push(hmd->relation_hist, &xrel, xrt_now - 60);
+		int64_t remote_ns = (int64_t)ts_ns;
+
+		/*
+		 * The windowed minimum skew is the sample that got here the
+		 * fastest, so the mapping lands on the sample time plus the
+		 * smallest network delay we have seen. Without round-trips
+		 * that is as close as we can get.
+		 */
+		m_clock_windowed_skew_tracker_push(hmd->clock_tracker, xrt_now, remote_ns);
+
+		timepoint_ns sample_ns = xrt_now;
+		if (m_clock_windowed_skew_tracker_to_local(hmd->clock_tracker, remote_ns, &sample_ns)) {
+			hmd->hw2mono_ns = sample_ns - remote_ns;
+
+			// How much later than the fastest sample this one arrived.
+			int64_t delay_ns = xrt_now - sample_ns;
+			hmd->clock_delay_ns += (delay_ns - hmd->clock_delay_ns) / 16;
+
+			// Jitter is how much that delay changes from sample to sample.
+			int64_t delay_change_ns = std::abs(delay_ns - hmd->last_delay_ns);
+			hmd->clock_jitter_ns += (delay_change_ns - hmd->clock_jitter_ns) / 16;
+			hmd->last_delay_ns = delay_ns;
+		}
+
+		// Never claim a sample is from the future.
+		if (sample_ns > xrt_now) {
+			sample_ns = xrt_now;
+		}
+
+		m_relation_history_push(hmd->relation_hist, &xrel, sample_ns);
 	};
 	CallbackManager::get().registerCb<ALVR_EVENT_TRACKING_UPDATED>(std::move(tracking_cb));
 
@@ -47,6 +47,8 @@ struct euroc_player_playback_config
 	bool use_source_ts;       //!< If true, use the original timestamps from the dataset
 	bool play_from_start;     //!< If set, the euroc player does not wait for user input to start
 	bool print_progress;      //!< Whether to print progress to stdout (useful for CLI runs)
+	int prefetch;             //!< Images per camera to decode ahead of playback, 0 decodes just in time
+	bool benchmark;           //!< Play at max speed and report the sustained frames/s when done
 };
 
 /*!
@@ -25,11 +25,14 @@
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <stdint.h>
 #include <stdio.h>
 #include <fstream>
 #include <future>
+#include <mutex>
 #include <thread>
 
 //! @see euroc_player_playback_config
@@ -47,6 +50,8 @@ DEBUG_GET_ONCE_BOOL_OPTION(send_all_imus_first, "EUROC_SEND_ALL_IMUS_FIRST", fal
 DEBUG_GET_ONCE_BOOL_OPTION(use_source_ts, "EUROC_USE_SOURCE_TS", false)
 DEBUG_GET_ONCE_BOOL_OPTION(play_from_start, "EUROC_PLAY_FROM_START", false)
 DEBUG_GET_ONCE_BOOL_OPTION(print_progress, "EUROC_PRINT_PROGRESS", false)
+DEBUG_GET_ONCE_NUM_OPTION(prefetch, "EUROC_PREFETCH", 8)
+DEBUG_GET_ONCE_BOOL_OPTION(benchmark, "EUROC_BENCHMARK", false)
 
 #define EUROC_PLAYER_STR "Euroc Player"
 
@@ -54,15 +59,20 @@ DEBUG_GET_ONCE_BOOL_OPTION(print_progress, "EUROC_PRINT_PROGRESS", false)
 #define EUROC_MAX_CAMS XRT_TRACKING_MAX_SLAM_CAMS
 
 using std::async;
+using std::condition_variable;
+using std::deque;
 using std::find_if;
 using std::ifstream;
 using std::is_same_v;
 using std::launch;
 using std::max_element;
+using std::mutex;
 using std::pair;
 using std::stof;
 using std::string;
+using std::thread;
 using std::to_string;
+using std::unique_lock;
 using std::vector;
 
 using img_sample = pair<timepoint_ns, string>;
@@ -80,6 +90,35 @@ enum euroc_player_ui_state
 	STREAM_ENDED
 };
 
+//! An image decoded ahead of playback.
+struct euroc_decoded_img
+{
+	uint64_t seq; //!< Index in `imgs[i]`
+	cv::Mat img;
+};
+
+/*!
+ * Decodes images ahead of playback with one thread per camera, see
+ * @ref euroc_player_playback_config::prefetch.
+ *
+ * Images are decoded into buffers from a per camera pool, a buffer is reused
+ * once the pool holds the only reference to it, that is when the frames that
+ * wrapped it have been freed downstream.
+ */
+struct euroc_prefetcher
+{
+	mutex lock;
+	condition_variable cond;                  //!< Notified on every decoded and taken image, and on stop
+	bool running;                             //!< Protected by `lock`
+	size_t window;                            //!< Max images waiting to be taken per camera
+	vector<deque<euroc_decoded_img>> ready;   //!< Decoded images per camera, protected by `lock`
+	vector<vector<cv::Mat>> pools;            //!< Image buffers per camera, only used by its thread
+	vector<thread> threads;                   //!< One decoding thread per camera
+	time_duration_ns wait_ns;                 //!< Time playback spent waiting on decoding
+	cv::ImreadModes read_mode;                //!< Playback options taken when started, read by all threads
+	float scale;
+};
+
 /*!
  * Euroc player is in charge of the playback of a particular dataset.
  *
@@ -114,6 +153,8 @@ struct euroc_player
 	vector<img_samples> *imgs; //!< List of all image names to read from the dataset per camera
 	gt_trajectory *gt;         //!< List of all groundtruth poses read from the dataset
 
+	struct euroc_prefetcher *prefetcher; //!< Set while streaming if decoding ahead
+
 	// Timestamp correction fields (can be disabled through `use_source_ts`)
 	timepoint_ns base_ts;   //!< First sample timestamp, stream timestamps are relative to this
 	timepoint_ns start_ts;  //!< When did the dataset started to be played
@@ -421,28 +462,179 @@ euroc_player_mapped_playback_ts(struct euroc_player *ep, timepoint_ns ts)
 	return euroc_player_mapped_ts(ep, ts);
 }
 
+//! Load will be influenced by the color and scale playback options
+static cv::ImreadModes
+euroc_player_read_mode(struct euroc_player *ep, float *out_scale)
+{
+	ep->playback.scale = CLAMP(ep->playback.scale, 1.0 / 16, 4);
+	*out_scale = ep->playback.scale;
+	return ep->playback.color ? cv::IMREAD_ANYCOLOR : cv::IMREAD_GRAYSCALE;
+}
+
+//! Decodes the image at `path` into `out`, its buffer is reused if it has the right size.
+//! `file` and `unscaled` are scratch buffers kept by the caller between calls.
+static void
+euroc_player_decode_img(cv::ImreadModes read_mode,
+                        float scale,
+                        const string &path,
+                        vector<uint8_t> &file,
+                        cv::Mat &unscaled,
+                        cv::Mat &out)
+{
+	ifstream fin{path, std::ios::binary | std::ios::ate};
+	EUROC_ASSERT(fin.is_open(), "Unable to open %s", path.c_str());
+	file.resize(fin.tellg());
+	fin.seekg(0);
+	fin.read((char *)file.data(), file.size());
+	EUROC_ASSERT(fin.good(), "Unable to read %s", path.c_str());
+
+	// If colored, decodes in BGR order
+	if (scale != 1.0) {
+		cv::imdecode(file, read_mode, &unscaled);
+		cv::resize(unscaled, out, cv::Size(), scale, scale);
+	} else {
+		cv::imdecode(file, read_mode, &out);
+	}
+}
+
+//! @returns a buffer nothing but the pool references, adds a new one if there is none
+static cv::Mat &
+euroc_prefetcher_get_buffer(vector<cv::Mat> &pool)
+{
+	for (cv::Mat &buffer : pool) {
+		if (buffer.u == nullptr || buffer.u->refcount == 1) {
+			return buffer;
+		}
+	}
+
+	pool.emplace_back();
+	return pool.back();
+}
+
+static void
+euroc_prefetcher_run(struct euroc_player *ep, int cam_index, uint64_t first_seq)
+{
+	struct euroc_prefetcher &pf = *ep->prefetcher;
+	const img_samples &samples = ep->imgs->at(cam_index);
+	vector<cv::Mat> &pool = pf.pools[cam_index];
+	vector<uint8_t> file;
+	cv::Mat unscaled;
+
+	for (uint64_t seq = first_seq; seq < samples.size(); seq++) {
+		{
+			unique_lock<mutex> lock(pf.lock);
+			pf.cond.wait(lock, [&] { return !pf.running || pf.ready[cam_index].size() < pf.window; });
+			if (!pf.running) {
+				return;
+			}
+		}
+
+		cv::Mat &buffer = euroc_prefetcher_get_buffer(pool);
+		euroc_player_decode_img(pf.read_mode, pf.scale, samples[seq].second, file, unscaled, buffer);
+
+		{
+			unique_lock<mutex> lock(pf.lock);
+			pf.ready[cam_index].push_back({seq, buffer});
+		}
+		pf.cond.notify_all();
+	}
+}
+
+static void
+euroc_player_start_prefetch(struct euroc_player *ep)
+{
+	if (ep->playback.prefetch <= 0) {
+		return;
+	}
+
+	int cam_count = ep->playback.cam_count;
+
+	ep->prefetcher = new euroc_prefetcher{};
+	struct euroc_prefetcher &pf = *ep->prefetcher;
+	pf.running = true;
+	pf.window = ep->playback.prefetch;
+	pf.ready.resize(cam_count);
+	pf.pools.resize(cam_count);
+	pf.read_mode = euroc_player_read_mode(ep, &pf.scale);
+	for (int i = 0; i < cam_count; i++) {
+		pf.threads.emplace_back(euroc_prefetcher_run, ep, i, ep->img_seq);
+	}
+
+	EUROC_DEBUG(ep, "Decoding up to %d images ahead per camera", ep->playback.prefetch);
+}
+
+static void
+euroc_player_stop_prefetch(struct euroc_player *ep)
+{
+	struct euroc_prefetcher *pf = ep->prefetcher;
+	if (pf == nullptr) {
+		return;
+	}
+
+	{
+		unique_lock<mutex> lock(pf->lock);
+		pf->running = false;
+	}
+	pf->cond.notify_all();
+
+	for (thread &t : pf->threads) {
+		t.join();
+	}
+
+	EUROC_DEBUG(ep, "Playback waited %.2fms on decoding", (double)pf->wait_ns / U_TIME_1MS_IN_NS);
+
+	// Frames still downstream keep their own reference to the buffers
+	ep->prefetcher = nullptr;
+	delete pf;
+}
+
+//! Waits for the prefetcher to decode the image for `img_seq`
+static cv::Mat
+euroc_player_take_prefetched_img(struct euroc_player *ep, int cam_index)
+{
+	struct euroc_prefetcher &pf = *ep->prefetcher;
+	deque<euroc_decoded_img> &ready = pf.ready[cam_index];
+
+	timepoint_ns wait_start_ts = os_monotonic_get_ts();
+	unique_lock<mutex> lock(pf.lock);
+	pf.cond.wait(lock, [&] { return !pf.running || !ready.empty(); });
+	EUROC_ASSERT(!ready.empty(), "Prefetcher stopped while playing");
+	pf.wait_ns += os_monotonic_get_ts() - wait_start_ts;
+
+	euroc_decoded_img decoded = std::move(ready.front());
+	ready.pop_front();
+	lock.unlock();
+	pf.cond.notify_all();
+
+	EUROC_ASSERT(decoded.seq == ep->img_seq, "Prefetched image %" PRIu64 " instead of %" PRIu64, decoded.seq,
+	             ep->img_seq);
+	return decoded.img;
+}
+
 static void
 euroc_player_load_next_frame(struct euroc_player *ep, int cam_index, struct xrt_frame *&xf)
 {
 	using xrt::auxiliary::tracking::FrameMat;
 	img_sample sample = ep->imgs->at(cam_index).at(ep->img_seq);
-	ep->playback.scale = CLAMP(ep->playback.scale, 1.0 / 16, 4);
 
-	// Load will be influenced by these playback options
-	bool allow_color = ep->playback.color;
-	float scale = ep->playback.scale;
-
-	// Load image from disk
+	// Load image from disk, or take it from the ones already decoded
 	timepoint_ns timestamp = euroc_player_mapped_playback_ts(ep, sample.first);
 	string img_name = sample.second;
 	EUROC_TRACE(ep, "cam%d img t = %ld filename = %s", cam_index, timestamp, img_name.c_str());
-	cv::ImreadModes read_mode = allow_color ? cv::IMREAD_ANYCOLOR : cv::IMREAD_GRAYSCALE;
-	cv::Mat img = cv::imread(img_name, read_mode); // If colored, reads in BGR order
 
-	if (scale != 1.0) {
-		cv::Mat tmp;
-		cv::resize(img, tmp, cv::Size(), scale, scale);
-		img = tmp;
+	cv::Mat img;
+	if (ep->prefetcher != nullptr) {
+		img = euroc_player_take_prefetched_img(ep, cam_index);
+	} else {
+		float scale = 1;
+		cv::ImreadModes read_mode = euroc_player_read_mode(ep, &scale);
+		img = cv::imread(img_name, read_mode); // If colored, reads in BGR order
+
+		if (scale != 1.0) {
+			cv::Mat tmp;
+			cv::resize(img, tmp, cv::Size(), scale, scale);
+			img = tmp;
+		}
 	}
 
 	// Create xrt_frame, it will be freed by FrameMat destructor
@@ -609,6 +801,10 @@ euroc_player_stream(void *ptr)
 	ep->start_ts = os_monotonic_get_ts();
 	euroc_player_user_skip(ep);
 
+	if (ep->playback.benchmark) {
+		ep->playback.max_speed = true;
+	}
+
 	// Push all IMU samples now if requested
 	if (ep->playback.send_all_imus_first) {
 		while (ep->imu_seq < ep->imus->size()) {
@@ -621,6 +817,10 @@ euroc_player_stream(void *ptr)
 		euroc_player_push_all_gt(ep);
 	}
 
+	euroc_player_start_prefetch(ep);
+	uint64_t first_img_seq = ep->img_seq;
+	timepoint_ns play_start_ts = os_monotonic_get_ts();
+
 	// Launch image and IMU producers
 	auto serve_imus = async(launch::async, [ep] { euroc_player_stream_samples<imu_samples>(ep); });
 	auto serve_imgs = async(launch::async, [ep] { euroc_player_stream_samples<img_samples>(ep); });
@@ -631,8 +831,18 @@ euroc_player_stream(void *ptr)
 	serve_imgs.get();
 	serve_imus.get();
 
+	double play_s = (double)(os_monotonic_get_ts() - play_start_ts) / U_TIME_1S_IN_NS;
+	uint64_t played_frames = ep->img_seq - first_img_seq;
+	euroc_player_stop_prefetch(ep);
+
 	ep->is_running = false;
 
+	if (ep->playback.benchmark) {
+		printf("\nEuroc benchmark: %" PRIu64 " frames (%d cams) in %.2fs, %.1f frames/s\n", played_frames,
+		       ep->playback.cam_count, play_s, play_s > 0 ? played_frames / play_s : 0);
+		(void)fflush(stdout);
+	}
+
 	EUROC_INFO(ep, "Euroc dataset playback finished");
 	euroc_player_set_ui_state(ep, STREAM_ENDED);
 
@@ -909,6 +1119,8 @@ euroc_player_setup_gui(struct euroc_player *ep)
 	u_var_add_f64(ep, &ep->playback.speed, "Speed");
 	u_var_add_bool(ep, &ep->playback.send_all_imus_first, "Send all IMU samples first");
 	u_var_add_bool(ep, &ep->playback.use_source_ts, "Use original timestamps");
+	u_var_add_i32(ep, &ep->playback.prefetch, "Decode N images ahead");
+	u_var_add_bool(ep, &ep->playback.benchmark, "Benchmark, report frames/s at the end");
 
 	u_var_add_gui_header(ep, NULL, "Streams");
 	u_var_add_ro_ff_vec3_f32(ep, ep->gyro_ff, "Gyroscope");
@@ -945,6 +1157,8 @@ euroc_player_fill_default_config_for(struct euroc_player_config *config, const c
 	playback.use_source_ts = debug_get_bool_option_use_source_ts();
 	playback.play_from_start = debug_get_bool_option_play_from_start();
 	playback.print_progress = debug_get_bool_option_print_progress();
+	playback.prefetch = (int)debug_get_num_option_prefetch();
+	playback.benchmark = debug_get_bool_option_benchmark();
 
 	config->log_level = debug_get_log_option_euroc_log();
 	config->dataset = dataset;
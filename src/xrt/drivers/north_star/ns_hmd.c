@@ -447,6 +447,19 @@ ns_mesh_calc(struct xrt_device *xdev, uint32_t view, float u, float v, struct xr
 	}
 }
 
+//! Only set for the polynomial 2D distortion, the 3D optical system keeps state between calls.
+static bool
+ns_mesh_calc_batch(struct xrt_device *xdev,
+                   uint32_t view,
+                   uint32_t count,
+                   const struct xrt_vec2 *uvs,
+                   struct xrt_uv_triplet *results)
+{
+	struct ns_hmd *ns = ns_hmd(xdev);
+
+	return u_compute_distortion_ns_p2d_batch(&ns->config.dist_p2d, view, count, uvs, results);
+}
+
 /*
  *
  * Create function.
@@ -471,6 +484,9 @@ ns_hmd_create(const cJSON *config_json)
 
 
 	ns->base.compute_distortion = ns_mesh_calc;
+	if (ns->config.distortion_type == NS_DISTORTION_TYPE_POLYNOMIAL_2D) {
+		ns->base.compute_distortion_batch = ns_mesh_calc_batch;
+	}
 	ns->base.update_inputs = u_device_noop_update_inputs;
 	ns->base.get_tracked_pose = ns_hmd_get_tracked_pose;
 	ns->base.get_view_poses = ns_hmd_get_view_poses;
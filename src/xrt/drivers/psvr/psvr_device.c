@@ -1014,6 +1014,18 @@ psvr_compute_distortion(struct xrt_device *xdev, uint32_t view, float u, float v
 	return u_compute_distortion_panotools(&psvr->vals, u, v, result);
 }
 
+static bool
+psvr_compute_distortion_batch(struct xrt_device *xdev,
+                              uint32_t view,
+                              uint32_t count,
+                              const struct xrt_vec2 *uvs,
+                              struct xrt_uv_triplet *results)
+{
+	struct psvr_device *psvr = psvr_device(xdev);
+
+	return u_compute_distortion_panotools_batch(&psvr->vals, count, uvs, results);
+}
+
 
 /*
  *
@@ -1037,6 +1049,7 @@ psvr_device_create_auto_prober(struct hid_device_info *sensor_hid_info,
 	psvr->base.get_tracked_pose = psvr_device_get_tracked_pose;
 	psvr->base.get_view_poses = u_device_get_view_poses;
 	psvr->base.compute_distortion = psvr_compute_distortion;
+	psvr->base.compute_distortion_batch = psvr_compute_distortion_batch;
 	psvr->base.destroy = psvr_device_destroy;
 	psvr->base.inputs[0].name = XRT_INPUT_GENERIC_HEAD_POSE;
 	psvr->base.name = XRT_DEVICE_GENERIC_HMD;
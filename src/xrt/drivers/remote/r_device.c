@@ -20,6 +20,7 @@
 #include "vive/vive_bindings.h"
 
 #include "math/m_api.h"
+#include "math/m_predict.h"
 
 #include "util/u_hand_simulation.h"
 
@@ -134,6 +135,21 @@ r_device_get_tracked_pose(struct xrt_device *xdev,
 		out_relation->relation_flags = 0;
 	}
 
+	/*
+	 * Packets can be lost over UDP, carry on from the latest data received
+	 * but only over the time since the next packet should have arrived.
+	 * Same as the stream, data that is on time is returned as is.
+	 */
+	if (r->use_udp && latest->active) {
+		int64_t late_ns = os_monotonic_get_ns() - r->latest_ns - r->udp_interval_ns;
+		late_ns = CLAMP(late_ns, 0, R_MAX_PREDICTION_NS);
+
+		if (late_ns > 0) {
+			struct xrt_space_relation relation = *out_relation;
+			m_predict_relation(&relation, time_ns_to_s(late_ns), out_relation);
+		}
+	}
+
 	return XRT_SUCCESS;
 }
 
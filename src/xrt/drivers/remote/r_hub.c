@@ -9,6 +9,8 @@
 
 #include "r_internal.h"
 
+#include "os/os_time.h"
+
 #include "util/u_var.h"
 #include "util/u_misc.h"
 #include "util/u_debug.h"
@@ -57,6 +59,7 @@
  */
 
 DEBUG_GET_ONCE_LOG_OPTION(remote_log, "REMOTE_LOG", U_LOGGING_INFO)
+DEBUG_GET_ONCE_BOOL_OPTION(remote_udp, "REMOTE_UDP", false)
 
 #define R_TRACE(R, ...) U_LOG_IFL_T((R)->rc.log_level, __VA_ARGS__)
 #define R_DEBUG(R, ...) U_LOG_IFL_D((R)->rc.log_level, __VA_ARGS__)
@@ -109,6 +112,25 @@ socket_write(r_socket_t id, void *ptr, size_t size, size_t current)
 	return send(id, (const char *)ptr, (int)(size - current), 0);
 }
 
+static inline r_socket_t
+socket_create_udp(void)
+{
+	return socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+}
+
+static inline ssize_t
+socket_recv_packet(r_socket_t id, void *ptr, size_t size, struct sockaddr_in *out_from)
+{
+	int from_length = (int)sizeof(*out_from);
+	return recvfrom(id, (char *)ptr, (int)size, 0, (struct sockaddr *)out_from, &from_length);
+}
+
+static inline ssize_t
+socket_send_packet(r_socket_t id, const void *ptr, size_t size)
+{
+	return send(id, (const char *)ptr, (int)size, 0);
+}
+
 #elif defined(XRT_OS_UNIX)
 
 static inline void
@@ -141,6 +163,25 @@ socket_write(r_socket_t id, void *ptr, size_t size, size_t current)
 	return write(id, ptr, size - current);
 }
 
+static inline r_socket_t
+socket_create_udp(void)
+{
+	return socket(AF_INET, SOCK_DGRAM, 0);
+}
+
+static inline ssize_t
+socket_recv_packet(r_socket_t id, void *ptr, size_t size, struct sockaddr_in *out_from)
+{
+	socklen_t from_length = (socklen_t)sizeof(*out_from);
+	return recvfrom(id, ptr, size, 0, (struct sockaddr *)out_from, &from_length);
+}
+
+static inline ssize_t
+socket_send_packet(r_socket_t id, const void *ptr, size_t size)
+{
+	return send(id, ptr, size, 0);
+}
+
 #endif // XRT_OS_UNIX
 
 
@@ -206,7 +247,7 @@ cleanup:
 }
 
 static bool
-wait_for_read_and_to_continue(struct r_hub *r, r_socket_t socket)
+wait_for_read_and_to_continue(struct r_hub *r, struct os_thread_helper *oth, r_socket_t socket)
 {
 	fd_set set;
 	int ret = 0;
@@ -216,7 +257,7 @@ wait_for_read_and_to_continue(struct r_hub *r, r_socket_t socket)
 		return false;
 	}
 
-	while (os_thread_helper_is_running(&r->oth) && ret == 0) {
+	while (os_thread_helper_is_running(oth) && ret == 0) {
 		// Select can modify timeout, reset each loop.
 		struct timeval timeout = {.tv_sec = 1, .tv_usec = 0};
 
@@ -242,7 +283,7 @@ do_accept(struct r_hub *r)
 {
 	struct sockaddr_in addr = {0};
 	r_socket_t ret = 0;
-	if (!wait_for_read_and_to_continue(r, r->accept_fd)) {
+	if (!wait_for_read_and_to_continue(r, &r->oth, r->accept_fd)) {
 		R_ERROR(r, "Failed to wait for id " R_SOCKET_FMT, r->accept_fd);
 		return -1;
 	}
@@ -265,6 +306,7 @@ do_accept(struct r_hub *r)
 	}
 
 	r->rc.fd = conn_fd;
+	r->peer_addr = addr.sin_addr.s_addr;
 
 	R_INFO(r, "Connection received! " R_SOCKET_FMT, r->rc.fd);
 
@@ -282,7 +324,7 @@ read_one(struct r_hub *r, struct r_remote_data *data)
 	while (current < size) {
 		void *ptr = (uint8_t *)data + current;
 
-		if (!wait_for_read_and_to_continue(r, rc->fd)) {
+		if (!wait_for_read_and_to_continue(r, &r->oth, rc->fd)) {
 			return -1;
 		}
 
@@ -338,7 +380,11 @@ run_thread(void *ptr)
 			}
 
 			r->latest = data;
+			r->latest_ns = os_monotonic_get_ns();
 		}
+
+		// No more UDP packets until the next connection.
+		r->peer_addr = 0;
 	}
 
 	R_INFO(r, "Leaving thread");
@@ -346,6 +392,94 @@ run_thread(void *ptr)
 	return NULL;
 }
 
+static r_socket_t
+setup_udp_fd(struct r_hub *r)
+{
+	struct sockaddr_in server_address = {0};
+
+	r_socket_t ret = socket_create_udp();
+	if (ret < 0) {
+		R_ERROR(r, "socket: " R_SOCKET_FMT, ret);
+		return ret;
+	}
+
+	r->udp_fd = ret;
+
+	// Same port number as the stream, UDP and TCP ports are separate.
+	server_address.sin_family = AF_INET;
+	server_address.sin_addr.s_addr = htonl(INADDR_ANY);
+	server_address.sin_port = htons(r->port);
+
+	ret = bind(r->udp_fd, (struct sockaddr *)&server_address, sizeof(server_address));
+	if (ret < 0) {
+		R_ERROR(r, "bind: " R_SOCKET_FMT, ret);
+		socket_close(r->udp_fd);
+		r->udp_fd = -1;
+		return ret;
+	}
+
+	R_INFO(r, "Receiving UDP on port %d", r->port);
+
+	return 0;
+}
+
+/*!
+ * Each packet is complete on its own, so a lost one only means the data is
+ * a bit older until the next one arrives, the devices predict from it.
+ */
+static void *
+run_udp_thread(void *ptr)
+{
+	struct r_hub *r = (struct r_hub *)ptr;
+
+	if (setup_udp_fd(r) < 0) {
+		R_INFO(r, "Leaving UDP thread");
+		return NULL;
+	}
+
+	// One byte more, to catch packets that are too big.
+	uint8_t buf[R_UDP_MAX_PACKET_SIZE + 1];
+
+	while (wait_for_read_and_to_continue(r, &r->udp_oth, r->udp_fd)) {
+		struct sockaddr_in from = {0};
+		ssize_t ret = socket_recv_packet(r->udp_fd, buf, sizeof(buf), &from);
+		if (ret < 0) {
+			R_ERROR(r, "recv: %zi", ret);
+			break;
+		}
+
+		// Only the controller connected over TCP may send, anybody can send to an open port.
+		if (r->peer_addr == 0 || from.sin_addr.s_addr != r->peer_addr) {
+			R_TRACE(r, "Dropped UDP packet from unknown sender");
+			r->udp.dropped++;
+			continue;
+		}
+
+		uint64_t lost = r->udp.lost;
+
+		struct r_remote_data data;
+		if (!r_udp_decode(&r->udp, buf, (size_t)ret, &data)) {
+			R_TRACE(r, "Dropped UDP packet");
+			continue;
+		}
+
+		int64_t now_ns = os_monotonic_get_ns();
+
+		// Only learn the interval from packets that followed each other, not across reconnects.
+		int64_t interval_ns = now_ns - r->latest_ns;
+		if (r->udp.lost == lost && r->udp.received > 1 && interval_ns < R_MAX_PREDICTION_NS) {
+			r->udp_interval_ns += (interval_ns - r->udp_interval_ns) / 8;
+		}
+
+		r->latest = data;
+		r->latest_ns = now_ns;
+	}
+
+	R_INFO(r, "Leaving UDP thread");
+
+	return NULL;
+}
+
 static xrt_result_t
 r_hub_system_devices_get_roles(struct xrt_system_devices *xsysd, struct xrt_system_roles *out_roles)
 {
@@ -368,8 +502,9 @@ r_hub_system_devices_destroy(struct xrt_system_devices *xsysd)
 
 	R_DEBUG(r, "Destroying");
 
-	// Stop the thread first.
+	// Stop the threads first.
 	os_thread_helper_stop_and_wait(&r->oth);
+	os_thread_helper_stop_and_wait(&r->udp_oth);
 
 	// Destroy all of the devices now.
 	for (uint32_t i = 0; i < ARRAY_SIZE(r->base.xdevs); i++) {
@@ -387,6 +522,11 @@ r_hub_system_devices_destroy(struct xrt_system_devices *xsysd)
 		r->rc.fd = -1;
 	}
 
+	if (r->udp_fd >= 0) {
+		socket_close(r->udp_fd);
+		r->udp_fd = -1;
+	}
+
 	free(r);
 
 #if defined(XRT_OS_WINDOWS)
@@ -432,6 +572,7 @@ r_create_devices(uint16_t port,
 	r->reset.right.pose.position.z = -0.5f;
 	r->reset.right.pose.orientation.w = 1.0f;
 	r->latest = r->reset;
+	r->latest_ns = os_monotonic_get_ns();
 	r->rc.log_level = debug_get_log_option_remote_log();
 	r->gui.hmd = true;
 	r->gui.left = true;
@@ -440,10 +581,16 @@ r_create_devices(uint16_t port,
 	r->view_count = view_count;
 	r->accept_fd = -1;
 	r->rc.fd = -1;
+	r->rc.udp_fd = -1;
+	r->udp_fd = -1;
+	r->use_udp = debug_get_bool_option_remote_udp();
 
 	snprintf(r->origin.name, sizeof(r->origin.name), "Remote Simulator");
 
 	ret = os_thread_helper_init(&r->oth);
+	if (ret == 0) {
+		ret = os_thread_helper_init(&r->udp_oth);
+	}
 	if (ret != 0) {
 		R_ERROR(r, "Failed to init threading!");
 		r_hub_system_devices_destroy(&r->base);
@@ -451,6 +598,9 @@ r_create_devices(uint16_t port,
 	}
 
 	ret = os_thread_helper_start(&r->oth, run_thread, r);
+	if (ret == 0 && r->use_udp) {
+		ret = os_thread_helper_start(&r->udp_oth, run_udp_thread, r);
+	}
 	if (ret != 0) {
 		R_ERROR(r, "Failed to start thread!");
 		r_hub_system_devices_destroy(&r->base);
@@ -525,6 +675,12 @@ r_create_devices(uint16_t port,
 	// u_var_add_gui_header(r, &r->gui.right, "Right");
 	u_var_add_bool(r, &r->latest.right.active, "right.active");
 	u_var_add_pose(r, &r->latest.right.pose, "right.pose");
+	if (r->use_udp) {
+		u_var_add_ro_u64(r, &r->udp.received, "udp.received");
+		u_var_add_ro_u64(r, &r->udp.lost, "udp.lost");
+		u_var_add_ro_u64(r, &r->udp.dropped, "udp.dropped");
+		u_var_add_ro_i64(r, &r->udp_interval_ns, "udp.interval_ns");
+	}
 
 	/*
 	 * Done now.
@@ -553,6 +709,7 @@ r_remote_connection_init(struct r_remote_connection *rc, const char *ip_addr, ui
 
 	// Set log level.
 	rc->log_level = debug_get_log_option_remote_log();
+	rc->udp_fd = -1;
 
 #if defined(XRT_OS_WINDOWS)
 	// Initialize Winsock.
@@ -619,6 +776,27 @@ r_remote_connection_init(struct r_remote_connection *rc, const char *ip_addr, ui
 
 	rc->fd = conn_fd;
 
+	if (!debug_get_bool_option_remote_udp()) {
+		return 0;
+	}
+
+	r_socket_t udp_fd = socket_create_udp();
+	if (udp_fd < 0) {
+		RC_ERROR(rc, "Failed to create UDP socket, using the stream");
+		return 0;
+	}
+
+	// Connected so that send can be used, the hub listens on the same port number.
+	ret = connect(udp_fd, (struct sockaddr *)&addr, sizeof(addr));
+	if (ret != 0) {
+		RC_ERROR(rc, "Failed to connect UDP socket, using the stream");
+		socket_close(udp_fd);
+		return 0;
+	}
+
+	rc->udp_fd = udp_fd;
+	r_udp_encoder_init(&rc->udp, (uint32_t)os_monotonic_get_ns());
+
 	return 0;
 
 cleanup:
@@ -652,9 +830,33 @@ r_remote_connection_read_one(struct r_remote_connection *rc, struct r_remote_dat
 	return 0;
 }
 
+static int
+write_one_udp(struct r_remote_connection *rc, const struct r_remote_data *data)
+{
+	uint8_t buf[R_UDP_MAX_PACKET_SIZE];
+
+	size_t size = r_udp_encode(&rc->udp, data, buf, sizeof(buf));
+	assert(size > 0);
+
+	/*
+	 * Never partial for datagrams. Errors like the hub not listening yet
+	 * are the same as a lost packet, the stream tells if it is gone.
+	 */
+	ssize_t ret = socket_send_packet(rc->udp_fd, buf, size);
+	if (ret < 0) {
+		RC_DEBUG(rc, "send: %zi", ret);
+	}
+
+	return 0;
+}
+
 int
 r_remote_connection_write_one(struct r_remote_connection *rc, const struct r_remote_data *data)
 {
+	if (rc->udp_fd >= 0) {
+		return write_one_udp(rc, data);
+	}
+
 	const size_t size = sizeof(*data);
 	size_t current = 0;
 
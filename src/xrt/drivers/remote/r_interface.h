@@ -144,6 +144,95 @@ struct r_remote_data
 	struct r_remote_controller_data left, right;
 };
 
+/*!
+ * Header value to be set in the UDP packets.
+ *
+ * @ingroup drv_remote
+ */
+#define R_UDP_HEADER_VALUE (*(uint64_t *)"mndrmtu\0")
+
+/*!
+ * How often a full @ref r_remote_data is sent over UDP, the packets in
+ * between only hold the 32-bit words that differ from the last full one.
+ *
+ * @ingroup drv_remote
+ */
+#define R_UDP_KEYFRAME_INTERVAL (64)
+
+//! Number of 32-bit words in a @ref r_remote_data.
+#define R_UDP_DATA_WORD_COUNT (sizeof(struct r_remote_data) / sizeof(uint32_t))
+
+//! Number of 32-bit words in the changed words mask of a delta packet.
+#define R_UDP_MASK_WORD_COUNT ((R_UDP_DATA_WORD_COUNT + 31) / 32)
+
+/*!
+ * Start of every UDP packet, followed by either a whole @ref r_remote_data
+ * for keyframes, or the changed words mask and the changed words.
+ *
+ * @ingroup drv_remote
+ */
+struct r_udp_packet_header
+{
+	uint64_t header;
+
+	//! Picked by the sender on connect, the receiver resets when it changes.
+	uint32_t session;
+
+	//! Increases by one for each packet.
+	uint32_t seq;
+
+	//! Sequence number of the keyframe this packet is relative to, same as seq for keyframes.
+	uint32_t key_seq;
+
+	uint32_t _pad;
+};
+
+//! Largest packet @ref r_udp_encode produces.
+#define R_UDP_MAX_PACKET_SIZE                                                                                          \
+	(sizeof(struct r_udp_packet_header) + R_UDP_MASK_WORD_COUNT * sizeof(uint32_t) + sizeof(struct r_remote_data))
+
+/*!
+ * Sending side state of the UDP transport.
+ *
+ * @ingroup drv_remote
+ */
+struct r_udp_encoder
+{
+	uint32_t session;
+	uint32_t seq;
+
+	//! Last keyframe sent.
+	uint32_t key_seq;
+	struct r_remote_data key;
+};
+
+/*!
+ * Receiving side state of the UDP transport.
+ *
+ * @ingroup drv_remote
+ */
+struct r_udp_decoder
+{
+	//! Has any packet of the session been decoded.
+	bool have_data;
+	uint32_t session;
+	uint32_t seq;
+
+	//! Last keyframe received, deltas relative to other keyframes can't be decoded.
+	bool have_key;
+	uint32_t key_seq;
+	struct r_remote_data key;
+
+	//! Packets decoded.
+	uint64_t received;
+
+	//! Packets skipped between decoded ones, going by the sequence numbers, includes dropped ones.
+	uint64_t lost;
+
+	//! Packets that arrived but were malformed, late or relative to a lost keyframe.
+	uint64_t dropped;
+};
+
 /*!
  * Shared connection.
  *
@@ -156,6 +245,12 @@ struct r_remote_connection
 
 	//! Socket.
 	r_socket_t fd;
+
+	//! UDP socket the data is written to when @p REMOTE_UDP is set, otherwise -1.
+	r_socket_t udp_fd;
+
+	//! State for encoding the data sent on @ref udp_fd.
+	struct r_udp_encoder udp;
 };
 
 /*!
@@ -181,9 +276,42 @@ r_remote_connection_init(struct r_remote_connection *rc, const char *addr, uint1
 int
 r_remote_connection_read_one(struct r_remote_connection *rc, struct r_remote_data *data);
 
+/*!
+ * Writes the data, over UDP if @p REMOTE_UDP is set and over the stream
+ * otherwise.
+ *
+ * @ingroup drv_remote
+ */
 int
 r_remote_connection_write_one(struct r_remote_connection *rc, const struct r_remote_data *data);
 
+/*!
+ * Starts a new UDP session, the first packet encoded will be a keyframe.
+ *
+ * @ingroup drv_remote
+ */
+void
+r_udp_encoder_init(struct r_udp_encoder *enc, uint32_t session);
+
+/*!
+ * Encodes the next packet into @p buf, which should be at least
+ * @ref R_UDP_MAX_PACKET_SIZE big. Returns the size of the packet, or zero if
+ * @p size is too small.
+ *
+ * @ingroup drv_remote
+ */
+size_t
+r_udp_encode(struct r_udp_encoder *enc, const struct r_remote_data *data, uint8_t *buf, size_t size);
+
+/*!
+ * Decodes a received packet, returns false if it was dropped in which case
+ * @p out_data is left untouched and the last decoded data still stands.
+ *
+ * @ingroup drv_remote
+ */
+bool
+r_udp_decode(struct r_udp_decoder *dec, const uint8_t *buf, size_t size, struct r_remote_data *out_data);
+
 
 #ifdef __cplusplus
 }
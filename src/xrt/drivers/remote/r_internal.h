@@ -18,6 +18,7 @@
 #include "os/os_threading.h"
 
 #include "util/u_hand_tracking.h"
+#include "util/u_time.h"
 
 
 #ifdef __cplusplus
@@ -46,9 +47,30 @@ struct r_hub
 	//! The latest data received.
 	struct r_remote_data latest;
 
+	//! When @ref latest was received, poses are predicted from it when packets are late over UDP.
+	int64_t latest_ns;
+
 	//! Incoming connection socket.
 	r_socket_t accept_fd;
 
+	//! Is the data received over UDP, set from @p REMOTE_UDP.
+	bool use_udp;
+
+	//! Socket the UDP packets are received on.
+	r_socket_t udp_fd;
+
+	//! Thread receiving the UDP packets.
+	struct os_thread_helper udp_oth;
+
+	//! State for decoding the UDP packets.
+	struct r_udp_decoder udp;
+
+	//! Smoothed time between UDP packets, data older than this has missed a packet.
+	int64_t udp_interval_ns;
+
+	//! Address of the connected TCP peer in network byte order, zero if none, only it may send UDP packets.
+	uint32_t peer_addr;
+
 	uint16_t port;
 	uint32_t view_count;
 
@@ -95,6 +117,13 @@ struct r_device
 };
 
 
+/*!
+ * How far past the latest data poses are predicted when UDP packets are late.
+ *
+ * @ingroup drv_remote
+ */
+#define R_MAX_PREDICTION_NS (100 * U_TIME_1MS_IN_NS)
+
 struct xrt_device *
 r_hmd_create(struct r_hub *r);
 
@@ -0,0 +1,194 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Delta encoding of the remote data for the UDP transport.
+ * @ingroup drv_remote
+ */
+
+#include "r_interface.h"
+
+#include <assert.h>
+#include <string.h>
+
+
+static_assert(sizeof(struct r_remote_data) % sizeof(uint32_t) == 0, "Data must be a whole number of words");
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+//! Is sequence number @p a after @p b, handles wrap around.
+static inline bool
+seq_is_after(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) > 0;
+}
+
+static void
+decoder_reset(struct r_udp_decoder *dec, uint32_t session)
+{
+	dec->have_data = false;
+	dec->have_key = false;
+	dec->session = session;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+void
+r_udp_encoder_init(struct r_udp_encoder *enc, uint32_t session)
+{
+	memset(enc, 0, sizeof(*enc));
+	enc->session = session;
+}
+
+size_t
+r_udp_encode(struct r_udp_encoder *enc, const struct r_remote_data *data, uint8_t *buf, size_t size)
+{
+	if (size < R_UDP_MAX_PACKET_SIZE) {
+		return 0;
+	}
+
+	struct r_udp_packet_header header = {
+	    .header = R_UDP_HEADER_VALUE,
+	    .session = enc->session,
+	    .seq = enc->seq++,
+	};
+
+	uint8_t *ptr = buf + sizeof(header);
+
+	// The first packet of a session is always a keyframe.
+	if (header.seq % R_UDP_KEYFRAME_INTERVAL == 0) {
+		header.key_seq = header.seq;
+		enc->key_seq = header.seq;
+		enc->key = *data;
+
+		memcpy(buf, &header, sizeof(header));
+		memcpy(ptr, data, sizeof(*data));
+
+		return sizeof(header) + sizeof(*data);
+	}
+
+	header.key_seq = enc->key_seq;
+	memcpy(buf, &header, sizeof(header));
+
+	uint32_t words[R_UDP_DATA_WORD_COUNT];
+	uint32_t key_words[R_UDP_DATA_WORD_COUNT];
+	memcpy(words, data, sizeof(words));
+	memcpy(key_words, &enc->key, sizeof(key_words));
+
+	uint32_t mask[R_UDP_MASK_WORD_COUNT] = {0};
+	uint8_t *word_ptr = ptr + sizeof(mask);
+
+	for (uint32_t i = 0; i < R_UDP_DATA_WORD_COUNT; i++) {
+		if (words[i] == key_words[i]) {
+			continue;
+		}
+
+		mask[i / 32] |= 1u << (i % 32);
+		memcpy(word_ptr, &words[i], sizeof(uint32_t));
+		word_ptr += sizeof(uint32_t);
+	}
+
+	memcpy(ptr, mask, sizeof(mask));
+
+	return (size_t)(word_ptr - buf);
+}
+
+bool
+r_udp_decode(struct r_udp_decoder *dec, const uint8_t *buf, size_t size, struct r_remote_data *out_data)
+{
+	struct r_udp_packet_header header;
+
+	if (size < sizeof(header)) {
+		dec->dropped++;
+		return false;
+	}
+
+	memcpy(&header, buf, sizeof(header));
+	if (header.header != R_UDP_HEADER_VALUE) {
+		dec->dropped++;
+		return false;
+	}
+
+	// The sender reconnected.
+	if (header.session != dec->session) {
+		decoder_reset(dec, header.session);
+	}
+
+	// Late or duplicated, a newer packet has already been used.
+	if (dec->have_data && !seq_is_after(header.seq, dec->seq)) {
+		dec->dropped++;
+		return false;
+	}
+
+	const uint8_t *ptr = buf + sizeof(header);
+	size_t payload_size = size - sizeof(header);
+
+	if (header.key_seq == header.seq) {
+		if (payload_size != sizeof(dec->key)) {
+			dec->dropped++;
+			return false;
+		}
+
+		memcpy(&dec->key, ptr, sizeof(dec->key));
+		dec->key_seq = header.seq;
+		dec->have_key = true;
+
+		*out_data = dec->key;
+	} else {
+		uint32_t mask[R_UDP_MASK_WORD_COUNT];
+
+		// Relative to a keyframe that was lost, wait for the next one.
+		if (!dec->have_key || dec->key_seq != header.key_seq || payload_size < sizeof(mask)) {
+			dec->dropped++;
+			return false;
+		}
+
+		memcpy(mask, ptr, sizeof(mask));
+		ptr += sizeof(mask);
+		payload_size -= sizeof(mask);
+
+		uint32_t words[R_UDP_DATA_WORD_COUNT];
+		memcpy(words, &dec->key, sizeof(words));
+
+		size_t word_count = 0;
+		for (uint32_t i = 0; i < R_UDP_DATA_WORD_COUNT; i++) {
+			if ((mask[i / 32] & (1u << (i % 32))) == 0) {
+				continue;
+			}
+			if ((word_count + 1) * sizeof(uint32_t) > payload_size) {
+				dec->dropped++;
+				return false;
+			}
+
+			memcpy(&words[i], ptr + word_count * sizeof(uint32_t), sizeof(uint32_t));
+			word_count++;
+		}
+
+		if (word_count * sizeof(uint32_t) != payload_size) {
+			dec->dropped++;
+			return false;
+		}
+
+		memcpy(out_data, words, sizeof(words));
+	}
+
+	if (dec->have_data) {
+		dec->lost += header.seq - dec->seq - 1;
+	}
+
+	dec->have_data = true;
+	dec->seq = header.seq;
+	dec->received++;
+
+	return true;
+}
@@ -906,6 +906,27 @@ compute_distortion(struct xrt_device *xdev, uint32_t view, float u, float v, str
 	return status;
 }
 
+static bool
+compute_distortion_batch(struct xrt_device *xdev,
+                         uint32_t view,
+                         uint32_t count,
+                         const struct xrt_vec2 *uvs,
+                         struct xrt_uv_triplet *results)
+{
+	struct survive_device *d = (struct survive_device *)xdev;
+	bool status = u_compute_distortion_vive_batch(&d->hmd.config.distortion.values[view], count, uvs, results);
+
+	if (d->hmd.config.variant == VIVE_VARIANT_PRO2) {
+		// Flip Y coordinates
+		for (uint32_t i = 0; i < count; i++) {
+			results[i].r.y = 1.0f - results[i].r.y;
+			results[i].g.y = 1.0f - results[i].g.y;
+			results[i].b.y = 1.0f - results[i].b.y;
+		}
+	}
+	return status;
+}
+
 static bool
 _create_hmd_device(struct survive_system *sys, const struct SurviveSimpleObject *sso, char *conf_str)
 {
@@ -985,6 +1006,7 @@ _create_hmd_device(struct survive_system *sys, const struct SurviveSimpleObject
 	survive->base.hmd->distortion.models = XRT_DISTORTION_MODEL_COMPUTE;
 	survive->base.hmd->distortion.preferred = XRT_DISTORTION_MODEL_COMPUTE;
 	survive->base.compute_distortion = compute_distortion;
+	survive->base.compute_distortion_batch = compute_distortion_batch;
 	survive->base.get_battery_status = survive_device_get_battery_status;
 
 	survive->base.orientation_tracking_supported = true;
@@ -432,6 +432,9 @@ wmr_camera_open(struct wmr_camera_open_config *config)
 		cam->cam_sinks[i] = config->tcam_sinks[i];
 	}
 
+	// Every frame is allocated from the pool, keep returned ones around.
+	u_frame_pool_add_user();
+
 	if (os_thread_helper_init(&cam->usb_thread) != 0) {
 		WMR_CAM_ERROR(cam, "Failed to initialise threading");
 		wmr_camera_free(cam);
@@ -570,6 +573,8 @@ wmr_camera_free(struct wmr_camera *cam)
 	u_sink_debug_destroy(&cam->debug_sinks[WMR_DEBUG_SINK_SLAM]);
 	u_sink_debug_destroy(&cam->debug_sinks[WMR_DEBUG_SINK_CONTROLLER]);
 
+	u_frame_pool_remove_user();
+
 	free(cam);
 }
 
@@ -464,6 +464,9 @@ struct xrt_device
 	 * the lookup (vertex attribute or distortion texture) used to pre-distort the image as required by the device's
 	 * optics.
 	 *
+	 * The compositor may call this from several threads at the same time, so
+	 * it must not modify the device.
+	 *
 	 * @param xdev            the device
 	 * @param view            the view index
 	 * @param u               horizontal texture coordinate
@@ -473,6 +476,34 @@ struct xrt_device
 	bool (*compute_distortion)(
 	    struct xrt_device *xdev, uint32_t view, float u, float v, struct xrt_uv_triplet *out_result);
 
+	/*!
+	 * Compute the distortion at many points at once, optional.
+	 *
+	 * Same as @ref compute_distortion but lets the device hoist the work
+	 * that only depends on the view out of the per-point loop, if not
+	 * implemented @ref compute_distortion is called for each point.
+	 *
+	 * A point that fails doesn't stop the batch, its result is the input
+	 * u,v for all three channels and false is returned once all points
+	 * have been written.
+	 *
+	 * Implementing this opts the device in to being called from several
+	 * threads at once, each with its own range of points, so it must not
+	 * change any device state. Devices that only have
+	 * @ref compute_distortion are always called from one thread.
+	 *
+	 * @param xdev             the device
+	 * @param view             the view index
+	 * @param count            number of points
+	 * @param uvs              @p count u,v pairs in screen/output space.
+	 * @param[out] out_results @p count u,v triplets, one per point.
+	 */
+	bool (*compute_distortion_batch)(struct xrt_device *xdev,
+	                                 uint32_t view,
+	                                 uint32_t count,
+	                                 const struct xrt_vec2 *uvs,
+	                                 struct xrt_uv_triplet *out_results);
+
 	/*!
 	 * Get the visibility mask for this device.
 	 *
@@ -693,6 +724,36 @@ xrt_device_compute_distortion(
 	return xdev->compute_distortion(xdev, view, u, v, out_result);
 }
 
+/*!
+ * Helper function for @ref xrt_device::compute_distortion_batch, falls back
+ * to @ref xrt_device::compute_distortion if the device doesn't implement it.
+ *
+ * @copydoc xrt_device::compute_distortion_batch
+ *
+ * @public @memberof xrt_device
+ */
+static inline bool
+xrt_device_compute_distortion_batch(struct xrt_device *xdev,
+                                    uint32_t view,
+                                    uint32_t count,
+                                    const struct xrt_vec2 *uvs,
+                                    struct xrt_uv_triplet *out_results)
+{
+	if (xdev->compute_distortion_batch != NULL) {
+		return xdev->compute_distortion_batch(xdev, view, count, uvs, out_results);
+	}
+
+	bool success = true;
+	for (uint32_t i = 0; i < count; i++) {
+		if (!xdev->compute_distortion(xdev, view, uvs[i].x, uvs[i].y, &out_results[i])) {
+			out_results[i].r = out_results[i].g = out_results[i].b = uvs[i];
+			success = false;
+		}
+	}
+
+	return success;
+}
+
 /*!
  * Helper function for @ref xrt_device::get_visibility_mask.
  *
@@ -161,6 +161,13 @@ struct ipc_connection
 
 	struct os_mutex mutex;
 
+	/*!
+	 * Slot of this client in the service, used to index per client data
+	 * in the shared memory. Set when describing the client, out of range
+	 * until then.
+	 */
+	uint32_t client_slot;
+
 #ifdef XRT_OS_ANDROID
 	struct ipc_client_android *ica;
 #endif // XRT_OS_ANDROID
@@ -199,6 +206,22 @@ ipc_client_xdev(struct xrt_device *xdev)
 	return (struct ipc_client_xdev *)xdev;
 }
 
+/*!
+ * Is IO active for this client, as toggled from the service. False if the
+ * client doesn't know its slot, it never described itself.
+ *
+ * @ingroup ipc_client
+ */
+static inline bool
+ipc_client_connection_is_io_active(struct ipc_connection *ipc_c)
+{
+	if (ipc_c->client_slot >= IPC_MAX_CLIENTS) {
+		return false;
+	}
+
+	return ipc_c->ism->client_io_active[ipc_c->client_slot];
+}
+
 /*!
  * Create an IPC client system compositor.
  *
@@ -236,6 +259,63 @@ ipc_client_create_native_compositor(struct xrt_system_compositor *xsysc,
                                     const struct xrt_session_info *xsi,
                                     struct xrt_compositor_native **out_xcn);
 
+/*!
+ * Try to get the pose from the pose ring in the shared memory instead of
+ * asking the service, see @ref ipc_shared_pose_ring.
+ *
+ * @return true if @p out_xret and @p out_relation have been set, false if
+ *         the caller needs to ask the service.
+ * @ingroup ipc_client
+ */
+bool
+ipc_client_xdev_get_tracked_pose_from_ring(struct ipc_client_xdev *icx,
+                                           enum xrt_input_name name,
+                                           int64_t at_timestamp_ns,
+                                           struct xrt_space_relation *out_relation,
+                                           xrt_result_t *out_xret);
+
+/*!
+ * Try to get the hand joints from the hand ring in the shared memory instead
+ * of asking the service, see @ref ipc_shared_hand_ring.
+ *
+ * @return true if the outputs have been set, false if the caller needs to
+ *         ask the service.
+ * @ingroup ipc_client
+ */
+bool
+ipc_client_xdev_get_hand_tracking_from_ring(struct ipc_client_xdev *icx,
+                                            enum xrt_input_name name,
+                                            int64_t at_timestamp_ns,
+                                            struct xrt_hand_joint_set *out_value,
+                                            int64_t *out_timestamp_ns);
+
+/*!
+ * Try to get the view poses from the shared memory instead of asking the
+ * service, the head relation comes from the head pose ring.
+ *
+ * @return true if the outputs have been set, false if the caller needs to
+ *         ask the service.
+ * @ingroup ipc_client
+ */
+bool
+ipc_client_xdev_get_view_poses_from_ring(struct ipc_client_xdev *icx,
+                                         const struct xrt_vec3 *default_eye_relation,
+                                         int64_t at_timestamp_ns,
+                                         uint32_t view_count,
+                                         struct xrt_space_relation *out_head_relation,
+                                         struct xrt_fov *out_fovs,
+                                         struct xrt_pose *out_poses);
+
+/*!
+ * Update the inputs of the device from the input snapshot in the shared
+ * memory, only asking the service if the snapshot is not being published,
+ * see @ref ipc_shared_input_snapshot.
+ *
+ * @ingroup ipc_client
+ */
+xrt_result_t
+ipc_client_xdev_update_inputs(struct ipc_client_xdev *icx);
+
 struct xrt_device *
 ipc_client_hmd_create(struct ipc_connection *ipc_c, struct xrt_tracking_origin *xtrack, uint32_t device_id);
 
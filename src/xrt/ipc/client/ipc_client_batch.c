@@ -0,0 +1,140 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Sending several calls in one message.
+ * @ingroup ipc_client
+ */
+
+#include "client/ipc_client.h"
+#include "client/ipc_client_connection.h"
+#include "ipc_client_generated.h"
+
+#include <string.h>
+
+
+xrt_result_t
+ipc_client_batch_add(struct ipc_client_batch *batch,
+                     const void *msg,
+                     size_t msg_size,
+                     void *const *outs,
+                     const xrt_graphics_sync_handle_t *handles,
+                     uint32_t handle_count)
+{
+	struct ipc_batch_msg *bmsg = &batch->msg;
+
+	ipc_command_t cmd;
+	memcpy(&cmd, msg, sizeof(cmd));
+
+	uint32_t index = bmsg->call_count;
+	size_t reply_size = ipc_batch_call_reply_size(cmd);
+
+	if (index >= IPC_BATCH_MAX_CALLS ||                           //
+	    reply_size == 0 ||                                        //
+	    bmsg->msg_size + msg_size > IPC_BATCH_MAX_MSG_SIZE ||     //
+	    bmsg->reply_size + reply_size > IPC_BATCH_MAX_REPLY_SIZE) {
+		U_LOG_E("Batch full or call '%s' can't be batched!", ipc_cmd_to_str(cmd));
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	if (handle_count > 0) {
+		// They are sent with the whole batch, one call gets them.
+		if (bmsg->handle_count > 0) {
+			U_LOG_E("Only one call with handles per batch!");
+			return XRT_ERROR_IPC_FAILURE;
+		}
+
+		batch->handles = handles;
+		bmsg->handle_count = handle_count;
+	}
+
+	bmsg->cmd = IPC_BATCH;
+	memcpy(&bmsg->msgs[bmsg->msg_size], msg, msg_size);
+	bmsg->msg_size += (uint32_t)msg_size;
+	bmsg->reply_size += (uint32_t)reply_size;
+	bmsg->call_count++;
+
+	batch->calls[index].cmd = cmd;
+	memcpy(batch->calls[index].outs, outs, sizeof(batch->calls[index].outs));
+	batch->calls[index].result = XRT_SUCCESS;
+
+	return XRT_SUCCESS;
+}
+
+xrt_result_t
+ipc_client_batch_submit(struct ipc_connection *ipc_c, struct ipc_client_batch *batch)
+{
+	struct ipc_batch_msg *bmsg = &batch->msg;
+	uint8_t replies[IPC_BATCH_MAX_REPLY_SIZE];
+	xrt_result_t xret;
+
+	if (bmsg->call_count == 0) {
+		return XRT_SUCCESS;
+	}
+
+	IPC_TRACE(ipc_c, "Calling batch of %u calls", bmsg->call_count);
+
+	// Other threads must not read/write the fd while we wait for reply
+	ipc_client_connection_lock(ipc_c);
+
+	xret = ipc_send(&ipc_c->imc, bmsg, sizeof(*bmsg));
+	if (xret != XRT_SUCCESS) {
+		goto out;
+	}
+
+	if (bmsg->handle_count > 0) {
+		struct ipc_result_reply _sync = {0};
+		struct ipc_command_msg _handle_msg = {
+		    .cmd = IPC_BATCH,
+		};
+
+		// Wait for server sync, same as a single call.
+		xret = ipc_receive(&ipc_c->imc, &_sync, sizeof(_sync));
+		if (xret != XRT_SUCCESS) {
+			goto out;
+		}
+
+		xret = ipc_send_handles_graphics_sync( //
+		    &ipc_c->imc,                       //
+		    &_handle_msg,                      //
+		    sizeof(_handle_msg),               //
+		    batch->handles,                    //
+		    bmsg->handle_count);               //
+		if (xret != XRT_SUCCESS) {
+			goto out;
+		}
+	}
+
+	// All of the replies come in one message.
+	xret = ipc_receive(&ipc_c->imc, replies, bmsg->reply_size);
+	if (xret != XRT_SUCCESS) {
+		goto out;
+	}
+
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i < bmsg->call_count; i++) {
+		ipc_command_t cmd = batch->calls[i].cmd;
+
+		xrt_result_t result = ipc_batch_unpack_reply(cmd, &replies[offset], batch->calls[i].outs);
+		batch->calls[i].result = result;
+		offset += (uint32_t)ipc_batch_call_reply_size(cmd);
+
+		if (result != XRT_SUCCESS && xret == XRT_SUCCESS) {
+			xret = result;
+		}
+	}
+
+	ipc_client_connection_unlock(ipc_c);
+
+	return xret;
+
+out:
+	ipc_client_connection_unlock(ipc_c);
+
+	// None of the calls got a reply, they all failed.
+	for (uint32_t i = 0; i < bmsg->call_count; i++) {
+		batch->calls[i].result = xret;
+	}
+
+	return xret;
+}
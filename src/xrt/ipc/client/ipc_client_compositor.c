@@ -18,11 +18,13 @@
 
 #include "util/u_misc.h"
 #include "util/u_wait.h"
+#include "util/u_debug.h"
 #include "util/u_handles.h"
 #include "util/u_trace_marker.h"
 #include "util/u_limited_unique_id.h"
 
 #include "shared/ipc_protocol.h"
+#include "shared/ipc_swapchain_queue.h"
 #include "client/ipc_client.h"
 #include "ipc_client_generated.h"
 
@@ -50,6 +52,12 @@
 //! Define to test the loopback allocator.
 #undef IPC_USE_LOOPBACK_IMAGE_ALLOCATOR
 
+/*!
+ * Acquire and release swapchain images through the queues in the shared
+ * memory area, false makes every call a round trip to the service.
+ */
+DEBUG_GET_ONCE_BOOL_OPTION(swapchain_queue, "IPC_SWAPCHAIN_QUEUE", true)
+
 /*!
  * Client proxy for an xrt_compositor_native implementation over IPC.
  * @implements xrt_compositor_native
@@ -80,6 +88,18 @@ struct ipc_client_compositor
 	//! To get better wake up in wait frame.
 	struct os_precise_sleeper sleeper;
 
+	/*!
+	 * The woke call from wait frame, it isn't sent right away but batched
+	 * with the next frame call, normally begin frame. The frame calls are
+	 * serialized by the app so no lock is needed.
+	 */
+	struct
+	{
+		bool pending;
+		int64_t frame_id;
+		int64_t time_ns;
+	} woke;
+
 #ifdef IPC_USE_LOOPBACK_IMAGE_ALLOCATOR
 	//! To test image allocator.
 	struct xrt_image_native_allocator loopback_xina;
@@ -97,6 +117,9 @@ struct ipc_client_swapchain
 	struct ipc_client_compositor *icc;
 
 	uint32_t id;
+
+	//! Image queue in the shared memory area, NULL if not used.
+	struct ipc_shared_swapchain_queue *queue;
 };
 
 /*!
@@ -119,6 +142,54 @@ struct ipc_client_compositor_semaphore
  *
  */
 
+/*!
+ * Start a batch with the pending woke call, returns false if there is none
+ * and the caller should do a plain call instead.
+ */
+static bool
+begin_batch_with_woke(struct ipc_client_compositor *icc, struct ipc_client_batch *batch)
+{
+	if (!icc->woke.pending) {
+		return false;
+	}
+
+	icc->woke.pending = false;
+
+	U_ZERO(batch);
+	xrt_result_t xret = ipc_batch_add_compositor_wait_woke(batch, icc->woke.frame_id, icc->woke.time_ns);
+	IPC_CHK_ONLY_PRINT(icc->ipc_c, xret, "ipc_batch_add_compositor_wait_woke");
+
+	return true;
+}
+
+/*!
+ * Send a batch started with @ref begin_batch_with_woke and one more call
+ * added, returns the result of that call. An error from the woke call is
+ * only printed, same as when it is sent on its own.
+ */
+static xrt_result_t
+submit_batch_with_woke(struct ipc_client_compositor *icc, struct ipc_client_batch *batch)
+{
+	(void)ipc_client_batch_submit(icc->ipc_c, batch);
+
+	IPC_CHK_ONLY_PRINT(icc->ipc_c, batch->calls[0].result, "ipc_call_compositor_wait_woke");
+
+	return batch->calls[1].result;
+}
+
+//! Send the pending woke call on its own, if any.
+static void
+flush_woke(struct ipc_client_compositor *icc)
+{
+	struct ipc_client_batch batch;
+	if (!begin_batch_with_woke(icc, &batch)) {
+		return;
+	}
+
+	xrt_result_t xret = ipc_client_batch_submit(icc->ipc_c, &batch);
+	IPC_CHK_ONLY_PRINT(icc->ipc_c, xret, "ipc_client_batch_submit");
+}
+
 static inline struct ipc_client_compositor *
 ipc_client_compositor(struct xrt_compositor *xc)
 {
@@ -137,6 +208,23 @@ ipc_client_compositor_semaphore(struct xrt_compositor_semaphore *xcsem)
 	return (struct ipc_client_compositor_semaphore *)xcsem;
 }
 
+static struct ipc_shared_swapchain_queue *
+get_swapchain_queue(struct ipc_client_compositor *icc, uint32_t queue_index, uint32_t image_count)
+{
+	if (!debug_get_bool_option_swapchain_queue() || queue_index >= IPC_MAX_CLIENTS * IPC_MAX_CLIENT_SWAPCHAINS) {
+		return NULL;
+	}
+
+	struct ipc_shared_swapchain_queue *queue = &icc->ipc_c->ism->swapchain_queues[queue_index];
+
+	// The service sets the queue up before replying.
+	if (ipc_seqlock_load_acquire(&queue->image_count) != image_count) {
+		return NULL;
+	}
+
+	return queue;
+}
+
 
 /*
  *
@@ -182,6 +270,21 @@ ipc_compositor_swapchain_destroy(struct xrt_swapchain *xsc)
 	free(xsc);
 }
 
+/*!
+ * The service replays the queue on every wait and layer sync, so this only
+ * makes a round trip when the client acquires and releases many times
+ * without either.
+ */
+static xrt_result_t
+replay_swapchain_queue_if_full(struct ipc_client_swapchain *ics)
+{
+	if (!ipc_swapchain_queue_needs_replay(ics->queue)) {
+		return XRT_SUCCESS;
+	}
+
+	return ipc_call_swapchain_replay_queue(ics->icc->ipc_c, ics->id);
+}
+
 static xrt_result_t
 ipc_compositor_swapchain_wait_image(struct xrt_swapchain *xsc, int64_t timeout_ns, uint32_t index)
 {
@@ -189,6 +292,10 @@ ipc_compositor_swapchain_wait_image(struct xrt_swapchain *xsc, int64_t timeout_n
 	struct ipc_client_compositor *icc = ics->icc;
 	xrt_result_t xret;
 
+	/*
+	 * Even with a queue, only the service knows when the compositor is
+	 * done with the image. The service replays the queue first.
+	 */
 	xret = ipc_call_swapchain_wait_image(icc->ipc_c, ics->id, timeout_ns, index);
 	IPC_CHK_ALWAYS_RET(icc->ipc_c, xret, "ipc_call_swapchain_wait_image");
 }
@@ -200,6 +307,13 @@ ipc_compositor_swapchain_acquire_image(struct xrt_swapchain *xsc, uint32_t *out_
 	struct ipc_client_compositor *icc = ics->icc;
 	xrt_result_t xret;
 
+	if (ics->queue != NULL) {
+		xret = replay_swapchain_queue_if_full(ics);
+		IPC_CHK_AND_RET(icc->ipc_c, xret, "ipc_call_swapchain_replay_queue");
+
+		return ipc_swapchain_queue_acquire(ics->queue, out_index);
+	}
+
 	xret = ipc_call_swapchain_acquire_image(icc->ipc_c, ics->id, out_index);
 	IPC_CHK_ALWAYS_RET(icc->ipc_c, xret, "ipc_call_swapchain_acquire_image");
 }
@@ -211,6 +325,13 @@ ipc_compositor_swapchain_release_image(struct xrt_swapchain *xsc, uint32_t index
 	struct ipc_client_compositor *icc = ics->icc;
 	xrt_result_t xret;
 
+	if (ics->queue != NULL) {
+		xret = replay_swapchain_queue_if_full(ics);
+		IPC_CHK_AND_RET(icc->ipc_c, xret, "ipc_call_swapchain_replay_queue");
+
+		return ipc_swapchain_queue_release(ics->queue, index);
+	}
+
 	xret = ipc_call_swapchain_release_image(icc->ipc_c, ics->id, index);
 	IPC_CHK_ALWAYS_RET(icc->ipc_c, xret, "ipc_call_swapchain_release_image");
 }
@@ -278,6 +399,7 @@ swapchain_server_create(struct ipc_client_compositor *icc,
 	uint32_t image_count;
 	uint64_t size;
 	bool use_dedicated_allocation;
+	uint32_t queue_index;
 
 	xret = ipc_call_swapchain_create( //
 	    icc->ipc_c,                   // connection
@@ -286,6 +408,7 @@ swapchain_server_create(struct ipc_client_compositor *icc,
 	    &image_count,                 // out
 	    &size,                        // out
 	    &use_dedicated_allocation,    // out
+	    &queue_index,                 // out
 	    remote_handles,               // handles
 	    XRT_MAX_SWAPCHAIN_IMAGES);    // handles
 	IPC_CHK_AND_RET(icc->ipc_c, xret, "ipc_call_swapchain_create");
@@ -300,6 +423,7 @@ swapchain_server_create(struct ipc_client_compositor *icc,
 	ics->base.limited_unique_id = u_limited_unique_id_get();
 	ics->icc = icc;
 	ics->id = handle;
+	ics->queue = get_swapchain_queue(icc, queue_index, image_count);
 
 	for (uint32_t i = 0; i < image_count; i++) {
 		ics->base.images[i].handle = remote_handles[i];
@@ -323,6 +447,7 @@ swapchain_server_import(struct ipc_client_compositor *icc,
 	xrt_graphics_buffer_handle_t handles[XRT_MAX_SWAPCHAIN_IMAGES] = {0};
 	xrt_result_t xret;
 	uint32_t id = 0;
+	uint32_t queue_index = 0;
 
 	for (uint32_t i = 0; i < image_count; i++) {
 		handles[i] = native_images[i].handle;
@@ -344,7 +469,8 @@ swapchain_server_import(struct ipc_client_compositor *icc,
 	    &args,                        // in
 	    handles,                      // handles
 	    image_count,                  // handles
-	    &id);                         // out
+	    &id,                          // out
+	    &queue_index);                // out
 	IPC_CHK_AND_RET(icc->ipc_c, xret, "ipc_call_swapchain_create");
 
 	struct ipc_client_swapchain *ics = U_TYPED_CALLOC(struct ipc_client_swapchain);
@@ -357,6 +483,7 @@ swapchain_server_import(struct ipc_client_compositor *icc,
 	ics->base.limited_unique_id = u_limited_unique_id_get();
 	ics->icc = icc;
 	ics->id = id;
+	ics->queue = get_swapchain_queue(icc, queue_index, image_count);
 
 	// The handles were copied in the IPC call so we can reuse them here.
 	for (uint32_t i = 0; i < image_count; i++) {
@@ -515,6 +642,9 @@ ipc_compositor_end_session(struct xrt_compositor *xc)
 
 	IPC_TRACE(icc->ipc_c, "Compositor end session.");
 
+	// Keep the frame timing complete.
+	flush_woke(icc);
+
 	xret = ipc_call_session_end(icc->ipc_c);
 	IPC_CHK_ALWAYS_RET(icc->ipc_c, xret, "ipc_call_session_end");
 }
@@ -534,6 +664,9 @@ ipc_compositor_wait_frame(struct xrt_compositor *xc,
 	int64_t predicted_display_time = 0;
 	int64_t predicted_display_period = 0;
 
+	// Only if the app waited again without beginning the frame.
+	flush_woke(icc);
+
 	xret = ipc_call_compositor_predict_frame( //
 	    icc->ipc_c,                           // Connection
 	    &frame_id,                            // Frame id
@@ -545,9 +678,10 @@ ipc_compositor_wait_frame(struct xrt_compositor *xc,
 	// Wait until the given wake up time.
 	u_wait_until(&icc->sleeper, wake_up_time_ns);
 
-	// Signal that we woke up.
-	xret = ipc_call_compositor_wait_woke(icc->ipc_c, frame_id);
-	IPC_CHK_AND_RET(icc->ipc_c, xret, "ipc_call_compositor_wait_woke");
+	// Signal that we woke up, sent with the next frame call to save a round trip.
+	icc->woke.pending = true;
+	icc->woke.frame_id = frame_id;
+	icc->woke.time_ns = os_monotonic_get_ns();
 
 	// Only write arguments once we have fully waited.
 	*out_frame_id = frame_id;
@@ -563,6 +697,15 @@ ipc_compositor_begin_frame(struct xrt_compositor *xc, int64_t frame_id)
 	struct ipc_client_compositor *icc = ipc_client_compositor(xc);
 	xrt_result_t xret;
 
+	struct ipc_client_batch batch;
+	if (begin_batch_with_woke(icc, &batch)) {
+		xret = ipc_batch_add_compositor_begin_frame(&batch, frame_id);
+		if (xret == XRT_SUCCESS) {
+			xret = submit_batch_with_woke(icc, &batch);
+		}
+		IPC_CHK_ALWAYS_RET(icc->ipc_c, xret, "ipc_call_compositor_begin_frame");
+	}
+
 	xret = ipc_call_compositor_begin_frame(icc->ipc_c, frame_id);
 	IPC_CHK_ALWAYS_RET(icc->ipc_c, xret, "ipc_call_compositor_begin_frame");
 }
@@ -747,12 +890,26 @@ ipc_compositor_layer_commit(struct xrt_compositor *xc, xrt_graphics_sync_handle_
 	// Last bit of data to put in the shared memory area.
 	slot->layer_count = icc->layers.layer_count;
 
-	xret = ipc_call_compositor_layer_sync( //
-	    icc->ipc_c,                        //
-	    icc->layers.slot_id,               //
-	    &sync_handle,                      //
-	    valid_sync ? 1 : 0,                //
-	    &icc->layers.slot_id);             //
+	struct ipc_client_batch batch;
+	if (begin_batch_with_woke(icc, &batch)) {
+		// The sync handle is sent with the batch.
+		xret = ipc_batch_add_compositor_layer_sync( //
+		    &batch,                                 //
+		    icc->layers.slot_id,                    //
+		    &sync_handle,                           //
+		    valid_sync ? 1 : 0,                     //
+		    &icc->layers.slot_id);                  //
+		if (xret == XRT_SUCCESS) {
+			xret = submit_batch_with_woke(icc, &batch);
+		}
+	} else {
+		xret = ipc_call_compositor_layer_sync( //
+		    icc->ipc_c,                        //
+		    icc->layers.slot_id,               //
+		    &sync_handle,                      //
+		    valid_sync ? 1 : 0,                //
+		    &icc->layers.slot_id);             //
+	}
 
 	/*
 	 * We are probably in a really bad state if we fail, at
@@ -786,12 +943,25 @@ ipc_compositor_layer_commit_with_semaphore(struct xrt_compositor *xc,
 	// Last bit of data to put in the shared memory area.
 	slot->layer_count = icc->layers.layer_count;
 
-	xret = ipc_call_compositor_layer_sync_with_semaphore( //
-	    icc->ipc_c,                                       //
-	    icc->layers.slot_id,                              //
-	    iccs->id,                                         //
-	    value,                                            //
-	    &icc->layers.slot_id);                            //
+	struct ipc_client_batch batch;
+	if (begin_batch_with_woke(icc, &batch)) {
+		xret = ipc_batch_add_compositor_layer_sync_with_semaphore( //
+		    &batch,                                                //
+		    icc->layers.slot_id,                                   //
+		    iccs->id,                                              //
+		    value,                                                 //
+		    &icc->layers.slot_id);                                 //
+		if (xret == XRT_SUCCESS) {
+			xret = submit_batch_with_woke(icc, &batch);
+		}
+	} else {
+		xret = ipc_call_compositor_layer_sync_with_semaphore( //
+		    icc->ipc_c,                                       //
+		    icc->layers.slot_id,                              //
+		    iccs->id,                                         //
+		    value,                                            //
+		    &icc->layers.slot_id);                            //
+	}
 
 	/*
 	 * We are probably in a really bad state if we fail, at
@@ -811,6 +981,15 @@ ipc_compositor_discard_frame(struct xrt_compositor *xc, int64_t frame_id)
 	struct ipc_client_compositor *icc = ipc_client_compositor(xc);
 	xrt_result_t xret;
 
+	struct ipc_client_batch batch;
+	if (begin_batch_with_woke(icc, &batch)) {
+		xret = ipc_batch_add_compositor_discard_frame(&batch, frame_id);
+		if (xret == XRT_SUCCESS) {
+			xret = submit_batch_with_woke(icc, &batch);
+		}
+		IPC_CHK_ALWAYS_RET(icc->ipc_c, xret, "ipc_call_compositor_discard_frame");
+	}
+
 	xret = ipc_call_compositor_discard_frame(icc->ipc_c, frame_id);
 	IPC_CHK_ALWAYS_RET(icc->ipc_c, xret, "ipc_call_compositor_discard_frame");
 }
@@ -319,12 +319,15 @@ ipc_client_describe_client(struct ipc_connection *ipc_c, const struct xrt_applic
 	desc.info = *a_info;
 	desc.pid = pid; // Extra info.
 
-	xrt_result_t xret = ipc_call_instance_describe_client(ipc_c, &desc);
+	uint32_t slot = UINT32_MAX;
+	xrt_result_t xret = ipc_call_instance_describe_client(ipc_c, &desc, &slot);
 	if (xret != XRT_SUCCESS) {
 		IPC_ERROR(ipc_c, "Failed to set instance description!");
 		return xret;
 	}
 
+	ipc_c->client_slot = slot;
+
 	return XRT_SUCCESS;
 }
 
@@ -346,6 +349,7 @@ ipc_client_connection_init(struct ipc_connection *ipc_c,
 	ipc_c->imc.ipc_handle = XRT_IPC_HANDLE_INVALID;
 	ipc_c->imc.log_level = log_level;
 	ipc_c->ism_handle = XRT_SHMEM_HANDLE_INVALID;
+	ipc_c->client_slot = UINT32_MAX;
 
 	// Must be done first.
 	int ret = os_mutex_init(&ipc_c->mutex);
@@ -65,8 +65,7 @@ ipc_client_device_destroy(struct xrt_device *xdev)
 	// Remove the variable tracking.
 	u_var_remove_root(icd);
 
-	// We do not own these, so don't free them.
-	icd->base.inputs = NULL;
+	// Inputs are allocated with the device, we do not own the outputs.
 	icd->base.outputs = NULL;
 
 	// Free this device with the helper.
@@ -78,8 +77,7 @@ ipc_client_device_update_inputs(struct xrt_device *xdev)
 {
 	ipc_client_device_t *icd = ipc_client_device(xdev);
 
-	xrt_result_t xret = ipc_call_device_update_input(icd->ipc_c, icd->device_id);
-	IPC_CHK_ALWAYS_RET(icd->ipc_c, xret, "ipc_call_device_update_input");
+	return ipc_client_xdev_update_inputs(icd);
 }
 
 static xrt_result_t
@@ -90,12 +88,17 @@ ipc_client_device_get_tracked_pose(struct xrt_device *xdev,
 {
 	ipc_client_device_t *icd = ipc_client_device(xdev);
 
-	xrt_result_t xret = ipc_call_device_get_tracked_pose( //
-	    icd->ipc_c,                                       //
-	    icd->device_id,                                   //
-	    name,                                             //
-	    at_timestamp_ns,                                  //
-	    out_relation);                                    //
+	xrt_result_t xret = XRT_SUCCESS;
+	if (ipc_client_xdev_get_tracked_pose_from_ring(icd, name, at_timestamp_ns, out_relation, &xret)) {
+		return xret;
+	}
+
+	xret = ipc_call_device_get_tracked_pose( //
+	    icd->ipc_c,                          //
+	    icd->device_id,                      //
+	    name,                                //
+	    at_timestamp_ns,                     //
+	    out_relation);                       //
 	IPC_CHK_ALWAYS_RET(icd->ipc_c, xret, "ipc_call_device_get_tracked_pose");
 }
 
@@ -108,6 +111,10 @@ ipc_client_device_get_hand_tracking(struct xrt_device *xdev,
 {
 	ipc_client_device_t *icd = ipc_client_device(xdev);
 
+	if (ipc_client_xdev_get_hand_tracking_from_ring(icd, name, at_timestamp_ns, out_value, out_timestamp_ns)) {
+		return;
+	}
+
 	xrt_result_t xret = ipc_call_device_get_hand_tracking( //
 	    icd->ipc_c,                                        //
 	    icd->device_id,                                    //
@@ -211,7 +218,7 @@ ipc_client_device_create(struct ipc_connection *ipc_c, struct xrt_tracking_origi
 
 	// Allocate and setup the basics.
 	enum u_device_alloc_flags flags = (enum u_device_alloc_flags)(U_DEVICE_ALLOC_HMD);
-	ipc_client_device_t *icd = U_DEVICE_ALLOCATE(ipc_client_device_t, flags, 0, 0);
+	ipc_client_device_t *icd = U_DEVICE_ALLOCATE(ipc_client_device_t, flags, isdev->input_count, 0);
 	icd->ipc_c = ipc_c;
 	icd->base.update_inputs = ipc_client_device_update_inputs;
 	icd->base.get_tracked_pose = ipc_client_device_get_tracked_pose;
@@ -233,10 +240,12 @@ ipc_client_device_create(struct ipc_connection *ipc_c, struct xrt_tracking_origi
 	snprintf(icd->base.str, XRT_DEVICE_NAME_LEN, "%s", isdev->str);
 	snprintf(icd->base.serial, XRT_DEVICE_NAME_LEN, "%s", isdev->serial);
 
-	// Setup inputs, by pointing directly to the shared memory.
+	// Setup inputs, our own copy updated from the input snapshot.
 	assert(isdev->input_count > 0);
-	icd->base.inputs = &ism->inputs[isdev->first_input_index];
 	icd->base.input_count = isdev->input_count;
+	for (uint32_t i = 0; i < isdev->input_count; i++) {
+		icd->base.inputs[i].name = ism->inputs[isdev->first_input_index + i].name;
+	}
 
 	// Setup outputs, if any point directly into the shared memory.
 	icd->base.output_count = isdev->output_count;
@@ -282,5 +291,9 @@ ipc_client_device_create(struct ipc_connection *ipc_c, struct xrt_tracking_origi
 	icd->base.stage_supported = isdev->stage_supported;
 
 	icd->base.device_type = isdev->device_type;
+
+	// Initial state of the inputs, errors are logged by the function.
+	ipc_client_xdev_update_inputs(icd);
+
 	return &icd->base;
 }
@@ -132,8 +132,7 @@ ipc_client_hmd_destroy(struct xrt_device *xdev)
 	// Remove the variable tracking.
 	u_var_remove_root(ich);
 
-	// We do not own these, so don't free them.
-	ich->base.inputs = NULL;
+	// Inputs are allocated with the device, we do not own the outputs.
 	ich->base.outputs = NULL;
 
 	// Free this device with the helper.
@@ -145,8 +144,7 @@ ipc_client_hmd_update_inputs(struct xrt_device *xdev)
 {
 	ipc_client_hmd_t *ich = ipc_client_hmd(xdev);
 
-	xrt_result_t xret = ipc_call_device_update_input(ich->ipc_c, ich->device_id);
-	IPC_CHK_ALWAYS_RET(ich->ipc_c, xret, "ipc_call_device_update_input");
+	return ipc_client_xdev_update_inputs(ich);
 }
 
 static xrt_result_t
@@ -158,6 +156,10 @@ ipc_client_hmd_get_tracked_pose(struct xrt_device *xdev,
 	ipc_client_hmd_t *ich = ipc_client_hmd(xdev);
 	xrt_result_t xret;
 
+	if (ipc_client_xdev_get_tracked_pose_from_ring(ich, name, at_timestamp_ns, out_relation, &xret)) {
+		return xret;
+	}
+
 	xret = ipc_call_device_get_tracked_pose( //
 	    ich->ipc_c,                          //
 	    ich->device_id,                      //
@@ -181,6 +183,17 @@ ipc_client_hmd_get_view_poses(struct xrt_device *xdev,
 
 	struct ipc_info_get_view_poses_2 info = {0};
 
+	if (ipc_client_xdev_get_view_poses_from_ring( //
+	        ich,                                  //
+	        default_eye_relation,                 //
+	        at_timestamp_ns,                      //
+	        view_count,                           //
+	        out_head_relation,                    //
+	        out_fovs,                             //
+	        out_poses)) {                         //
+		return;
+	}
+
 	if (view_count == 2) {
 		// Fast path.
 		xret = ipc_call_device_get_view_poses_2( //
@@ -324,7 +337,7 @@ ipc_client_hmd_create(struct ipc_connection *ipc_c, struct xrt_tracking_origin *
 
 
 	enum u_device_alloc_flags flags = (enum u_device_alloc_flags)(U_DEVICE_ALLOC_HMD);
-	ipc_client_hmd_t *ich = U_DEVICE_ALLOCATE(ipc_client_hmd_t, flags, 0, 0);
+	ipc_client_hmd_t *ich = U_DEVICE_ALLOCATE(ipc_client_hmd_t, flags, isdev->input_count, 0);
 	ich->ipc_c = ipc_c;
 	ich->device_id = device_id;
 	ich->base.update_inputs = ipc_client_hmd_update_inputs;
@@ -345,10 +358,12 @@ ipc_client_hmd_create(struct ipc_connection *ipc_c, struct xrt_tracking_origin *
 	snprintf(ich->base.str, XRT_DEVICE_NAME_LEN, "%s", isdev->str);
 	snprintf(ich->base.serial, XRT_DEVICE_NAME_LEN, "%s", isdev->serial);
 
-	// Setup inputs, by pointing directly to the shared memory.
+	// Setup inputs, our own copy updated from the input snapshot.
 	assert(isdev->input_count > 0);
-	ich->base.inputs = &ism->inputs[isdev->first_input_index];
 	ich->base.input_count = isdev->input_count;
+	for (uint32_t i = 0; i < isdev->input_count; i++) {
+		ich->base.inputs[i].name = ism->inputs[isdev->first_input_index + i].name;
+	}
 
 #if 0
 	// Setup info.
@@ -397,5 +412,8 @@ ipc_client_hmd_create(struct ipc_connection *ipc_c, struct xrt_tracking_origin *
 	ich->base.stage_supported = isdev->stage_supported;
 	ich->base.battery_status_supported = isdev->battery_status_supported;
 
+	// Initial state of the inputs, errors are logged by the function.
+	ipc_client_xdev_update_inputs(ich);
+
 	return &ich->base;
 }
@@ -0,0 +1,79 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Reading inputs from the shared memory input snapshots.
+ * @ingroup ipc_client
+ */
+
+#include "xrt/xrt_device.h"
+
+#include "os/os_time.h"
+
+#include "util/u_debug.h"
+
+#include "shared/ipc_input_snapshot.h"
+#include "client/ipc_client.h"
+#include "ipc_client_generated.h"
+
+
+/*
+ *
+ * Defines and helpers.
+ *
+ */
+
+DEBUG_GET_ONCE_BOOL_OPTION(input_snapshot, "IPC_INPUT_SNAPSHOT", true)
+
+/*!
+ * How many publish periods a snapshot can miss before the client asks the
+ * service instead, covers the service thread being scheduled late.
+ */
+#define MAX_MISSED_PERIODS (4)
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+xrt_result_t
+ipc_client_xdev_update_inputs(struct ipc_client_xdev *icx)
+{
+	struct ipc_connection *ipc_c = icx->ipc_c;
+	struct ipc_shared_memory *ism = ipc_c->ism;
+
+	if (icx->device_id >= XRT_SYSTEM_MAX_DEVICES) {
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	struct ipc_shared_device *isdev = &ism->isdevs[icx->device_id];
+	struct ipc_shared_input_snapshot *snap = &ism->input_snapshots[icx->device_id];
+	const struct xrt_input *src = &ism->inputs[isdev->first_input_index];
+	uint32_t input_count = icx->base.input_count;
+	bool client_io_active = ipc_client_connection_is_io_active(ipc_c);
+
+	int64_t period_ns = ism->pose_ring_period_ns;
+	if (period_ns > 0 && debug_get_bool_option_input_snapshot()) {
+		int64_t now_ns = os_monotonic_get_ns();
+		int64_t max_age_ns = period_ns * MAX_MISSED_PERIODS;
+
+		if (ipc_input_snapshot_read(snap, src, input_count, now_ns, max_age_ns, client_io_active,
+		                            icx->base.inputs)) {
+			return XRT_SUCCESS;
+		}
+	}
+
+	// Not published or stale, this makes the service update the snapshot.
+	xrt_result_t xret = ipc_call_device_update_input(ipc_c, icx->device_id);
+	IPC_CHK_AND_RET(ipc_c, xret, "ipc_call_device_update_input");
+
+	// Just updated, so it can't be too old.
+	if (!ipc_input_snapshot_read(snap, src, input_count, 0, INT64_MAX, client_io_active, icx->base.inputs)) {
+		IPC_ERROR(ipc_c, "Failed to read the input snapshot of device %u", icx->device_id);
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	return XRT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Reading poses and hand joints from the shared memory rings.
+ * @ingroup ipc_client
+ */
+
+#include "xrt/xrt_device.h"
+
+#include "os/os_time.h"
+
+#include "util/u_debug.h"
+#include "util/u_time.h"
+
+#include "shared/ipc_pose_ring.h"
+#include "client/ipc_client.h"
+
+
+/*
+ *
+ * Defines and helpers.
+ *
+ */
+
+DEBUG_GET_ONCE_BOOL_OPTION(pose_ring, "IPC_POSE_RING", true)
+
+/*!
+ * How many publish periods a ring can miss before the client stops
+ * predicting from it, covers the service thread being scheduled late.
+ */
+#define MAX_MISSED_PERIODS (4)
+
+/*!
+ * Hand rings hold the tracker's own timestamps and trackers often run much
+ * slower than the service publishes, this covers trackers down to 20Hz.
+ */
+#define HAND_MAX_AGE_NS (50 * U_TIME_1MS_IN_NS)
+
+static struct ipc_shared_device_poses *
+get_device_poses(struct ipc_client_xdev *icx, int64_t *out_max_age_ns)
+{
+	struct ipc_shared_memory *ism = icx->ipc_c->ism;
+
+	int64_t period_ns = ism->pose_ring_period_ns;
+	if (period_ns <= 0 || !debug_get_bool_option_pose_ring()) {
+		return NULL;
+	}
+
+	if (icx->device_id >= XRT_SYSTEM_MAX_DEVICES) {
+		return NULL;
+	}
+
+	*out_max_age_ns = period_ns * MAX_MISSED_PERIODS;
+
+	return &ism->device_poses[icx->device_id];
+}
+
+static struct xrt_input *
+find_input(struct ipc_client_xdev *icx, enum xrt_input_name name)
+{
+	for (uint32_t i = 0; i < icx->base.input_count; i++) {
+		if (icx->base.inputs[i].name == name) {
+			return &icx->base.inputs[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+bool
+ipc_client_xdev_get_tracked_pose_from_ring(struct ipc_client_xdev *icx,
+                                           enum xrt_input_name name,
+                                           int64_t at_timestamp_ns,
+                                           struct xrt_space_relation *out_relation,
+                                           xrt_result_t *out_xret)
+{
+	int64_t max_age_ns = 0;
+	struct ipc_shared_device_poses *isdp = get_device_poses(icx, &max_age_ns);
+	if (isdp == NULL) {
+		return false;
+	}
+
+	struct ipc_shared_pose_ring *ring = ipc_pose_ring_find(isdp, name);
+	if (ring == NULL) {
+		return false;
+	}
+
+	// Our copy from the input snapshot, masked like the service checks.
+	struct xrt_input *input = find_input(icx, name);
+	if (input == NULL) {
+		return false;
+	}
+
+	// Same as the service, the ring only knows about the device's IO.
+	struct ipc_connection *ipc_c = icx->ipc_c;
+	bool device_io_active = ipc_c->ism->input_snapshots[icx->device_id].io_active;
+	bool client_io_active = ipc_client_connection_is_io_active(ipc_c);
+	if ((!device_io_active || !client_io_active) && name != XRT_INPUT_GENERIC_HEAD_POSE) {
+		U_ZERO(out_relation);
+		*out_xret = XRT_SUCCESS;
+		return true;
+	}
+
+	if (!input->active) {
+		*out_xret = XRT_ERROR_POSE_NOT_ACTIVE;
+		return true;
+	}
+
+	int64_t now_ns = os_monotonic_get_ns();
+	if (!ipc_pose_ring_locate(ring, now_ns, max_age_ns, at_timestamp_ns, out_relation)) {
+		return false;
+	}
+
+	*out_xret = XRT_SUCCESS;
+	return true;
+}
+
+bool
+ipc_client_xdev_get_hand_tracking_from_ring(struct ipc_client_xdev *icx,
+                                            enum xrt_input_name name,
+                                            int64_t at_timestamp_ns,
+                                            struct xrt_hand_joint_set *out_value,
+                                            int64_t *out_timestamp_ns)
+{
+	int64_t max_age_ns = 0;
+	if (get_device_poses(icx, &max_age_ns) == NULL) {
+		return false;
+	}
+
+	struct ipc_shared_hand_ring *ring = ipc_hand_ring_find(icx->ipc_c->ism, icx->device_id, name);
+	if (ring == NULL) {
+		return false;
+	}
+
+	if (max_age_ns < HAND_MAX_AGE_NS) {
+		max_age_ns = HAND_MAX_AGE_NS;
+	}
+
+	int64_t now_ns = os_monotonic_get_ns();
+	return ipc_hand_ring_locate(ring, now_ns, max_age_ns, at_timestamp_ns, out_value, out_timestamp_ns);
+}
+
+bool
+ipc_client_xdev_get_view_poses_from_ring(struct ipc_client_xdev *icx,
+                                         const struct xrt_vec3 *default_eye_relation,
+                                         int64_t at_timestamp_ns,
+                                         uint32_t view_count,
+                                         struct xrt_space_relation *out_head_relation,
+                                         struct xrt_fov *out_fovs,
+                                         struct xrt_pose *out_poses)
+{
+	int64_t max_age_ns = 0;
+	struct ipc_shared_device_poses *isdp = get_device_poses(icx, &max_age_ns);
+	if (isdp == NULL) {
+		return false;
+	}
+
+	struct ipc_shared_pose_ring *ring = ipc_pose_ring_find(isdp, XRT_INPUT_GENERIC_HEAD_POSE);
+	if (ring == NULL) {
+		return false;
+	}
+
+	// Each client has its own views, they might use another eye relation.
+	uint32_t slot = icx->ipc_c->client_slot;
+	if (slot >= IPC_MAX_CLIENTS) {
+		return false;
+	}
+
+	// Read the views first so the service starts publishing them right away.
+	if (!ipc_view_poses_read(&isdp->views[slot], default_eye_relation, view_count, out_fovs, out_poses)) {
+		return false;
+	}
+
+	int64_t now_ns = os_monotonic_get_ns();
+	return ipc_pose_ring_locate(ring, now_ns, max_age_ns, at_timestamp_ns, out_head_relation);
+}
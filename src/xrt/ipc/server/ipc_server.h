@@ -50,7 +50,6 @@ extern "C" {
  */
 
 #define IPC_MAX_CLIENT_SEMAPHORES 8
-#define IPC_MAX_CLIENT_SWAPCHAINS (XRT_MAX_LAYERS * 2)
 #define IPC_MAX_CLIENT_SPACES 128
 
 struct xrt_instance;
@@ -318,6 +317,60 @@ ipc_server_mainloop_init(struct ipc_server_mainloop *ml);
 void
 ipc_server_mainloop_poll(struct ipc_server *vs, struct ipc_server_mainloop *ml);
 
+/*!
+ * Thread publishing device poses into the pose and hand rings and device
+ * inputs into the input snapshots in the shared memory, see
+ * @ref ipc_shared_pose_ring, @ref ipc_shared_hand_ring and
+ * @ref ipc_shared_input_snapshot.
+ *
+ * @ingroup ipc_server
+ */
+struct ipc_server_pose_publisher
+{
+	struct os_thread_helper oth;
+
+	//! Has the thread been started.
+	bool started;
+
+	int64_t period_ns;
+
+	//! Publish rings, views, inputs and hand rings until these times, bumped when clients read.
+	int64_t rings_until_ns[XRT_SYSTEM_MAX_DEVICES][IPC_SHARED_MAX_POSE_RINGS];
+	int64_t views_until_ns[XRT_SYSTEM_MAX_DEVICES][IPC_MAX_CLIENTS];
+	int64_t inputs_until_ns[XRT_SYSTEM_MAX_DEVICES];
+	int64_t hand_rings_until_ns[IPC_SHARED_MAX_HAND_RINGS];
+
+	/*!
+	 * Only one thread at a time updates the inputs of a device and writes
+	 * them to the snapshot, this thread or a client thread asking for it.
+	 */
+	struct os_mutex input_lock;
+};
+
+/*!
+ * Optional pool of worker threads servicing all of the clients, instead of
+ * one thread per client. One thread waits on all of the client sockets and
+ * hands a readable client to the worker pool, the client socket is not
+ * waited on again until its message has been handled, this keeps the
+ * messages from each client in order. There is a worker per client slot,
+ * so a client blocked in a handler never holds up another client.
+ *
+ * @ingroup ipc_server
+ */
+struct ipc_server_client_pool
+{
+	struct os_thread_helper oth;
+
+	//! Has the pool been started.
+	bool started;
+
+	//! Waits on all of the client sockets, one shot so only one worker per client.
+	int epoll_fd;
+
+	struct u_worker_thread_pool *uwtp;
+	struct u_worker_group *uwg;
+};
+
 /*!
  * Main IPC object for the server.
  *
@@ -352,6 +405,10 @@ struct ipc_server
 
 	struct ipc_server_mainloop ml;
 
+	struct ipc_server_pose_publisher pose_publisher;
+
+	struct ipc_server_client_pool client_pool;
+
 	// Is the mainloop supposed to run.
 	volatile bool running;
 
@@ -440,6 +497,89 @@ ipc_server_client_thread(void *_ics);
 void
 ipc_server_client_destroy_session_and_compositor(volatile struct ipc_client_state *ics);
 
+/*!
+ * Removes the client from the server and releases everything it still holds,
+ * closes the client's channel.
+ *
+ * @ingroup ipc_server
+ */
+void
+ipc_server_client_shutdown(volatile struct ipc_client_state *ics);
+
+#ifndef XRT_OS_WINDOWS
+/*!
+ * Read one message from the client and dispatch it, blocks until the whole
+ * message has been received.
+ *
+ * @return Anything but XRT_SUCCESS means the client should be disconnected.
+ * @ingroup ipc_server
+ */
+xrt_result_t
+ipc_server_client_receive_and_dispatch(volatile struct ipc_client_state *ics);
+#endif
+
+/*!
+ * Start the client pool if enabled, see @ref ipc_server_client_pool.
+ *
+ * @return <0 on error.
+ * @ingroup ipc_server
+ */
+int
+ipc_server_client_pool_start(struct ipc_server *s);
+
+/*!
+ * Hand a newly connected client to the pool, called with the global state
+ * lock held.
+ *
+ * @return <0 on error, the client has not been added.
+ * @ingroup ipc_server
+ */
+int
+ipc_server_client_pool_add(struct ipc_server *s, volatile struct ipc_client_state *ics);
+
+/*!
+ * Disconnects all of the clients in the pool and stops it, safe to call if
+ * never started.
+ *
+ * @ingroup ipc_server
+ */
+void
+ipc_server_client_pool_stop(struct ipc_server *s);
+
+/*!
+ * Set up the pose rings in the shared memory, called when creating it.
+ *
+ * @ingroup ipc_server
+ */
+void
+ipc_server_pose_publisher_setup_shm(struct ipc_server *s);
+
+/*!
+ * Update the inputs of the device and write them to its input snapshot, can
+ * be called from any thread.
+ *
+ * @ingroup ipc_server
+ */
+xrt_result_t
+ipc_server_update_input_snapshot(struct ipc_server *s, uint32_t device_id, struct xrt_device *xdev);
+
+/*!
+ * Start publishing poses, does nothing if the pose rings are disabled.
+ *
+ * @return <0 on error.
+ * @ingroup ipc_server
+ */
+int
+ipc_server_pose_publisher_start(struct ipc_server *s);
+
+/*!
+ * Stop publishing poses, safe to call if never started.
+ *
+ * @ingroup ipc_server
+ */
+void
+ipc_server_pose_publisher_stop(struct ipc_server *s);
+
 /*!
  * @defgroup ipc_server_internals Server Internals
  * @brief These are only called by the platform-specific mainloop polling code.
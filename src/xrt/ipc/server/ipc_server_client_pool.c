@@ -0,0 +1,285 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Worker pool servicing all of the clients from one event loop.
+ * @ingroup ipc_server
+ */
+
+#include "util/u_misc.h"
+#include "util/u_debug.h"
+#include "util/u_worker.h"
+#include "util/u_trace_marker.h"
+
+#include "server/ipc_server.h"
+
+#ifndef XRT_OS_WINDOWS
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#endif // XRT_OS_WINDOWS
+
+
+/*!
+ * Service all of the clients from one event loop and a worker pool, instead
+ * of one thread per client.
+ *
+ * The pool has a worker for every client slot. Handlers block, like waiting
+ * for the next frame or on a swapchain image, and each client only ever has
+ * one message being handled, so a blocked client can't hold up the others.
+ */
+DEBUG_GET_ONCE_BOOL_OPTION(client_pool, "IPC_CLIENT_POOL", false)
+
+
+#ifndef XRT_OS_WINDOWS // Linux & Android
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static void
+remove_client(struct ipc_server *s, volatile struct ipc_client_state *ics)
+{
+	struct ipc_server_client_pool *cp = &s->client_pool;
+	int32_t index = ics->server_thread_index;
+
+	// Must be done before the shutdown closes the socket.
+	epoll_ctl(cp->epoll_fd, EPOLL_CTL_DEL, ics->imc.ipc_handle, NULL);
+
+	IPC_INFO(s, "Client %u disconnected.", ics->client_state.id);
+
+	ipc_server_client_shutdown(ics);
+
+	// Now the slot can be reused, there is no thread to join.
+	os_mutex_lock(&s->global_state.lock);
+	s->threads[index].state = IPC_THREAD_READY;
+	os_mutex_unlock(&s->global_state.lock);
+}
+
+static int
+arm_client(struct ipc_server_client_pool *cp, volatile struct ipc_client_state *ics, int op)
+{
+	struct epoll_event ev = XRT_STRUCT_INIT;
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = (void *)ics;
+
+	return epoll_ctl(cp->epoll_fd, op, ics->imc.ipc_handle, &ev);
+}
+
+static void
+client_task(void *ptr)
+{
+	volatile struct ipc_client_state *ics = (volatile struct ipc_client_state *)ptr;
+	struct ipc_server *s = ics->server;
+
+	xrt_result_t xret = ipc_server_client_receive_and_dispatch(ics);
+
+	// Wait for the next message from this client, only now so it stays in order.
+	if (xret == XRT_SUCCESS && arm_client(&s->client_pool, ics, EPOLL_CTL_MOD) == 0) {
+		return;
+	}
+
+	remove_client(s, ics);
+}
+
+static void
+disconnect_task(void *ptr)
+{
+	volatile struct ipc_client_state *ics = (volatile struct ipc_client_state *)ptr;
+
+	remove_client(ics->server, ics);
+}
+
+static void *
+run_event_loop(void *ptr)
+{
+	struct ipc_server *s = (struct ipc_server *)ptr;
+	struct ipc_server_client_pool *cp = &s->client_pool;
+
+	U_TRACE_SET_THREAD_NAME("IPC Client Pool");
+	os_thread_helper_name(&cp->oth, "IPC Client Pool");
+
+	os_thread_helper_lock(&cp->oth);
+
+	while (os_thread_helper_is_running_locked(&cp->oth)) {
+		os_thread_helper_unlock(&cp->oth);
+
+		const int half_a_second_ms = 500;
+		struct epoll_event events[IPC_MAX_CLIENTS];
+
+		int ret = epoll_wait(cp->epoll_fd, events, ARRAY_SIZE(events), half_a_second_ms);
+		if (ret < 0 && errno != EINTR) {
+			IPC_ERROR(s, "Failed epoll_wait '%i', stopping client pool.", ret);
+			ipc_server_handle_failure(s);
+			return NULL;
+		}
+
+		for (int i = 0; i < ret; i++) {
+			void *ics = events[i].data.ptr;
+
+			/*
+			 * A client may send a message and hang up right away, read it
+			 * first. Once the socket is drained the read fails and the
+			 * client is removed, only a hang up without data goes straight
+			 * to the disconnect.
+			 */
+			if ((events[i].events & EPOLLIN) != 0) {
+				u_worker_group_push(cp->uwg, client_task, ics);
+			} else if ((events[i].events & (EPOLLHUP | EPOLLERR)) != 0) {
+				u_worker_group_push(cp->uwg, disconnect_task, ics);
+			}
+		}
+
+		os_thread_helper_lock(&cp->oth);
+	}
+
+	os_thread_helper_unlock(&cp->oth);
+
+	return NULL;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+int
+ipc_server_client_pool_start(struct ipc_server *s)
+{
+	struct ipc_server_client_pool *cp = &s->client_pool;
+
+	if (!debug_get_bool_option_client_pool()) {
+		return 0;
+	}
+
+	// One worker per client slot, see IPC_CLIENT_POOL above.
+	const uint32_t thread_count = IPC_MAX_CLIENTS;
+
+	cp->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (cp->epoll_fd < 0) {
+		IPC_ERROR(s, "Failed to create client pool epoll fd!");
+		return -1;
+	}
+
+	// One extra thread for when stop waits on the group, nothing else waits.
+	cp->uwtp = u_worker_thread_pool_create(thread_count, thread_count + 1, "IPC Client");
+	if (cp->uwtp == NULL) {
+		close(cp->epoll_fd);
+		return -1;
+	}
+
+	cp->uwg = u_worker_group_create(cp->uwtp);
+
+	int ret = os_thread_helper_init(&cp->oth);
+	if (ret < 0) {
+		goto err_destroy;
+	}
+
+	ret = os_thread_helper_start(&cp->oth, run_event_loop, s);
+	if (ret < 0) {
+		os_thread_helper_destroy(&cp->oth);
+		goto err_destroy;
+	}
+
+	cp->started = true;
+
+	IPC_INFO(s, "Servicing clients with a pool of %u threads.", thread_count);
+
+	return 0;
+
+err_destroy:
+	u_worker_group_reference(&cp->uwg, NULL);
+	u_worker_thread_pool_reference(&cp->uwtp, NULL);
+	close(cp->epoll_fd);
+	return ret;
+}
+
+int
+ipc_server_client_pool_add(struct ipc_server *s, volatile struct ipc_client_state *ics)
+{
+	struct ipc_server_client_pool *cp = &s->client_pool;
+
+	int ret = arm_client(cp, ics, EPOLL_CTL_ADD);
+	if (ret < 0) {
+		IPC_ERROR(s, "Error epoll_ctl(client socket) failed '%i'.", ret);
+		return ret;
+	}
+
+	IPC_INFO(s, "Client %u connected", ics->client_state.id);
+
+	return 0;
+}
+
+void
+ipc_server_client_pool_stop(struct ipc_server *s)
+{
+	struct ipc_server_client_pool *cp = &s->client_pool;
+
+	if (!cp->started) {
+		return;
+	}
+
+	// Also waits for the thread to exit, no new tasks after this.
+	os_thread_helper_destroy(&cp->oth);
+
+	// Unblock any worker waiting on the rest of a message.
+	os_mutex_lock(&s->global_state.lock);
+	for (uint32_t i = 0; i < IPC_MAX_CLIENTS; i++) {
+		volatile struct ipc_client_state *ics = &s->threads[i].ics;
+		if (ics->server_thread_index >= 0) {
+			shutdown(ics->imc.ipc_handle, SHUT_RDWR);
+		}
+	}
+	os_mutex_unlock(&s->global_state.lock);
+
+	u_worker_group_wait_all(cp->uwg);
+
+	// Clients that were idle, their socket was never handed to a worker.
+	for (uint32_t i = 0; i < IPC_MAX_CLIENTS; i++) {
+		volatile struct ipc_client_state *ics = &s->threads[i].ics;
+		if (ics->server_thread_index >= 0) {
+			remove_client(s, ics);
+		}
+	}
+
+	u_worker_group_reference(&cp->uwg, NULL);
+	u_worker_thread_pool_reference(&cp->uwtp, NULL);
+
+	close(cp->epoll_fd);
+	cp->epoll_fd = -1;
+	cp->started = false;
+}
+
+
+#else // XRT_OS_WINDOWS
+
+int
+ipc_server_client_pool_start(struct ipc_server *s)
+{
+	if (debug_get_bool_option_client_pool()) {
+		IPC_WARN(s, "Client pool not supported on this platform, using one thread per client.");
+	}
+
+	return 0;
+}
+
+int
+ipc_server_client_pool_add(struct ipc_server *s, volatile struct ipc_client_state *ics)
+{
+	return -1;
+}
+
+void
+ipc_server_client_pool_stop(struct ipc_server *s)
+{
+	// Never started.
+}
+
+#endif // XRT_OS_WINDOWS
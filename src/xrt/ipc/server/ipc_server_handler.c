@@ -15,6 +15,7 @@
 #include "util/u_visibility_mask.h"
 #include "util/u_trace_marker.h"
 
+#include "shared/ipc_swapchain_queue.h"
 #include "server/ipc_server.h"
 #include "ipc_server_generated.h"
 
@@ -102,6 +103,60 @@ set_swapchain_info(volatile struct ipc_client_state *ics,
 	ics->swapchain_data[index].image_count = xsc->image_count;
 }
 
+//! Index of the swapchain's image queue in the shared memory area.
+static uint32_t
+get_swapchain_queue_index(volatile struct ipc_client_state *ics, uint32_t index)
+{
+	return (uint32_t)ics->server_thread_index * IPC_MAX_CLIENT_SWAPCHAINS + index;
+}
+
+/*!
+ * Set up the shared memory image queue of the swapchain, returns the index
+ * of the queue that the client should use.
+ */
+static uint32_t
+init_swapchain_queue(volatile struct ipc_client_state *ics, uint32_t index, uint32_t image_count)
+{
+	uint32_t queue_index = get_swapchain_queue_index(ics, index);
+
+	ipc_swapchain_queue_init(&ics->server->ism->swapchain_queues[queue_index], image_count);
+
+	return queue_index;
+}
+
+/*!
+ * Bring the service swapchain up to date with the acquires and releases
+ * the client has done through its image queue.
+ */
+static xrt_result_t
+replay_swapchain_queue(volatile struct ipc_client_state *ics, uint32_t id)
+{
+	if (id >= IPC_MAX_CLIENT_SWAPCHAINS || ics->xscs[id] == NULL) {
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	uint32_t queue_index = get_swapchain_queue_index(ics, id);
+	struct xrt_swapchain *xsc = ics->xscs[id];
+
+	xrt_result_t xret = ipc_swapchain_queue_replay(&ics->server->ism->swapchain_queues[queue_index], xsc);
+	if (xret != XRT_SUCCESS) {
+		IPC_ERROR(ics->server, "Swapchain %u image queue out of step with the swapchain!", id);
+	}
+
+	return xret;
+}
+
+//! The layers about to be committed may use any swapchain, replay them all.
+static void
+replay_all_swapchain_queues(volatile struct ipc_client_state *ics)
+{
+	for (uint32_t id = 0; id < IPC_MAX_CLIENT_SWAPCHAINS; id++) {
+		if (ics->swapchain_data[id].active && ics->xscs[id] != NULL) {
+			(void)replay_swapchain_queue(ics, id);
+		}
+	}
+}
+
 static xrt_result_t
 validate_reference_space_type(volatile struct ipc_client_state *ics, enum xrt_reference_space_type type)
 {
@@ -298,7 +353,8 @@ ipc_handle_instance_get_shm_fd(volatile struct ipc_client_state *ics,
 
 xrt_result_t
 ipc_handle_instance_describe_client(volatile struct ipc_client_state *ics,
-                                    const struct ipc_client_description *client_desc)
+                                    const struct ipc_client_description *client_desc,
+                                    uint32_t *out_slot)
 {
 	ics->client_state.info = client_desc->info;
 	ics->client_state.pid = client_desc->pid;
@@ -338,6 +394,9 @@ ipc_handle_instance_describe_client(volatile struct ipc_client_state *ics,
 	// Log the pretty message.
 	IPC_INFO(ics->server, "%s", sink.buffer);
 
+	// Same index as used for the per client data in the shared memory.
+	*out_slot = (uint32_t)ics->server_thread_index;
+
 	return XRT_SUCCESS;
 }
 
@@ -938,7 +997,7 @@ ipc_handle_compositor_predict_frame(volatile struct ipc_client_state *ics,
 }
 
 xrt_result_t
-ipc_handle_compositor_wait_woke(volatile struct ipc_client_state *ics, int64_t frame_id)
+ipc_handle_compositor_wait_woke(volatile struct ipc_client_state *ics, int64_t frame_id, int64_t woke_time_ns)
 {
 	IPC_TRACE_MARKER();
 
@@ -946,7 +1005,17 @@ ipc_handle_compositor_wait_woke(volatile struct ipc_client_state *ics, int64_t f
 		return XRT_ERROR_IPC_SESSION_NOT_CREATED;
 	}
 
-	return xrt_comp_mark_frame(ics->xc, frame_id, XRT_COMPOSITOR_FRAME_POINT_WOKE, os_monotonic_get_ns());
+	/*
+	 * The client may send this batched with the next call, so it tells us
+	 * when it woke up. Both sides use the same clock, but don't trust a
+	 * time in the future.
+	 */
+	int64_t now_ns = os_monotonic_get_ns();
+	if (woke_time_ns <= 0 || woke_time_ns > now_ns) {
+		woke_time_ns = now_ns;
+	}
+
+	return xrt_comp_mark_frame(ics->xc, frame_id, XRT_COMPOSITOR_FRAME_POINT_WOKE, woke_time_ns);
 }
 
 xrt_result_t
@@ -1338,6 +1407,8 @@ ipc_handle_compositor_layer_sync(volatile struct ipc_client_state *ics,
 	 * Transfer data to underlying compositor.
 	 */
 
+	replay_all_swapchain_queues(ics);
+
 	xrt_comp_layer_begin(ics->xc, &copy.data);
 
 	_update_layers(ics, ics->xc, &copy);
@@ -1394,6 +1465,8 @@ ipc_handle_compositor_layer_sync_with_semaphore(volatile struct ipc_client_state
 	 * Transfer data to underlying compositor.
 	 */
 
+	replay_all_swapchain_queues(ics);
+
 	xrt_comp_layer_begin(ics->xc, &copy.data);
 
 	_update_layers(ics, ics->xc, &copy);
@@ -1569,6 +1642,7 @@ ipc_handle_system_toggle_io_device(volatile struct ipc_client_state *ics, uint32
 	struct ipc_device *idev = &ics->server->idevs[device_id];
 
 	idev->io_active = !idev->io_active;
+	ics->server->ism->input_snapshots[device_id].io_active = idev->io_active;
 
 	return XRT_SUCCESS;
 }
@@ -1594,6 +1668,7 @@ ipc_handle_swapchain_create(volatile struct ipc_client_state *ics,
                             uint32_t *out_image_count,
                             uint64_t *out_size,
                             bool *out_use_dedicated_allocation,
+                            uint32_t *out_queue_index,
                             uint32_t max_handle_capacity,
                             xrt_graphics_buffer_handle_t *out_handles,
                             uint32_t *out_handle_count)
@@ -1645,6 +1720,7 @@ ipc_handle_swapchain_create(volatile struct ipc_client_state *ics,
 	*out_use_dedicated_allocation = xscn->images[0].use_dedicated_allocation;
 	*out_id = index;
 	*out_image_count = xsc->image_count;
+	*out_queue_index = init_swapchain_queue(ics, index, xsc->image_count);
 
 	// Setup the fds.
 	*out_handle_count = xsc->image_count;
@@ -1660,6 +1736,7 @@ ipc_handle_swapchain_import(volatile struct ipc_client_state *ics,
                             const struct xrt_swapchain_create_info *info,
                             const struct ipc_arg_swapchain_from_native *args,
                             uint32_t *out_id,
+                            uint32_t *out_queue_index,
                             const xrt_graphics_buffer_handle_t *handles,
                             uint32_t handle_count)
 {
@@ -1701,6 +1778,7 @@ ipc_handle_swapchain_import(volatile struct ipc_client_state *ics,
 
 	set_swapchain_info(ics, index, info, xsc);
 	*out_id = index;
+	*out_queue_index = init_swapchain_queue(ics, index, xsc->image_count);
 
 	return XRT_SUCCESS;
 }
@@ -1712,6 +1790,11 @@ ipc_handle_swapchain_wait_image(volatile struct ipc_client_state *ics, uint32_t
 		return XRT_ERROR_IPC_SESSION_NOT_CREATED;
 	}
 
+	xrt_result_t xret = replay_swapchain_queue(ics, id);
+	if (xret != XRT_SUCCESS) {
+		return xret;
+	}
+
 	//! @todo Look up the index.
 	uint32_t sc_index = id;
 	struct xrt_swapchain *xsc = ics->xscs[sc_index];
@@ -1751,6 +1834,16 @@ ipc_handle_swapchain_release_image(volatile struct ipc_client_state *ics, uint32
 	return XRT_SUCCESS;
 }
 
+xrt_result_t
+ipc_handle_swapchain_replay_queue(volatile struct ipc_client_state *ics, uint32_t id)
+{
+	if (ics->xc == NULL) {
+		return XRT_ERROR_IPC_SESSION_NOT_CREATED;
+	}
+
+	return replay_swapchain_queue(ics, id);
+}
+
 xrt_result_t
 ipc_handle_swapchain_destroy(volatile struct ipc_client_state *ics, uint32_t id)
 {
@@ -1760,6 +1853,8 @@ ipc_handle_swapchain_destroy(volatile struct ipc_client_state *ics, uint32_t id)
 
 	ics->swapchain_count--;
 
+	ipc_swapchain_queue_fini(&ics->server->ism->swapchain_queues[get_swapchain_queue_index(ics, id)]);
+
 	// Drop our reference, does NULL checking. Cast away volatile.
 	xrt_swapchain_reference((struct xrt_swapchain **)&ics->xscs[id], NULL);
 	ics->swapchain_data[id].active = false;
@@ -1851,39 +1946,18 @@ ipc_handle_device_update_input(volatile struct ipc_client_state *ics, uint32_t i
 {
 	// To make the code a bit more readable.
 	uint32_t device_id = id;
-	struct ipc_shared_memory *ism = ics->server->ism;
 	struct ipc_device *idev = get_idev(ics, device_id);
-	struct xrt_device *xdev = idev->xdev;
-	struct ipc_shared_device *isdev = &ism->isdevs[device_id];
 
-	// Update inputs.
-	xrt_result_t xret = xrt_device_update_inputs(xdev);
+	/*
+	 * Shared by all clients, so not masked here. Clients copy the snapshot
+	 * out and mask it with their own and the device's IO state.
+	 */
+	xrt_result_t xret = ipc_server_update_input_snapshot(ics->server, device_id, idev->xdev);
 	if (xret != XRT_SUCCESS) {
 		IPC_ERROR(ics->server, "Failed to update input");
 		return xret;
 	}
 
-	// Copy data into the shared memory.
-	struct xrt_input *src = xdev->inputs;
-	struct xrt_input *dst = &ism->inputs[isdev->first_input_index];
-	size_t size = sizeof(struct xrt_input) * isdev->input_count;
-
-	bool io_active = ics->io_active && idev->io_active;
-	if (io_active) {
-		memcpy(dst, src, size);
-	} else {
-		memset(dst, 0, size);
-
-		for (uint32_t i = 0; i < isdev->input_count; i++) {
-			dst[i].name = src[i].name;
-
-			// Special case the rotation of the head.
-			if (dst[i].name == XRT_INPUT_GENERIC_HEAD_POSE) {
-				dst[i].active = src[i].active;
-			}
-		}
-	}
-
 	// Reply.
 	return XRT_SUCCESS;
 }
@@ -1924,15 +1998,14 @@ ipc_handle_device_get_tracked_pose(volatile struct ipc_client_state *ics,
 
 	// Special case the headpose.
 	bool disabled = (!isdev->io_active || !ics->io_active) && name != XRT_INPUT_GENERIC_HEAD_POSE;
-	bool active_on_client = input->active;
 
-	// We have been disabled but the client hasn't called update.
-	if (disabled && active_on_client) {
+	// The client's masked copy of the inputs might not have caught up yet.
+	if (disabled) {
 		U_ZERO(out_relation);
 		return XRT_SUCCESS;
 	}
 
-	if (disabled || !active_on_client) {
+	if (!input->active) {
 		return XRT_ERROR_POSE_NOT_ACTIVE;
 	}
 
@@ -12,6 +12,7 @@
 #include "util/u_trace_marker.h"
 
 #include "shared/ipc_utils.h"
+#include "shared/ipc_swapchain_queue.h"
 #include "server/ipc_server.h"
 #include "ipc_server_generated.h"
 
@@ -35,8 +36,8 @@
  *
  */
 
-static void
-common_shutdown(volatile struct ipc_client_state *ics)
+void
+ipc_server_client_shutdown(volatile struct ipc_client_state *ics)
 {
 	/*
 	 * Remove the thread from the server.
@@ -118,6 +119,47 @@ common_shutdown(volatile struct ipc_client_state *ics)
 
 #ifndef XRT_OS_WINDOWS // Linux & Android
 
+xrt_result_t
+ipc_server_client_receive_and_dispatch(volatile struct ipc_client_state *ics)
+{
+	// Peek the first 4 bytes to get the command type
+	enum ipc_command cmd;
+	ssize_t len = recv(ics->imc.ipc_handle, &cmd, sizeof(cmd), MSG_PEEK);
+	if (len != sizeof(cmd)) {
+		IPC_ERROR(ics->server, "Invalid command received.");
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	size_t cmd_size = ipc_command_size(cmd);
+	if (cmd_size == 0) {
+		IPC_ERROR(ics->server, "Invalid command size.");
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	// Read the whole command now that we know its size
+	uint8_t buf[IPC_BUF_SIZE] = {0};
+
+	len = recv(ics->imc.ipc_handle, &buf, cmd_size, 0);
+	if (len != (ssize_t)cmd_size) {
+		IPC_ERROR(ics->server, "Invalid packet received, disconnecting client.");
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	// Check the first 4 bytes of the message and dispatch.
+	ipc_command_t *ipc_command = (ipc_command_t *)buf;
+
+	IPC_TRACE_BEGIN(ipc_dispatch);
+	xrt_result_t result = ipc_dispatch(ics, ipc_command);
+	IPC_TRACE_END(ipc_dispatch);
+
+	if (result != XRT_SUCCESS) {
+		IPC_ERROR(ics->server, "During packet handling, disconnecting client.");
+		return result;
+	}
+
+	return XRT_SUCCESS;
+}
+
 static int
 setup_epoll(volatile struct ipc_client_state *ics)
 {
@@ -184,38 +226,7 @@ client_loop(volatile struct ipc_client_state *ics)
 			break;
 		}
 
-		// Peek the first 4 bytes to get the command type
-		enum ipc_command cmd;
-		ssize_t len = recv(ics->imc.ipc_handle, &cmd, sizeof(cmd), MSG_PEEK);
-		if (len != sizeof(cmd)) {
-			IPC_ERROR(ics->server, "Invalid command received.");
-			break;
-		}
-
-		size_t cmd_size = ipc_command_size(cmd);
-		if (cmd_size == 0) {
-			IPC_ERROR(ics->server, "Invalid command size.");
-			break;
-		}
-
-		// Read the whole command now that we know its size
-		uint8_t buf[IPC_BUF_SIZE] = {0};
-
-		len = recv(ics->imc.ipc_handle, &buf, cmd_size, 0);
-		if (len != (ssize_t)cmd_size) {
-			IPC_ERROR(ics->server, "Invalid packet received, disconnecting client.");
-			break;
-		}
-
-		// Check the first 4 bytes of the message and dispatch.
-		ipc_command_t *ipc_command = (ipc_command_t *)buf;
-
-		IPC_TRACE_BEGIN(ipc_dispatch);
-		xrt_result_t result = ipc_dispatch(ics, ipc_command);
-		IPC_TRACE_END(ipc_dispatch);
-
-		if (result != XRT_SUCCESS) {
-			IPC_ERROR(ics->server, "During packet handling, disconnecting client.");
+		if (ipc_server_client_receive_and_dispatch(ics) != XRT_SUCCESS) {
 			break;
 		}
 	}
@@ -224,7 +235,7 @@ client_loop(volatile struct ipc_client_state *ics)
 	epoll_fd = -1;
 
 	// Following code is same for all platforms.
-	common_shutdown(ics);
+	ipc_server_client_shutdown(ics);
 }
 
 #else // XRT_OS_WINDOWS
@@ -304,7 +315,7 @@ client_loop(volatile struct ipc_client_state *ics)
 	}
 
 	// Following code is same for all platforms.
-	common_shutdown(ics);
+	ipc_server_client_shutdown(ics);
 }
 
 #endif // XRT_OS_WINDOWS
@@ -326,6 +337,12 @@ ipc_server_client_destroy_session_and_compositor(volatile struct ipc_client_stat
 
 	// Destroy all swapchains now.
 	for (uint32_t j = 0; j < IPC_MAX_CLIENT_SWAPCHAINS; j++) {
+		// Wake anybody waiting, not needed if the client is already gone.
+		if (ics->swapchain_data[j].active && ics->server_thread_index >= 0) {
+			uint32_t queue_index = (uint32_t)ics->server_thread_index * IPC_MAX_CLIENT_SWAPCHAINS + j;
+			ipc_swapchain_queue_fini(&ics->server->ism->swapchain_queues[queue_index]);
+		}
+
 		// Drop our reference, does NULL checking. Cast away volatile.
 		xrt_swapchain_reference((struct xrt_swapchain **)&ics->xscs[j], NULL);
 		ics->swapchain_data[j].active = false;
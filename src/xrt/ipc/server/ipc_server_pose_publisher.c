@@ -0,0 +1,330 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Publishes device poses and inputs into the shared memory.
+ * @ingroup ipc_server
+ */
+
+#include "xrt/xrt_device.h"
+
+#include "os/os_time.h"
+#include "util/u_misc.h"
+#include "util/u_time.h"
+#include "util/u_debug.h"
+#include "util/u_trace_marker.h"
+
+#include "shared/ipc_pose_ring.h"
+#include "shared/ipc_input_snapshot.h"
+#include "server/ipc_server.h"
+
+#include <string.h>
+
+
+/*
+ *
+ * Defines and helpers.
+ *
+ */
+
+/*!
+ * How often to publish poses and inputs, zero disables the pose rings and
+ * input snapshots and clients will always do a round trip to the service.
+ */
+DEBUG_GET_ONCE_NUM_OPTION(pose_ring_hz, "IPC_POSE_RING_HZ", 500)
+
+/*!
+ * How long to keep publishing a ring after a client last read it.
+ */
+#define WANTED_LINGER_NS (U_TIME_1S_IN_NS)
+
+static bool
+take_wanted(volatile uint32_t *wanted)
+{
+	if (*wanted == 0) {
+		return false;
+	}
+
+	*wanted = 0;
+	return true;
+}
+
+static void
+publish_ring(struct xrt_device *xdev, struct ipc_shared_pose_ring *ring, bool io_disabled, int64_t now_ns)
+{
+	// The head pose is never disabled, see ipc_handle_device_get_tracked_pose.
+	io_disabled = io_disabled && ring->name != XRT_INPUT_GENERIC_HEAD_POSE;
+
+	ipc_pose_ring_set_io_disabled(ring, io_disabled);
+	if (io_disabled) {
+		return;
+	}
+
+	struct xrt_space_relation relation = XRT_SPACE_RELATION_ZERO;
+	xrt_result_t xret = xrt_device_get_tracked_pose(xdev, ring->name, now_ns, &relation);
+	if (xret != XRT_SUCCESS) {
+		return;
+	}
+
+	ipc_pose_ring_push(ring, now_ns, &relation);
+}
+
+static void
+publish_hand_ring(struct xrt_device *xdev, struct ipc_shared_hand_ring *ring, int64_t now_ns)
+{
+	// Not masked by IO, same as ipc_handle_device_get_hand_tracking.
+	struct xrt_hand_joint_set set = {0};
+	int64_t timestamp_ns = 0;
+	xrt_device_get_hand_tracking(xdev, ring->name, now_ns, &set, &timestamp_ns);
+
+	// The call can't fail, but drivers that have nothing don't set a timestamp.
+	if (timestamp_ns <= 0) {
+		return;
+	}
+
+	// Trackers often run slower than we publish, only push new samples.
+	if (ring->count > 0) {
+		int64_t last_ns = ring->samples[(ring->count - 1) % IPC_SHARED_HAND_RING_LEN].timestamp_ns;
+		if (timestamp_ns <= last_ns) {
+			return;
+		}
+	}
+
+	ipc_hand_ring_push(ring, timestamp_ns, &set);
+}
+
+static void
+publish_views(struct xrt_device *xdev, struct ipc_shared_view_poses *views, int64_t now_ns)
+{
+	uint32_t view_count = views->wanted_view_count;
+	struct xrt_vec3 eye_relation = views->wanted_eye_relation;
+
+	if (view_count == 0 || view_count > XRT_MAX_VIEWS) {
+		return;
+	}
+
+	struct xrt_space_relation head_relation = XRT_SPACE_RELATION_ZERO;
+	struct xrt_fov fovs[XRT_MAX_VIEWS] = {0};
+	struct xrt_pose poses[XRT_MAX_VIEWS] = {0};
+
+	xrt_device_get_view_poses(xdev, &eye_relation, now_ns, view_count, &head_relation, fovs, poses);
+
+	ipc_view_poses_write(views, &eye_relation, view_count, fovs, poses);
+}
+
+static void
+publish(struct ipc_server_pose_publisher *pp, struct ipc_server *s)
+{
+	SINK_TRACE_MARKER();
+
+	int64_t now_ns = os_monotonic_get_ns();
+
+	for (uint32_t i = 0; i < s->ism->isdev_count; i++) {
+		struct ipc_device *idev = &s->idevs[i];
+		struct ipc_shared_device_poses *isdp = &s->ism->device_poses[i];
+		if (idev->xdev == NULL) {
+			continue;
+		}
+
+		// Clients mask the rings themselves when their own IO is disabled.
+		bool io_disabled = !idev->io_active;
+
+		if (take_wanted(&s->ism->input_snapshots[i].wanted)) {
+			pp->inputs_until_ns[i] = now_ns + WANTED_LINGER_NS;
+		}
+		if (pp->inputs_until_ns[i] > now_ns) {
+			ipc_server_update_input_snapshot(s, i, idev->xdev);
+		}
+
+		for (uint32_t k = 0; k < IPC_MAX_CLIENTS; k++) {
+			if (take_wanted(&isdp->views[k].wanted)) {
+				pp->views_until_ns[i][k] = now_ns + WANTED_LINGER_NS;
+			}
+			if (pp->views_until_ns[i][k] > now_ns) {
+				publish_views(idev->xdev, &isdp->views[k], now_ns);
+			}
+		}
+
+		for (uint32_t k = 0; k < isdp->ring_count; k++) {
+			struct ipc_shared_pose_ring *ring = &isdp->rings[k];
+
+			if (take_wanted(&ring->wanted)) {
+				pp->rings_until_ns[i][k] = now_ns + WANTED_LINGER_NS;
+			}
+			if (pp->rings_until_ns[i][k] > now_ns) {
+				publish_ring(idev->xdev, ring, io_disabled, now_ns);
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < s->ism->hand_ring_count; i++) {
+		struct ipc_shared_hand_ring *ring = &s->ism->hand_rings[i];
+		struct xrt_device *xdev = s->idevs[ring->device_id].xdev;
+
+		if (take_wanted(&ring->wanted)) {
+			pp->hand_rings_until_ns[i] = now_ns + WANTED_LINGER_NS;
+		}
+		if (pp->hand_rings_until_ns[i] > now_ns) {
+			publish_hand_ring(xdev, ring, now_ns);
+		}
+	}
+}
+
+static void *
+run_publisher(void *ptr)
+{
+	struct ipc_server *s = (struct ipc_server *)ptr;
+	struct ipc_server_pose_publisher *pp = &s->pose_publisher;
+
+	U_TRACE_SET_THREAD_NAME("IPC Pose Publisher");
+	os_thread_helper_name(&pp->oth, "IPC Pose Publisher");
+
+	os_thread_helper_lock(&pp->oth);
+
+	while (os_thread_helper_is_running_locked(&pp->oth)) {
+		os_thread_helper_unlock(&pp->oth);
+
+		int64_t start_ns = os_monotonic_get_ns();
+
+		publish(pp, s);
+
+		int64_t sleep_ns = pp->period_ns - (os_monotonic_get_ns() - start_ns);
+		if (sleep_ns > 0) {
+			os_nanosleep(sleep_ns);
+		}
+
+		os_thread_helper_lock(&pp->oth);
+	}
+
+	os_thread_helper_unlock(&pp->oth);
+
+	return NULL;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+void
+ipc_server_pose_publisher_setup_shm(struct ipc_server *s)
+{
+	// Also used by clients that ask for updates, so always set.
+	for (uint32_t i = 0; i < s->ism->isdev_count; i++) {
+		s->ism->input_snapshots[i].io_active = s->idevs[i].io_active;
+	}
+
+	int64_t hz = debug_get_num_option_pose_ring_hz();
+	if (hz <= 0) {
+		s->ism->pose_ring_period_ns = 0;
+		return;
+	}
+
+	s->ism->pose_ring_period_ns = U_TIME_1S_IN_NS / hz;
+
+	for (uint32_t i = 0; i < s->ism->isdev_count; i++) {
+		struct xrt_device *xdev = s->idevs[i].xdev;
+		struct ipc_shared_device_poses *isdp = &s->ism->device_poses[i];
+		if (xdev == NULL) {
+			continue;
+		}
+
+		uint32_t count = 0;
+		for (uint32_t k = 0; k < xdev->input_count && count < IPC_SHARED_MAX_POSE_RINGS; k++) {
+			enum xrt_input_name name = xdev->inputs[k].name;
+			if (XRT_GET_INPUT_TYPE(name) != XRT_INPUT_TYPE_POSE) {
+				continue;
+			}
+
+			isdp->rings[count++].name = name;
+		}
+
+		isdp->ring_count = count;
+
+		// Joint sets are big, so only a few inputs of all devices get rings.
+		for (uint32_t k = 0; k < xdev->input_count; k++) {
+			enum xrt_input_name name = xdev->inputs[k].name;
+			if (XRT_GET_INPUT_TYPE(name) != XRT_INPUT_TYPE_HAND_TRACKING) {
+				continue;
+			}
+			if (s->ism->hand_ring_count >= IPC_SHARED_MAX_HAND_RINGS) {
+				IPC_WARN(s, "Out of hand rings, '%s' will not be mirrored.", xdev->str);
+				break;
+			}
+
+			struct ipc_shared_hand_ring *ring = &s->ism->hand_rings[s->ism->hand_ring_count++];
+			ring->device_id = i;
+			ring->name = name;
+		}
+	}
+}
+
+xrt_result_t
+ipc_server_update_input_snapshot(struct ipc_server *s, uint32_t device_id, struct xrt_device *xdev)
+{
+	struct ipc_shared_memory *ism = s->ism;
+	struct ipc_shared_device *isdev = &ism->isdevs[device_id];
+	struct ipc_server_pose_publisher *pp = &s->pose_publisher;
+
+	os_mutex_lock(&pp->input_lock);
+
+	xrt_result_t xret = xrt_device_update_inputs(xdev);
+	if (xret == XRT_SUCCESS) {
+		struct ipc_shared_input_snapshot *snap = &ism->input_snapshots[device_id];
+		struct xrt_input *dst = &ism->inputs[isdev->first_input_index];
+		int64_t now_ns = os_monotonic_get_ns();
+
+		ipc_input_snapshot_write(snap, dst, xdev->inputs, isdev->input_count, now_ns);
+	}
+
+	os_mutex_unlock(&pp->input_lock);
+
+	return xret;
+}
+
+int
+ipc_server_pose_publisher_start(struct ipc_server *s)
+{
+	struct ipc_server_pose_publisher *pp = &s->pose_publisher;
+
+	if (s->ism->pose_ring_period_ns <= 0) {
+		IPC_INFO(s, "Pose rings disabled, clients will ask for every pose.");
+		return 0;
+	}
+
+	pp->period_ns = s->ism->pose_ring_period_ns;
+
+	int ret = os_thread_helper_init(&pp->oth);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = os_thread_helper_start(&pp->oth, run_publisher, s);
+	if (ret < 0) {
+		os_thread_helper_destroy(&pp->oth);
+		return ret;
+	}
+
+	pp->started = true;
+
+	return 0;
+}
+
+void
+ipc_server_pose_publisher_stop(struct ipc_server *s)
+{
+	struct ipc_server_pose_publisher *pp = &s->pose_publisher;
+
+	if (!pp->started) {
+		return;
+	}
+
+	// Also waits for the thread to exit.
+	os_thread_helper_destroy(&pp->oth);
+	pp->started = false;
+
+	// Clients fall back to asking the service.
+	s->ism->pose_ring_period_ns = 0;
+}
@@ -194,6 +194,12 @@ teardown_all(struct ipc_server *s)
 {
 	u_var_remove_root(s);
 
+	// Uses the devices and the shared memory.
+	ipc_server_pose_publisher_stop(s);
+
+	// Disconnects the pooled clients, uses the compositor and devices.
+	ipc_server_client_pool_stop(s);
+
 	xrt_syscomp_destroy(&s->xsysc);
 
 	teardown_idevs(s);
@@ -211,6 +217,7 @@ teardown_all(struct ipc_server *s)
 	ipc_shmem_destroy(&s->ism_handle, (void **)&s->ism, sizeof(struct ipc_shared_memory));
 
 	// Destroyed last.
+	os_mutex_destroy(&s->pose_publisher.input_lock);
 	os_mutex_destroy(&s->global_state.lock);
 }
 
@@ -439,6 +446,9 @@ init_shm(struct ipc_server *s)
 	ism->roles.hand_tracking.left = find_xdev_index(s, s->xsysd->static_roles.hand_tracking.left);
 	ism->roles.hand_tracking.right = find_xdev_index(s, s->xsysd->static_roles.hand_tracking.right);
 
+	// Which poses to mirror, needs the device count.
+	ipc_server_pose_publisher_setup_shm(s);
+
 	// Fill out git version info.
 	snprintf(s->ism->u_git_tag, IPC_VERSION_NAME_LEN, "%s", u_git_tag);
 
@@ -478,6 +488,13 @@ init_all(struct ipc_server *s, enum u_logging_level log_level)
 		return ret;
 	}
 
+	ret = os_mutex_init(&s->pose_publisher.input_lock);
+	if (ret < 0) {
+		IPC_ERROR(s, "Input lock mutex failed to init!");
+		os_mutex_destroy(&s->global_state.lock);
+		return ret;
+	}
+
 	s->process = u_process_create_if_not_running();
 
 	if (!s->process) {
@@ -535,6 +552,21 @@ init_all(struct ipc_server *s, enum u_logging_level log_level)
 	// Never fails, do this second last.
 	init_server_state(s);
 
+	// Looks at the client states.
+	ret = ipc_server_pose_publisher_start(s);
+	if (ret < 0) {
+		IPC_ERROR(s, "Failed to start pose publisher!");
+		teardown_all(s);
+		return ret;
+	}
+
+	ret = ipc_server_client_pool_start(s);
+	if (ret < 0) {
+		IPC_ERROR(s, "Failed to start client pool!");
+		teardown_all(s);
+		return ret;
+	}
+
 	u_var_add_root(s, "IPC Server", false);
 	u_var_add_log_level(s, &s->log_level, "Log level");
 	u_var_add_bool(s, &s->exit_on_disconnect, "exit_on_disconnect");
@@ -791,6 +823,11 @@ toggle_io_client_locked(struct ipc_server *s, uint32_t client_id)
 
 	ics->io_active = !ics->io_active;
 
+	int index = ics->server_thread_index;
+	if (index >= 0 && index < IPC_MAX_CLIENTS) {
+		s->ism->client_io_active[index] = ics->io_active;
+	}
+
 	return XRT_SUCCESS;
 }
 
@@ -912,10 +949,18 @@ ipc_server_handle_client_connected(struct ipc_server *vs, xrt_ipc_handle_t ipc_h
 
 	os_mutex_lock(&vs->global_state.lock);
 
+	bool pooled = vs->client_pool.started;
+
 	// find the next free thread in our array (server_thread_index is -1)
 	// and have it handle this connection
 	for (uint32_t i = 0; i < IPC_MAX_CLIENTS; i++) {
 		volatile struct ipc_client_state *_cs = &vs->threads[i].ics;
+
+		// Pooled clients have no thread to join, skip slots still shutting down.
+		if (pooled && vs->threads[i].state != IPC_THREAD_READY) {
+			continue;
+		}
+
 		if (_cs->server_thread_index < 0) {
 			ics = _cs;
 			cs_index = i;
@@ -965,8 +1010,22 @@ ipc_server_handle_client_connected(struct ipc_server *vs, xrt_ipc_handle_t ipc_h
 	ics->server = vs;
 	ics->server_thread_index = cs_index;
 	ics->io_active = true;
+	vs->ism->client_io_active[cs_index] = true;
+
+	if (pooled) {
+		if (ipc_server_client_pool_add(vs, ics) < 0) {
+			xrt_ipc_handle_close(ipc_handle);
+			ics->server_thread_index = -1;
+			it->state = IPC_THREAD_READY;
+
+			os_mutex_unlock(&vs->global_state.lock);
+			return;
+		}
+	} else {
+		os_thread_start(&it->thread, ipc_server_client_thread, (void *)ics);
+	}
 
-	os_thread_start(&it->thread, ipc_server_client_thread, (void *)ics);
+	it->state = IPC_THREAD_RUNNING;
 
 	// Unlock when we are done.
 	os_mutex_unlock(&vs->global_state.lock);
@@ -0,0 +1,115 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Reading and writing the input snapshots in the shared memory area.
+ * @ingroup ipc_shared
+ */
+
+#include "util/u_misc.h"
+
+#include "shared/ipc_input_snapshot.h"
+
+#include <string.h>
+
+
+/*!
+ * How many times readers retry when the service writes at the same time,
+ * a write is just a copy of the device's inputs so this is plenty.
+ */
+#define READ_TRIES (8)
+
+
+/*
+ *
+ * Service side functions.
+ *
+ */
+
+void
+ipc_input_snapshot_write(struct ipc_shared_input_snapshot *snap,
+                         struct xrt_input *dst,
+                         const struct xrt_input *inputs,
+                         uint32_t input_count,
+                         int64_t timestamp_ns)
+{
+	ipc_seqlock_write_begin(&snap->seq);
+
+	memcpy(dst, inputs, sizeof(*dst) * input_count);
+	snap->timestamp_ns = timestamp_ns;
+
+	ipc_seqlock_write_end(&snap->seq);
+}
+
+
+/*
+ *
+ * Client side functions.
+ *
+ */
+
+void
+ipc_input_snapshot_mask(struct xrt_input *inputs, uint32_t input_count)
+{
+	for (uint32_t i = 0; i < input_count; i++) {
+		enum xrt_input_name name = inputs[i].name;
+		bool active = inputs[i].active;
+
+		U_ZERO(&inputs[i]);
+		inputs[i].name = name;
+
+		// Special case the rotation of the head.
+		if (name == XRT_INPUT_GENERIC_HEAD_POSE) {
+			inputs[i].active = active;
+		}
+	}
+}
+
+bool
+ipc_input_snapshot_read(struct ipc_shared_input_snapshot *snap,
+                        const struct xrt_input *src,
+                        uint32_t input_count,
+                        int64_t now_ns,
+                        int64_t max_age_ns,
+                        bool client_io_active,
+                        struct xrt_input *out_inputs)
+{
+	// Only write when needed, keeps the cache line shared between clients.
+	if (snap->wanted == 0) {
+		snap->wanted = 1;
+	}
+
+	bool got = false;
+
+	for (int tries = 0; tries < READ_TRIES && !got; tries++) {
+		uint32_t start;
+		if (!ipc_seqlock_read_begin(&snap->seq, &start)) {
+			continue;
+		}
+
+		int64_t timestamp_ns = snap->timestamp_ns;
+		memcpy(out_inputs, src, sizeof(*out_inputs) * input_count);
+
+		if (!ipc_seqlock_read_end(&snap->seq, start)) {
+			// The service wrote while we read, try again.
+			continue;
+		}
+
+		// Might be stale, or never published and all zero.
+		if (timestamp_ns == 0 || now_ns - timestamp_ns > max_age_ns) {
+			return false;
+		}
+
+		got = true;
+	}
+
+	if (!got) {
+		return false;
+	}
+
+	if (!client_io_active || !snap->io_active) {
+		ipc_input_snapshot_mask(out_inputs, input_count);
+	}
+
+	return true;
+}
@@ -0,0 +1,78 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Reading and writing the input snapshots in the shared memory area.
+ * @ingroup ipc_shared
+ */
+
+#pragma once
+
+#include "shared/ipc_protocol.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ *
+ * Service side, callers make sure only one thread writes at a time.
+ *
+ */
+
+/*!
+ * Copy the device's @p inputs into the shared memory @p dst and publish
+ * them as updated at @p timestamp_ns.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_input_snapshot_write(struct ipc_shared_input_snapshot *snap,
+                         struct xrt_input *dst,
+                         const struct xrt_input *inputs,
+                         uint32_t input_count,
+                         int64_t timestamp_ns);
+
+
+/*
+ *
+ * Client side, can be called from any number of threads.
+ *
+ */
+
+/*!
+ * Clear all inputs except for their names, what a client sees when IO is not
+ * active for it or the device. The head pose stays active.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_input_snapshot_mask(struct xrt_input *inputs, uint32_t input_count);
+
+/*!
+ * Copy a consistent snapshot of the inputs in @p src to @p out_inputs and
+ * mask them unless both @p client_io_active and the device's IO is active,
+ * also tells the service that the snapshot is in use.
+ *
+ * Returns false if the snapshot was never published, is older than
+ * @p max_age_ns or the service kept writing while reading. The caller should
+ * then ask the service to update the snapshot, @p out_inputs may have been
+ * partially written to.
+ *
+ * @ingroup ipc_shared
+ */
+bool
+ipc_input_snapshot_read(struct ipc_shared_input_snapshot *snap,
+                        const struct xrt_input *src,
+                        uint32_t input_count,
+                        int64_t now_ns,
+                        int64_t max_age_ns,
+                        bool client_io_active,
+                        struct xrt_input *out_inputs);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,415 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Reading and writing the pose and hand joint rings in the shared memory area.
+ * @ingroup ipc_shared
+ */
+
+#include "math/m_api.h"
+#include "math/m_vec3.h"
+#include "math/m_predict.h"
+
+#include "util/u_time.h"
+
+#include "shared/ipc_pose_ring.h"
+
+#include <string.h>
+#include <assert.h>
+
+
+/*!
+ * How many times readers retry when the service writes at the same time,
+ * it only writes for a few hundred nanoseconds every period so this is
+ * more than plenty.
+ */
+#define READ_TRIES (8)
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static float
+get_amount(int64_t before_ns, int64_t after_ns, int64_t at_timestamp_ns)
+{
+	return (float)(at_timestamp_ns - before_ns) / (float)(after_ns - before_ns);
+}
+
+static void
+interpolate(const struct xrt_space_relation *before,
+            const struct xrt_space_relation *after,
+            float amount,
+            struct xrt_space_relation *out_relation)
+{
+	struct xrt_space_relation result = XRT_SPACE_RELATION_ZERO;
+	result.relation_flags = before->relation_flags & after->relation_flags;
+
+	if ((result.relation_flags & XRT_SPACE_RELATION_POSITION_VALID_BIT) != 0) {
+		result.pose.position = m_vec3_lerp(before->pose.position, after->pose.position, amount);
+	}
+	if ((result.relation_flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT) != 0) {
+		math_quat_slerp(&before->pose.orientation, &after->pose.orientation, amount, &result.pose.orientation);
+	}
+	if ((result.relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT) != 0) {
+		result.linear_velocity = m_vec3_lerp(before->linear_velocity, after->linear_velocity, amount);
+	}
+	if ((result.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT) != 0) {
+		result.angular_velocity = m_vec3_lerp(before->angular_velocity, after->angular_velocity, amount);
+	}
+
+	*out_relation = result;
+}
+
+static void
+interpolate_hand(const struct xrt_hand_joint_set *before,
+                 const struct xrt_hand_joint_set *after,
+                 float amount,
+                 struct xrt_hand_joint_set *out_set)
+{
+	for (uint32_t i = 0; i < XRT_HAND_JOINT_COUNT; i++) {
+		const struct xrt_hand_joint_value *b = &before->values.hand_joint_set_default[i];
+		const struct xrt_hand_joint_value *a = &after->values.hand_joint_set_default[i];
+		struct xrt_hand_joint_value *out = &out_set->values.hand_joint_set_default[i];
+
+		interpolate(&b->relation, &a->relation, amount, &out->relation);
+		out->radius = b->radius + (a->radius - b->radius) * amount;
+	}
+
+	interpolate(&before->hand_pose, &after->hand_pose, amount, &out_set->hand_pose);
+	out_set->is_active = true;
+}
+
+static void
+predict_hand(const struct xrt_hand_joint_set *set, double delta_s, struct xrt_hand_joint_set *out_set)
+{
+	for (uint32_t i = 0; i < XRT_HAND_JOINT_COUNT; i++) {
+		const struct xrt_hand_joint_value *v = &set->values.hand_joint_set_default[i];
+		struct xrt_hand_joint_value *out = &out_set->values.hand_joint_set_default[i];
+
+		m_predict_relation(&v->relation, delta_s, &out->relation);
+		out->radius = v->radius;
+	}
+
+	m_predict_relation(&set->hand_pose, delta_s, &out_set->hand_pose);
+	out_set->is_active = set->is_active;
+}
+
+
+/*
+ *
+ * Service side functions.
+ *
+ */
+
+void
+ipc_pose_ring_push(struct ipc_shared_pose_ring *ring, int64_t timestamp_ns, const struct xrt_space_relation *relation)
+{
+	ipc_seqlock_write_begin(&ring->seq);
+
+	struct ipc_shared_pose_sample *sample = &ring->samples[ring->count % IPC_SHARED_POSE_RING_LEN];
+	sample->timestamp_ns = timestamp_ns;
+	sample->relation = *relation;
+	ring->count++;
+
+	ipc_seqlock_write_end(&ring->seq);
+}
+
+void
+ipc_hand_ring_push(struct ipc_shared_hand_ring *ring, int64_t timestamp_ns, const struct xrt_hand_joint_set *set)
+{
+	ipc_seqlock_write_begin(&ring->seq);
+
+	struct ipc_shared_hand_sample *sample = &ring->samples[ring->count % IPC_SHARED_HAND_RING_LEN];
+	sample->timestamp_ns = timestamp_ns;
+	sample->set = *set;
+	ring->count++;
+
+	ipc_seqlock_write_end(&ring->seq);
+}
+
+void
+ipc_pose_ring_set_io_disabled(struct ipc_shared_pose_ring *ring, bool io_disabled)
+{
+	if (ring->io_disabled == io_disabled) {
+		return;
+	}
+
+	ipc_seqlock_write_begin(&ring->seq);
+	ring->io_disabled = io_disabled;
+	ipc_seqlock_write_end(&ring->seq);
+}
+
+void
+ipc_view_poses_write(struct ipc_shared_view_poses *views,
+                     const struct xrt_vec3 *eye_relation,
+                     uint32_t view_count,
+                     const struct xrt_fov *fovs,
+                     const struct xrt_pose *poses)
+{
+	assert(view_count <= XRT_MAX_VIEWS);
+
+	ipc_seqlock_write_begin(&views->seq);
+
+	views->view_count = view_count;
+	views->eye_relation = *eye_relation;
+	memcpy(views->fovs, fovs, sizeof(*fovs) * view_count);
+	memcpy(views->poses, poses, sizeof(*poses) * view_count);
+
+	ipc_seqlock_write_end(&views->seq);
+}
+
+
+/*
+ *
+ * Client side functions.
+ *
+ */
+
+struct ipc_shared_pose_ring *
+ipc_pose_ring_find(struct ipc_shared_device_poses *isdp, enum xrt_input_name name)
+{
+	for (uint32_t i = 0; i < isdp->ring_count && i < IPC_SHARED_MAX_POSE_RINGS; i++) {
+		if (isdp->rings[i].name == name) {
+			return &isdp->rings[i];
+		}
+	}
+
+	return NULL;
+}
+
+bool
+ipc_pose_ring_locate(struct ipc_shared_pose_ring *ring,
+                     int64_t now_ns,
+                     int64_t max_age_ns,
+                     int64_t at_timestamp_ns,
+                     struct xrt_space_relation *out_relation)
+{
+	// The ring is sampled at now, the future needs the driver's prediction.
+	if (at_timestamp_ns > now_ns) {
+		return false;
+	}
+
+	// Only write when needed, keeps the cache line shared between clients.
+	if (ring->wanted == 0) {
+		ring->wanted = 1;
+	}
+
+	struct ipc_shared_pose_sample before;
+	struct ipc_shared_pose_sample after;
+	bool found = false;
+	bool predict = false;
+
+	for (int tries = 0; tries < READ_TRIES; tries++) {
+		uint32_t start;
+		if (!ipc_seqlock_read_begin(&ring->seq, &start)) {
+			continue;
+		}
+
+		uint32_t count = ring->count;
+		bool io_disabled = ring->io_disabled;
+		uint32_t available = count < IPC_SHARED_POSE_RING_LEN ? count : IPC_SHARED_POSE_RING_LEN;
+
+		found = false;
+		predict = false;
+
+		if (available > 0 && !io_disabled) {
+			after = ring->samples[(count - 1) % IPC_SHARED_POSE_RING_LEN];
+
+			if (at_timestamp_ns >= after.timestamp_ns) {
+				found = true;
+				predict = true;
+			}
+
+			// Walk back from the newest, most queries are close to now.
+			for (uint32_t i = 1; i < available && !found; i++) {
+				before = ring->samples[(count - 1 - i) % IPC_SHARED_POSE_RING_LEN];
+				if (before.timestamp_ns <= at_timestamp_ns) {
+					found = true;
+					break;
+				}
+				after = before;
+			}
+		}
+
+		if (ipc_seqlock_read_end(&ring->seq, start)) {
+			break;
+		}
+
+		// The service wrote while we read, try again.
+		found = false;
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	if (predict) {
+		// The service has stopped publishing, don't predict from old data.
+		if (now_ns - after.timestamp_ns > max_age_ns) {
+			return false;
+		}
+
+		double delta_s = time_ns_to_s(at_timestamp_ns - after.timestamp_ns);
+		m_predict_relation(&after.relation, delta_s, out_relation);
+		return true;
+	}
+
+	float amount = get_amount(before.timestamp_ns, after.timestamp_ns, at_timestamp_ns);
+	interpolate(&before.relation, &after.relation, amount, out_relation);
+	return true;
+}
+
+struct ipc_shared_hand_ring *
+ipc_hand_ring_find(struct ipc_shared_memory *ism, uint32_t device_id, enum xrt_input_name name)
+{
+	for (uint32_t i = 0; i < ism->hand_ring_count && i < IPC_SHARED_MAX_HAND_RINGS; i++) {
+		struct ipc_shared_hand_ring *ring = &ism->hand_rings[i];
+		if (ring->device_id == device_id && ring->name == name) {
+			return ring;
+		}
+	}
+
+	return NULL;
+}
+
+bool
+ipc_hand_ring_locate(struct ipc_shared_hand_ring *ring,
+                     int64_t now_ns,
+                     int64_t max_age_ns,
+                     int64_t at_timestamp_ns,
+                     struct xrt_hand_joint_set *out_set,
+                     int64_t *out_timestamp_ns)
+{
+	// Same as poses, the future needs the driver's prediction.
+	if (at_timestamp_ns > now_ns) {
+		return false;
+	}
+
+	// Only write when needed, keeps the cache line shared between clients.
+	if (ring->wanted == 0) {
+		ring->wanted = 1;
+	}
+
+	// The samples are big, so only copy the ones that are used.
+	struct ipc_shared_hand_sample before;
+	struct ipc_shared_hand_sample after;
+	bool found = false;
+	bool predict = false;
+
+	for (int tries = 0; tries < READ_TRIES; tries++) {
+		uint32_t start;
+		if (!ipc_seqlock_read_begin(&ring->seq, &start)) {
+			continue;
+		}
+
+		uint32_t count = ring->count;
+		uint32_t available = count < IPC_SHARED_HAND_RING_LEN ? count : IPC_SHARED_HAND_RING_LEN;
+
+		found = false;
+		predict = false;
+
+		if (available > 0) {
+			uint32_t newest = (count - 1) % IPC_SHARED_HAND_RING_LEN;
+
+			if (at_timestamp_ns >= ring->samples[newest].timestamp_ns) {
+				after = ring->samples[newest];
+				found = true;
+				predict = true;
+			}
+
+			// Walk back from the newest, most queries are close to now.
+			for (uint32_t i = 1; i < available && !found; i++) {
+				const struct ipc_shared_hand_sample *sample =
+				    &ring->samples[(count - 1 - i) % IPC_SHARED_HAND_RING_LEN];
+				if (sample->timestamp_ns <= at_timestamp_ns) {
+					before = *sample;
+					after = ring->samples[(count - i) % IPC_SHARED_HAND_RING_LEN];
+					found = true;
+				}
+			}
+		}
+
+		if (ipc_seqlock_read_end(&ring->seq, start)) {
+			break;
+		}
+
+		// The service wrote while we read, try again.
+		found = false;
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	if (predict) {
+		// The service has stopped publishing, don't predict from old data.
+		if (now_ns - after.timestamp_ns > max_age_ns) {
+			return false;
+		}
+
+		double delta_s = time_ns_to_s(at_timestamp_ns - after.timestamp_ns);
+		predict_hand(&after.set, delta_s, out_set);
+		*out_timestamp_ns = at_timestamp_ns;
+		return true;
+	}
+
+	// Can't interpolate joints of a hand that wasn't seen, use the closest.
+	if (!before.set.is_active || !after.set.is_active) {
+		bool use_before = at_timestamp_ns - before.timestamp_ns < after.timestamp_ns - at_timestamp_ns;
+		const struct ipc_shared_hand_sample *closest = use_before ? &before : &after;
+
+		*out_set = closest->set;
+		*out_timestamp_ns = closest->timestamp_ns;
+		return true;
+	}
+
+	float amount = get_amount(before.timestamp_ns, after.timestamp_ns, at_timestamp_ns);
+	interpolate_hand(&before.set, &after.set, amount, out_set);
+	*out_timestamp_ns = at_timestamp_ns;
+	return true;
+}
+
+bool
+ipc_view_poses_read(struct ipc_shared_view_poses *views,
+                    const struct xrt_vec3 *eye_relation,
+                    uint32_t view_count,
+                    struct xrt_fov *out_fovs,
+                    struct xrt_pose *out_poses)
+{
+	if (view_count > XRT_MAX_VIEWS) {
+		return false;
+	}
+
+	// Tell the service what we want, only write when it changes.
+	if (views->wanted_view_count != view_count ||
+	    memcmp(&views->wanted_eye_relation, eye_relation, sizeof(*eye_relation)) != 0) {
+		views->wanted_eye_relation = *eye_relation;
+		views->wanted_view_count = view_count;
+	}
+	if (views->wanted == 0) {
+		views->wanted = 1;
+	}
+
+	for (int tries = 0; tries < READ_TRIES; tries++) {
+		uint32_t start;
+		if (!ipc_seqlock_read_begin(&views->seq, &start)) {
+			continue;
+		}
+
+		bool match = views->view_count == view_count &&
+		             memcmp(&views->eye_relation, eye_relation, sizeof(*eye_relation)) == 0;
+		if (match) {
+			memcpy(out_fovs, views->fovs, sizeof(*out_fovs) * view_count);
+			memcpy(out_poses, views->poses, sizeof(*out_poses) * view_count);
+		}
+
+		if (ipc_seqlock_read_end(&views->seq, start)) {
+			return match;
+		}
+	}
+
+	return false;
+}
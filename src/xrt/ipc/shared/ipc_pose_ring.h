@@ -0,0 +1,140 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Reading and writing the pose and hand joint rings in the shared memory area.
+ * @ingroup ipc_shared
+ */
+
+#pragma once
+
+#include "shared/ipc_protocol.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ *
+ * Service side, only ever called from the one publishing thread.
+ *
+ */
+
+/*!
+ * Push a new sample to the ring, the timestamp must be newer than the last.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_pose_ring_push(struct ipc_shared_pose_ring *ring, int64_t timestamp_ns, const struct xrt_space_relation *relation);
+
+/*!
+ * Push a new joint set to the hand ring, the timestamp must be newer than
+ * the last.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_hand_ring_push(struct ipc_shared_hand_ring *ring, int64_t timestamp_ns, const struct xrt_hand_joint_set *set);
+
+/*!
+ * Make clients fall back to asking the service, or let them read again.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_pose_ring_set_io_disabled(struct ipc_shared_pose_ring *ring, bool io_disabled);
+
+/*!
+ * Publish the view fovs and poses sampled with @p eye_relation.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_view_poses_write(struct ipc_shared_view_poses *views,
+                     const struct xrt_vec3 *eye_relation,
+                     uint32_t view_count,
+                     const struct xrt_fov *fovs,
+                     const struct xrt_pose *poses);
+
+
+/*
+ *
+ * Client side, can be called from any number of threads.
+ *
+ */
+
+/*!
+ * Find the ring mirroring @p name, NULL if the service doesn't mirror it.
+ *
+ * @ingroup ipc_shared
+ */
+struct ipc_shared_pose_ring *
+ipc_pose_ring_find(struct ipc_shared_device_poses *isdp, enum xrt_input_name name);
+
+/*!
+ * Interpolate the pose at @p at_timestamp_ns from the ring, also tells the
+ * service that the ring is in use. Between the newest sample and @p now_ns
+ * the pose is predicted, this only bridges the gap to the next publish.
+ *
+ * Returns false if the ring can't answer, it is not published yet, the
+ * newest sample is older than @p max_age_ns, @p at_timestamp_ns is older
+ * than the oldest sample or after @p now_ns, or IO is disabled. The caller
+ * should then ask the service instead, which lets the driver predict.
+ *
+ * @ingroup ipc_shared
+ */
+bool
+ipc_pose_ring_locate(struct ipc_shared_pose_ring *ring,
+                     int64_t now_ns,
+                     int64_t max_age_ns,
+                     int64_t at_timestamp_ns,
+                     struct xrt_space_relation *out_relation);
+
+/*!
+ * Find the hand ring mirroring @p name of the device, NULL if the service
+ * doesn't mirror it.
+ *
+ * @ingroup ipc_shared
+ */
+struct ipc_shared_hand_ring *
+ipc_hand_ring_find(struct ipc_shared_memory *ism, uint32_t device_id, enum xrt_input_name name);
+
+/*!
+ * Interpolate the joint set at @p at_timestamp_ns from the ring, predicting
+ * up to @p now_ns, also tells the service that the ring is in use. Joint sets are only
+ * interpolated if the hand is active in both samples, otherwise the closest
+ * one is used as is.
+ *
+ * Returns false if the ring can't answer, same as @ref ipc_pose_ring_locate.
+ *
+ * @ingroup ipc_shared
+ */
+bool
+ipc_hand_ring_locate(struct ipc_shared_hand_ring *ring,
+                     int64_t now_ns,
+                     int64_t max_age_ns,
+                     int64_t at_timestamp_ns,
+                     struct xrt_hand_joint_set *out_set,
+                     int64_t *out_timestamp_ns);
+
+/*!
+ * Get the published view fovs and poses, also tells the service what to
+ * publish. Returns false if what's published doesn't match @p eye_relation
+ * and @p view_count, the caller should then ask the service instead.
+ *
+ * @ingroup ipc_shared
+ */
+bool
+ipc_view_poses_read(struct ipc_shared_view_poses *views,
+                    const struct xrt_vec3 *eye_relation,
+                    uint32_t view_count,
+                    struct xrt_fov *out_fovs,
+                    struct xrt_pose *out_poses);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -25,6 +25,8 @@
 #include "xrt/xrt_tracking.h"
 #include "xrt/xrt_config_build.h"
 
+#include "shared/ipc_seqlock.h"
+
 #include <sys/types.h>
 
 
@@ -36,12 +38,17 @@
 #define IPC_MAX_LAYERS XRT_MAX_LAYERS
 #define IPC_MAX_SLOTS 128
 #define IPC_MAX_CLIENTS 8
+#define IPC_MAX_CLIENT_SWAPCHAINS (XRT_MAX_LAYERS * 2)
 #define IPC_MAX_RAW_VIEWS 32 // Max views that we can get, artificial limit.
 #define IPC_EVENT_QUEUE_SIZE 32
 
 #define IPC_SHARED_MAX_INPUTS 1024
 #define IPC_SHARED_MAX_OUTPUTS 128
 #define IPC_SHARED_MAX_BINDINGS 64
+#define IPC_SHARED_MAX_POSE_RINGS 4 // max pose inputs per device mirrored into shared mem
+#define IPC_SHARED_POSE_RING_LEN 16
+#define IPC_SHARED_MAX_HAND_RINGS 4 // max hand tracking inputs mirrored into shared mem, all devices
+#define IPC_SHARED_HAND_RING_LEN 8
 
 // example: v21.0.0-560-g586d33b5
 #define IPC_VERSION_NAME_LEN 64
@@ -140,6 +147,220 @@ struct ipc_shared_device
 	bool battery_status_supported;
 };
 
+/*!
+ * A sample in a @ref ipc_shared_pose_ring.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_pose_sample
+{
+	int64_t timestamp_ns;
+	struct xrt_space_relation relation;
+};
+
+/*!
+ * Recent poses of one pose input, published by the service so clients can
+ * interpolate or predict locally instead of doing a round trip, see
+ * ipc_pose_ring.h for the reading and writing.
+ *
+ * The service only publishes rings that clients have asked for recently,
+ * by setting @ref wanted.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_pose_ring
+{
+	//! Which input this ring mirrors, zero if unused.
+	enum xrt_input_name name;
+
+	//! Written by the service, guards everything below it.
+	ipc_seqlock_t seq;
+
+	/*!
+	 * Set by the service while IO is disabled for the device, clients
+	 * check their own IO state in @ref ipc_shared_memory::client_io_active.
+	 */
+	bool io_disabled;
+
+	//! Total number of samples published, newest is at `(count - 1) % IPC_SHARED_POSE_RING_LEN`.
+	uint32_t count;
+
+	struct ipc_shared_pose_sample samples[IPC_SHARED_POSE_RING_LEN];
+
+	//! Set by clients when reading, cleared by the service.
+	volatile uint32_t wanted;
+};
+
+/*!
+ * The view fovs and poses of a HMD device for one client, the head relation
+ * comes from the ring of the head pose input. Those rarely change so only the
+ * newest ones are published. Clients can use different eye relations, so
+ * each has its own.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_view_poses
+{
+	//! Written by the service, guards everything below it.
+	ipc_seqlock_t seq;
+
+	//! Zero until the service has published any views.
+	uint32_t view_count;
+
+	//! The eye relation the views were sampled with.
+	struct xrt_vec3 eye_relation;
+
+	struct xrt_fov fovs[XRT_MAX_VIEWS];
+	struct xrt_pose poses[XRT_MAX_VIEWS];
+
+	/*!
+	 * Set by clients, what they want published. Not guarded by anything,
+	 * clients check that what they get matches what they asked for.
+	 *
+	 * @{
+	 */
+	volatile uint32_t wanted_view_count;
+	struct xrt_vec3 wanted_eye_relation;
+	//! @}
+
+	//! Set by clients when reading, cleared by the service.
+	volatile uint32_t wanted;
+};
+
+/*!
+ * A sample in a @ref ipc_shared_hand_ring.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_hand_sample
+{
+	int64_t timestamp_ns;
+	struct xrt_hand_joint_set set;
+};
+
+/*!
+ * Recent joint sets of one hand tracking input, works like
+ * @ref ipc_shared_pose_ring but the joint sets are too big to have a ring
+ * for every device, so there are only a few shared by all devices.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_hand_ring
+{
+	//! Which device this ring mirrors.
+	uint32_t device_id;
+
+	//! Which input this ring mirrors, zero if unused.
+	enum xrt_input_name name;
+
+	//! Written by the service, guards everything below it.
+	ipc_seqlock_t seq;
+
+	//! Total number of samples published, newest is at `(count - 1) % IPC_SHARED_HAND_RING_LEN`.
+	uint32_t count;
+
+	struct ipc_shared_hand_sample samples[IPC_SHARED_HAND_RING_LEN];
+
+	//! Set by clients when reading, cleared by the service.
+	volatile uint32_t wanted;
+};
+
+/*!
+ * Mirrored tracking data for a single device.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_device_poses
+{
+	//! Number of rings in use, the first ones.
+	uint32_t ring_count;
+
+	struct ipc_shared_pose_ring rings[IPC_SHARED_MAX_POSE_RINGS];
+
+	//! Only used for HMD devices, indexed by client slot.
+	struct ipc_shared_view_poses views[IPC_MAX_CLIENTS];
+};
+
+/*!
+ * The latest input state of one device, published by the service so that
+ * clients can copy it out without a round trip, see ipc_input_snapshot.h.
+ * The inputs themselves are in @ref ipc_shared_memory::inputs starting at
+ * the device's @ref ipc_shared_device::first_input_index.
+ *
+ * The inputs are never masked, the service shares them between all clients
+ * so each client applies its own and the device's IO state when copying.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_input_snapshot
+{
+	//! Written by the service, guards this and the device's inputs.
+	ipc_seqlock_t seq;
+
+	//! When the inputs were last updated, zero if never.
+	int64_t timestamp_ns;
+
+	//! Set by the service when IO for the device is toggled.
+	volatile bool io_active;
+
+	//! Set by clients when reading, cleared by the service.
+	volatile uint32_t wanted;
+};
+
+/*!
+ * Number of acquires and releases a client can record in a swapchain
+ * image queue before the service has to replay them.
+ *
+ * @ingroup ipc
+ */
+#define IPC_SWAPCHAIN_QUEUE_MAX_OPS (XRT_MAX_SWAPCHAIN_IMAGES * 2)
+
+//! Set in @ref ipc_shared_swapchain_queue::ops for a release, otherwise an acquire.
+#define IPC_SWAPCHAIN_QUEUE_OP_RELEASE (1u << 31)
+
+/*!
+ * The image index state of one swapchain, so that clients can acquire and
+ * release images without a round trip to the service, see
+ * ipc_swapchain_queue.h for the reading and writing.
+ *
+ * The service swapchain stays authoritative: every acquire and release is
+ * also recorded in @ref ops, and the service replays them on its swapchain
+ * before anything that looks at the images, like waiting on an image or a
+ * layer sync. Waiting on an image always goes to the service, which knows
+ * when the compositor is done with it.
+ *
+ * Released images are acquired oldest first, like the service side
+ * swapchains do.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_swapchain_queue
+{
+	//! Number of images in the swapchain, zero if the queue is unused.
+	uint32_t image_count;
+
+	//! Total number of images acquired, the next is at `acquired % XRT_MAX_SWAPCHAIN_IMAGES`.
+	volatile uint32_t acquired;
+
+	//! Total number of images released, including the initial ones.
+	volatile uint32_t released;
+
+	//! Image indices in the order they were released.
+	volatile uint32_t indices[XRT_MAX_SWAPCHAIN_IMAGES];
+
+	//! Which images are acquired and not yet released, by image index.
+	volatile bool image_acquired[XRT_MAX_SWAPCHAIN_IMAGES];
+
+	//! Total number of operations recorded by the client.
+	volatile uint32_t ops_recorded;
+
+	//! Total number of operations replayed by the service.
+	volatile uint32_t ops_replayed;
+
+	//! Image index of each operation, or'ed with @ref IPC_SWAPCHAIN_QUEUE_OP_RELEASE for releases.
+	volatile uint32_t ops[IPC_SWAPCHAIN_QUEUE_MAX_OPS];
+};
+
 /*!
  * Data for a single composition layer.
  *
@@ -269,6 +490,10 @@ struct ipc_shared_memory
 		uint32_t blend_mode_count;
 	} hmd;
 
+	/*!
+	 * The inputs of all devices, each device's range is guarded by its
+	 * @ref ipc_shared_input_snapshot::seq.
+	 */
 	struct xrt_input inputs[IPC_SHARED_MAX_INPUTS];
 
 	struct xrt_output outputs[IPC_SHARED_MAX_OUTPUTS];
@@ -279,6 +504,45 @@ struct ipc_shared_memory
 
 	struct ipc_layer_slot slots[IPC_MAX_SLOTS];
 
+	/*!
+	 * Tracking data of the devices, indexed like @ref isdevs.
+	 */
+	struct ipc_shared_device_poses device_poses[XRT_SYSTEM_MAX_DEVICES];
+
+	//! Number of rings in use, the first ones.
+	uint32_t hand_ring_count;
+
+	/*!
+	 * Hand joint rings of all devices, clients find theirs by device and
+	 * input name.
+	 */
+	struct ipc_shared_hand_ring hand_rings[IPC_SHARED_MAX_HAND_RINGS];
+
+	/*!
+	 * Input snapshots of the devices, indexed like @ref isdevs.
+	 */
+	struct ipc_shared_input_snapshot input_snapshots[XRT_SYSTEM_MAX_DEVICES];
+
+	/*!
+	 * Is IO active for the client in that slot, clients are told their
+	 * slot when they describe themselves.
+	 */
+	volatile bool client_io_active[IPC_MAX_CLIENTS];
+
+	/*!
+	 * How often the service publishes to the pose rings and input
+	 * snapshots, zero if it doesn't and clients must always ask the
+	 * service.
+	 */
+	int64_t pose_ring_period_ns;
+
+	/*!
+	 * Image queues of all swapchains of all clients, indexed by the
+	 * client slot times @ref IPC_MAX_CLIENT_SWAPCHAINS plus the swapchain
+	 * id. Clients get the index when creating or importing a swapchain.
+	 */
+	struct ipc_shared_swapchain_queue swapchain_queues[IPC_MAX_CLIENTS * IPC_MAX_CLIENT_SWAPCHAINS];
+
 	uint64_t startup_timestamp;
 };
 
@@ -0,0 +1,139 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Sequence lock for data in the shared memory area.
+ * @ingroup ipc_shared
+ */
+
+#pragma once
+
+#include "xrt/xrt_compiler.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * A sequence lock, for data with one writer and any number of readers that
+ * must never block the writer, like the service publishing into the shared
+ * memory area. It is odd while the writer is writing, readers copy the data
+ * out and retry if the sequence changed while they did.
+ *
+ * Readers must only copy the data, never follow pointers or index using it
+ * without clamping, because what they read may be torn.
+ *
+ * @ingroup ipc_shared
+ */
+typedef volatile uint32_t ipc_seqlock_t;
+
+static inline uint32_t
+ipc_seqlock_load_acquire(const ipc_seqlock_t *seq)
+{
+#if defined(__GNUC__)
+	return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER)
+	uint32_t ret = *seq;
+	_ReadWriteBarrier();
+	return ret;
+#else
+#error "compiler not supported"
+#endif
+}
+
+static inline void
+ipc_seqlock_store_release(ipc_seqlock_t *seq, uint32_t value)
+{
+#if defined(__GNUC__)
+	__atomic_store_n(seq, value, __ATOMIC_RELEASE);
+#elif defined(_MSC_VER)
+	_ReadWriteBarrier();
+	*seq = value;
+#else
+#error "compiler not supported"
+#endif
+}
+
+static inline void
+ipc_seqlock_fence_acquire(void)
+{
+#if defined(__GNUC__)
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER)
+	_ReadWriteBarrier();
+#else
+#error "compiler not supported"
+#endif
+}
+
+static inline void
+ipc_seqlock_fence_release(void)
+{
+#if defined(__GNUC__)
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+#elif defined(_MSC_VER)
+	_ReadWriteBarrier();
+#else
+#error "compiler not supported"
+#endif
+}
+
+/*!
+ * Start writing, only one writer at a time.
+ *
+ * @ingroup ipc_shared
+ */
+static inline void
+ipc_seqlock_write_begin(ipc_seqlock_t *seq)
+{
+	ipc_seqlock_store_release(seq, *seq + 1);
+	ipc_seqlock_fence_release();
+}
+
+/*!
+ * Done writing, publishes the data to readers.
+ *
+ * @ingroup ipc_shared
+ */
+static inline void
+ipc_seqlock_write_end(ipc_seqlock_t *seq)
+{
+	ipc_seqlock_store_release(seq, *seq + 1);
+}
+
+/*!
+ * Start reading, returns false if a write is in progress, then the caller
+ * should try again later instead of spinning on the writer.
+ *
+ * @ingroup ipc_shared
+ */
+static inline bool
+ipc_seqlock_read_begin(const ipc_seqlock_t *seq, uint32_t *out_start)
+{
+	uint32_t start = ipc_seqlock_load_acquire(seq);
+	*out_start = start;
+	return (start & 1) == 0;
+}
+
+/*!
+ * Returns true if the data read since @ref ipc_seqlock_read_begin is
+ * consistent, false if it was written to and must be read again.
+ *
+ * @ingroup ipc_shared
+ */
+static inline bool
+ipc_seqlock_read_end(const ipc_seqlock_t *seq, uint32_t start)
+{
+	ipc_seqlock_fence_acquire();
+	return *seq == start;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,159 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Swapchain image queues in the shared memory area.
+ * @ingroup ipc_shared
+ */
+
+#include "shared/ipc_swapchain_queue.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+
+/*
+ *
+ * Service side functions.
+ *
+ */
+
+void
+ipc_swapchain_queue_init(struct ipc_shared_swapchain_queue *queue, uint32_t image_count)
+{
+	assert(image_count <= XRT_MAX_SWAPCHAIN_IMAGES);
+
+	for (uint32_t i = 0; i < XRT_MAX_SWAPCHAIN_IMAGES; i++) {
+		queue->indices[i] = i;
+		queue->image_acquired[i] = false;
+	}
+
+	queue->acquired = 0;
+	queue->released = image_count;
+	queue->ops_recorded = 0;
+	queue->ops_replayed = 0;
+
+	// Last, makes everything above visible to the client.
+	ipc_seqlock_store_release(&queue->image_count, image_count);
+}
+
+void
+ipc_swapchain_queue_fini(struct ipc_shared_swapchain_queue *queue)
+{
+	ipc_seqlock_store_release(&queue->image_count, 0);
+}
+
+xrt_result_t
+ipc_swapchain_queue_replay(struct ipc_shared_swapchain_queue *queue, struct xrt_swapchain *xsc)
+{
+	uint32_t replayed = queue->ops_replayed;
+	uint32_t recorded = ipc_seqlock_load_acquire(&queue->ops_recorded);
+
+	// The client can't have recorded more than fits, the queue is broken.
+	if (recorded - replayed > IPC_SWAPCHAIN_QUEUE_MAX_OPS) {
+		ipc_seqlock_store_release(&queue->ops_replayed, recorded);
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	xrt_result_t xret = XRT_SUCCESS;
+	for (; replayed != recorded && xret == XRT_SUCCESS; replayed++) {
+		uint32_t op = queue->ops[replayed % IPC_SWAPCHAIN_QUEUE_MAX_OPS];
+		uint32_t index = op & ~IPC_SWAPCHAIN_QUEUE_OP_RELEASE;
+
+		if (index >= xsc->image_count) {
+			xret = XRT_ERROR_IPC_FAILURE;
+		} else if ((op & IPC_SWAPCHAIN_QUEUE_OP_RELEASE) != 0) {
+			xret = xrt_swapchain_release_image(xsc, index);
+		} else {
+			uint32_t acquired_index = 0;
+			xret = xrt_swapchain_acquire_image(xsc, &acquired_index);
+
+			// Both sides hand out the oldest released image, so this is the same image.
+			if (xret == XRT_SUCCESS && acquired_index != index) {
+				xret = XRT_ERROR_IPC_FAILURE;
+			}
+		}
+	}
+
+	// On error the rest is dropped, there is no getting back in step.
+	ipc_seqlock_store_release(&queue->ops_replayed, recorded);
+
+	return xret;
+}
+
+
+/*
+ *
+ * Client side functions.
+ *
+ */
+
+//! Record an operation for the service to replay, the caller has checked that there is room.
+static void
+record_op(struct ipc_shared_swapchain_queue *queue, uint32_t op)
+{
+	uint32_t recorded = queue->ops_recorded;
+
+	queue->ops[recorded % IPC_SWAPCHAIN_QUEUE_MAX_OPS] = op;
+
+	// Makes the operation visible to the service.
+	ipc_seqlock_store_release(&queue->ops_recorded, recorded + 1);
+}
+
+bool
+ipc_swapchain_queue_needs_replay(struct ipc_shared_swapchain_queue *queue)
+{
+	uint32_t replayed = ipc_seqlock_load_acquire(&queue->ops_replayed);
+
+	return queue->ops_recorded - replayed >= IPC_SWAPCHAIN_QUEUE_MAX_OPS;
+}
+
+xrt_result_t
+ipc_swapchain_queue_acquire(struct ipc_shared_swapchain_queue *queue, uint32_t *out_index)
+{
+	if (ipc_swapchain_queue_needs_replay(queue)) {
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	uint32_t acquired = queue->acquired;
+	uint32_t released = queue->released;
+
+	if (acquired == released) {
+		return XRT_ERROR_NO_IMAGE_AVAILABLE;
+	}
+
+	uint32_t index = queue->indices[acquired % XRT_MAX_SWAPCHAIN_IMAGES];
+	assert(!queue->image_acquired[index]);
+	queue->image_acquired[index] = true;
+	queue->acquired = acquired + 1;
+
+	record_op(queue, index);
+
+	*out_index = index;
+
+	return XRT_SUCCESS;
+}
+
+xrt_result_t
+ipc_swapchain_queue_release(struct ipc_shared_swapchain_queue *queue, uint32_t index)
+{
+	uint32_t image_count = queue->image_count;
+	uint32_t released = queue->released;
+
+	// Either an invalid index or not an image we have acquired.
+	if (index >= image_count || !queue->image_acquired[index]) {
+		return XRT_ERROR_NO_IMAGE_AVAILABLE;
+	}
+
+	if (ipc_swapchain_queue_needs_replay(queue)) {
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	queue->image_acquired[index] = false;
+	queue->indices[released % XRT_MAX_SWAPCHAIN_IMAGES] = index;
+	queue->released = released + 1;
+
+	record_op(queue, index | IPC_SWAPCHAIN_QUEUE_OP_RELEASE);
+
+	return XRT_SUCCESS;
+}
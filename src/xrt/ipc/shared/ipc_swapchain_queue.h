@@ -0,0 +1,96 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Swapchain image queues in the shared memory area.
+ * @ingroup ipc_shared
+ */
+
+#pragma once
+
+#include "shared/ipc_protocol.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ *
+ * Service side.
+ *
+ */
+
+/*!
+ * Set up the queue for a new swapchain, all images start out released in
+ * index order.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_swapchain_queue_init(struct ipc_shared_swapchain_queue *queue, uint32_t image_count);
+
+/*!
+ * Mark the queue as unused, the swapchain has been destroyed.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_swapchain_queue_fini(struct ipc_shared_swapchain_queue *queue);
+
+/*!
+ * Replay the acquires and releases the client has recorded since the last
+ * call on the service swapchain, in order. Must be called before anything
+ * that depends on which images the client holds.
+ *
+ * On error the remaining operations are dropped.
+ *
+ * @ingroup ipc_shared
+ */
+xrt_result_t
+ipc_swapchain_queue_replay(struct ipc_shared_swapchain_queue *queue, struct xrt_swapchain *xsc);
+
+
+/*
+ *
+ * Client side, same threading rules as @ref xrt_swapchain.
+ *
+ */
+
+/*!
+ * Is there no more room to record operations, the service has to replay
+ * them before the client can acquire or release again.
+ *
+ * @ingroup ipc_shared
+ */
+bool
+ipc_swapchain_queue_needs_replay(struct ipc_shared_swapchain_queue *queue);
+
+/*!
+ * Get the image that was released the longest time ago.
+ *
+ * Returns @ref XRT_ERROR_NO_IMAGE_AVAILABLE if all images are acquired, and
+ * @ref XRT_ERROR_IPC_FAILURE if @ref ipc_swapchain_queue_needs_replay.
+ *
+ * @ingroup ipc_shared
+ */
+xrt_result_t
+ipc_swapchain_queue_acquire(struct ipc_shared_swapchain_queue *queue, uint32_t *out_index);
+
+/*!
+ * Give back an acquired image.
+ *
+ * Returns @ref XRT_ERROR_NO_IMAGE_AVAILABLE if the index is out of range
+ * or that image isn't acquired, and @ref XRT_ERROR_IPC_FAILURE if
+ * @ref ipc_swapchain_queue_needs_replay.
+ *
+ * @ingroup ipc_shared
+ */
+xrt_result_t
+ipc_swapchain_queue_release(struct ipc_shared_swapchain_queue *queue, uint32_t index);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -264,6 +264,15 @@ class Call:
             args.extend(self.out_handles.arg_decls)
         write_decl(f, 'xrt_result_t', 'ipc_call_' + self.name, args)
 
+    def write_batch_add_decl(self, f):
+        """Write declaration of ipc_batch_add_CALLNAME."""
+        args = ["struct ipc_client_batch *batch"]
+        args.extend(arg.get_func_argument_in() for arg in self.in_args)
+        if self.in_handles:
+            args.extend(self.in_handles.const_arg_decls)
+        args.extend(arg.get_func_argument_out() for arg in self.out_args)
+        write_decl(f, 'xrt_result_t', 'ipc_batch_add_' + self.name, args)
+
     def write_handler_decl(self, f):
         """Write declaration of ipc_handle_CALLNAME."""
         args = ["volatile struct ipc_client_state *ics"]
@@ -296,6 +305,7 @@ class Call:
         self.in_handles = None
         self.out_handles = None
         self.varlen = False
+        self.batchable = False
         for key, val in data.items():
             if key == 'id':
                 self.id = val
@@ -309,12 +319,16 @@ class Call:
                 self.in_handles = HandleType(val)
             elif key == 'varlen':
                 self.varlen = val
+            elif key == 'batchable':
+                self.batchable = val
             else:
                 raise RuntimeError("Unrecognized key")
         if not self.id:
             self.id = "IPC_" + name.upper()
         if self.varlen and (self.in_handles or self.out_handles):
             raise Exception("Can not have handles with varlen functions")
+        if self.batchable and (self.varlen or self.out_handles):
+            raise Exception("Can not batch varlen functions or functions returning handles")
 
 
 class Proto:
@@ -341,3 +355,24 @@ class Proto:
         self.calls = [Call(name, call) for name, call
                       in data.items()
                       if not name.startswith("$")]
+
+        # All handles in a batch are sent together, so they must share a type.
+        batch_handles = set(call.in_handles.typename
+                            for call in self.batchable_calls
+                            if call.in_handles)
+        if len(batch_handles) > 1:
+            raise Exception("Batchable functions must all take the same handle type")
+        self.batch_in_handles = None
+        for call in self.batchable_calls:
+            if call.in_handles:
+                self.batch_in_handles = call.in_handles
+
+    @property
+    def batchable_calls(self):
+        """Get the calls that can be sent in a batch."""
+        return [call for call in self.calls if call.batchable]
+
+    @property
+    def batch_max_out_args(self):
+        """Get the largest number of out arguments of any batchable call."""
+        return max([len(call.out_args) for call in self.batchable_calls] + [1])
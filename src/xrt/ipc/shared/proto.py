@@ -10,6 +10,11 @@ from ipcproto.common import (Proto, write_decl, write_invocation,
                              write_cpp_header_guard_end, write_msg_struct,
                              write_reply_struct, write_msg_send)
 
+# Keep sizeof(struct ipc_batch_msg) below IPC_BUF_SIZE.
+BATCH_MAX_CALLS = 16
+BATCH_MAX_MSG_SIZE = 384
+BATCH_MAX_REPLY_SIZE = 1024
+
 header = '''// Copyright 2020-2023, Collabora, Ltd.
 // SPDX-License-Identifier: BSL-1.0
 /*!
@@ -156,6 +161,7 @@ struct ipc_connection;
     f.write('\n\tIPC_ERR = 0,')
     for call in p.calls:
         f.write("\n\t" + call.id + ",")
+    f.write("\n\tIPC_BATCH,")
     f.write("\n} ipc_command_t;\n")
 
     f.write('''
@@ -178,9 +184,25 @@ struct ipc_result_reply
     f.write('\n\tcase IPC_ERR: return "IPC_ERR";')
     for call in p.calls:
         f.write('\n\tcase ' + call.id + ': return "' + call.id + '";')
+    f.write('\n\tcase IPC_BATCH: return "IPC_BATCH";')
     f.write('\n\tdefault: return "IPC_UNKNOWN";')
     f.write('\n\t}\n}\n')
 
+    f.write('''
+//! Max number of calls in a @ref ipc_batch_msg.
+#define IPC_BATCH_MAX_CALLS %d
+
+//! Max total size of the calls' msg structs in a @ref ipc_batch_msg.
+#define IPC_BATCH_MAX_MSG_SIZE %d
+
+//! Max total size of the replies to a @ref ipc_batch_msg.
+#define IPC_BATCH_MAX_REPLY_SIZE %d
+
+//! Max number of out arguments of any call that can be batched.
+#define IPC_BATCH_MAX_OUT_ARGS %d
+
+''' % (BATCH_MAX_CALLS, BATCH_MAX_MSG_SIZE, BATCH_MAX_REPLY_SIZE, p.batch_max_out_args))
+
     f.write('#pragma pack (push, 1)')
 
     for call in p.calls:
@@ -204,12 +226,100 @@ struct ipc_result_reply
                 f.write('\t' + arg.get_struct_field() + ';\n')
             f.write('};\n')
 
+    f.write('''
+/*!
+ * Several calls sent as one message, the calls' msg structs follow each
+ * other in @p msgs. The replies are sent back the same way, as one message
+ * of @p reply_size bytes.
+ */
+struct ipc_batch_msg
+{
+\tenum ipc_command cmd;
+\tuint32_t call_count;
+\tuint32_t msg_size;
+\tuint32_t reply_size;
+\tuint32_t handle_count;
+\tuint8_t msgs[IPC_BATCH_MAX_MSG_SIZE];
+};
+''')
+
     f.write('#pragma pack (pop)\n')
 
+    write_batch_size_helpers(f, p)
+
     write_cpp_header_guard_end(f)
     f.close()
 
 
+def write_batch_size_helpers(f, p):
+    """Write size lookups for the calls that can be put in a batch."""
+    write_decl(f, return_type='static inline size_t',
+        function_name='ipc_batch_call_msg_size', args=['ipc_command_t id'])
+    f.write('\n{')
+    f.write('\n\tswitch (id) {')
+    for call in p.batchable_calls:
+        if call.needs_msg_struct:
+            f.write('\n\tcase %s: return sizeof(struct ipc_%s_msg);' % (call.id, call.name))
+        else:
+            f.write('\n\tcase %s: return sizeof(struct ipc_command_msg);' % call.id)
+    f.write('\n\tdefault: return 0; // Not allowed in a batch.')
+    f.write('\n\t}\n}\n')
+
+    write_decl(f, return_type='static inline size_t',
+        function_name='ipc_batch_call_reply_size', args=['ipc_command_t id'])
+    f.write('\n{')
+    f.write('\n\tswitch (id) {')
+    for call in p.batchable_calls:
+        if call.out_args:
+            f.write('\n\tcase %s: return sizeof(struct ipc_%s_reply);' % (call.id, call.name))
+        else:
+            f.write('\n\tcase %s: return sizeof(struct ipc_result_reply);' % call.id)
+    f.write('\n\tdefault: return 0; // Not allowed in a batch.')
+    f.write('\n\t}\n}\n')
+
+
+def write_batch_add_definition(f, call):
+    """Write a ipc_batch_add_CALLNAME function."""
+    call.write_batch_add_decl(f)
+    f.write("\n{\n")
+
+    write_msg_struct(f, call, '\t')
+
+    f.write("\tvoid *_outs[IPC_BATCH_MAX_OUT_ARGS] = {0};\n")
+    for i, arg in enumerate(call.out_args):
+        f.write("\t_outs[%d] = out_%s;\n" % (i, arg.name))
+
+    args = ['batch', '&_msg', 'sizeof(_msg)', '_outs']
+    if call.in_handles:
+        args.extend(call.in_handles.arg_names)
+    else:
+        args.extend(('NULL', '0'))
+    write_invocation(f, 'xrt_result_t ret', 'ipc_client_batch_add', args, indent="\t")
+    f.write(";\n")
+    f.write("\n\treturn ret;\n}\n")
+
+
+def write_batch_unpack_definition(f, p):
+    """Write the function copying replies in a batch to the out arguments."""
+    write_decl(f, 'xrt_result_t', 'ipc_batch_unpack_reply',
+               ['ipc_command_t cmd', 'const void *reply', 'void *const *outs'])
+    f.write("\n{\n")
+    f.write("\tswitch (cmd) {\n")
+    for call in p.batchable_calls:
+        f.write("\tcase " + call.id + ": {\n")
+        if call.out_args:
+            f.write("\t\tstruct ipc_%s_reply _reply;\n" % call.name)
+        else:
+            f.write("\t\tstruct ipc_result_reply _reply;\n")
+        f.write("\t\tmemcpy(&_reply, reply, sizeof(_reply));\n")
+        for i, arg in enumerate(call.out_args):
+            f.write("\t\t*(%s *)outs[%d] = _reply.%s;\n" % (arg.typename, i, arg.name))
+        f.write("\t\treturn _reply.result;\n")
+        f.write("\t}\n")
+    f.write("\tdefault: return XRT_ERROR_IPC_FAILURE;\n")
+    f.write("\t}\n}\n")
+
+
 def generate_client_c(file, p):
     """Generate IPC client proxy source."""
     f = open(file, "w")
@@ -217,6 +327,9 @@ def generate_client_c(file, p):
     f.write('''
 #include "client/ipc_client.h"
 #include "ipc_protocol_generated.h"
+#include "ipc_client_generated.h"
+
+#include <string.h>
 
 
 \n''')
@@ -229,6 +342,11 @@ def generate_client_c(file, p):
         else:
             write_call_definition(f, call)
 
+    for call in p.batchable_calls:
+        write_batch_add_definition(f, call)
+
+    write_batch_unpack_definition(f, p)
+
     f.close()
 
 
@@ -259,6 +377,64 @@ def generate_client_h(file, p):
             call.write_call_decl(f)
         f.write(";\n")
 
+    handle_type = 'xrt_graphics_sync_handle_t'
+    if p.batch_in_handles:
+        handle_type = p.batch_in_handles.typename
+
+    f.write('''
+/*!
+ * Calls to be sent in one message, fill it with the ipc_batch_add_* functions
+ * and send it with @ref ipc_client_batch_submit. The out arguments and
+ * handles given to the add functions must stay valid until then.
+ */
+struct ipc_client_batch
+{
+\t//! Sent as is, the calls' msg structs are appended to it.
+\tstruct ipc_batch_msg msg;
+
+\t//! Handles of the call taking handles, only one such call per batch.
+\tconst %s *handles;
+
+\tstruct
+\t{
+\t\tipc_command_t cmd;
+\t\tvoid *outs[IPC_BATCH_MAX_OUT_ARGS];
+
+\t\t//! Set by @ref ipc_client_batch_submit.
+\t\txrt_result_t result;
+\t} calls[IPC_BATCH_MAX_CALLS];
+};
+
+/*!
+ * Append a call to the batch, used by the generated ipc_batch_add_* functions.
+ */
+xrt_result_t
+ipc_client_batch_add(struct ipc_client_batch *batch,
+                     const void *msg,
+                     size_t msg_size,
+                     void *const *outs,
+                     const %s *handles,
+                     uint32_t handle_count);
+
+/*!
+ * Send all of the calls in the batch in one message and wait for all of
+ * the replies, the out arguments and the per call results are written. If
+ * sending or receiving fails every call's result is that error.
+ *
+ * @return The first error, either sending or from any of the calls.
+ */
+xrt_result_t
+ipc_client_batch_submit(struct ipc_connection *ipc_c, struct ipc_client_batch *batch);
+''' % (handle_type, handle_type))
+
+    for call in p.batchable_calls:
+        call.write_batch_add_decl(f)
+        f.write(";\n")
+
+    write_decl(f, 'xrt_result_t', 'ipc_batch_unpack_reply',
+               ['ipc_command_t cmd', 'const void *reply', 'void *const *outs'])
+    f.write(";\n")
+
     write_cpp_header_guard_end(f)
     f.close()
 
@@ -275,10 +451,16 @@ def generate_server_c(file, p):
 
 #include "server/ipc_server.h"
 
+#include "util/u_handles.h"
+
 #include "ipc_server_generated.h"
 
+#include <string.h>
+
 ''')
 
+    write_batch_dispatch(f, p)
+
     f.write('''
 xrt_result_t
 ipc_dispatch(volatile struct ipc_client_state *ics, ipc_command_t *ipc_command)
@@ -406,6 +588,10 @@ ipc_dispatch(volatile struct ipc_client_state *ics, ipc_command_t *ipc_command)
 
         f.write("\n\t\treturn xret;\n")
         f.write("\t}\n")
+    f.write("\tcase IPC_BATCH: {\n")
+    f.write("\t\tIPC_TRACE(ics->server, \"Dispatching batch\");\n\n")
+    f.write("\t\treturn ipc_dispatch_batch(ics, (struct ipc_batch_msg *)ipc_command);\n")
+    f.write("\t}\n")
     f.write('''\tdefault:
 \t\tU_LOG_E("UNHANDLED IPC MESSAGE! %d", *ipc_command);
 \t\treturn XRT_ERROR_IPC_FAILURE;
@@ -427,6 +613,7 @@ ipc_command_size(const enum ipc_command cmd)
         else:
             f.write("\tcase " + call.id + ": return sizeof(enum ipc_command);\n")
 
+    f.write("\tcase IPC_BATCH: return sizeof(struct ipc_batch_msg);\n")
     f.write('''\tdefault:
 \t\tU_LOG_E("UNHANDLED IPC COMMAND! %d", cmd);
 \t\treturn 0;
@@ -438,6 +625,181 @@ ipc_command_size(const enum ipc_command cmd)
     f.close()
 
 
+def write_batch_dispatch_call(f, p):
+    """Write the dispatch of a single call in a batch, the reply is not sent."""
+    handles = p.batch_in_handles
+    args = ["volatile struct ipc_client_state *ics",
+            "ipc_command_t *ipc_command"]
+    if handles:
+        args.extend(("const %s *in_handles" % handles.typename,
+                     "uint32_t *in_handle_count"))
+    args.append("void *out_reply")
+    write_decl(f, 'static xrt_result_t', 'ipc_dispatch_batch_call', args)
+    f.write("\n{\n")
+    f.write("\tswitch (*ipc_command) {\n")
+
+    for call in p.batchable_calls:
+        f.write("\tcase " + call.id + ": {\n")
+        f.write("\t\tIPC_TRACE(ics->server, \"Dispatching batched " + call.name + "\");\n\n")
+
+        if call.needs_msg_struct:
+            f.write("\t\tstruct ipc_{0}_msg *msg = (struct ipc_{0}_msg *)ipc_command;\n".format(call.name))
+        if call.out_args:
+            f.write("\t\tstruct ipc_%s_reply reply = {0};\n" % call.name)
+        else:
+            f.write("\t\tstruct ipc_result_reply reply = {0};\n")
+
+        if call.in_handles:
+            # The handles sent with the batch belong to this call, only once.
+            f.write("\n\t\tif (msg->%s != *in_handle_count) {\n" % call.in_handles.count_arg_name)
+            f.write("\t\t\treturn XRT_ERROR_IPC_FAILURE;\n")
+            f.write("\t\t}\n")
+            f.write("\t\t*in_handle_count = 0;\n")
+
+        args = ["ics"]
+        for arg in call.in_args:
+            args.append(("&msg->" + arg.name)
+                        if arg.is_aggregate
+                        else ("msg->" + arg.name))
+        args.extend("&reply." + arg.name for arg in call.out_args)
+        if call.in_handles:
+            args.extend(("in_handles",
+                         "msg->" + call.in_handles.count_arg_name))
+
+        write_invocation(f, 'reply.result', 'ipc_handle_' + call.name, args, indent="\t\t")
+        f.write(";\n\n")
+        f.write("\t\tmemcpy(out_reply, &reply, sizeof(reply));\n")
+        f.write("\t\treturn XRT_SUCCESS;\n")
+        f.write("\t}\n")
+
+    f.write('''\tdefault:
+\t\tU_LOG_E("IPC COMMAND NOT ALLOWED IN BATCH! %d", *ipc_command);
+\t\treturn XRT_ERROR_IPC_FAILURE;
+\t}
+}
+''')
+
+
+def write_batch_dispatch(f, p):
+    """Write the dispatch of a whole batch, only one reply is sent."""
+    write_batch_dispatch_call(f, p)
+
+    handles = p.batch_in_handles
+
+    f.write('''
+static xrt_result_t
+ipc_dispatch_batch(volatile struct ipc_client_state *ics, struct ipc_batch_msg *batch_msg)
+{
+\tstruct ipc_message_channel *imc = (struct ipc_message_channel *)&ics->imc;
+\tuint8_t replies[IPC_BATCH_MAX_REPLY_SIZE];
+
+\tif (batch_msg->call_count == 0 ||                      //
+\t    batch_msg->call_count > IPC_BATCH_MAX_CALLS ||     //
+\t    batch_msg->msg_size > IPC_BATCH_MAX_MSG_SIZE ||    //
+\t    batch_msg->reply_size > IPC_BATCH_MAX_REPLY_SIZE || //
+\t    batch_msg->handle_count > XRT_MAX_IPC_HANDLES) {
+\t\treturn XRT_ERROR_IPC_FAILURE;
+\t}
+
+\txrt_result_t xret = XRT_SUCCESS;
+\tuint32_t msg_offset = 0;
+\tuint32_t reply_offset = 0;
+''')
+
+    if handles:
+        f.write('''
+\t%s in_handles[XRT_MAX_IPC_HANDLES] = {0};
+\tuint32_t in_handle_count = 0;
+
+\tif (batch_msg->handle_count > 0) {
+\t\t// Same as a single call, let the client know we are ready for the handles.
+\t\tstruct ipc_result_reply _sync = {XRT_SUCCESS};
+\t\tstruct ipc_command_msg _handle_msg = {0};
+
+\t\txrt_result_t sync_result = ipc_send(imc, &_sync, sizeof(_sync));
+\t\tif (sync_result != XRT_SUCCESS) {
+\t\t\treturn sync_result;
+\t\t}
+
+\t\txrt_result_t receive_handle_result = ipc_receive_handles_%s( //
+\t\t    imc, &_handle_msg, sizeof(_handle_msg), in_handles, batch_msg->handle_count);
+\t\tif (receive_handle_result != XRT_SUCCESS) {
+\t\t\treturn receive_handle_result;
+\t\t}
+
+\t\t// From here on we own the handles, the call taking them sets the count to zero.
+\t\tin_handle_count = batch_msg->handle_count;
+
+\t\tif (_handle_msg.cmd != IPC_BATCH) {
+\t\t\txret = XRT_ERROR_IPC_FAILURE;
+\t\t\tgoto out;
+\t\t}
+\t}
+''' % (handles.typename, handles.stem))
+    else:
+        f.write('''
+\tif (batch_msg->handle_count != 0) {
+\t\treturn XRT_ERROR_IPC_FAILURE;
+\t}
+''')
+
+    call_args = "ics, ipc_command, in_handles, &in_handle_count, &replies[reply_offset]" if handles \
+        else "ics, ipc_command, &replies[reply_offset]"
+
+    f.write('''
+\tfor (uint32_t i = 0; i < batch_msg->call_count; i++) {
+\t\tipc_command_t cmd;
+\t\tif (msg_offset + sizeof(cmd) > batch_msg->msg_size) {
+\t\t\txret = XRT_ERROR_IPC_FAILURE;
+\t\t\tgoto out;
+\t\t}
+\t\tmemcpy(&cmd, &batch_msg->msgs[msg_offset], sizeof(cmd));
+
+\t\tsize_t msg_size = ipc_batch_call_msg_size(cmd);
+\t\tsize_t reply_size = ipc_batch_call_reply_size(cmd);
+\t\tif (msg_size == 0 ||                                    //
+\t\t    msg_offset + msg_size > batch_msg->msg_size ||      //
+\t\t    reply_offset + reply_size > batch_msg->reply_size) {
+\t\t\txret = XRT_ERROR_IPC_FAILURE;
+\t\t\tgoto out;
+\t\t}
+
+\t\t// The batch message is packed so the calls are too.
+\t\tipc_command_t *ipc_command = (ipc_command_t *)&batch_msg->msgs[msg_offset];
+\t\txret = ipc_dispatch_batch_call(%s);
+\t\tif (xret != XRT_SUCCESS) {
+\t\t\tgoto out;
+\t\t}
+
+\t\tmsg_offset += (uint32_t)msg_size;
+\t\treply_offset += (uint32_t)reply_size;
+\t}
+
+\tif (msg_offset != batch_msg->msg_size || reply_offset != batch_msg->reply_size) {
+\t\txret = XRT_ERROR_IPC_FAILURE;
+\t\tgoto out;
+\t}
+
+\t// All of the replies in one go.
+\txret = ipc_send(imc, replies, reply_offset);
+
+out:
+''' % call_args)
+
+    if handles:
+        f.write('''\t// The batch failed before the call taking the handles, or no call took them.
+\tfor (uint32_t i = 0; i < in_handle_count; i++) {
+\t\tu_%s_unref(&in_handles[i]);
+\t}
+
+''' % handles.stem)
+
+    f.write('''\treturn xret;
+}
+
+''')
+
+
 def generate_server_header(file, p):
     """Generate IPC server header.
 
@@ -452,6 +452,7 @@ gui_scene_remote(struct gui_program *p, const char *address)
 	gr->base.render = scene_render;
 	gr->base.destroy = scene_destroy;
 	gr->rc.fd = -1;
+	gr->rc.udp_fd = -1;
 
 	// GUI input defaults.
 	if (address != NULL) {
@@ -25,6 +25,7 @@ static void
 setup_paths(struct oxr_logger *log,
             struct oxr_instance *inst,
             const char **src_paths,
+            const uint64_t *src_hashes,
             XrPath **dest_paths,
             uint32_t *dest_path_count)
 {
@@ -40,7 +41,7 @@ setup_paths(struct oxr_logger *log,
 	for (size_t x = 0; x < *dest_path_count; x++) {
 		const char *str = src_paths[x];
 		size_t len = strlen(str);
-		oxr_path_get_or_create(log, inst, str, len, &(*dest_paths)[x]);
+		oxr_path_get_or_create_with_hash(log, inst, str, len, src_hashes[x], &(*dest_paths)[x]);
 	}
 }
 
@@ -116,11 +117,8 @@ interaction_profile_find_or_create_in_instance(struct oxr_logger *log,
 	struct profile_template *templ = NULL;
 
 	for (size_t x = 0; x < OXR_BINDINGS_PROFILE_TEMPLATE_COUNT; x++) {
-		XrPath t_path = XR_NULL_PATH;
-
-		oxr_path_get_or_create(log, inst, profile_templates[x].path, strlen(profile_templates[x].path),
-		                       &t_path);
-		if (t_path == path) {
+		// Cached at instance creation.
+		if (profile_templates[x].path_cache == path) {
 			templ = &profile_templates[x];
 			break;
 		}
@@ -134,6 +132,7 @@ interaction_profile_find_or_create_in_instance(struct oxr_logger *log,
 	struct oxr_interaction_profile *p = U_TYPED_CALLOC(struct oxr_interaction_profile);
 
 	p->xname = templ->name;
+	p->templ = templ;
 	p->binding_count = templ->binding_count;
 	p->bindings = U_TYPED_ARRAY_CALLOC(struct oxr_binding, p->binding_count);
 	p->dpad_count = templ->dpad_count;
@@ -146,8 +145,8 @@ interaction_profile_find_or_create_in_instance(struct oxr_logger *log,
 		struct oxr_binding *b = &p->bindings[x];
 
 		XrPath subaction_path;
-		XrResult r =
-		    oxr_path_get_or_create(log, inst, t->subaction_path, strlen(t->subaction_path), &subaction_path);
+		XrResult r = oxr_path_get_or_create_with_hash(log, inst, t->subaction_path, strlen(t->subaction_path),
+		                                              t->subaction_path_hash, &subaction_path);
 		if (r != XR_SUCCESS) {
 			oxr_log(log, "Couldn't get subaction path %s\n", t->subaction_path);
 		}
@@ -157,7 +156,7 @@ interaction_profile_find_or_create_in_instance(struct oxr_logger *log,
 		}
 
 		b->localized_name = t->localized_name;
-		setup_paths(log, inst, t->paths, &b->paths, &b->path_count);
+		setup_paths(log, inst, t->paths, t->path_hashes, &b->paths, &b->path_count);
 		b->input = t->input;
 		b->dpad_activate = t->dpad_activate;
 		b->output = t->output;
@@ -168,8 +167,8 @@ interaction_profile_find_or_create_in_instance(struct oxr_logger *log,
 		struct oxr_dpad_emulation *d = &p->dpads[x];
 
 		XrPath subaction_path;
-		XrResult r =
-		    oxr_path_get_or_create(log, inst, t->subaction_path, strlen(t->subaction_path), &subaction_path);
+		XrResult r = oxr_path_get_or_create_with_hash(log, inst, t->subaction_path, strlen(t->subaction_path),
+		                                              t->subaction_path_hash, &subaction_path);
 		if (r != XR_SUCCESS) {
 			oxr_log(log, "Couldn't get subaction path %s\n", t->subaction_path);
 		}
@@ -178,7 +177,7 @@ interaction_profile_find_or_create_in_instance(struct oxr_logger *log,
 			oxr_log(log, "Invalid subaction path %s\n", t->subaction_path);
 		}
 
-		setup_paths(log, inst, t->paths, &d->paths, &d->path_count);
+		setup_paths(log, inst, t->paths, t->path_hashes, &d->paths, &d->path_count);
 		d->position = t->position;
 		d->activate = t->activate;
 	}
@@ -210,25 +209,50 @@ reset_all_keys(struct oxr_binding *bindings, size_t binding_count)
 	}
 }
 
+/*!
+ * Find the bindings of the profile that has the given path, the entries are
+ * sorted by binding and then path index. Returns the number of entries.
+ */
+static size_t
+find_path_lookup(struct oxr_logger *log,
+                 struct oxr_instance *inst,
+                 struct oxr_interaction_profile *p,
+                 XrPath path,
+                 const struct binding_path_lookup **out_lookup)
+{
+	uint64_t hash = 0;
+	if (p->templ == NULL || oxr_path_get_hash(log, inst, path, &hash) != XR_SUCCESS) {
+		return 0;
+	}
+
+	size_t count = 0;
+	*out_lookup = oxr_bindings_find_path_lookup(p->templ, hash, &count);
+
+	return count;
+}
+
 static void
-add_key_to_matching_bindings(struct oxr_binding *bindings, size_t binding_count, XrPath path, uint32_t key)
+add_key_to_matching_bindings(
+    struct oxr_logger *log, struct oxr_instance *inst, struct oxr_interaction_profile *p, XrPath path, uint32_t key)
 {
-	for (size_t x = 0; x < binding_count; x++) {
-		struct oxr_binding *b = &bindings[x];
-
-		bool found = false;
-		uint32_t preferred_path_index;
-		for (uint32_t y = 0; y < b->path_count; y++) {
-			if (b->paths[y] == path) {
-				found = true;
-				preferred_path_index = y;
-				break;
-			}
+	const struct binding_path_lookup *lookup = NULL;
+	size_t count = find_path_lookup(log, inst, p, path, &lookup);
+
+	uint32_t last_binding_index = UINT32_MAX;
+	for (size_t x = 0; x < count; x++) {
+		struct oxr_binding *b = &p->bindings[lookup[x].binding_index];
+		uint32_t preferred_path_index = lookup[x].path_index;
+
+		// Hashes can collide.
+		if (b->paths[preferred_path_index] != path) {
+			continue;
 		}
 
-		if (!found) {
+		// Only the first path index of a binding is used.
+		if (lookup[x].binding_index == last_binding_index) {
 			continue;
 		}
+		last_binding_index = lookup[x].binding_index;
 
 		U_ARRAY_REALLOC_OR_FREE(b->keys, uint32_t, (b->key_count + 1));
 		U_ARRAY_REALLOC_OR_FREE(b->preferred_binding_path_index, uint32_t, (b->key_count + 1));
@@ -329,16 +353,14 @@ get_identifier_str_in_profile(struct oxr_logger *log,
 		return NULL;
 	}
 
-	for (size_t i = 0; i < oip->binding_count; i++) {
-		struct oxr_binding *binding = &oip->bindings[i];
+	const struct binding_path_lookup *lookup = NULL;
+	size_t count = find_path_lookup(log, inst, oip, path, &lookup);
 
-		for (size_t k = 0; k < binding->path_count; k++) {
-			if (binding->paths[k] != path) {
-				continue;
-			}
-			str = binding->localized_name;
-			i = oip->binding_count; // Break the outer loop as well.
-			break;
+	// Sorted by binding, so this is the first binding with the path.
+	for (size_t i = 0; i < count; i++) {
+		struct oxr_binding *binding = &oip->bindings[lookup[i].binding_index];
+		if (binding->paths[lookup[i].path_index] == path) {
+			return binding->localized_name;
 		}
 	}
 
@@ -355,12 +377,12 @@ oxr_get_profile_for_device_name(struct oxr_logger *log,
 	 * Map xrt_device_name to an interaction profile XrPath.
 	 * Set *out_p to an oxr_interaction_profile if bindings for that interaction profile XrPath have been suggested.
 	 */
-	for (uint32_t i = 0; i < ARRAY_SIZE(profile_templates); i++) {
-		if (name == profile_templates[i].name) {
-			interaction_profile_find_in_session(log, sess, profile_templates[i].path_cache, out_p);
-			return;
-		}
+	int index = oxr_bindings_profile_template_index(name);
+	if (index < 0) {
+		return;
 	}
+
+	interaction_profile_find_in_session(log, sess, profile_templates[index].path_cache, out_p);
 }
 
 
@@ -590,11 +612,8 @@ oxr_action_suggest_interaction_profile_bindings(struct oxr_logger *log,
 		goto out;
 	}
 
-	struct oxr_binding *bindings = p->bindings;
-	size_t binding_count = p->binding_count;
-
 	// Everything is now valid, reset the keys.
-	reset_all_keys(bindings, binding_count);
+	reset_all_keys(p->bindings, p->binding_count);
 	// Transfer ownership of dpad state to profile
 	oxr_dpad_state_deinit(&p->dpad_state);
 	p->dpad_state = *dpad_state;
@@ -604,7 +623,7 @@ oxr_action_suggest_interaction_profile_bindings(struct oxr_logger *log,
 		const XrActionSuggestedBinding *s = &suggestedBindings->suggestedBindings[i];
 		struct oxr_action *act = XRT_CAST_OXR_HANDLE_TO_PTR(struct oxr_action *, s->action);
 
-		add_key_to_matching_bindings(bindings, binding_count, s->binding, act->act_key);
+		add_key_to_matching_bindings(log, inst, p, s->binding, act->act_key);
 	}
 
 out:
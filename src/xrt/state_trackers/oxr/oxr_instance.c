@@ -282,7 +282,9 @@ oxr_instance_create(struct oxr_logger *log,
 	oxr_get_interaction_profile_path_cache(&path_cache);
 
 	for (uint32_t i = 0; i < ARRAY_SIZE(path_cache->path_cache); i++) {
-		cache_path(log, inst, *path_cache->path_cache[i].path_cache_name, path_cache->path_cache[i].path_cache);
+		const struct oxr_bindings_path_cache_element *e = &path_cache->path_cache[i];
+		oxr_path_get_or_create_with_hash(log, inst, *e->path_cache_name, strlen(*e->path_cache_name),
+		                                 *e->path_cache_hash, e->path_cache);
 	}
 
 	// fill in our application info - @todo - replicate all createInfo
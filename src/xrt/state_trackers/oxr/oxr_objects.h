@@ -130,6 +130,10 @@ struct oxr_facial_tracker_htc;
 struct oxr_face_tracker2_fb;
 struct oxr_body_tracker_fb;
 struct oxr_xdev_list;
+struct oxr_path;
+struct oxr_path_slot;
+struct oxr_path_arena_block;
+struct profile_template;
 
 #define XRT_MAX_HANDLE_CHILDREN 256
 #define OXR_MAX_BINDINGS_PER_ACTION 32
@@ -297,6 +301,12 @@ oxr_instance_convert_win32perfcounter_to_time(struct oxr_logger *log,
  *
  */
 
+/*!
+ * Hash used for path strings, 64 bit FNV-1a.
+ */
+uint64_t
+oxr_path_hash(const char *str, size_t length);
+
 /*!
  * Initialize the path system.
  * @private @memberof oxr_instance
@@ -325,6 +335,21 @@ XrResult
 oxr_path_get_or_create(
     struct oxr_logger *log, struct oxr_instance *inst, const char *str, size_t length, XrPath *out_path);
 
+/*!
+ * Same as @ref oxr_path_get_or_create but with the @p hash of the string
+ * already computed with @ref oxr_path_hash, the bindings generator does this
+ * for all of the paths of the interaction profiles.
+ *
+ * @public @memberof oxr_instance
+ */
+XrResult
+oxr_path_get_or_create_with_hash(struct oxr_logger *log,
+                                 struct oxr_instance *inst,
+                                 const char *str,
+                                 size_t length,
+                                 uint64_t hash,
+                                 XrPath *out_path);
+
 /*!
  * Only get the path for the given string if it exists.
  *
@@ -347,6 +372,14 @@ XrResult
 oxr_path_get_string(
     struct oxr_logger *log, const struct oxr_instance *inst, XrPath path, const char **out_str, size_t *out_length);
 
+/*!
+ * Get the @ref oxr_path_hash of the path's string, without hashing it again.
+ *
+ * @public @memberof oxr_instance
+ */
+XrResult
+oxr_path_get_hash(struct oxr_logger *log, const struct oxr_instance *inst, XrPath path, uint64_t *out_hash);
+
 /*!
  * Destroy the path system and all paths that the instance has created.
  *
@@ -1654,13 +1687,21 @@ struct oxr_instance
 	} action_sets;
 
 	//! Path store, for looking up paths.
-	struct u_hashset *path_store;
-	//! Mapping from ID to path.
-	struct oxr_path **path_array;
-	//! Total length of path array.
-	size_t path_array_length;
-	//! Number of paths in the array (0 is always null).
-	size_t path_num;
+	struct
+	{
+		//! Open addressing table of hashes and ids, length is a power of two.
+		struct oxr_path_slot *slots;
+		//! Total length of the table.
+		size_t slot_count;
+		//! Fixed size chunks of paths indexed by ID, paths never move.
+		struct oxr_path **chunks;
+		//! Number of chunks.
+		size_t chunk_count;
+		//! Number of paths (0 is always null).
+		size_t num;
+		//! Blocks that the path strings are allocated from, current first.
+		struct oxr_path_arena_block *arena;
+	} path_store;
 
 	// Event queue.
 	struct
@@ -1982,6 +2023,9 @@ struct oxr_interaction_profile
 	//! Used to lookup @ref xrt_binding_profile for fallback.
 	enum xrt_device_name xname;
 
+	//! Generated template this profile was made from, has the lookup tables.
+	const struct profile_template *templ;
+
 	//! Name presented to the user.
 	const char *localized_name;
 
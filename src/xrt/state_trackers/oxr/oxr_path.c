@@ -1,4 +1,4 @@
-// Copyright 2019-2020, Collabora, Ltd.
+// Copyright 2019-2024, Collabora, Ltd.
 // SPDX-License-Identifier: BSL-1.0
 /*!
  * @file
@@ -11,16 +11,32 @@
 #include <string.h>
 #include <stdlib.h>
 
-#include "math/m_api.h"
 #include "util/u_misc.h"
+#include "util/u_hash.h"
 
 #include "oxr_objects.h"
 #include "oxr_logger.h"
 
 
 /*!
- * Internal representation of a path, item follows this struct in memory and
- * that in turn is followed by the string.
+ * Number of paths in each chunk, paths never move once created.
+ */
+#define PATH_CHUNK_SIZE (256)
+
+/*!
+ * Size of the blocks that the strings are allocated from, longer strings get
+ * a block of their own.
+ */
+#define ARENA_BLOCK_SIZE (16 * 1024)
+
+/*!
+ * Initial number of slots in the table, must be a power of two. Instance
+ * creation alone interns a few hundred paths.
+ */
+#define INITIAL_SLOT_COUNT (1024)
+
+/*!
+ * Internal representation of a path, the string lives in the arena.
  *
  * @ingroup oxr_main
  */
@@ -29,6 +45,34 @@ struct oxr_path
 	uint64_t debug;
 	XrPath id;
 	void *attached;
+	uint64_t hash;
+	const char *str;
+	size_t length;
+};
+
+/*!
+ * A slot in the open addressing table, the hash is kept here so that probing
+ * rarely has to look at the path itself. An id of XR_NULL_PATH means empty.
+ *
+ * @ingroup oxr_main
+ */
+struct oxr_path_slot
+{
+	uint64_t hash;
+	XrPath id;
+};
+
+/*!
+ * A block of path strings.
+ *
+ * @ingroup oxr_main
+ */
+struct oxr_path_arena_block
+{
+	struct oxr_path_arena_block *next;
+	size_t used;
+	size_t size;
+	char data[];
 };
 
 
@@ -38,22 +82,38 @@ struct oxr_path
  *
  */
 
-static inline XrPath
-to_xr_path(struct oxr_path *path)
+static inline struct oxr_path *
+get_path(const struct oxr_instance *inst, XrPath id)
 {
-	return path->id;
+	return &inst->path_store.chunks[id / PATH_CHUNK_SIZE][id % PATH_CHUNK_SIZE];
 }
 
-static inline struct u_hashset_item *
-get_item(struct oxr_path *path)
+static inline bool
+path_matches(const struct oxr_path *path, const char *str, size_t length)
 {
-	return (struct u_hashset_item *)&path[1];
+	return path->length == length && memcmp(path->str, str, length) == 0;
 }
 
-static inline struct oxr_path *
-from_item(struct u_hashset_item *item)
+/*!
+ * Returns the slot holding the path or the empty slot where it would go.
+ */
+static struct oxr_path_slot *
+find_slot(const struct oxr_instance *inst, const char *str, size_t length, uint64_t hash)
 {
-	return &((struct oxr_path *)item)[-1];
+	size_t mask = inst->path_store.slot_count - 1;
+	size_t i = (size_t)hash & mask;
+
+	// The table is never full, so this always ends.
+	while (true) {
+		struct oxr_path_slot *slot = &inst->path_store.slots[i];
+		if (slot->id == XR_NULL_PATH) {
+			return slot;
+		}
+		if (slot->hash == hash && path_matches(get_path(inst, slot->id), str, length)) {
+			return slot;
+		}
+		i = (i + 1) & mask;
+	}
 }
 
 
@@ -64,84 +124,138 @@ from_item(struct u_hashset_item *item)
  */
 
 static XrResult
-oxr_ensure_array_length(struct oxr_logger *log, struct oxr_instance *inst, XrPath *out_id)
+grow_slots(struct oxr_logger *log, struct oxr_instance *inst)
 {
-	size_t num = inst->path_num + 1;
+	size_t old_count = inst->path_store.slot_count;
+	struct oxr_path_slot *old_slots = inst->path_store.slots;
 
-	if (num < inst->path_array_length) {
-		*out_id = inst->path_num++;
-		return XR_SUCCESS;
+	size_t new_count = old_count * 2;
+	struct oxr_path_slot *new_slots = U_TYPED_ARRAY_CALLOC(struct oxr_path_slot, new_count);
+	if (new_slots == NULL) {
+		return oxr_error(log, XR_ERROR_RUNTIME_FAILURE, "Failed to allocate path table");
 	}
 
-	size_t new_size = inst->path_array_length;
-	while (new_size < num) {
-		new_size += 64;
+	// Hashes are stored, so no strings need to be touched.
+	size_t mask = new_count - 1;
+	for (size_t x = 0; x < old_count; x++) {
+		if (old_slots[x].id == XR_NULL_PATH) {
+			continue;
+		}
+
+		size_t i = (size_t)old_slots[x].hash & mask;
+		while (new_slots[i].id != XR_NULL_PATH) {
+			i = (i + 1) & mask;
+		}
+		new_slots[i] = old_slots[x];
 	}
 
-	U_ARRAY_REALLOC_OR_FREE(inst->path_array, struct oxr_path *, new_size);
-	inst->path_array_length = new_size;
-
-	*out_id = inst->path_num++;
+	free(old_slots);
+	inst->path_store.slots = new_slots;
+	inst->path_store.slot_count = new_count;
 
 	return XR_SUCCESS;
 }
 
-static XrResult
-oxr_allocate_path(
-    struct oxr_logger *log, struct oxr_instance *inst, const char *str, size_t length, struct oxr_path **out_path)
+static char *
+arena_alloc(struct oxr_instance *inst, size_t size)
 {
-	struct u_hashset_item *item = NULL;
-	struct oxr_path *path = NULL;
-	size_t size = 0;
-	int ret;
-
-	size += sizeof(struct oxr_path);       // Main path object.
-	size += sizeof(struct u_hashset_item); // Embedded hashset item.
-	size += length;                        // String.
-	size += 1;                             // Null terminate it.
-
-	// Now allocate and setup the path.
-	path = U_CALLOC_WITH_CAST(struct oxr_path, size);
-	if (path == NULL) {
-		return oxr_error(log, XR_ERROR_RUNTIME_FAILURE, "Failed to allocate path");
+	struct oxr_path_arena_block *block = inst->path_store.arena;
+	if (block != NULL && block->size - block->used >= size) {
+		char *ptr = &block->data[block->used];
+		block->used += size;
+		return ptr;
 	}
-	path->debug = OXR_XR_DEBUG_PATH;
 
-	// Setup the item.
-	item = get_item(path);
-	item->hash = math_hash_string(str, length);
-	item->length = length;
+	size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+	block = U_CALLOC_WITH_CAST(struct oxr_path_arena_block, sizeof(*block) + block_size);
+	if (block == NULL) {
+		return NULL;
+	}
+	block->size = block_size;
+	block->used = size;
+
+	// Oversized blocks go behind the current one so its space isn't lost.
+	struct oxr_path_arena_block *current = inst->path_store.arena;
+	if (block_size > ARENA_BLOCK_SIZE && current != NULL) {
+		block->next = current->next;
+		current->next = block;
+	} else {
+		block->next = current;
+		inst->path_store.arena = block;
+	}
 
-	// Yes a const cast! D:
-	char *store = (char *)item->c_str;
-	for (size_t i = 0; i < length; i++) {
-		store[i] = str[i];
+	return block->data;
+}
+
+static XrResult
+oxr_allocate_path(struct oxr_logger *log,
+                  struct oxr_instance *inst,
+                  const char *str,
+                  size_t length,
+                  uint64_t hash,
+                  struct oxr_path_slot *slot,
+                  XrPath *out_id)
+{
+	XrPath id = inst->path_store.num;
+
+	// Make sure there is a chunk for the new path.
+	size_t chunk = id / PATH_CHUNK_SIZE;
+	if (chunk >= inst->path_store.chunk_count) {
+		size_t chunk_count = chunk + 1;
+
+		// Not U_ARRAY_REALLOC_OR_FREE, the existing paths must stay reachable.
+		struct oxr_path **chunks = realloc(inst->path_store.chunks, sizeof(*chunks) * chunk_count);
+		if (chunks == NULL) {
+			return oxr_error(log, XR_ERROR_RUNTIME_FAILURE, "Failed to allocate path chunks");
+		}
+		inst->path_store.chunks = chunks;
+
+		chunks[chunk] = U_TYPED_ARRAY_CALLOC(struct oxr_path, PATH_CHUNK_SIZE);
+		if (chunks[chunk] == NULL) {
+			return oxr_error(log, XR_ERROR_RUNTIME_FAILURE, "Failed to allocate path chunk");
+		}
+		inst->path_store.chunk_count = chunk_count;
 	}
-	store[length] = '\0';
 
-	// Insert and return.
-	ret = u_hashset_insert_item(inst->path_store, item);
-	if (ret) {
-		free(path);
-		return oxr_error(log, XR_ERROR_RUNTIME_FAILURE, "Failed to insert item");
+	char *store = arena_alloc(inst, length + 1);
+	if (store == NULL) {
+		return oxr_error(log, XR_ERROR_RUNTIME_FAILURE, "Failed to allocate path string");
 	}
+	memcpy(store, str, length);
+	store[length] = '\0';
 
-	oxr_ensure_array_length(log, inst, &path->id);
-	inst->path_array[path->id] = path;
+	struct oxr_path *path = get_path(inst, id);
+	path->debug = OXR_XR_DEBUG_PATH;
+	path->id = id;
+	path->hash = hash;
+	path->str = store;
+	path->length = length;
+
+	slot->hash = hash;
+	slot->id = id;
+	inst->path_store.num++;
+
+	// Keep the load below 3/4, probes stay short.
+	if (inst->path_store.num * 4 > inst->path_store.slot_count * 3) {
+		XrResult ret = grow_slots(log, inst);
+		if (ret != XR_SUCCESS) {
+			return ret;
+		}
+	}
 
-	*out_path = path;
+	*out_id = id;
 
 	return XR_SUCCESS;
 }
 
-struct oxr_path *
+static struct oxr_path *
 get_path_or_null(struct oxr_logger *log, const struct oxr_instance *inst, XrPath xr_path)
 {
-	if (xr_path >= inst->path_array_length) {
+	if (xr_path == XR_NULL_PATH || xr_path >= inst->path_store.num) {
 		return NULL;
 	}
 
-	return inst->path_array[xr_path];
+	return get_path(inst, xr_path);
 }
 
 
@@ -151,6 +265,13 @@ get_path_or_null(struct oxr_logger *log, const struct oxr_instance *inst, XrPath
  *
  */
 
+uint64_t
+oxr_path_hash(const char *str, size_t length)
+{
+	// FNV-1a, simple enough to be precomputed by the bindings generator.
+	return u_hash_fnv1a_64(U_HASH_FNV1A_64_INIT, str, length);
+}
+
 bool
 oxr_path_is_valid(struct oxr_logger *log, struct oxr_instance *inst, XrPath xr_path)
 {
@@ -172,43 +293,36 @@ XrResult
 oxr_path_get_or_create(
     struct oxr_logger *log, struct oxr_instance *inst, const char *str, size_t length, XrPath *out_path)
 {
-	struct u_hashset_item *item;
-	struct oxr_path *path = NULL;
-	XrResult ret;
-	int h_ret;
+	return oxr_path_get_or_create_with_hash(log, inst, str, length, oxr_path_hash(str, length), out_path);
+}
 
+XrResult
+oxr_path_get_or_create_with_hash(struct oxr_logger *log,
+                                 struct oxr_instance *inst,
+                                 const char *str,
+                                 size_t length,
+                                 uint64_t hash,
+                                 XrPath *out_path)
+{
 	// Look it up the instance path store.
-	h_ret = u_hashset_find_str(inst->path_store, str, length, &item);
-	if (h_ret == 0) {
-		*out_path = to_xr_path(from_item(item));
+	struct oxr_path_slot *slot = find_slot(inst, str, length, hash);
+	if (slot->id != XR_NULL_PATH) {
+		*out_path = slot->id;
 		return XR_SUCCESS;
 	}
 
 	// Create the path since it was not found.
-	ret = oxr_allocate_path(log, inst, str, length, &path);
-	if (ret != XR_SUCCESS) {
-		return ret;
-	}
-
-	*out_path = to_xr_path(path);
-
-	return XR_SUCCESS;
+	return oxr_allocate_path(log, inst, str, length, hash, slot, out_path);
 }
 
 XrResult
 oxr_path_only_get(struct oxr_logger *log, struct oxr_instance *inst, const char *str, size_t length, XrPath *out_path)
 {
-	struct u_hashset_item *item;
-	int h_ret;
-
 	// Look it up the instance path store.
-	h_ret = u_hashset_find_str(inst->path_store, str, length, &item);
-	if (h_ret == 0) {
-		*out_path = to_xr_path(from_item(item));
-		return XR_SUCCESS;
-	}
+	struct oxr_path_slot *slot = find_slot(inst, str, length, oxr_path_hash(str, length));
 
-	*out_path = XR_NULL_PATH;
+	// The empty slot has XR_NULL_PATH as id.
+	*out_path = slot->id;
 	return XR_SUCCESS;
 }
 
@@ -221,32 +335,40 @@ oxr_path_get_string(
 		return XR_ERROR_PATH_INVALID;
 	}
 
-	*out_str = get_item(path)->c_str;
-	*out_length = get_item(path)->length;
+	*out_str = path->str;
+	*out_length = path->length;
 
 	return XR_SUCCESS;
 }
 
-void
-destroy_callback(struct u_hashset_item *item, void *priv)
+XrResult
+oxr_path_get_hash(struct oxr_logger *log, const struct oxr_instance *inst, XrPath xr_path, uint64_t *out_hash)
 {
-	struct oxr_path *path = from_item(item);
+	struct oxr_path *path = get_path_or_null(log, inst, xr_path);
+	if (path == NULL) {
+		return XR_ERROR_PATH_INVALID;
+	}
+
+	*out_hash = path->hash;
 
-	free(path);
+	return XR_SUCCESS;
 }
 
 XrResult
 oxr_path_init(struct oxr_logger *log, struct oxr_instance *inst)
 {
-	int h_ret = u_hashset_create(&inst->path_store);
-	if (h_ret != 0) {
-		return oxr_error(log, XR_ERROR_RUNTIME_FAILURE, "Failed to create hashset");
+	inst->path_store.slots = U_TYPED_ARRAY_CALLOC(struct oxr_path_slot, INITIAL_SLOT_COUNT);
+	if (inst->path_store.slots == NULL) {
+		return oxr_error(log, XR_ERROR_RUNTIME_FAILURE, "Failed to allocate path table");
 	}
 
-	size_t new_size = 64;
-	U_ARRAY_REALLOC_OR_FREE(inst->path_array, struct oxr_path *, new_size);
-	inst->path_array_length = new_size;
-	inst->path_num = 1; // Reserve space for XR_NULL_PATH
+	inst->path_store.slot_count = INITIAL_SLOT_COUNT;
+	inst->path_store.chunks = NULL;
+	inst->path_store.chunk_count = 0;
+	inst->path_store.arena = NULL;
+
+	// Reserve space for XR_NULL_PATH, the first chunk is made on demand.
+	inst->path_store.num = 1;
 
 	return XR_SUCCESS;
 }
@@ -254,18 +376,18 @@ oxr_path_init(struct oxr_logger *log, struct oxr_instance *inst)
 void
 oxr_path_destroy(struct oxr_logger *log, struct oxr_instance *inst)
 {
-	if (inst->path_array != NULL) {
-		free(inst->path_array);
+	for (size_t i = 0; i < inst->path_store.chunk_count; i++) {
+		free(inst->path_store.chunks[i]);
 	}
-
-	inst->path_array = NULL;
-	inst->path_num = 0;
-	inst->path_array_length = 0;
-
-	if (inst->path_store == NULL) {
-		return;
+	free(inst->path_store.chunks);
+	free(inst->path_store.slots);
+
+	struct oxr_path_arena_block *block = inst->path_store.arena;
+	while (block != NULL) {
+		struct oxr_path_arena_block *next = block->next;
+		free(block);
+		block = next;
 	}
 
-	u_hashset_clear_and_call_for_each(inst->path_store, destroy_callback, inst);
-	u_hashset_destroy(&inst->path_store);
+	U_ZERO(&inst->path_store);
 }
@@ -0,0 +1,153 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Cache of the last known device topology and the builder used for it.
+ * @ingroup st_prober
+ */
+
+#include "util/u_file.h"
+#include "util/u_hash.h"
+#include "util/u_json.h"
+#include "util/u_misc.h"
+
+#include "p_prober.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+
+#define CACHE_FILE_NAME "prober_cache_v0.json"
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static uint64_t
+hash_string(uint64_t hash, const char *str)
+{
+	if (str == NULL) {
+		return u_hash_fnv1a_64(hash, "", 1);
+	}
+
+	return u_hash_fnv1a_64(hash, str, strlen(str) + 1);
+}
+
+static uint64_t
+hash_device(const struct prober_device *pdev)
+{
+	uint64_t hash = U_HASH_FNV1A_64_INIT;
+
+	hash = u_hash_fnv1a_64(hash, &pdev->base.vendor_id, sizeof(pdev->base.vendor_id));
+	hash = u_hash_fnv1a_64(hash, &pdev->base.product_id, sizeof(pdev->base.product_id));
+	hash = u_hash_fnv1a_64(hash, &pdev->base.bus, sizeof(pdev->base.bus));
+
+	// The USB path, the address changes on every plug so isn't used.
+	hash = u_hash_fnv1a_64(hash, &pdev->usb.bus, sizeof(pdev->usb.bus));
+	hash = u_hash_fnv1a_64(hash, &pdev->usb.num_ports, sizeof(pdev->usb.num_ports));
+	hash = u_hash_fnv1a_64(hash, pdev->usb.ports, pdev->usb.num_ports);
+	hash = hash_string(hash, pdev->usb.serial);
+
+	hash = u_hash_fnv1a_64(hash, &pdev->bluetooth.id, sizeof(pdev->bluetooth.id));
+
+	return hash;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+uint64_t
+p_cache_get_topology(struct prober *p)
+{
+	enum u_config_json_active_config active;
+	u_config_json_get_active(&p->json, &active);
+
+	// Enumeration order isn't stable, so combine the devices in any order.
+	uint64_t topology = (uint64_t)active;
+	for (size_t i = 0; i < p->device_count; i++) {
+		topology += hash_device(&p->devices[i]);
+	}
+
+	return topology;
+}
+
+void
+p_cache_load(struct prober *p)
+{
+	U_ZERO(&p->cache);
+
+#ifdef U_FILE_HAVE_CONFIG_DIR
+	FILE *file = u_file_open_file_in_config_dir(CACHE_FILE_NAME, "rb");
+	if (file == NULL) {
+		return;
+	}
+
+	char *str = u_file_read_content(file);
+	fclose(file);
+	if (str == NULL) {
+		return;
+	}
+
+	cJSON *root = cJSON_Parse(str);
+	free(str);
+	if (root == NULL) {
+		P_WARN(p, "Failed to parse '%s', ignoring it", CACHE_FILE_NAME);
+		return;
+	}
+
+	char topology[32] = {0};
+	bool ok = u_json_get_string_into_array(u_json_get(root, "topology"), topology, sizeof(topology)) &&
+	          u_json_get_string_into_array(u_json_get(root, "builder"), p->cache.builder, sizeof(p->cache.builder));
+	cJSON_Delete(root);
+
+	if (!ok || sscanf(topology, "%" SCNx64, &p->cache.topology) != 1) {
+		P_WARN(p, "Malformed '%s', ignoring it", CACHE_FILE_NAME);
+		U_ZERO(&p->cache);
+		return;
+	}
+
+	p->cache.loaded = true;
+#endif
+}
+
+void
+p_cache_store(struct prober *p, uint64_t topology, const char *builder)
+{
+	if (p->cache.loaded && p->cache.topology == topology && strcmp(p->cache.builder, builder) == 0) {
+		return;
+	}
+
+#ifdef U_FILE_HAVE_CONFIG_DIR
+	char topology_str[32];
+	snprintf(topology_str, sizeof(topology_str), "%016" PRIx64, topology);
+
+	cJSON *root = cJSON_CreateObject();
+	cJSON_AddStringToObject(root, "topology", topology_str);
+	cJSON_AddStringToObject(root, "builder", builder);
+	char *str = cJSON_Print(root);
+	cJSON_Delete(root);
+
+	FILE *file = u_file_open_file_in_config_dir(CACHE_FILE_NAME, "w");
+	if (file == NULL) {
+		P_WARN(p, "Could not write '%s'", CACHE_FILE_NAME);
+		free(str);
+		return;
+	}
+
+	fprintf(file, "%s\n", str);
+	fclose(file);
+	free(str);
+
+	p->cache.loaded = true;
+	p->cache.topology = topology;
+	snprintf(p->cache.builder, sizeof(p->cache.builder), "%s", builder);
+#endif
+}
@@ -12,6 +12,7 @@
 
 #include "util/u_misc.h"
 #include "util/u_pretty_print.h"
+#include "util/u_time.h"
 
 #include "p_prober.h"
 
@@ -166,3 +167,40 @@ p_dump_device(struct prober *p, struct prober_device *pdev, int id, bool use_std
 		U_LOG_RAW("%s", sink.buffer);
 	}
 }
+
+void
+p_dump_timings(struct prober *p, u_pp_delegate_t dg)
+{
+	P("\tTimings:\n");
+
+#ifdef XRT_HAVE_LIBUDEV
+	PTT("udev:             %.2fms", time_ns_to_ms_f(p->timings.udev_ns));
+#endif
+#ifdef XRT_HAVE_LIBUSB
+	PTT("libusb:           %.2fms", time_ns_to_ms_f(p->timings.libusb_ns));
+#endif
+#ifdef XRT_HAVE_LIBUVC
+	PTT("libuvc:           %.2fms", time_ns_to_ms_f(p->timings.libuvc_ns));
+#endif
+
+	for (int i = 0; i < XRT_MAX_AUTO_PROBERS && p->auto_probers[i] != NULL; i++) {
+		if (p->timings.auto_prober_ns[i] == 0) {
+			continue;
+		}
+		PTT("auto prober %-16s %.2fms", p->auto_probers[i]->name,
+		    time_ns_to_ms_f(p->timings.auto_prober_ns[i]));
+	}
+
+	for (size_t i = 0; i < p->builder_count; i++) {
+		if (p->timings.builder_estimate_ns[i] == 0) {
+			continue;
+		}
+		PTT("estimate %-19s %.2fms", p->builders[i]->identifier,
+		    time_ns_to_ms_f(p->timings.builder_estimate_ns[i]));
+	}
+
+	if (p->timings.open_system_builder != NULL) {
+		PTT("open %-23s %.2fms%s", p->timings.open_system_builder, time_ns_to_ms_f(p->timings.open_system_ns),
+		    p->timings.cache_hit ? " (from cache)" : "");
+	}
+}
@@ -18,8 +18,10 @@
 #include "util/u_debug.h"
 #include "util/u_pretty_print.h"
 #include "util/u_trace_marker.h"
+#include "util/u_worker.h"
 
 #include "os/os_hid.h"
+#include "os/os_time.h"
 #include "p_prober.h"
 
 #ifdef XRT_HAVE_V4L2
@@ -57,6 +59,8 @@ DEBUG_GET_ONCE_BOOL_OPTION(qwerty_combine, "QWERTY_COMBINE", false)
 DEBUG_GET_ONCE_OPTION(vf_path, "VF_PATH", NULL)
 DEBUG_GET_ONCE_OPTION(euroc_path, "EUROC_PATH", NULL)
 DEBUG_GET_ONCE_NUM_OPTION(rs_source_index, "RS_SOURCE_INDEX", -1)
+DEBUG_GET_ONCE_BOOL_OPTION(concurrent, "PROBER_CONCURRENT", false)
+DEBUG_GET_ONCE_BOOL_OPTION(cache, "PROBER_CACHE", false)
 
 
 /*
@@ -294,6 +298,8 @@ static void
 add_builder(struct prober *p, struct xrt_builder *xb)
 {
 	U_ARRAY_REALLOC_OR_FREE(p->builders, struct xrt_builder *, (p->builder_count + 1));
+	U_ARRAY_REALLOC_OR_FREE(p->timings.builder_estimate_ns, int64_t, (p->builder_count + 1));
+	p->timings.builder_estimate_ns[p->builder_count] = 0;
 	p->builders[p->builder_count++] = xb;
 
 	P_TRACE(p, "%s: %s", xb->identifier, xb->name);
@@ -455,13 +461,22 @@ initialize(struct prober *p, struct xrt_prober_entry_lists *lists)
 	p->json.file_loaded = false;
 	p->json.root = NULL;
 
+	// Before anything that can fail, teardown destroys it.
+	int ret = os_mutex_init(&p->list_lock);
+	if (ret != 0) {
+		P_ERROR(p, "Failed to init list mutex!");
+		return -1;
+	}
+
 	u_var_add_root((void *)p, "Prober", true);
 	u_var_add_log_level(p, &p->log_level, "Log level");
 
-	int ret;
-
 	u_config_json_open_or_create_main_file(&p->json);
 
+	if (debug_get_bool_option_cache()) {
+		p_cache_load(p);
+	}
+
 	ret = collect_entries(p);
 	if (ret != 0) {
 		teardown(p);
@@ -594,6 +609,8 @@ teardown(struct prober *p)
 	p->builder_count = 0;
 	free(p->builders);
 	p->builders = NULL;
+	free(p->timings.builder_estimate_ns);
+	p->timings.builder_estimate_ns = NULL;
 
 	// Clean up all auto_probers.
 	for (int i = 0; i < XRT_MAX_AUTO_PROBERS && p->auto_probers[i]; i++) {
@@ -624,6 +641,8 @@ teardown(struct prober *p)
 	u_config_json_close(&p->json);
 
 	free(p->disabled_drivers);
+
+	os_mutex_destroy(&p->list_lock);
 }
 
 static void
@@ -718,9 +737,53 @@ add_from_devices(struct prober *p, struct xrt_device **xdevs, size_t xdev_count,
 	}
 }
 
+/*!
+ * One auto prober to run, on this thread or on a worker.
+ */
+struct auto_probe_job
+{
+	struct prober *p;
+	struct xrt_auto_prober *xap;
+	bool no_hmds;
+	int64_t *out_ns;
+
+	int num_found;
+	struct xrt_device *xdevs[XRT_MAX_DEVICES_PER_PROBE];
+};
+
+static void
+run_auto_probe_job(void *ptr)
+{
+	struct auto_probe_job *job = (struct auto_probe_job *)ptr;
+	struct prober *p = job->p;
+
+	int64_t start_ns = os_monotonic_get_ns();
+	job->num_found = job->xap->lelo_dallas_autoprobe(job->xap, NULL, job->no_hmds, &p->base, job->xdevs);
+	*job->out_ns = os_monotonic_get_ns() - start_ns;
+}
+
+static void
+handle_auto_probe_job(
+    struct prober *p, struct auto_probe_job *job, struct xrt_device **xdevs, size_t xdev_count, bool *have_hmd)
+{
+	for (int created_idx = 0; created_idx < job->num_found; ++created_idx) {
+		if (job->xdevs[created_idx] == NULL) {
+			P_DEBUG(p,
+			        "Leaving device creation loop early: %s autoprobe function reported %i "
+			        "created, but only %i non-null",
+			        job->xap->name, job->num_found, created_idx);
+			continue;
+		}
+		handle_found_device(p, xdevs, xdev_count, have_hmd, job->xdevs[created_idx]);
+	}
+}
+
 static void
 add_from_auto_probers(struct prober *p, struct xrt_device **xdevs, size_t xdev_count, bool *have_hmd)
 {
+	struct auto_probe_job jobs[XRT_MAX_AUTO_PROBERS] = {0};
+	uint32_t job_count = 0;
+
 	for (int i = 0; i < XRT_MAX_AUTO_PROBERS && p->auto_probers[i]; i++) {
 
 		bool skip = false;
@@ -735,31 +798,48 @@ add_from_auto_probers(struct prober *p, struct xrt_device **xdevs, size_t xdev_c
 			continue;
 		}
 
+		jobs[job_count].p = p;
+		jobs[job_count].xap = p->auto_probers[i];
+		jobs[job_count].out_ns = &p->timings.auto_prober_ns[i];
+		job_count++;
+	}
+
+	if (debug_get_bool_option_concurrent() && job_count > 1) {
 		/*
-		 * If we have found a HMD, tell the auto probers not to open
-		 * any more HMDs. This is mostly to stop OpenHMD and Monado
-		 * fighting over devices.
+		 * They mostly block on devices and timeouts, so one thread
+		 * each. They can't see each others HMDs, handle_found_device
+		 * closes any extra ones.
 		 */
-		bool no_hmds = *have_hmd;
-
-		struct xrt_device *new_xdevs[XRT_MAX_DEVICES_PER_PROBE] = {NULL};
-		int num_found =
-		    p->auto_probers[i]->lelo_dallas_autoprobe(p->auto_probers[i], NULL, no_hmds, &p->base, new_xdevs);
+		struct u_worker_thread_pool *pool = u_worker_thread_pool_create(job_count - 1, job_count, "Prober");
+		struct u_worker_group *group = u_worker_group_create(pool);
 
-		if (num_found <= 0) {
-			continue;
+		for (uint32_t i = 0; i < job_count; i++) {
+			jobs[i].no_hmds = *have_hmd;
+			u_worker_group_push(group, run_auto_probe_job, &jobs[i]);
 		}
+		u_worker_group_wait_all(group);
 
-		for (int created_idx = 0; created_idx < num_found; ++created_idx) {
-			if (new_xdevs[created_idx] == NULL) {
-				P_DEBUG(p,
-				        "Leaving device creation loop early: %s autoprobe function reported %i "
-				        "created, but only %i non-null",
-				        p->auto_probers[i]->name, num_found, created_idx);
-				continue;
-			}
-			handle_found_device(p, xdevs, xdev_count, have_hmd, new_xdevs[created_idx]);
+		u_worker_group_reference(&group, NULL);
+		u_worker_thread_pool_reference(&pool, NULL);
+
+		// Same order as serially.
+		for (uint32_t i = 0; i < job_count; i++) {
+			handle_auto_probe_job(p, &jobs[i], xdevs, xdev_count, have_hmd);
 		}
+
+		return;
+	}
+
+	for (uint32_t i = 0; i < job_count; i++) {
+		/*
+		 * If we have found a HMD, tell the auto probers not to open
+		 * any more HMDs. This is mostly to stop OpenHMD and Monado
+		 * fighting over devices.
+		 */
+		jobs[i].no_hmds = *have_hmd;
+
+		run_auto_probe_job(&jobs[i]);
+		handle_auto_probe_job(p, &jobs[i], xdevs, xdev_count, have_hmd);
 	}
 }
 
@@ -880,22 +960,23 @@ print_system_devices(u_pp_delegate_t dg, struct xrt_system_devices *xsysd)
  */
 
 static xrt_result_t
-p_probe(struct xrt_prober *xp)
+probe_locked(struct prober *p)
 {
-	XRT_TRACE_MARKER();
-
-	struct prober *p = (struct prober *)xp;
 	XRT_MAYBE_UNUSED int ret = 0;
-
-	if (p->list_locked) {
-		return XRT_ERROR_PROBER_LIST_LOCKED;
-	}
+	XRT_MAYBE_UNUSED int64_t start_ns = 0;
 
 	// Free old list first.
 	teardown_devices(p);
 
+	/*
+	 * These stay serial, libusb and libuvc attach themselves to the
+	 * devices that udev found.
+	 */
+
 #ifdef XRT_HAVE_LIBUDEV
+	start_ns = os_monotonic_get_ns();
 	ret = p_udev_probe(p);
+	p->timings.udev_ns = os_monotonic_get_ns() - start_ns;
 	if (ret != 0) {
 		P_ERROR(p, "Failed to enumerate udev devices\n");
 		return XRT_ERROR_PROBING_FAILED;
@@ -903,7 +984,9 @@ p_probe(struct xrt_prober *xp)
 #endif
 
 #ifdef XRT_HAVE_LIBUSB
+	start_ns = os_monotonic_get_ns();
 	ret = p_libusb_probe(p);
+	p->timings.libusb_ns = os_monotonic_get_ns() - start_ns;
 	if (ret != 0) {
 		P_ERROR(p, "Failed to enumerate libusb devices\n");
 		return XRT_ERROR_PROBING_FAILED;
@@ -911,7 +994,9 @@ p_probe(struct xrt_prober *xp)
 #endif
 
 #ifdef XRT_HAVE_LIBUVC
+	start_ns = os_monotonic_get_ns();
 	ret = p_libuvc_probe(p);
+	p->timings.libuvc_ns = os_monotonic_get_ns() - start_ns;
 	if (ret != 0) {
 		P_ERROR(p, "Failed to enumerate libuvc devices\n");
 		return XRT_ERROR_PROBING_FAILED;
@@ -922,25 +1007,50 @@ p_probe(struct xrt_prober *xp)
 }
 
 static xrt_result_t
-p_lock_list(struct xrt_prober *xp, struct xrt_prober_device ***out_devices, size_t *out_device_count)
+p_probe(struct xrt_prober *xp)
 {
+	XRT_TRACE_MARKER();
+
 	struct prober *p = (struct prober *)xp;
 
-	if (p->list_locked) {
+	os_mutex_lock(&p->list_lock);
+
+	if (p->list_lock_count > 0) {
+		os_mutex_unlock(&p->list_lock);
 		return XRT_ERROR_PROBER_LIST_LOCKED;
 	}
 
+	// Held throughout, so nobody can lock the list while it is rebuilt.
+	xrt_result_t xret = probe_locked(p);
+
+	os_mutex_unlock(&p->list_lock);
+
+	return xret;
+}
+
+static xrt_result_t
+p_lock_list(struct xrt_prober *xp, struct xrt_prober_device ***out_devices, size_t *out_device_count)
+{
+	struct prober *p = (struct prober *)xp;
+
 	assert(out_devices != NULL);
 	assert(*out_devices == NULL);
 
+	// Only builders estimating concurrently can hold it at the same time.
+	os_mutex_lock(&p->list_lock);
+	if (p->list_lock_count > 0 && !p->list_shared) {
+		os_mutex_unlock(&p->list_lock);
+		return XRT_ERROR_PROBER_LIST_LOCKED;
+	}
+	p->list_lock_count++;
+	os_mutex_unlock(&p->list_lock);
+
 	// Build a list of all current probed devices.
 	struct xrt_prober_device **dev_list = U_TYPED_ARRAY_CALLOC(struct xrt_prober_device *, p->device_count);
 	for (size_t i = 0; i < p->device_count; i++) {
 		dev_list[i] = &p->devices[i].base;
 	}
 
-	p->list_locked = true;
-
 	*out_devices = dev_list;
 	*out_device_count = p->device_count;
 
@@ -952,13 +1062,19 @@ p_unlock_list(struct xrt_prober *xp, struct xrt_prober_device ***devices)
 {
 	struct prober *p = (struct prober *)xp;
 
-	if (!p->list_locked) {
+	os_mutex_lock(&p->list_lock);
+	bool locked = p->list_lock_count > 0;
+	if (locked) {
+		p->list_lock_count--;
+	}
+	os_mutex_unlock(&p->list_lock);
+
+	if (!locked) {
 		return XRT_ERROR_PROBER_LIST_NOT_LOCKED;
 	}
 
 	assert(devices != NULL);
 
-	p->list_locked = false;
 	free(*devices);
 	*devices = NULL;
 
@@ -977,9 +1093,93 @@ p_dump(struct xrt_prober *xp, bool use_stdout)
 		p_dump_device(p, pdev, (int)i, use_stdout);
 	}
 
+	struct u_pp_sink_stack_only sink;
+	u_pp_delegate_t dg = u_pp_sink_stack_only_init(&sink);
+
+	p_dump_timings(p, dg);
+
+	if (use_stdout) {
+		printf("%s", sink.buffer);
+	} else {
+		U_LOG_RAW("%s", sink.buffer);
+	}
+
 	return 0;
 }
 
+/*!
+ * Builder and its estimate, only estimated once even if looked at by more
+ * than one selection pass.
+ */
+struct builder_estimate_job
+{
+	struct prober *p;
+	size_t index;
+
+	bool done;
+	struct xrt_builder_estimate estimate;
+};
+
+static void
+run_builder_estimate_job(void *ptr)
+{
+	struct builder_estimate_job *job = (struct builder_estimate_job *)ptr;
+	struct prober *p = job->p;
+	struct xrt_builder *xb = p->builders[job->index];
+
+	int64_t start_ns = os_monotonic_get_ns();
+	xrt_builder_estimate_system(xb, p->json.root, &p->base, &job->estimate);
+	p->timings.builder_estimate_ns[job->index] = os_monotonic_get_ns() - start_ns;
+
+	job->done = true;
+}
+
+static struct xrt_builder_estimate *
+get_builder_estimate(struct builder_estimate_job *jobs, size_t index)
+{
+	if (!jobs[index].done) {
+		run_builder_estimate_job(&jobs[index]);
+	}
+
+	return &jobs[index].estimate;
+}
+
+static void
+estimate_builders_concurrently(struct prober *p, struct builder_estimate_job *jobs)
+{
+	uint32_t count = 0;
+	for (size_t i = 0; i < p->builder_count; i++) {
+		if (!p->builders[i]->exclude_from_automatic_discovery) {
+			count++;
+		}
+	}
+
+	if (count <= 1) {
+		return;
+	}
+
+	struct u_worker_thread_pool *pool = u_worker_thread_pool_create(count - 1, count, "Builder");
+	struct u_worker_group *group = u_worker_group_create(pool);
+
+	os_mutex_lock(&p->list_lock);
+	p->list_shared = true;
+	os_mutex_unlock(&p->list_lock);
+
+	for (size_t i = 0; i < p->builder_count; i++) {
+		if (!p->builders[i]->exclude_from_automatic_discovery) {
+			u_worker_group_push(group, run_builder_estimate_job, &jobs[i]);
+		}
+	}
+	u_worker_group_wait_all(group);
+
+	os_mutex_lock(&p->list_lock);
+	p->list_shared = false;
+	os_mutex_unlock(&p->list_lock);
+
+	u_worker_group_reference(&group, NULL);
+	u_worker_thread_pool_reference(&pool, NULL);
+}
+
 static xrt_result_t
 p_create_system(struct xrt_prober *xp,
                 struct xrt_session_event_sink *broadcast,
@@ -994,6 +1194,14 @@ p_create_system(struct xrt_prober *xp,
 	xrt_result_t xret = XRT_SUCCESS;
 	struct u_pp_sink_stack_only sink; // Not inited, very large.
 	u_pp_delegate_t dg = u_pp_sink_stack_only_init(&sink);
+	bool use_cache = debug_get_bool_option_cache();
+	uint64_t topology = 0;
+
+	struct builder_estimate_job *jobs = U_TYPED_ARRAY_CALLOC(struct builder_estimate_job, p->builder_count);
+	for (size_t i = 0; i < p->builder_count; i++) {
+		jobs[i].p = p;
+		jobs[i].index = i;
+	}
 
 
 	/*
@@ -1027,10 +1235,46 @@ p_create_system(struct xrt_prober *xp,
 	}
 
 
+	/*
+	 * Cache, only the last used builder needs to be estimated on a hit.
+	 */
+
+	if (use_cache) {
+		topology = p_cache_get_topology(p);
+	}
+
+	if (select == NULL && use_cache && p->cache.loaded && p->cache.topology == topology) {
+		for (size_t i = 0; i < p->builder_count; i++) {
+			struct xrt_builder *xb = p->builders[i];
+
+			if (xb->exclude_from_automatic_discovery || strcmp(xb->identifier, p->cache.builder) != 0) {
+				continue;
+			}
+
+			// Devices might have been swapped for ones that look the same.
+			if (get_builder_estimate(jobs, i)->certain.head) {
+				select = xb;
+				p->timings.cache_hit = true;
+			}
+			break;
+		}
+
+		if (select != NULL) {
+			u_pp(dg, "\n\tSelected %s from the device cache", select->identifier);
+		} else {
+			u_pp(dg, "\n\tCached builder %s could not be used", p->cache.builder);
+		}
+	}
+
+
 	/*
 	 * Estimate.
 	 */
 
+	if (select == NULL && debug_get_bool_option_concurrent()) {
+		estimate_builders_concurrently(p, jobs);
+	}
+
 	//! @todo Improve estimation selection logic.
 	if (select == NULL) {
 		for (size_t i = 0; i < p->builder_count; i++) {
@@ -1040,10 +1284,7 @@ p_create_system(struct xrt_prober *xp,
 				continue;
 			}
 
-			struct xrt_builder_estimate estimate = {0};
-			xrt_builder_estimate_system(xb, p->json.root, xp, &estimate);
-
-			if (estimate.certain.head) {
+			if (get_builder_estimate(jobs, i)->certain.head) {
 				select = xb;
 				break;
 			}
@@ -1064,10 +1305,7 @@ p_create_system(struct xrt_prober *xp,
 				continue;
 			}
 
-			struct xrt_builder_estimate estimate = {0};
-			xrt_builder_estimate_system(xb, p->json.root, xp, &estimate);
-
-			if (estimate.maybe.head) {
+			if (get_builder_estimate(jobs, i)->maybe.head) {
 				select = xb;
 				break;
 			}
@@ -1080,8 +1318,13 @@ p_create_system(struct xrt_prober *xp,
 		}
 	}
 
+	free(jobs);
+	jobs = NULL;
+
 	if (select != NULL) {
 		u_pp(dg, "\n\tUsing builder %s: %s", select->identifier, select->name);
+
+		int64_t start_ns = os_monotonic_get_ns();
 		xret = xrt_builder_open_system( //
 		    select,                     //
 		    p->json.root,               //
@@ -1089,10 +1332,16 @@ p_create_system(struct xrt_prober *xp,
 		    broadcast,                  //
 		    out_xsysd,                  //
 		    out_xso);                   //
+		p->timings.open_system_ns = os_monotonic_get_ns() - start_ns;
+		p->timings.open_system_builder = select->identifier;
 
 		if (xret == XRT_SUCCESS) {
 			print_system_devices(dg, *out_xsysd);
 		}
+
+		if (xret == XRT_SUCCESS && use_cache) {
+			p_cache_store(p, topology, select->identifier);
+		}
 	} else {
 		u_pp(dg, "\n\tNo builder can be used to create a head device");
 		xret = XRT_ERROR_DEVICE_CREATION_FAILED;
@@ -1101,6 +1350,10 @@ p_create_system(struct xrt_prober *xp,
 	u_pp(dg, "\n\tResult: ");
 	u_pp_xrt_result(dg, xret);
 
+	// Only now are all the timings known, p_dump runs before this.
+	u_pp(dg, "\n");
+	p_dump_timings(p, dg);
+
 	P_INFO(p, "%s", sink.buffer);
 
 	return xret;
@@ -17,6 +17,9 @@
 
 #include "util/u_logging.h"
 #include "util/u_config_json.h"
+#include "util/u_pretty_print.h"
+
+#include "os/os_threading.h"
 
 #ifdef XRT_HAVE_LIBUSB
 #include <libusb.h>
@@ -139,9 +142,16 @@ struct prober
 	size_t builder_count;
 
 	/*!
-	 * Has the list been locked.
+	 * How many times the list has been locked, only more than once while
+	 * @ref list_shared is set. Protected by @ref list_lock.
 	 */
-	bool list_locked;
+	uint32_t list_lock_count;
+
+	//! Set while builders estimate concurrently and each lock the list.
+	bool list_shared;
+
+	//! Protects the list lock state, also held while probing.
+	struct os_mutex list_lock;
 
 #ifdef XRT_HAVE_LIBUSB
 	struct
@@ -174,6 +184,35 @@ struct prober
 	size_t num_disabled_drivers;
 	char **disabled_drivers;
 
+	//! Last known device topology and the builder used for it, see p_cache.c.
+	struct
+	{
+		bool loaded;
+		uint64_t topology;
+		char builder[64];
+	} cache;
+
+	//! How long the steps of starting up took, see @ref p_dump_timings.
+	struct
+	{
+		int64_t udev_ns;
+		int64_t libusb_ns;
+		int64_t libuvc_ns;
+
+		//! Zero for auto probers that haven't run.
+		int64_t auto_prober_ns[XRT_MAX_AUTO_PROBERS];
+
+		//! One per builder, zero for builders that haven't been estimated.
+		int64_t *builder_estimate_ns;
+
+		//! Builder that was used, NULL if none yet.
+		const char *open_system_builder;
+		int64_t open_system_ns;
+
+		//! Was the builder picked from the cache.
+		bool cache_hit;
+	} timings;
+
 	enum u_logging_level log_level;
 };
 
@@ -192,6 +231,14 @@ struct prober
 void
 p_dump_device(struct prober *p, struct prober_device *pdev, int id, bool use_stdout);
 
+/*!
+ * Print how long probing, the auto probers and the builders took.
+ *
+ * @public @memberof prober
+ */
+void
+p_dump_timings(struct prober *p, u_pp_delegate_t dg);
+
 /*!
  * Get or create a @ref prober_device from the device.
  *
@@ -218,6 +265,39 @@ p_dev_get_bluetooth_dev(struct prober *p,
                         const char *product_name,
                         struct prober_device **out_pdev);
 
+/*!
+ * @name Device cache
+ * @{
+ */
+/*!
+ * Identifies the currently probed devices by their USB path, serial and the
+ * active config, independent of enumeration order.
+ *
+ * @private @memberof prober
+ */
+uint64_t
+p_cache_get_topology(struct prober *p);
+
+/*!
+ * Load the cache from the config dir, leaves it unloaded if there is none.
+ *
+ * @private @memberof prober
+ */
+void
+p_cache_load(struct prober *p);
+
+/*!
+ * Remember that @p builder was used for the @p topology, only writes the
+ * file if anything changed.
+ *
+ * @private @memberof prober
+ */
+void
+p_cache_store(struct prober *p, uint64_t topology, const char *builder);
+/*!
+ * @}
+ */
+
 /*!
  * @name Tracking systems
  * @{
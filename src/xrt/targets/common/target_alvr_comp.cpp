@@ -1,9 +1,17 @@
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
-#include <iostream>
 
 extern "C" {
 #include "main/comp_compositor.h"
 #include "main/comp_target.h"
+
+#include "os/os_time.h"
+#include "util/u_pacing.h"
+#include "util/u_time.h"
 }
 
 #include "EventManager.hpp"
@@ -14,17 +22,66 @@ extern "C" {
 
 // TODO: Deal with the exceptions?
 
+//! How long @ref alvr_target_acquire waits for the encoder to give back an image.
+static constexpr std::chrono::milliseconds ALVR_ACQUIRE_TIMEOUT{500};
+
+/*!
+ * Who currently owns one of the images shared with the encoder.
+ */
+enum class alvr_image_state
+{
+	//! Can be handed out by acquire.
+	FREE,
+	//! Handed to the renderer, not yet presented.
+	ACQUIRED,
+	//! Presented, the encoder may still be reading from it.
+	ENCODING,
+};
+
+/*!
+ * Book-keeping for a single image of the pseudo-swapchain.
+ */
+struct alvr_image_slot
+{
+	alvr_image_state state = alvr_image_state::FREE;
+
+	//! Value of the render complete timeline semaphore this image was presented with.
+	uint64_t timeline_value = 0;
+};
+
 struct comp_target_alvr
 {
 	comp_target base;
 
-	comp_target_image imgs[3];
+	std::array<comp_target_image, ALVR_SWAPCHAIN_IMGS> imgs;
 
 	// TODO: Handling errors on construction becomes a lot harder with all the emplace shenanigans, solve that
 	// somehow (could simply to a dynamic allocation fwiw)
 	Optional<alvr::Encoder> enc;
 
-	uint32_t curimg;
+	//! Have the images been created and exported by the encoder.
+	bool has_images;
+
+	/*!
+	 * Image ownership ring, protected by @ref slot_mutex. The renderer
+	 * only blocks in acquire when every image is owned by the encoder.
+	 */
+	std::mutex slot_mutex;
+	std::condition_variable slot_cond;
+	std::array<alvr_image_slot, ALVR_SWAPCHAIN_IMGS> slots;
+
+	//! Index after the last acquired image, acquire searches from here to keep the images rotating.
+	uint32_t next_slot;
+
+	//! Frame pacing, learns composite and encode time.
+	struct u_pacing_compositor *upc;
+
+	//! The frame id of the frame currently being composited.
+	int64_t current_frame_id;
+
+	//! Frame id and time of the last frame handed to the encoder, for encode timing.
+	int64_t last_present_frame_id;
+	int64_t last_present_ns;
 };
 
 // TODO: Make connection async? (aka let it continue to composit even if connection lost?)
@@ -92,6 +149,8 @@ alvr_target_init_post_vulkan(comp_target *ct, uint32_t pref_w, uint32_t pref_h)
 
 	base.enc.emplace(info);
 
+	u_pc_stream_create(ct->c->settings.nominal_frame_interval_ns, os_monotonic_get_ns(), &base.upc);
+
 	// TODO: This should obviously go
 	std::this_thread::sleep_for(std::chrono::seconds(2));
 
@@ -103,9 +162,34 @@ alvr_target_check_ready(comp_target *ct)
 {
 	auto &acomp = get_acomp(ct);
 
+	// Ready for image creation as soon as the encoder exists, image ownership is handled in acquire.
 	return acomp.enc.hasValue();
 }
 
+/*!
+ * Hand every image that was presented with a timeline value up to and
+ * including @p timeline_value back to the ring, and wake up acquire.
+ */
+static void
+alvr_target_release_up_to(comp_target_alvr &acomp, uint64_t timeline_value)
+{
+	bool released = false;
+
+	{
+		std::lock_guard lock(acomp.slot_mutex);
+		for (auto &slot : acomp.slots) {
+			if (slot.state == alvr_image_state::ENCODING && slot.timeline_value <= timeline_value) {
+				slot.state = alvr_image_state::FREE;
+				released = true;
+			}
+		}
+	}
+
+	if (released) {
+		acomp.slot_cond.notify_all();
+	}
+}
+
 
 void
 alvr_target_create_images(comp_target *ct, const comp_target_create_images_info *create_info)
@@ -130,22 +214,34 @@ alvr_target_create_images(comp_target *ct, const comp_target_create_images_info
 	// TODO: This
 	ct->format = VK_FORMAT_R8G8B8A8_UNORM;
 
-	for (int i = 0; i < 3; ++i) {
+	for (uint32_t i = 0; i < ALVR_SWAPCHAIN_IMGS; ++i) {
 		acomp.imgs[i].handle = expt.imgs[i].img;
 		acomp.imgs[i].view = expt.imgs[i].view;
 	}
 
-	ct->images = acomp.imgs;
+	ct->images = acomp.imgs.data();
 	ct->image_count = ALVR_SWAPCHAIN_IMGS;
 
-	acomp.curimg = 0;
+	/*
+	 * The renderer waits for the queue to go idle before (re)creating
+	 * images, so nothing can still be using the old ones.
+	 */
+	{
+		std::lock_guard lock(acomp.slot_mutex);
+		acomp.slots.fill(alvr_image_slot{});
+		acomp.next_slot = 0;
+		acomp.has_images = true;
+	}
+	acomp.slot_cond.notify_all();
 }
 
 bool
 alvr_target_has_images(comp_target *ct)
 {
-	// TODO: Should be fine because of exceptions, but actually checking is a lot better
-	return true;
+	auto &acomp = get_acomp(ct);
+
+	std::lock_guard lock(acomp.slot_mutex);
+	return acomp.has_images && ct->image_count > 0;
 }
 
 VkResult
@@ -153,12 +249,34 @@ alvr_target_acquire(comp_target *ct, uint32_t *out_index)
 {
 	auto &acomp = get_acomp(ct);
 
-	// TODO: Write actual pseudo-swapchain implementation (currently works because we ensure the job completed
-	// before we start a new one, not given with sliced encoding)
-	//
-	// Also this logic is kinda weird, but it seems to work
-	*out_index = acomp.curimg++;
-	acomp.curimg %= ALVR_SWAPCHAIN_IMGS;
+	std::unique_lock lock(acomp.slot_mutex);
+
+	if (!acomp.has_images) {
+		return VK_ERROR_OUT_OF_DATE_KHR;
+	}
+
+	// Oldest free image first, so we rotate through the ring.
+	auto find_free = [&acomp](uint32_t &out) {
+		for (uint32_t i = 0; i < ALVR_SWAPCHAIN_IMGS; i++) {
+			uint32_t index = (acomp.next_slot + i) % ALVR_SWAPCHAIN_IMGS;
+			if (acomp.slots[index].state == alvr_image_state::FREE) {
+				out = index;
+				return true;
+			}
+		}
+		return false;
+	};
+
+	uint32_t index = 0;
+	if (!acomp.slot_cond.wait_for(lock, ALVR_ACQUIRE_TIMEOUT, [&] { return find_free(index); })) {
+		// Every image is still in flight, the encoder has stalled, the renderer skips this frame.
+		return VK_TIMEOUT;
+	}
+
+	acomp.slots[index].state = alvr_image_state::ACQUIRED;
+	acomp.next_slot = (index + 1) % ALVR_SWAPCHAIN_IMGS;
+
+	*out_index = index;
 
 	return VK_SUCCESS;
 }
@@ -228,10 +346,45 @@ alvr_target_present(comp_target *ct,
 	};
 
 
-	printf("present\n");
+	{
+		std::lock_guard lock(base.slot_mutex);
+		auto &slot = base.slots[img_idx];
+		assert(slot.state == alvr_image_state::ACQUIRED);
+		slot.state = alvr_image_state::ENCODING;
+		slot.timeline_value = timeline_semaphore_value;
+	}
+
+	int64_t present_ns = os_monotonic_get_ns();
 
 	base.enc.get().present(img_idx, timeline_semaphore_value, viewInfo);
 
+	int64_t returned_ns = os_monotonic_get_ns();
+
+	/*
+	 * The encoder waits for the previous job before starting this one, if
+	 * that made us block we know when the previous frame was done encoding.
+	 * Otherwise it finished before we got here and we learn nothing new.
+	 *
+	 * Known limitation: the encoder has no completion callback, so encode
+	 * time is only learned when it is the bottleneck. While it keeps up the
+	 * pacer keeps its last estimate, which errs on the late side.
+	 */
+	if (base.last_present_frame_id >= 0 && returned_ns - present_ns > U_TIME_HALF_MS_IN_NS) {
+		u_pc_stream_info_encode(base.upc, base.last_present_frame_id, base.last_present_ns, returned_ns);
+	}
+	base.last_present_frame_id = base.current_frame_id;
+	base.last_present_ns = present_ns;
+
+	/*
+	 * The encoder finishes the previous job before it starts a new one,
+	 * so once present returns every earlier image is free again. This
+	 * relies on the encoder working on one whole frame at a time, the
+	 * binding has no per-image fence that would tell us directly.
+	 */
+	if (timeline_semaphore_value > 0) {
+		alvr_target_release_up_to(base, timeline_semaphore_value - 1);
+	}
+
 	// TODO: Figure out whether we need a frame count
 	return VK_SUCCESS;
 }
@@ -243,6 +396,26 @@ alvr_target_set_title(comp_target *ct, const char *title)
 VkResult
 alvr_target_update_timings(comp_target *ct)
 {
+	auto &acomp = get_acomp(ct);
+
+	if (acomp.upc == nullptr) {
+		return VK_SUCCESS;
+	}
+
+	/*
+	 * The next vsync of the streamer is when it wants the next frame handed
+	 * to the encoder, the pacer also learns the frame period from these.
+	 */
+	u64 next_vsync_ns = 0;
+	alvr_duration_until_next_vsync(&next_vsync_ns);
+
+	u_pc_update_vblank_from_display_control(acomp.upc, os_monotonic_get_ns() + (int64_t)next_vsync_ns);
+
+	/*
+	 * The streamer doesn't give us the client's network and decode latency,
+	 * so the pacer uses the fixed U_PACING_STREAM_LATENCY_MS for it.
+	 */
+
 	return VK_SUCCESS;
 }
 
@@ -255,37 +428,61 @@ alvr_target_calc_frame_pacing(comp_target *ct,
                               int64_t *out_present_slop,
                               int64_t *out_predicted_display)
 {
-	// NOTE: I think it's deriving the point to query poses for from the display time
-	// and how to schedule the rendering from the present time
-
-	// TODO: Do we need the frame index for anything?
-	static int64_t frame = 0;
-	*out_frame_id = ++frame;
-
-	// TODO: Improve handling
-	u64 nextVsync = 0;
-	// NOTE: That's the next vsync that will be performed, we want to aim for the one after it
-	alvr_duration_until_next_vsync(&nextVsync);
-
-	std::cout << "duration until next vsync: " << nextVsync << "\n";
-
-	nextVsync += os_monotonic_get_ns();
-
-	std::cout << "next vsync time: " << nextVsync << "\n";
-
-	// timed for 120 fps
-	*out_wake_up = nextVsync;
-	*out_desired_present = nextVsync + 8;
-	// graphics and encode are each allowed to take one full frametime since they are async
-	*out_present_slop = 8;
-	*out_predicted_display = nextVsync + 16;
+	auto &acomp = get_acomp(ct);
 
-	std::cout << "calculated wake up time: " << *out_wake_up << "\n";
+	int64_t frame_id = -1;
+	int64_t wake_up_time_ns = 0;
+	int64_t desired_present_time_ns = 0;
+	int64_t present_slop_ns = 0;
+	int64_t predicted_display_time_ns = 0;
+	int64_t predicted_display_period_ns = 0;
+	int64_t min_display_period_ns = 0;
+	int64_t now_ns = os_monotonic_get_ns();
+
+	// Make sure we have the latest phase before predicting.
+	alvr_target_update_timings(ct);
+
+	u_pc_predict(acomp.upc,                    //
+	             now_ns,                       //
+	             &frame_id,                    //
+	             &wake_up_time_ns,             //
+	             &desired_present_time_ns,     //
+	             &present_slop_ns,             //
+	             &predicted_display_time_ns,   //
+	             &predicted_display_period_ns, //
+	             &min_display_period_ns);      //
+
+	acomp.current_frame_id = frame_id;
+
+	*out_frame_id = frame_id;
+	*out_wake_up = wake_up_time_ns;
+	*out_desired_present = desired_present_time_ns;
+	*out_present_slop = present_slop_ns;
+	*out_predicted_display = predicted_display_time_ns;
 }
 
 void
-alvr_target_mark_timing_point(comp_target *ct, enum comp_target_timing_point tp, int64_t t, int64_t t2)
-{}
+alvr_target_mark_timing_point(comp_target *ct, enum comp_target_timing_point point, int64_t frame_id, int64_t when_ns)
+{
+	auto &acomp = get_acomp(ct);
+	assert(frame_id == acomp.current_frame_id);
+
+	switch (point) {
+	case COMP_TARGET_TIMING_POINT_WAKE_UP:
+		u_pc_mark_point(acomp.upc, U_TIMING_POINT_WAKE_UP, acomp.current_frame_id, when_ns);
+		break;
+	case COMP_TARGET_TIMING_POINT_BEGIN:
+		u_pc_mark_point(acomp.upc, U_TIMING_POINT_BEGIN, acomp.current_frame_id, when_ns);
+		break;
+	case COMP_TARGET_TIMING_POINT_SUBMIT_BEGIN:
+		u_pc_mark_point(acomp.upc, U_TIMING_POINT_SUBMIT_BEGIN, acomp.current_frame_id, when_ns);
+		break;
+	case COMP_TARGET_TIMING_POINT_SUBMIT_END:
+		u_pc_mark_point(acomp.upc, U_TIMING_POINT_SUBMIT_END, acomp.current_frame_id, when_ns);
+		break;
+	default: assert(false);
+	}
+}
 
 void
 alvr_target_flush_wsi(comp_target *ct)
@@ -293,7 +490,21 @@ alvr_target_flush_wsi(comp_target *ct)
 
 void
 alvr_target_info_gpu(comp_target *ct, int64_t frame_id, int64_t gpu_start_ns, int64_t gpu_end_ns, int64_t when_ns)
-{}
+{
+	auto &acomp = get_acomp(ct);
+
+	u_pc_info_gpu(acomp.upc, frame_id, gpu_start_ns, gpu_end_ns, when_ns);
+}
+
+void
+alvr_target_destroy(comp_target *ct)
+{
+	auto *acomp = &get_acomp(ct);
+
+	u_pc_destroy(&acomp->upc);
+
+	delete acomp;
+}
 
 bool
 create_target_alvr(const comp_target_factory *factory, struct comp_compositor *compositor, comp_target **target)
@@ -314,7 +525,9 @@ create_target_alvr(const comp_target_factory *factory, struct comp_compositor *c
 	                                  .update_timings = alvr_target_update_timings,
 	                                  .info_gpu = alvr_target_info_gpu,
 	                                  .set_title = alvr_target_set_title,
-	                              }};
+	                                  .destroy = alvr_target_destroy,
+	                              },
+	                              .last_present_frame_id = -1};
 
 
 	*target = &t->base;
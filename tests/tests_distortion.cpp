@@ -0,0 +1,262 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Distortion batch and parallel computation tests.
+ */
+
+#include "os/os_time.h"
+
+#include "util/u_worker.h"
+#include "util/u_distortion_mesh.h"
+
+#include "catch_amalgamated.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+using Catch::Approx;
+
+static constexpr uint32_t kDim = 128;
+
+static std::vector<xrt_vec2>
+make_grid(uint32_t dim)
+{
+	std::vector<xrt_vec2> uvs(dim * dim);
+	for (uint32_t row = 0; row < dim; row++) {
+		for (uint32_t col = 0; col < dim; col++) {
+			uvs[row * dim + col] = {(float)col / (dim - 1), (float)row / (dim - 1)};
+		}
+	}
+	return uvs;
+}
+
+static void
+check_same(const xrt_uv_triplet &a, const xrt_uv_triplet &b)
+{
+	CHECK(a.r.x == Approx(b.r.x));
+	CHECK(a.r.y == Approx(b.r.y));
+	CHECK(a.g.x == Approx(b.g.x));
+	CHECK(a.g.y == Approx(b.g.y));
+	CHECK(a.b.x == Approx(b.b.x));
+	CHECK(a.b.y == Approx(b.b.y));
+}
+
+static u_vive_values
+make_vive_values()
+{
+	u_vive_values values = {};
+	values.aspect_x_over_y = 0.9f;
+	values.grow_for_undistort = 0.6f;
+	for (int i = 0; i < 3; i++) {
+		values.center[i] = {0.01f * i, -0.02f * i};
+		values.coefficients[i][0] = 0.2f + 0.01f * i;
+		values.coefficients[i][1] = 0.05f;
+		values.coefficients[i][2] = -0.01f;
+		values.coefficients[i][3] = 0.0f;
+	}
+	return values;
+}
+
+static bool
+vive_compute(xrt_device *xdev, uint32_t view, float u, float v, xrt_uv_triplet *result)
+{
+	static u_vive_values values = make_vive_values();
+	return u_compute_distortion_vive(&values, u, v, result);
+}
+
+TEST_CASE("distortion_batch")
+{
+	std::vector<xrt_vec2> uvs = make_grid(17);
+	const uint32_t count = (uint32_t)uvs.size();
+	std::vector<xrt_uv_triplet> single(count);
+	std::vector<xrt_uv_triplet> batch(count);
+
+	SECTION("vive")
+	{
+		u_vive_values values = make_vive_values();
+		for (uint32_t i = 0; i < count; i++) {
+			u_compute_distortion_vive(&values, uvs[i].x, uvs[i].y, &single[i]);
+		}
+		REQUIRE(u_compute_distortion_vive_batch(&values, count, uvs.data(), batch.data()));
+	}
+
+	SECTION("panotools")
+	{
+		u_panotools_values values = {};
+		values.distortion_k[0] = 1.0f;
+		values.distortion_k[1] = 0.22f;
+		values.distortion_k[2] = 0.24f;
+		values.aberration_k[0] = 0.996f;
+		values.aberration_k[1] = 1.0f;
+		values.aberration_k[2] = 1.014f;
+		values.scale = 0.06f;
+		values.lens_center = {0.032f, 0.034f};
+		values.viewport_size = {0.063f, 0.068f};
+
+		for (uint32_t i = 0; i < count; i++) {
+			u_compute_distortion_panotools(&values, uvs[i].x, uvs[i].y, &single[i]);
+		}
+		REQUIRE(u_compute_distortion_panotools_batch(&values, count, uvs.data(), batch.data()));
+	}
+
+	SECTION("cardboard")
+	{
+		u_cardboard_distortion_values values = {};
+		values.distortion_k[0] = 0.441f;
+		values.distortion_k[1] = 0.156f;
+		values.screen.size = {1.2f, 1.4f};
+		values.screen.offset = {0.6f, 0.7f};
+		values.texture.size = {1.0f, 1.1f};
+		values.texture.offset = {0.5f, 0.55f};
+
+		for (uint32_t i = 0; i < count; i++) {
+			u_compute_distortion_cardboard(&values, uvs[i].x, uvs[i].y, &single[i]);
+		}
+		REQUIRE(u_compute_distortion_cardboard_batch(&values, count, uvs.data(), batch.data()));
+	}
+
+	SECTION("ns_p2d")
+	{
+		u_ns_p2d_values values = {};
+		for (int i = 0; i < 16; i++) {
+			values.x_coefficients_left[i] = values.x_coefficients_right[i] = 0.01f * (i + 1);
+			values.y_coefficients_left[i] = values.y_coefficients_right[i] = -0.02f * (i % 5);
+		}
+		values.fov[1] = {-0.8f, 0.7f, 0.75f, -0.85f};
+
+		for (uint32_t i = 0; i < count; i++) {
+			u_compute_distortion_ns_p2d(&values, 1, uvs[i].x, uvs[i].y, &single[i]);
+		}
+		REQUIRE(u_compute_distortion_ns_p2d_batch(&values, 1, count, uvs.data(), batch.data()));
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		check_same(single[i], batch[i]);
+	}
+}
+
+TEST_CASE("distortion_compute_points")
+{
+	xrt_device xdev = {};
+	xdev.compute_distortion = vive_compute;
+
+	// More than fits in one task, with a partial last one.
+	std::vector<xrt_vec2> uvs = make_grid(kDim + 3);
+	const uint32_t count = (uint32_t)uvs.size();
+	std::vector<xrt_uv_triplet> results(count);
+
+	// Also run without a pool, that computes everything on this thread.
+	u_worker_thread_pool *pool = nullptr;
+	bool threaded = GENERATE(false, true);
+	if (threaded) {
+		pool = u_worker_thread_pool_create(3, 4, "Distortion Test");
+	}
+
+	auto check_results = [&] {
+		for (uint32_t i = 0; i < count; i++) {
+			xrt_uv_triplet expected;
+			vive_compute(&xdev, 0, uvs[i].x, uvs[i].y, &expected);
+			check_same(results[i], expected);
+		}
+	};
+
+	SECTION("Single point fallback")
+	{
+		REQUIRE(u_distortion_compute_points(&xdev, pool, 0, count, uvs.data(), results.data()));
+		check_results();
+	}
+
+	SECTION("Batch function")
+	{
+		xdev.compute_distortion_batch = [](xrt_device *, uint32_t, uint32_t count, const xrt_vec2 *uvs,
+		                                   xrt_uv_triplet *results) {
+			u_vive_values values = make_vive_values();
+			return u_compute_distortion_vive_batch(&values, count, uvs, results);
+		};
+		REQUIRE(u_distortion_compute_points(&xdev, pool, 0, count, uvs.data(), results.data()));
+		check_results();
+	}
+
+	SECTION("Devices without a batch function stay on the calling thread")
+	{
+		static std::thread::id caller;
+		static std::atomic<bool> other_thread;
+		caller = std::this_thread::get_id();
+		other_thread = false;
+
+		xdev.compute_distortion = [](xrt_device *xdev, uint32_t view, float u, float v, xrt_uv_triplet *result) {
+			if (std::this_thread::get_id() != caller) {
+				other_thread = true;
+			}
+			return vive_compute(xdev, view, u, v, result);
+		};
+		REQUIRE(u_distortion_compute_points(&xdev, pool, 0, count, uvs.data(), results.data()));
+		check_results();
+		CHECK_FALSE(other_thread);
+	}
+
+		SECTION("Failure is reported, the rest is still computed")
+	{
+		xdev.compute_distortion = [](xrt_device *, uint32_t, float u, float v, xrt_uv_triplet *result) {
+			if (u >= 0.5f && v >= 0.5f) {
+				return false;
+			}
+			result->r = result->g = result->b = {u * 0.5f, v * 0.5f};
+			return true;
+		};
+		CHECK_FALSE(u_distortion_compute_points(&xdev, pool, 0, count, uvs.data(), results.data()));
+
+		// Failed points get their input, every point is written.
+		bool all_written = true;
+		for (uint32_t i = 0; i < count; i++) {
+			bool failed = uvs[i].x >= 0.5f && uvs[i].y >= 0.5f;
+			float scale = failed ? 1.0f : 0.5f;
+			all_written = all_written && results[i].g.x == uvs[i].x * scale;
+			all_written = all_written && results[i].g.y == uvs[i].y * scale;
+		}
+		CHECK(all_written);
+	}
+
+	u_worker_thread_pool_reference(&pool, nullptr);
+}
+
+TEST_CASE("distortion_image", "[.][benchmark]")
+{
+	xrt_device xdev = {};
+	xdev.compute_distortion = vive_compute;
+
+	std::vector<xrt_vec2> uvs = make_grid(kDim);
+	const uint32_t count = (uint32_t)uvs.size();
+	std::vector<xrt_uv_triplet> results(count);
+	const int runs = 50;
+
+	auto measure = [&](const char *name, auto &&func) {
+		int64_t start_ns = os_monotonic_get_ns();
+		for (int i = 0; i < runs; i++) {
+			func();
+		}
+		double ms = (double)(os_monotonic_get_ns() - start_ns) / 1e6 / runs;
+		printf("%-20s %7.3f ms/view\n", name, ms);
+	};
+
+	measure("per point", [&] {
+		for (uint32_t i = 0; i < count; i++) {
+			xrt_device_compute_distortion(&xdev, 0, uvs[i].x, uvs[i].y, &results[i]);
+		}
+	});
+
+	xdev.compute_distortion_batch = [](xrt_device *, uint32_t, uint32_t count, const xrt_vec2 *uvs,
+	                                   xrt_uv_triplet *results) {
+		static u_vive_values values = make_vive_values();
+		return u_compute_distortion_vive_batch(&values, count, uvs, results);
+	};
+
+	measure("batch", [&] { xrt_device_compute_distortion_batch(&xdev, 0, count, uvs.data(), results.data()); });
+	u_worker_thread_pool *pool = u_distortion_thread_pool_create();
+	measure("batch, threaded",
+	        [&] { u_distortion_compute_points(&xdev, pool, 0, count, uvs.data(), results.data()); });
+	u_worker_thread_pool_reference(&pool, nullptr);
+}
@@ -0,0 +1,230 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Format conversion kernel tests and benchmarks.
+ *
+ * Run the benchmarks with `tests_format_convert "[benchmark]"`.
+ */
+
+#include "util/u_format_convert.h"
+#include "util/u_frame.h"
+#include "util/u_sink.h"
+
+#include "catch_amalgamated.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+
+using Kernel = u_format_convert_row_func_t u_format_convert_funcs::*;
+
+struct KernelInfo
+{
+	const char *name;
+	Kernel kernel;
+	uint32_t src_bytes_per_pixel; //!< Per destination pixel, per source row
+	uint32_t src_rows;
+	uint32_t dst_bytes_per_pixel;
+	bool even_width;
+};
+
+static const KernelInfo kKernels[] = {
+    {"L8_to_R8G8B8", &u_format_convert_funcs::L8_to_R8G8B8, 1, 1, 3, false},
+    {"YUYV422_to_R8G8B8", &u_format_convert_funcs::YUYV422_to_R8G8B8, 2, 1, 3, true},
+    {"YUYV422_to_L8", &u_format_convert_funcs::YUYV422_to_L8, 2, 1, 1, false},
+    {"UYVY422_to_R8G8B8", &u_format_convert_funcs::UYVY422_to_R8G8B8, 2, 1, 3, true},
+    {"YUV888_to_R8G8B8", &u_format_convert_funcs::YUV888_to_R8G8B8, 3, 1, 3, false},
+    {"BAYER_GR8_to_R8G8B8", &u_format_convert_funcs::BAYER_GR8_to_R8G8B8, 2, 2, 3, false},
+};
+
+static std::vector<const u_format_convert_funcs *>
+get_available_funcs()
+{
+	std::vector<const u_format_convert_funcs *> ret;
+	for (int i = 0; i < U_FORMAT_CONVERT_IMPL_COUNT; i++) {
+		const u_format_convert_funcs *funcs = u_format_convert_get_funcs((u_format_convert_impl)i);
+		if (funcs != nullptr) {
+			ret.push_back(funcs);
+		}
+	}
+	return ret;
+}
+
+static std::vector<uint8_t>
+convert(const u_format_convert_funcs *funcs, const KernelInfo &info, const std::vector<uint8_t> &src, uint32_t w)
+{
+	size_t src_stride = w * info.src_bytes_per_pixel;
+
+	// Canary bytes after the row to catch overruns.
+	std::vector<uint8_t> dst(w * info.dst_bytes_per_pixel + 64, 0xcd);
+	(funcs->*info.kernel)(src.data(), src_stride, dst.data(), w);
+
+	return dst;
+}
+
+TEST_CASE("u_format_convert_scalar")
+{
+	const u_format_convert_funcs *scalar = u_format_convert_get_funcs(U_FORMAT_CONVERT_IMPL_SCALAR);
+	REQUIRE(scalar != nullptr);
+	REQUIRE(u_format_convert_get_best_funcs() != nullptr);
+
+	// Black and white ends of video range, then clamped beyond it.
+	const std::vector<uint8_t> yuv = {16, 128, 128, 235, 128, 128, 255, 255, 255, 0, 0, 0};
+	uint8_t rgb[12] = {};
+	scalar->YUV888_to_R8G8B8(yuv.data(), yuv.size(), rgb, 4);
+
+	const uint8_t expected[12] = {0, 0, 0, 255, 255, 255, 255, 125, 255, 0, 136, 0};
+	for (int i = 0; i < 12; i++) {
+		CAPTURE(i);
+		CHECK((int)rgb[i] == (int)expected[i]);
+	}
+}
+
+TEST_CASE("u_format_convert_parity")
+{
+	const u_format_convert_funcs *scalar = u_format_convert_get_funcs(U_FORMAT_CONVERT_IMPL_SCALAR);
+	std::mt19937 rng(1234);
+
+	for (const u_format_convert_funcs *funcs : get_available_funcs()) {
+		for (const KernelInfo &info : kKernels) {
+			// Covers whole blocks, tails and rows shorter than a block.
+			for (uint32_t w = 1; w <= 100; w++) {
+				if (info.even_width && (w % 2) != 0) {
+					continue;
+				}
+
+				std::vector<uint8_t> src(w * info.src_bytes_per_pixel * info.src_rows);
+				for (uint8_t &b : src) {
+					b = (uint8_t)rng();
+				}
+
+				// Not comparing in the CHECK, Catch2 can't print random bytes.
+				bool equal = convert(funcs, info, src, w) == convert(scalar, info, src, w);
+				CAPTURE(funcs->name, info.name, w);
+				CHECK(equal);
+			}
+		}
+	}
+}
+
+TEST_CASE("u_format_convert_parity_exhaustive_yuv")
+{
+	const u_format_convert_funcs *scalar = u_format_convert_get_funcs(U_FORMAT_CONVERT_IMPL_SCALAR);
+
+	// Every Y, U and V combination, one row of 256 pixels per Y.
+	const uint32_t w = 256 * 256;
+	std::vector<uint8_t> src(w * 3);
+	std::vector<uint8_t> expected(w * 3);
+	std::vector<uint8_t> actual(w * 3);
+
+	for (const u_format_convert_funcs *funcs : get_available_funcs()) {
+		CAPTURE(funcs->name);
+		bool all_equal = true;
+
+		for (uint32_t y = 0; y < 256; y++) {
+			for (uint32_t uv = 0; uv < w; uv++) {
+				src[uv * 3 + 0] = (uint8_t)y;
+				src[uv * 3 + 1] = (uint8_t)(uv >> 8);
+				src[uv * 3 + 2] = (uint8_t)uv;
+			}
+
+			scalar->YUV888_to_R8G8B8(src.data(), src.size(), expected.data(), w);
+			funcs->YUV888_to_R8G8B8(src.data(), src.size(), actual.data(), w);
+			all_equal = all_equal && expected == actual;
+		}
+
+		CHECK(all_equal);
+	}
+}
+
+struct CaptureSink
+{
+	xrt_frame_sink base = {};
+	xrt_frame *frame = nullptr;
+};
+
+static void
+capture_push_frame(xrt_frame_sink *xfs, xrt_frame *xf)
+{
+	CaptureSink *capture = (CaptureSink *)xfs;
+	xrt_frame_reference(&capture->frame, xf);
+}
+
+TEST_CASE("u_sink_converter_row_bands")
+{
+	const u_format_convert_funcs *scalar = u_format_convert_get_funcs(U_FORMAT_CONVERT_IMPL_SCALAR);
+
+	// Big enough to be split into bands, odd height so they are uneven.
+	const uint32_t w = 1280;
+	const uint32_t h = 801;
+
+	xrt_frame *src = nullptr;
+	u_frame_create_one_off(XRT_FORMAT_YUYV422, w, h, &src);
+	REQUIRE(src != nullptr);
+
+	std::mt19937 rng(4321);
+	for (size_t i = 0; i < src->size; i++) {
+		src->data[i] = (uint8_t)rng();
+	}
+
+	CaptureSink capture;
+	capture.base.push_frame = capture_push_frame;
+
+	xrt_frame_context xfctx = {};
+	xrt_frame_sink *converter = nullptr;
+	u_sink_create_format_converter(&xfctx, XRT_FORMAT_R8G8B8, &capture.base, &converter);
+	REQUIRE(converter != nullptr);
+
+	xrt_sink_push_frame(converter, src);
+	REQUIRE(capture.frame != nullptr);
+	REQUIRE(capture.frame->format == XRT_FORMAT_R8G8B8);
+
+	std::vector<uint8_t> expected(w * 3);
+	bool all_equal = true;
+	for (uint32_t y = 0; y < h; y++) {
+		scalar->YUYV422_to_R8G8B8(src->data + y * src->stride, src->stride, expected.data(), w);
+		const uint8_t *actual = capture.frame->data + y * capture.frame->stride;
+		all_equal = all_equal && std::equal(expected.begin(), expected.end(), actual);
+	}
+	CHECK(all_equal);
+
+	xrt_frame_reference(&capture.frame, nullptr);
+	xrt_frame_reference(&src, nullptr);
+	xrt_frame_context_destroy_nodes(&xfctx);
+}
+
+TEST_CASE("u_format_convert_benchmark", "[.][benchmark]")
+{
+	struct Resolution
+	{
+		uint32_t w, h;
+	};
+	const Resolution resolutions[] = {{640, 480}, {1280, 800}, {1920, 1080}};
+
+	for (const Resolution &res : resolutions) {
+		for (const KernelInfo &info : kKernels) {
+			size_t src_stride = res.w * info.src_bytes_per_pixel;
+			size_t dst_stride = res.w * info.dst_bytes_per_pixel;
+			std::vector<uint8_t> src(src_stride * info.src_rows * res.h, 0x80);
+			std::vector<uint8_t> dst(dst_stride * res.h);
+
+			for (const u_format_convert_funcs *funcs : get_available_funcs()) {
+				u_format_convert_row_func_t func = funcs->*info.kernel;
+				std::string name = std::string(info.name) + " " + funcs->name + " " +
+				                   std::to_string(res.w) + "x" + std::to_string(res.h);
+
+				BENCHMARK(name.c_str())
+				{
+					for (uint32_t y = 0; y < res.h; y++) {
+						func(src.data() + y * src_stride * info.src_rows, src_stride,
+						     dst.data() + y * dst_stride, res.w);
+					}
+					return dst[0];
+				};
+			}
+		}
+	}
+}
@@ -0,0 +1,153 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Frame pool tests.
+ */
+
+#include "util/u_frame.h"
+
+#include "catch_amalgamated.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+
+static bool
+is_page_aligned(const void *ptr)
+{
+	return ((uintptr_t)ptr % 4096) == 0;
+}
+
+TEST_CASE("u_frame_pool")
+{
+	u_frame_pool_trim();
+	u_frame_pool_add_user();
+
+	u_frame_pool_stats before = {};
+	u_frame_pool_get_stats(&before);
+
+	SECTION("Returned frames are reused")
+	{
+		xrt_frame *xf = nullptr;
+		u_frame_create_one_off(XRT_FORMAT_L8, 640, 480, &xf);
+		REQUIRE(xf != nullptr);
+		CHECK(xf->size == 640 * 480);
+		CHECK(is_page_aligned(xf->data));
+		uint8_t *data = xf->data;
+
+		u_frame_pool_stats stats = {};
+		u_frame_pool_get_stats(&stats);
+		CHECK(stats.misses == before.misses + 1);
+		CHECK(stats.frames_in_use == before.frames_in_use + 1);
+
+		xrt_frame_reference(&xf, nullptr);
+		u_frame_pool_get_stats(&stats);
+		CHECK(stats.frames_in_use == before.frames_in_use);
+		CHECK(stats.frames_cached == 1);
+		CHECK(stats.bytes_cached >= 640 * 480);
+
+		// A slightly different size falls in the same class.
+		u_frame_create_one_off(XRT_FORMAT_L8, 640, 482, &xf);
+		CHECK(xf->data == data);
+		CHECK(xf->width == 640);
+		CHECK(xf->height == 482);
+		CHECK(xf->reference.count == 1);
+
+		u_frame_pool_get_stats(&stats);
+		CHECK(stats.hits == before.hits + 1);
+		CHECK(stats.frames_cached == 0);
+
+		xrt_frame_reference(&xf, nullptr);
+	}
+
+	SECTION("Different size classes don't share")
+	{
+		xrt_frame *small = nullptr;
+		xrt_frame *big = nullptr;
+		u_frame_create_one_off(XRT_FORMAT_L8, 64, 64, &small);
+		xrt_frame_reference(&small, nullptr);
+
+		u_frame_create_one_off(XRT_FORMAT_R8G8B8, 1280, 960, &big);
+		CHECK(is_page_aligned(big->data));
+
+		u_frame_pool_stats stats = {};
+		u_frame_pool_get_stats(&stats);
+		CHECK(stats.misses == before.misses + 2);
+		CHECK(stats.frames_cached == 1);
+
+		xrt_frame_reference(&big, nullptr);
+	}
+
+	SECTION("Clones copy and come from the pool")
+	{
+		xrt_frame *xf = nullptr;
+		u_frame_create_one_off(XRT_FORMAT_R8G8B8, 32, 16, &xf);
+		memset(xf->data, 0xab, xf->size);
+		xf->timestamp = 42;
+
+		xrt_frame *clone = nullptr;
+		u_frame_clone(xf, &clone);
+		REQUIRE(clone != nullptr);
+		CHECK(clone->data != xf->data);
+		CHECK(is_page_aligned(clone->data));
+		CHECK(clone->timestamp == 42);
+		CHECK(clone->size == xf->size);
+		CHECK(memcmp(clone->data, xf->data, xf->size) == 0);
+
+		xrt_frame_reference(&xf, nullptr);
+		xrt_frame_reference(&clone, nullptr);
+
+		u_frame_pool_stats stats = {};
+		u_frame_pool_get_stats(&stats);
+		CHECK(stats.frames_in_use == before.frames_in_use);
+		CHECK(stats.frames_cached == 2);
+	}
+
+	u_frame_pool_trim();
+
+	u_frame_pool_stats after = {};
+	u_frame_pool_get_stats(&after);
+	CHECK(after.frames_cached == 0);
+	CHECK(after.bytes_cached == 0);
+
+	u_frame_pool_remove_user();
+}
+
+TEST_CASE("u_frame_pool_users")
+{
+	u_frame_pool_trim();
+
+	SECTION("Nothing is cached without users")
+	{
+		xrt_frame *xf = nullptr;
+		u_frame_create_one_off(XRT_FORMAT_L8, 64, 64, &xf);
+		xrt_frame_reference(&xf, nullptr);
+
+		u_frame_pool_stats stats = {};
+		u_frame_pool_get_stats(&stats);
+		CHECK(stats.frames_cached == 0);
+	}
+
+	SECTION("The last user leaving frees the cache")
+	{
+		u_frame_pool_add_user();
+		u_frame_pool_add_user();
+
+		xrt_frame *xf = nullptr;
+		u_frame_create_one_off(XRT_FORMAT_L8, 64, 64, &xf);
+		xrt_frame_reference(&xf, nullptr);
+
+		u_frame_pool_remove_user();
+
+		u_frame_pool_stats stats = {};
+		u_frame_pool_get_stats(&stats);
+		CHECK(stats.frames_cached == 1);
+
+		u_frame_pool_remove_user();
+
+		u_frame_pool_get_stats(&stats);
+		CHECK(stats.frames_cached == 0);
+		CHECK(stats.bytes_cached == 0);
+	}
+}
@@ -31,7 +31,13 @@ TEST_CASE("m_relation_history")
 {
 	m_relation_history *rh = nullptr;
 
-	m_relation_history_create(&rh);
+	bool single_writer = GENERATE(false, true);
+	CAPTURE(single_writer);
+	if (single_writer) {
+		m_relation_history_create_single_writer(&rh);
+	} else {
+		m_relation_history_create(&rh);
+	}
 	SECTION("empty buffer")
 	{
 		xrt_space_relation out_relation = XRT_SPACE_RELATION_ZERO;
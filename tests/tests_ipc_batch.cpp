@@ -0,0 +1,296 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Batched IPC call tests, also counts the syscalls of a frame.
+ */
+
+#include "os/os_time.h"
+
+#include "client/ipc_client.h"
+#include "ipc_client_generated.h"
+
+#include "catch_amalgamated.hpp"
+
+#include <thread>
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+
+static constexpr int64_t kFrameId = 42;
+static constexpr uint32_t kFreeSlot = 3;
+
+/*!
+ * Just enough of a service to answer the frame loop calls, counts every
+ * message sent or received, each is one syscall on the client side too.
+ */
+struct FakeService
+{
+	int fd = -1;
+	uint32_t syscalls = 0;
+	uint32_t batches = 0;
+	xrt_result_t wait_woke_result = XRT_SUCCESS;
+
+	bool
+	recv_exact(void *data, size_t size)
+	{
+		syscalls++;
+		return recv(fd, data, size, MSG_WAITALL) == (ssize_t)size;
+	}
+
+	bool
+	send_exact(const void *data, size_t size)
+	{
+		syscalls++;
+		return send(fd, data, size, MSG_NOSIGNAL) == (ssize_t)size;
+	}
+
+	//! Predict frame needs its reply right away, so it is never batched.
+	static size_t
+	msg_size(ipc_command_t cmd)
+	{
+		if (cmd == IPC_COMPOSITOR_PREDICT_FRAME) {
+			return sizeof(ipc_command_msg);
+		}
+		return ipc_batch_call_msg_size(cmd);
+	}
+
+	//! Fills in the reply of a single call, returns its size.
+	size_t
+	reply(ipc_command_t cmd, uint8_t *out_reply)
+	{
+		size_t size = cmd == IPC_COMPOSITOR_PREDICT_FRAME ? sizeof(ipc_compositor_predict_frame_reply)
+		                                                  : ipc_batch_call_reply_size(cmd);
+		memset(out_reply, 0, size);
+
+		if (cmd == IPC_COMPOSITOR_PREDICT_FRAME) {
+			ipc_compositor_predict_frame_reply r = {};
+			r.result = XRT_SUCCESS;
+			r.frame_id = kFrameId;
+			memcpy(out_reply, &r, sizeof(r));
+		} else if (cmd == IPC_COMPOSITOR_LAYER_SYNC) {
+			ipc_compositor_layer_sync_reply r = {};
+			r.result = XRT_SUCCESS;
+			r.free_slot_id = kFreeSlot;
+			memcpy(out_reply, &r, sizeof(r));
+		} else if (cmd == IPC_COMPOSITOR_WAIT_WOKE) {
+			ipc_result_reply r = {wait_woke_result};
+			memcpy(out_reply, &r, sizeof(r));
+		}
+
+		return size;
+	}
+
+	//! Same handle dance as the real service, sync reply and then the handles.
+	bool
+	sync_handles()
+	{
+		ipc_result_reply sync = {XRT_SUCCESS};
+		ipc_command_msg filler = {};
+		return send_exact(&sync, sizeof(sync)) && recv_exact(&filler, sizeof(filler));
+	}
+
+	bool
+	handle_one()
+	{
+		ipc_command_t cmd;
+		if (recv(fd, &cmd, sizeof(cmd), MSG_PEEK | MSG_WAITALL) != (ssize_t)sizeof(cmd)) {
+			return false;
+		}
+
+		uint8_t replies[IPC_BATCH_MAX_REPLY_SIZE];
+
+		if (cmd != IPC_BATCH) {
+			uint8_t msg[IPC_BATCH_MAX_MSG_SIZE];
+			size_t size = msg_size(cmd);
+			if (size == 0 || !recv_exact(msg, size)) {
+				return false;
+			}
+			if (cmd == IPC_COMPOSITOR_LAYER_SYNC && !sync_handles()) {
+				return false;
+			}
+			return send_exact(replies, reply(cmd, replies));
+		}
+
+		ipc_batch_msg bmsg;
+		if (!recv_exact(&bmsg, sizeof(bmsg))) {
+			return false;
+		}
+		if (bmsg.handle_count > 0 && !sync_handles()) {
+			return false;
+		}
+
+		batches++;
+
+		size_t msg_offset = 0;
+		size_t reply_offset = 0;
+		for (uint32_t i = 0; i < bmsg.call_count; i++) {
+			ipc_command_t call_cmd;
+			memcpy(&call_cmd, &bmsg.msgs[msg_offset], sizeof(call_cmd));
+			msg_offset += ipc_batch_call_msg_size(call_cmd);
+			reply_offset += reply(call_cmd, &replies[reply_offset]);
+		}
+
+		return reply_offset == bmsg.reply_size && send_exact(replies, reply_offset);
+	}
+
+	void
+	run()
+	{
+		while (handle_one()) {
+		}
+	}
+};
+
+struct Connection
+{
+	ipc_connection ipc_c = {};
+	FakeService service;
+	std::thread thread;
+
+	Connection()
+	{
+		int fds[2];
+		REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+		ipc_c.imc.ipc_handle = fds[0];
+		ipc_c.imc.log_level = U_LOGGING_WARN;
+		os_mutex_init(&ipc_c.mutex);
+
+		service.fd = fds[1];
+		thread = std::thread([this] { service.run(); });
+	}
+
+	~Connection()
+	{
+		// Makes the service stop.
+		close(ipc_c.imc.ipc_handle);
+		thread.join();
+		close(service.fd);
+		os_mutex_destroy(&ipc_c.mutex);
+	}
+};
+
+//! What the frame loop did before batching, one round trip per call.
+static void
+frame_sequential(ipc_connection *ipc_c)
+{
+	int64_t frame_id = -1, wake_up_time, display_time, display_period;
+	uint32_t free_slot = 0;
+
+	REQUIRE(ipc_call_compositor_predict_frame(ipc_c, &frame_id, &wake_up_time, &display_time, &display_period) ==
+	        XRT_SUCCESS);
+	REQUIRE(ipc_call_compositor_wait_woke(ipc_c, frame_id, 1) == XRT_SUCCESS);
+	REQUIRE(ipc_call_compositor_begin_frame(ipc_c, frame_id) == XRT_SUCCESS);
+	REQUIRE(ipc_call_compositor_layer_sync(ipc_c, 0, NULL, 0, &free_slot) == XRT_SUCCESS);
+
+	CHECK(frame_id == kFrameId);
+	CHECK(free_slot == kFreeSlot);
+}
+
+//! What the frame loop does now, wait woke goes along with begin frame.
+static void
+frame_batched(ipc_connection *ipc_c)
+{
+	int64_t frame_id = -1, wake_up_time, display_time, display_period;
+	uint32_t free_slot = 0;
+
+	REQUIRE(ipc_call_compositor_predict_frame(ipc_c, &frame_id, &wake_up_time, &display_time, &display_period) ==
+	        XRT_SUCCESS);
+
+	ipc_client_batch batch = {};
+	REQUIRE(ipc_batch_add_compositor_wait_woke(&batch, frame_id, 1) == XRT_SUCCESS);
+	REQUIRE(ipc_batch_add_compositor_begin_frame(&batch, frame_id) == XRT_SUCCESS);
+	REQUIRE(ipc_client_batch_submit(ipc_c, &batch) == XRT_SUCCESS);
+
+	REQUIRE(ipc_call_compositor_layer_sync(ipc_c, 0, NULL, 0, &free_slot) == XRT_SUCCESS);
+
+	CHECK(frame_id == kFrameId);
+	CHECK(free_slot == kFreeSlot);
+}
+
+TEST_CASE("ipc_batch")
+{
+	Connection conn;
+
+	SECTION("Out arguments and results are unpacked")
+	{
+		uint32_t free_slot = 0;
+
+		ipc_client_batch batch = {};
+		REQUIRE(ipc_batch_add_compositor_wait_woke(&batch, kFrameId, 1) == XRT_SUCCESS);
+		REQUIRE(ipc_batch_add_compositor_begin_frame(&batch, kFrameId) == XRT_SUCCESS);
+		REQUIRE(ipc_batch_add_compositor_layer_sync(&batch, 0, NULL, 0, &free_slot) == XRT_SUCCESS);
+		REQUIRE(ipc_client_batch_submit(&conn.ipc_c, &batch) == XRT_SUCCESS);
+
+		CHECK(free_slot == kFreeSlot);
+		CHECK(batch.calls[1].result == XRT_SUCCESS);
+		CHECK(conn.service.batches == 1);
+	}
+
+	SECTION("Each call gets its own result")
+	{
+		conn.service.wait_woke_result = XRT_ERROR_IPC_FAILURE;
+
+		ipc_client_batch batch = {};
+		REQUIRE(ipc_batch_add_compositor_wait_woke(&batch, kFrameId, 1) == XRT_SUCCESS);
+		REQUIRE(ipc_batch_add_compositor_begin_frame(&batch, kFrameId) == XRT_SUCCESS);
+		CHECK(ipc_client_batch_submit(&conn.ipc_c, &batch) == XRT_ERROR_IPC_FAILURE);
+
+		CHECK(batch.calls[0].result == XRT_ERROR_IPC_FAILURE);
+		CHECK(batch.calls[1].result == XRT_SUCCESS);
+	}
+
+		SECTION("Empty batch sends nothing")
+	{
+		ipc_client_batch batch = {};
+		REQUIRE(ipc_client_batch_submit(&conn.ipc_c, &batch) == XRT_SUCCESS);
+		CHECK(conn.service.syscalls == 0);
+	}
+
+	SECTION("Full batch is refused")
+	{
+		ipc_client_batch batch = {};
+		for (uint32_t i = 0; i < IPC_BATCH_MAX_CALLS; i++) {
+			REQUIRE(ipc_batch_add_compositor_begin_frame(&batch, i) == XRT_SUCCESS);
+		}
+		CHECK(ipc_batch_add_compositor_begin_frame(&batch, 0) == XRT_ERROR_IPC_FAILURE);
+	}
+
+	SECTION("Fewer syscalls per frame")
+	{
+		frame_sequential(&conn.ipc_c);
+		uint32_t sequential = conn.service.syscalls;
+
+		conn.service.syscalls = 0;
+		frame_batched(&conn.ipc_c);
+		uint32_t batched = conn.service.syscalls;
+
+		CHECK(sequential == 10);
+		CHECK(batched == 8);
+	}
+}
+
+TEST_CASE("ipc_batch_frame_loop", "[.][benchmark]")
+{
+	Connection conn;
+	const int frame_count = 10000;
+
+	auto measure = [&](const char *name, void (*frame)(ipc_connection *)) {
+		conn.service.syscalls = 0;
+		int64_t start_ns = os_monotonic_get_ns();
+
+		for (int i = 0; i < frame_count; i++) {
+			frame(&conn.ipc_c);
+		}
+
+		double us = (double)(os_monotonic_get_ns() - start_ns) / 1000.0 / frame_count;
+		printf("%-12s %5.2f syscalls/frame %7.2f us/frame\n", name, (double)conn.service.syscalls / frame_count,
+		       us);
+	};
+
+	measure("sequential", frame_sequential);
+	measure("batched", frame_batched);
+}
@@ -0,0 +1,138 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Shared memory input snapshot tests.
+ */
+
+#include "shared/ipc_input_snapshot.h"
+
+#include "util/u_time.h"
+
+#include "catch_amalgamated.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+static constexpr uint32_t kInputCount = 16;
+static constexpr int64_t kMaxAgeNs = U_TIME_1MS_IN_NS * 8;
+
+//! All inputs get @p value so torn reads are easy to spot.
+static std::vector<xrt_input>
+make_inputs(int64_t value)
+{
+	std::vector<xrt_input> inputs(kInputCount);
+	for (uint32_t i = 0; i < kInputCount; i++) {
+		inputs[i].name = i == 0 ? XRT_INPUT_GENERIC_HEAD_POSE : XRT_INPUT_SIMPLE_SELECT_CLICK;
+		inputs[i].active = true;
+		inputs[i].timestamp = value;
+		inputs[i].value.vec1.x = (float)value;
+	}
+	return inputs;
+}
+
+TEST_CASE("ipc_input_snapshot")
+{
+	ipc_shared_input_snapshot snap{};
+	snap.io_active = true;
+	std::vector<xrt_input> shared(kInputCount);
+	std::vector<xrt_input> out(kInputCount);
+
+	const int64_t start_ns = U_TIME_1S_IN_NS;
+
+	SECTION("Never published misses but is wanted")
+	{
+		CHECK_FALSE(ipc_input_snapshot_read(&snap, shared.data(), kInputCount, start_ns, kMaxAgeNs, true,
+		                                    out.data()));
+		CHECK(snap.wanted != 0);
+	}
+
+	std::vector<xrt_input> inputs = make_inputs(42);
+	ipc_input_snapshot_write(&snap, shared.data(), inputs.data(), kInputCount, start_ns);
+
+	SECTION("Copies the inputs")
+	{
+		REQUIRE(ipc_input_snapshot_read(&snap, shared.data(), kInputCount, start_ns, kMaxAgeNs, true,
+		                                out.data()));
+		CHECK(out[5].active);
+		CHECK(out[5].timestamp == 42);
+		CHECK(out[5].value.vec1.x == 42.0f);
+	}
+
+	SECTION("Stale snapshot misses")
+	{
+		int64_t now_ns = start_ns + kMaxAgeNs + 1;
+		CHECK_FALSE(ipc_input_snapshot_read(&snap, shared.data(), kInputCount, now_ns, kMaxAgeNs, true,
+		                                    out.data()));
+	}
+
+	SECTION("Masked for the client without IO, head pose stays active")
+	{
+		REQUIRE(ipc_input_snapshot_read(&snap, shared.data(), kInputCount, start_ns, kMaxAgeNs, false,
+		                                out.data()));
+		CHECK(out[0].active);
+		CHECK(out[0].name == XRT_INPUT_GENERIC_HEAD_POSE);
+		CHECK_FALSE(out[5].active);
+		CHECK(out[5].name == XRT_INPUT_SIMPLE_SELECT_CLICK);
+		CHECK(out[5].value.vec1.x == 0.0f);
+
+		// Other clients still see everything.
+		std::vector<xrt_input> other(kInputCount);
+		REQUIRE(ipc_input_snapshot_read(&snap, shared.data(), kInputCount, start_ns, kMaxAgeNs, true,
+		                                other.data()));
+		CHECK(other[5].active);
+		CHECK(other[5].value.vec1.x == 42.0f);
+	}
+
+	SECTION("Masked when the device has no IO")
+	{
+		snap.io_active = false;
+		REQUIRE(ipc_input_snapshot_read(&snap, shared.data(), kInputCount, start_ns, kMaxAgeNs, true,
+		                                out.data()));
+		CHECK(out[0].active);
+		CHECK_FALSE(out[5].active);
+	}
+}
+
+TEST_CASE("ipc_input_snapshot_concurrent")
+{
+	ipc_shared_input_snapshot snap{};
+	snap.io_active = true;
+	std::vector<xrt_input> shared(kInputCount);
+
+	std::atomic<bool> running{true};
+	std::thread writer([&] {
+		for (int64_t value = 1; running; value++) {
+			std::vector<xrt_input> inputs = make_inputs(value);
+			ipc_input_snapshot_write(&snap, shared.data(), inputs.data(), kInputCount, value);
+		}
+	});
+
+	uint32_t reads = 0;
+	bool consistent = true;
+	std::vector<xrt_input> out(kInputCount);
+
+	auto end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (reads < 10000 && std::chrono::steady_clock::now() < end) {
+		if (!ipc_input_snapshot_read(&snap, shared.data(), kInputCount, 0, INT64_MAX, true, out.data())) {
+			// Not published yet or the writer got preempted mid write.
+			std::this_thread::yield();
+			continue;
+		}
+
+		reads++;
+		for (uint32_t k = 1; k < kInputCount; k++) {
+			consistent = consistent && out[k].timestamp == out[0].timestamp;
+			consistent = consistent && out[k].value.vec1.x == out[0].value.vec1.x;
+		}
+	}
+
+	running = false;
+	writer.join();
+
+	CHECK(reads > 0);
+	CHECK(consistent);
+}
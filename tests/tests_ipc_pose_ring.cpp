@@ -0,0 +1,317 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Shared memory pose ring tests.
+ */
+
+#include "shared/ipc_pose_ring.h"
+
+#include "util/u_time.h"
+
+#include "catch_amalgamated.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+
+using Catch::Approx;
+
+static constexpr int64_t kPeriodNs = U_TIME_1MS_IN_NS * 2;
+static constexpr int64_t kMaxAgeNs = kPeriodNs * 4;
+
+//! Moves along x at one meter per second, with the velocity set.
+static xrt_space_relation
+make_relation(int64_t timestamp_ns)
+{
+	xrt_space_relation rel = XRT_SPACE_RELATION_ZERO;
+	rel.relation_flags = (enum xrt_space_relation_flags)(
+	    XRT_SPACE_RELATION_POSITION_VALID_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT |
+	    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT |
+	    XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT);
+	rel.pose.orientation.w = 1.0f;
+	rel.pose.position.x = (float)time_ns_to_s(timestamp_ns);
+	rel.linear_velocity.x = 1.0f;
+	return rel;
+}
+
+static void
+push(ipc_shared_pose_ring &ring, int64_t timestamp_ns)
+{
+	xrt_space_relation rel = make_relation(timestamp_ns);
+	ipc_pose_ring_push(&ring, timestamp_ns, &rel);
+}
+
+TEST_CASE("ipc_pose_ring")
+{
+	ipc_shared_pose_ring ring{};
+	ring.name = XRT_INPUT_GENERIC_HEAD_POSE;
+
+	xrt_space_relation out = XRT_SPACE_RELATION_ZERO;
+	const int64_t start_ns = U_TIME_1S_IN_NS;
+
+	SECTION("Empty ring misses but is wanted")
+	{
+		CHECK_FALSE(ipc_pose_ring_locate(&ring, start_ns, kMaxAgeNs, start_ns, &out));
+		CHECK(ring.wanted != 0);
+	}
+
+	for (int i = 0; i < 4; i++) {
+		push(ring, start_ns + i * kPeriodNs);
+	}
+	const int64_t newest_ns = start_ns + 3 * kPeriodNs;
+
+	SECTION("Interpolates between samples")
+	{
+		int64_t at_ns = start_ns + kPeriodNs + kPeriodNs / 4;
+		REQUIRE(ipc_pose_ring_locate(&ring, newest_ns, kMaxAgeNs, at_ns, &out));
+		CHECK(out.pose.position.x == Approx(time_ns_to_s(at_ns)));
+		CHECK((out.relation_flags & XRT_SPACE_RELATION_POSITION_VALID_BIT) != 0);
+		CHECK((out.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT) == 0);
+	}
+
+	SECTION("Exact sample")
+	{
+		REQUIRE(ipc_pose_ring_locate(&ring, newest_ns, kMaxAgeNs, start_ns, &out));
+		CHECK(out.pose.position.x == Approx(time_ns_to_s(start_ns)));
+	}
+
+	SECTION("Predicts past the newest sample up to now")
+	{
+		int64_t now_ns = newest_ns + kPeriodNs / 2;
+		REQUIRE(ipc_pose_ring_locate(&ring, now_ns, kMaxAgeNs, now_ns, &out));
+		CHECK(out.pose.position.x == Approx(time_ns_to_s(now_ns)));
+	}
+
+	SECTION("Misses future timestamps")
+	{
+		int64_t at_ns = newest_ns + U_TIME_1MS_IN_NS * 20;
+		CHECK_FALSE(ipc_pose_ring_locate(&ring, newest_ns, kMaxAgeNs, at_ns, &out));
+	}
+
+	SECTION("Does not predict from stale samples")
+	{
+		int64_t now_ns = newest_ns + kMaxAgeNs + 1;
+		CHECK_FALSE(ipc_pose_ring_locate(&ring, now_ns, kMaxAgeNs, now_ns, &out));
+
+		// Old enough to be inside the ring is still fine.
+		CHECK(ipc_pose_ring_locate(&ring, now_ns, kMaxAgeNs, start_ns + kPeriodNs, &out));
+	}
+
+	SECTION("Misses before the oldest sample")
+	{
+		for (int i = 4; i < IPC_SHARED_POSE_RING_LEN + 4; i++) {
+			push(ring, start_ns + i * kPeriodNs);
+		}
+
+		int64_t now_ns = start_ns + (IPC_SHARED_POSE_RING_LEN + 3) * kPeriodNs;
+		CHECK_FALSE(ipc_pose_ring_locate(&ring, now_ns, kMaxAgeNs, start_ns + kPeriodNs, &out));
+		CHECK(ipc_pose_ring_locate(&ring, now_ns, kMaxAgeNs, start_ns + 5 * kPeriodNs, &out));
+	}
+
+	SECTION("IO disabled")
+	{
+		ipc_pose_ring_set_io_disabled(&ring, true);
+		CHECK_FALSE(ipc_pose_ring_locate(&ring, newest_ns, kMaxAgeNs, newest_ns, &out));
+
+		ipc_pose_ring_set_io_disabled(&ring, false);
+		CHECK(ipc_pose_ring_locate(&ring, newest_ns, kMaxAgeNs, newest_ns, &out));
+	}
+}
+
+TEST_CASE("ipc_pose_ring_find")
+{
+	ipc_shared_device_poses isdp{};
+	isdp.ring_count = 2;
+	isdp.rings[0].name = XRT_INPUT_GENERIC_HEAD_POSE;
+	isdp.rings[1].name = XRT_INPUT_SIMPLE_GRIP_POSE;
+
+	CHECK(ipc_pose_ring_find(&isdp, XRT_INPUT_SIMPLE_GRIP_POSE) == &isdp.rings[1]);
+	CHECK(ipc_pose_ring_find(&isdp, XRT_INPUT_SIMPLE_AIM_POSE) == nullptr);
+}
+
+//! Every joint and the hand pose move like make_relation, joint radius grows with time.
+static xrt_hand_joint_set
+make_hand(int64_t timestamp_ns, bool is_active)
+{
+	xrt_hand_joint_set set = {};
+	for (uint32_t i = 0; i < XRT_HAND_JOINT_COUNT; i++) {
+		set.values.hand_joint_set_default[i].relation = make_relation(timestamp_ns);
+		set.values.hand_joint_set_default[i].radius = (float)time_ns_to_s(timestamp_ns) * 0.01f;
+	}
+	set.hand_pose = make_relation(timestamp_ns);
+	set.is_active = is_active;
+	return set;
+}
+
+TEST_CASE("ipc_hand_ring")
+{
+	ipc_shared_hand_ring ring{};
+	ring.name = XRT_INPUT_GENERIC_HAND_TRACKING_LEFT;
+
+	xrt_hand_joint_set out = {};
+	int64_t out_ns = 0;
+	const int64_t start_ns = U_TIME_1S_IN_NS;
+
+	SECTION("Empty ring misses but is wanted")
+	{
+		CHECK_FALSE(ipc_hand_ring_locate(&ring, start_ns, kMaxAgeNs, start_ns, &out, &out_ns));
+		CHECK(ring.wanted != 0);
+	}
+
+	for (int i = 0; i < 4; i++) {
+		xrt_hand_joint_set set = make_hand(start_ns + i * kPeriodNs, true);
+		ipc_hand_ring_push(&ring, start_ns + i * kPeriodNs, &set);
+	}
+	const int64_t newest_ns = start_ns + 3 * kPeriodNs;
+	const uint32_t tip = XRT_HAND_JOINT_INDEX_TIP;
+
+	SECTION("Interpolates between samples")
+	{
+		int64_t at_ns = start_ns + kPeriodNs + kPeriodNs / 4;
+		REQUIRE(ipc_hand_ring_locate(&ring, newest_ns, kMaxAgeNs, at_ns, &out, &out_ns));
+		CHECK(out_ns == at_ns);
+		CHECK(out.is_active);
+		CHECK(out.hand_pose.pose.position.x == Approx(time_ns_to_s(at_ns)));
+		CHECK(out.values.hand_joint_set_default[tip].relation.pose.position.x == Approx(time_ns_to_s(at_ns)));
+		CHECK(out.values.hand_joint_set_default[tip].radius == Approx(time_ns_to_s(at_ns) * 0.01));
+	}
+
+	SECTION("Predicts past the newest sample up to now")
+	{
+		int64_t now_ns = newest_ns + kPeriodNs / 2;
+		REQUIRE(ipc_hand_ring_locate(&ring, now_ns, kMaxAgeNs, now_ns, &out, &out_ns));
+		CHECK(out.values.hand_joint_set_default[tip].relation.pose.position.x == Approx(time_ns_to_s(now_ns)));
+	}
+
+	SECTION("Misses future timestamps")
+	{
+		int64_t at_ns = newest_ns + U_TIME_1MS_IN_NS * 20;
+		CHECK_FALSE(ipc_hand_ring_locate(&ring, newest_ns, kMaxAgeNs, at_ns, &out, &out_ns));
+	}
+
+	SECTION("Does not predict from stale samples")
+	{
+		int64_t now_ns = newest_ns + kMaxAgeNs + 1;
+		CHECK_FALSE(ipc_hand_ring_locate(&ring, now_ns, kMaxAgeNs, now_ns, &out, &out_ns));
+	}
+
+	SECTION("Uses the closest sample when the hand was lost")
+	{
+		int64_t lost_ns = newest_ns + kPeriodNs;
+		xrt_hand_joint_set set = make_hand(lost_ns, false);
+		ipc_hand_ring_push(&ring, lost_ns, &set);
+
+		REQUIRE(ipc_hand_ring_locate(&ring, lost_ns, kMaxAgeNs, newest_ns + kPeriodNs / 4, &out, &out_ns));
+		CHECK(out.is_active);
+		CHECK(out_ns == newest_ns);
+
+		REQUIRE(ipc_hand_ring_locate(&ring, lost_ns, kMaxAgeNs, lost_ns - kPeriodNs / 4, &out, &out_ns));
+		CHECK_FALSE(out.is_active);
+		CHECK(out_ns == lost_ns);
+	}
+}
+
+TEST_CASE("ipc_hand_ring_find")
+{
+	ipc_shared_memory *ism = new ipc_shared_memory{};
+	ism->hand_ring_count = 2;
+	ism->hand_rings[0].device_id = 3;
+	ism->hand_rings[0].name = XRT_INPUT_GENERIC_HAND_TRACKING_LEFT;
+	ism->hand_rings[1].device_id = 3;
+	ism->hand_rings[1].name = XRT_INPUT_GENERIC_HAND_TRACKING_RIGHT;
+
+	CHECK(ipc_hand_ring_find(ism, 3, XRT_INPUT_GENERIC_HAND_TRACKING_RIGHT) == &ism->hand_rings[1]);
+	CHECK(ipc_hand_ring_find(ism, 2, XRT_INPUT_GENERIC_HAND_TRACKING_RIGHT) == nullptr);
+
+	delete ism;
+}
+
+TEST_CASE("ipc_view_poses")
+{
+	ipc_shared_view_poses views{};
+
+	const xrt_vec3 eye_relation = {0.063f, 0.0f, 0.0f};
+	const xrt_vec3 other_eye_relation = {0.07f, 0.0f, 0.0f};
+
+	xrt_fov fovs[2] = {};
+	xrt_pose poses[2] = {};
+
+	// Nothing published yet, but the service now knows what to publish.
+	CHECK_FALSE(ipc_view_poses_read(&views, &eye_relation, 2, fovs, poses));
+	CHECK(views.wanted != 0);
+	CHECK(views.wanted_view_count == 2);
+	CHECK(views.wanted_eye_relation.x == eye_relation.x);
+
+	xrt_fov in_fovs[2] = {{-1.0f, 0.8f, 0.9f, -0.9f}, {-0.8f, 1.0f, 0.9f, -0.9f}};
+	xrt_pose in_poses[2] = {XRT_POSE_IDENTITY, XRT_POSE_IDENTITY};
+	in_poses[0].position.x = -eye_relation.x / 2;
+	in_poses[1].position.x = eye_relation.x / 2;
+	ipc_view_poses_write(&views, &eye_relation, 2, in_fovs, in_poses);
+
+	REQUIRE(ipc_view_poses_read(&views, &eye_relation, 2, fovs, poses));
+	CHECK(fovs[1].angle_left == in_fovs[1].angle_left);
+	CHECK(poses[0].position.x == in_poses[0].position.x);
+
+	// Mismatches fall back to the service.
+	CHECK_FALSE(ipc_view_poses_read(&views, &other_eye_relation, 2, fovs, poses));
+	CHECK_FALSE(ipc_view_poses_read(&views, &eye_relation, 1, fovs, poses));
+}
+
+TEST_CASE("ipc_pose_ring_concurrent")
+{
+	ipc_shared_pose_ring ring{};
+	ring.name = XRT_INPUT_GENERIC_HEAD_POSE;
+
+	const int64_t start_ns = U_TIME_1S_IN_NS;
+	const int64_t step_ns = U_TIME_1MS_IN_NS;
+	const int sample_count = 2000;
+	std::atomic<int64_t> newest_ns{0};
+	std::atomic<bool> reading{false};
+	std::atomic<bool> done{false};
+
+	push(ring, start_ns);
+	newest_ns = start_ns;
+
+	std::thread writer([&] {
+		while (!reading.load()) {
+			std::this_thread::yield();
+		}
+
+		for (int i = 1; i < sample_count; i++) {
+			int64_t ts = start_ns + i * step_ns;
+			push(ring, ts);
+			newest_ns.store(ts, std::memory_order_release);
+
+			// The service publishes periodically, not back to back.
+			std::this_thread::sleep_for(std::chrono::microseconds(20));
+		}
+
+		done = true;
+	});
+
+	// Every read that succeeds must be consistent, torn reads show up as a wrong position.
+	int hits = 0;
+	int bad = 0;
+	reading = true;
+	while (!done.load()) {
+		int64_t now_ns = newest_ns.load(std::memory_order_acquire);
+		int64_t at_ns = now_ns - step_ns / 2;
+
+		xrt_space_relation out = XRT_SPACE_RELATION_ZERO;
+		if (!ipc_pose_ring_locate(&ring, now_ns, INT64_MAX, at_ns, &out)) {
+			continue;
+		}
+
+		hits++;
+		if (out.pose.position.x != Approx(time_ns_to_s(at_ns)).epsilon(1e-5)) {
+			bad++;
+		}
+	}
+
+	writer.join();
+
+	CHECK(hits > 0);
+	CHECK(bad == 0);
+}
@@ -0,0 +1,154 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Shared memory swapchain image queue tests.
+ */
+
+#include "shared/ipc_swapchain_queue.h"
+
+#include "catch_amalgamated.hpp"
+
+#include <deque>
+
+
+namespace {
+
+//! Hands out images oldest released first, like the service swapchains.
+struct fake_swapchain
+{
+	xrt_swapchain base = {};
+	std::deque<uint32_t> fifo;
+
+	explicit fake_swapchain(uint32_t image_count)
+	{
+		base.image_count = image_count;
+		base.acquire_image = acquire_image;
+		base.release_image = release_image;
+		for (uint32_t i = 0; i < image_count; i++) {
+			fifo.push_back(i);
+		}
+	}
+
+	static xrt_result_t
+	acquire_image(xrt_swapchain *xsc, uint32_t *out_index)
+	{
+		auto fsc = reinterpret_cast<fake_swapchain *>(xsc);
+		if (fsc->fifo.empty()) {
+			return XRT_ERROR_NO_IMAGE_AVAILABLE;
+		}
+		*out_index = fsc->fifo.front();
+		fsc->fifo.pop_front();
+		return XRT_SUCCESS;
+	}
+
+	static xrt_result_t
+	release_image(xrt_swapchain *xsc, uint32_t index)
+	{
+		reinterpret_cast<fake_swapchain *>(xsc)->fifo.push_back(index);
+		return XRT_SUCCESS;
+	}
+};
+
+} // namespace
+
+
+TEST_CASE("ipc_swapchain_queue")
+{
+	ipc_shared_swapchain_queue queue{};
+	ipc_swapchain_queue_init(&queue, 3);
+
+	fake_swapchain fsc(3);
+
+	uint32_t index = UINT32_MAX;
+
+	SECTION("Acquire in index order, then release order")
+	{
+		for (uint32_t i = 0; i < 3; i++) {
+			REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+			CHECK(index == i);
+		}
+		CHECK(ipc_swapchain_queue_acquire(&queue, &index) == XRT_ERROR_NO_IMAGE_AVAILABLE);
+
+		REQUIRE(ipc_swapchain_queue_release(&queue, 2) == XRT_SUCCESS);
+		REQUIRE(ipc_swapchain_queue_release(&queue, 0) == XRT_SUCCESS);
+
+		REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+		CHECK(index == 2);
+		REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+		CHECK(index == 0);
+	}
+
+	SECTION("Many frames wrap around the ring")
+	{
+		for (uint32_t frame = 0; frame < 100; frame++) {
+			REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+			CHECK(index == frame % 3);
+			REQUIRE(ipc_swapchain_queue_release(&queue, index) == XRT_SUCCESS);
+
+			// Like the layer sync every frame.
+			REQUIRE(ipc_swapchain_queue_replay(&queue, &fsc.base) == XRT_SUCCESS);
+		}
+
+		CHECK(fsc.fifo == std::deque<uint32_t>{1, 2, 0});
+	}
+
+	SECTION("Replay keeps the service swapchain in step")
+	{
+		REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+		REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+		REQUIRE(ipc_swapchain_queue_release(&queue, 1) == XRT_SUCCESS);
+		REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+		CHECK(index == 2);
+
+		REQUIRE(ipc_swapchain_queue_replay(&queue, &fsc.base) == XRT_SUCCESS);
+		CHECK(fsc.fifo == std::deque<uint32_t>{1});
+
+		// Nothing new to replay.
+		REQUIRE(ipc_swapchain_queue_replay(&queue, &fsc.base) == XRT_SUCCESS);
+		CHECK(fsc.fifo == std::deque<uint32_t>{1});
+	}
+
+	SECTION("A full queue needs a replay")
+	{
+		for (uint32_t i = 0; i < IPC_SWAPCHAIN_QUEUE_MAX_OPS / 2; i++) {
+			REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+			REQUIRE(ipc_swapchain_queue_release(&queue, index) == XRT_SUCCESS);
+		}
+
+		CHECK(ipc_swapchain_queue_needs_replay(&queue));
+		CHECK(ipc_swapchain_queue_acquire(&queue, &index) == XRT_ERROR_IPC_FAILURE);
+
+		REQUIRE(ipc_swapchain_queue_replay(&queue, &fsc.base) == XRT_SUCCESS);
+		CHECK_FALSE(ipc_swapchain_queue_needs_replay(&queue));
+		REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+	}
+
+	SECTION("Service swapchain out of step")
+	{
+		// The service handed out an image behind the queue's back.
+		uint32_t service_index = 0;
+		REQUIRE(fsc.base.acquire_image(&fsc.base, &service_index) == XRT_SUCCESS);
+
+		REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+		CHECK(ipc_swapchain_queue_replay(&queue, &fsc.base) == XRT_ERROR_IPC_FAILURE);
+	}
+
+	SECTION("Invalid releases")
+	{
+		// Nothing acquired yet.
+		CHECK(ipc_swapchain_queue_release(&queue, 0) == XRT_ERROR_NO_IMAGE_AVAILABLE);
+
+		REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+		CHECK(ipc_swapchain_queue_release(&queue, 3) == XRT_ERROR_NO_IMAGE_AVAILABLE);
+
+		// Only the acquired image can be released, and only once.
+		CHECK(ipc_swapchain_queue_release(&queue, index + 1) == XRT_ERROR_NO_IMAGE_AVAILABLE);
+		CHECK(ipc_swapchain_queue_release(&queue, index) == XRT_SUCCESS);
+		CHECK(ipc_swapchain_queue_release(&queue, index) == XRT_ERROR_NO_IMAGE_AVAILABLE);
+
+		// A bad release doesn't change what is acquired next.
+		REQUIRE(ipc_swapchain_queue_acquire(&queue, &index) == XRT_SUCCESS);
+		CHECK(index == 1);
+	}
+}
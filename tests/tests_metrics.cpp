@@ -0,0 +1,96 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Metrics writer tests.
+ */
+
+#include "util/u_metrics.h"
+
+#include "monado_metrics.pb.h"
+#include "pb_decode.h"
+
+#include "catch_amalgamated.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+
+static constexpr int kThreads = 4;
+static constexpr int kRecordsPerThread = 500;
+
+TEST_CASE("u_metrics")
+{
+	char path[] = "/tmp/monado_metrics_test_XXXXXX";
+	int fd = mkstemp(path);
+	REQUIRE(fd >= 0);
+	close(fd);
+
+	// Read once by the metrics code.
+	setenv("XRT_METRICS_FILE", path, 1);
+
+	u_metrics_init();
+	REQUIRE(u_metrics_is_active());
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < kThreads; t++) {
+		threads.emplace_back([t] {
+			for (int i = 0; i < kRecordsPerThread; i++) {
+				u_metrics_used umu = {};
+				umu.session_id = t;
+				umu.session_frame_id = i;
+				u_metrics_write_used(&umu);
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	u_metrics_close();
+	CHECK_FALSE(u_metrics_is_active());
+
+	FILE *file = fopen(path, "rb");
+	REQUIRE(file != nullptr);
+	std::vector<uint8_t> data;
+	uint8_t buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data.insert(data.end(), buffer, buffer + read);
+	}
+	fclose(file);
+	remove(path);
+
+	pb_istream_t stream = pb_istream_from_buffer(data.data(), data.size());
+
+	// The version always comes first.
+	monado_metrics_Record record = monado_metrics_Record_init_default;
+	REQUIRE(pb_decode_delimited(&stream, &monado_metrics_Record_msg, &record));
+	CHECK(record.which_record == monado_metrics_Record_version_tag);
+
+	std::set<std::pair<int64_t, int64_t>> seen;
+	int64_t last_frame_id[kThreads] = {-1, -1, -1, -1};
+	while (stream.bytes_left > 0) {
+		record = monado_metrics_Record_init_default;
+		REQUIRE(pb_decode_delimited(&stream, &monado_metrics_Record_msg, &record));
+		REQUIRE(record.which_record == monado_metrics_Record_used_tag);
+
+		int64_t t = record.record.used.session_id;
+		int64_t i = record.record.used.session_frame_id;
+		REQUIRE(t >= 0);
+		REQUIRE(t < kThreads);
+
+		// In order per thread, never twice.
+		CHECK(i > last_frame_id[t]);
+		last_frame_id[t] = i;
+		CHECK(seen.insert({t, i}).second);
+	}
+
+	// Everything is either written or counted as dropped.
+	CHECK(seen.size() + u_metrics_get_dropped_count() == kThreads * kRecordsPerThread);
+}
@@ -0,0 +1,145 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Generated binding lookup table tests and benchmarks.
+ *
+ * Run the benchmarks with `tests_oxr_bindings "[benchmark]"`.
+ */
+
+#include "catch_amalgamated.hpp"
+
+#include <xrt/xrt_defines.h>
+
+#include <oxr/oxr_objects.h>
+
+extern "C" {
+#include "bindings/b_generated_bindings.h"
+}
+
+#include <cstring>
+
+
+static uint64_t
+hash_of(const char *str)
+{
+	return oxr_path_hash(str, strlen(str));
+}
+
+//! What the lookup replaces, the first binding and path index with the path.
+static bool
+linear_find(const profile_template &t, const char *path, size_t *out_binding, size_t *out_path)
+{
+	for (size_t i = 0; i < t.binding_count; i++) {
+		for (size_t k = 0; t.bindings[i].paths[k] != NULL; k++) {
+			if (strcmp(t.bindings[i].paths[k], path) == 0) {
+				*out_binding = i;
+				*out_path = k;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static bool
+lookup_find(const profile_template &t, const char *path, size_t *out_binding, size_t *out_path)
+{
+	size_t count = 0;
+	const binding_path_lookup *lookup = oxr_bindings_find_path_lookup(&t, hash_of(path), &count);
+	for (size_t i = 0; i < count; i++) {
+		if (strcmp(t.bindings[lookup[i].binding_index].paths[lookup[i].path_index], path) == 0) {
+			*out_binding = lookup[i].binding_index;
+			*out_path = lookup[i].path_index;
+			return true;
+		}
+	}
+	return false;
+}
+
+TEST_CASE("oxr_bindings_lookup")
+{
+	SECTION("Profile template from device name")
+	{
+		bool all_first = true;
+		for (size_t i = 0; i < ARRAY_SIZE(profile_templates); i++) {
+			int index = oxr_bindings_profile_template_index(profile_templates[i].name);
+			all_first = all_first && index >= 0 && (size_t)index <= i;
+			all_first = all_first && profile_templates[index].name == profile_templates[i].name;
+		}
+		CHECK(all_first);
+
+		CHECK(oxr_bindings_profile_template_index(XRT_DEVICE_INVALID) == -1);
+		CHECK(oxr_bindings_profile_template_index(XRT_DEVICE_GENERIC_HMD) == -1);
+	}
+
+	SECTION("Every binding path is found, same as a linear search")
+	{
+		bool all_sorted = true;
+		bool all_same = true;
+		for (const profile_template &t : profile_templates) {
+			size_t path_count = 0;
+			for (size_t i = 0; i < t.binding_count; i++) {
+				for (size_t k = 0; t.bindings[i].paths[k] != NULL; k++) {
+					const char *path = t.bindings[i].paths[k];
+					size_t lb = 0, lp = 0, fb = 1, fp = 1;
+					all_same = all_same && linear_find(t, path, &lb, &lp);
+					all_same = all_same && lookup_find(t, path, &fb, &fp);
+					all_same = all_same && lb == fb && lp == fp;
+					path_count++;
+				}
+			}
+			CHECK(t.path_lookup_count == path_count);
+
+			for (size_t i = 1; i < t.path_lookup_count; i++) {
+				all_sorted = all_sorted && t.path_lookup[i - 1].hash <= t.path_lookup[i].hash;
+			}
+		}
+		CHECK(all_sorted);
+		CHECK(all_same);
+	}
+
+	SECTION("Unknown paths are not found")
+	{
+		size_t count = 1;
+		const profile_template &t = profile_templates[0];
+		CHECK(oxr_bindings_find_path_lookup(&t, hash_of("/user/hand/left/input/nope"), &count) == NULL);
+		CHECK(count == 0);
+	}
+}
+
+TEST_CASE("oxr_bindings_benchmark", "[.][benchmark]")
+{
+	const profile_template *index = nullptr;
+	for (const profile_template &t : profile_templates) {
+		if (strcmp(t.path, "/interaction_profiles/valve/index_controller") == 0) {
+			index = &t;
+		}
+	}
+	REQUIRE(index != nullptr);
+
+	// Like an app suggesting every binding of the profile.
+	BENCHMARK("Linear search, all index_controller paths")
+	{
+		size_t sum = 0, b = 0, p = 0;
+		for (size_t i = 0; i < index->binding_count; i++) {
+			for (size_t k = 0; index->bindings[i].paths[k] != NULL; k++) {
+				linear_find(*index, index->bindings[i].paths[k], &b, &p);
+				sum += b;
+			}
+		}
+		return sum;
+	};
+
+	BENCHMARK("Lookup table, all index_controller paths")
+	{
+		size_t sum = 0, b = 0, p = 0;
+		for (size_t i = 0; i < index->binding_count; i++) {
+			for (size_t k = 0; index->bindings[i].paths[k] != NULL; k++) {
+				lookup_find(*index, index->bindings[i].paths[k], &b, &p);
+				sum += b;
+			}
+		}
+		return sum;
+	};
+}
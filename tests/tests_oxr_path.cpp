@@ -0,0 +1,216 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Path interning tests and benchmarks.
+ *
+ * Run the benchmarks with `tests_oxr_path "[benchmark]"`.
+ */
+
+#include "catch_amalgamated.hpp"
+
+#include <xrt/xrt_defines.h>
+
+#include <oxr/oxr_objects.h>
+#include <oxr/oxr_logger.h>
+#include <oxr/oxr_subaction.h>
+
+#include "bindings/b_generated_bindings.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+//! Only the path store of the instance is used.
+struct PathFixture
+{
+	oxr_logger log = {};
+	oxr_instance *inst = nullptr;
+
+	PathFixture()
+	{
+		oxr_log_init(&log, "test");
+		inst = (oxr_instance *)calloc(1, sizeof(oxr_instance));
+		REQUIRE(oxr_path_init(&log, inst) == XR_SUCCESS);
+	}
+
+	~PathFixture()
+	{
+		oxr_path_destroy(&log, inst);
+		free(inst);
+	}
+
+	XrPath
+	get_or_create(const std::string &str)
+	{
+		XrPath path = XR_NULL_PATH;
+		REQUIRE(oxr_path_get_or_create(&log, inst, str.c_str(), str.size(), &path) == XR_SUCCESS);
+		return path;
+	}
+
+	std::string
+	get_string(XrPath path)
+	{
+		const char *str = nullptr;
+		size_t length = 0;
+		REQUIRE(oxr_path_get_string(&log, inst, path, &str, &length) == XR_SUCCESS);
+		REQUIRE(str[length] == '\0');
+		return std::string(str, length);
+	}
+};
+
+//! What instance creation and binding setup interns, using the generated hashes.
+static void
+intern_all_profiles(oxr_logger *log, oxr_instance *inst)
+{
+	XrPath path;
+
+#define INTERN_SUBACTION_PATH(NAME, NAME_CAPS, PATH) oxr_path_get_or_create(log, inst, PATH, strlen(PATH), &path);
+	OXR_FOR_EACH_SUBACTION_PATH_DETAILED(INTERN_SUBACTION_PATH)
+#undef INTERN_SUBACTION_PATH
+
+	for (const profile_template &t : profile_templates) {
+		oxr_path_get_or_create_with_hash(log, inst, t.path, strlen(t.path), t.path_hash, &path);
+
+		for (size_t i = 0; i < t.binding_count; i++) {
+			const binding_template &b = t.bindings[i];
+			oxr_path_get_or_create_with_hash(log, inst, b.subaction_path, strlen(b.subaction_path),
+			                                 b.subaction_path_hash, &path);
+			for (size_t k = 0; b.paths[k] != NULL; k++) {
+				oxr_path_get_or_create_with_hash(log, inst, b.paths[k], strlen(b.paths[k]),
+				                                 b.path_hashes[k], &path);
+			}
+		}
+	}
+}
+
+TEST_CASE("oxr_path")
+{
+	PathFixture f;
+
+	SECTION("Round trips and dedups")
+	{
+		XrPath a = f.get_or_create("/user/hand/left");
+		XrPath b = f.get_or_create("/user/hand/right");
+		CHECK(a != XR_NULL_PATH);
+		CHECK(a != b);
+		CHECK(f.get_or_create("/user/hand/left") == a);
+		CHECK(f.get_string(a) == "/user/hand/left");
+		CHECK(f.get_string(b) == "/user/hand/right");
+
+		XrPath found = XR_NULL_PATH;
+		CHECK(oxr_path_only_get(&f.log, f.inst, "/user/hand/left", 15, &found) == XR_SUCCESS);
+		CHECK(found == a);
+	}
+
+	SECTION("Unknown and invalid paths")
+	{
+		XrPath a = f.get_or_create("/user/head");
+
+		XrPath found = a;
+		CHECK(oxr_path_only_get(&f.log, f.inst, "/user/gamepad", 13, &found) == XR_SUCCESS);
+		CHECK(found == XR_NULL_PATH);
+
+		CHECK_FALSE(oxr_path_is_valid(&f.log, f.inst, XR_NULL_PATH));
+		CHECK(oxr_path_is_valid(&f.log, f.inst, a));
+		CHECK_FALSE(oxr_path_is_valid(&f.log, f.inst, a + 1));
+		CHECK_FALSE(oxr_path_is_valid(&f.log, f.inst, UINT64_MAX));
+
+		const char *str = nullptr;
+		size_t length = 0;
+		CHECK(oxr_path_get_string(&f.log, f.inst, a + 1, &str, &length) == XR_ERROR_PATH_INVALID);
+	}
+
+	SECTION("Strings and ids survive growing")
+	{
+		XrPath first = f.get_or_create("/first");
+		const char *first_str = nullptr;
+		size_t length = 0;
+		REQUIRE(oxr_path_get_string(&f.log, f.inst, first, &first_str, &length) == XR_SUCCESS);
+
+		// Past the table, chunk and arena block sizes, one string larger than a block.
+		std::vector<XrPath> paths;
+		for (int i = 0; i < 20000; i++) {
+			paths.push_back(f.get_or_create("/user/path/" + std::to_string(i)));
+		}
+		std::string huge = "/huge/" + std::string(40000, 'x');
+		XrPath huge_path = f.get_or_create(huge);
+
+		bool all_same = true;
+		for (int i = 0; i < 20000; i++) {
+			std::string str = "/user/path/" + std::to_string(i);
+			all_same = all_same && f.get_or_create(str) == paths[i] && f.get_string(paths[i]) == str;
+		}
+		CHECK(all_same);
+		CHECK(f.get_string(huge_path) == huge);
+
+		const char *str = nullptr;
+		REQUIRE(oxr_path_get_string(&f.log, f.inst, first, &str, &length) == XR_SUCCESS);
+		CHECK(str == first_str);
+	}
+
+	SECTION("Generated hashes match")
+	{
+		bool all_match = true;
+		for (const profile_template &t : profile_templates) {
+			all_match = all_match && oxr_path_hash(t.path, strlen(t.path)) == t.path_hash;
+
+			for (size_t i = 0; i < t.binding_count; i++) {
+				const binding_template &b = t.bindings[i];
+				uint64_t hash = oxr_path_hash(b.subaction_path, strlen(b.subaction_path));
+				all_match = all_match && hash == b.subaction_path_hash;
+				for (size_t k = 0; b.paths[k] != NULL; k++) {
+					size_t length = strlen(b.paths[k]);
+					all_match = all_match && oxr_path_hash(b.paths[k], length) == b.path_hashes[k];
+				}
+			}
+
+			for (size_t i = 0; i < t.dpad_count; i++) {
+				const dpad_emulation &d = t.dpads[i];
+				for (size_t k = 0; d.paths[k] != NULL; k++) {
+					size_t length = strlen(d.paths[k]);
+					all_match = all_match && oxr_path_hash(d.paths[k], length) == d.path_hashes[k];
+				}
+			}
+		}
+		CHECK(all_match);
+	}
+}
+
+TEST_CASE("oxr_path_benchmark", "[.][benchmark]")
+{
+	PathFixture f;
+	intern_all_profiles(&f.log, f.inst);
+
+	const char *str = "/interaction_profiles/valve/index_controller";
+	size_t length = strlen(str);
+	XrPath path = f.get_or_create(str);
+
+	BENCHMARK("xrStringToPath existing path")
+	{
+		XrPath out = XR_NULL_PATH;
+		oxr_path_get_or_create(&f.log, f.inst, str, length, &out);
+		return out;
+	};
+
+	BENCHMARK("xrPathToString")
+	{
+		const char *out = nullptr;
+		size_t out_length = 0;
+		oxr_path_get_string(&f.log, f.inst, path, &out, &out_length);
+		return out_length;
+	};
+
+	BENCHMARK("Instance creation, all profile paths")
+	{
+		oxr_instance *inst = (oxr_instance *)calloc(1, sizeof(oxr_instance));
+		oxr_path_init(&f.log, inst);
+		intern_all_profiles(&f.log, inst);
+		size_t num = inst->path_store.num;
+		oxr_path_destroy(&f.log, inst);
+		free(inst);
+		return num;
+	};
+}
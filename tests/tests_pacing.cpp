@@ -402,3 +402,87 @@ TEST_CASE("u_pacing_compositor_fake")
 	}
 	u_pc_destroy(&upc);
 }
+
+TEST_CASE("u_pacing_compositor_stream")
+{
+	MockClock clock;
+	u_pacing_compositor *upc = nullptr;
+	REQUIRE(XRT_SUCCESS == u_pc_stream_create(frame_interval_ns.count(), clock.now(), &upc));
+	REQUIRE(upc != nullptr);
+
+	clock.advance(1ms);
+
+	SECTION("Standalone predictions")
+	{
+		CompositorPredictions predictions;
+		u_pc_predict(upc, clock.now(), &predictions.frame_id, &predictions.wake_up_time_ns,
+		             &predictions.desired_present_time_ns, &predictions.present_slop_ns,
+		             &predictions.predicted_display_time_ns, &predictions.predicted_display_period_ns,
+		             &predictions.min_display_period_ns);
+		basicPredictionConsistencyChecks(clock.now(), predictions);
+	}
+	SECTION("Learns from feedback")
+	{
+		constexpr auto encodeTime = 3ms;
+		constexpr auto latency = 4ms;
+
+		// Streamer wants frames on this phase.
+		u_pc_update_vblank_from_display_control(upc, clock.now() + unanoseconds(5ms).count());
+
+		CompositorPredictions predictions;
+		for (int i = 0; i < 50; ++i) {
+			u_pc_predict(upc, clock.now(), &predictions.frame_id, &predictions.wake_up_time_ns,
+			             &predictions.desired_present_time_ns, &predictions.present_slop_ns,
+			             &predictions.predicted_display_time_ns, &predictions.predicted_display_period_ns,
+			             &predictions.min_display_period_ns);
+			INFO(predictions.frame_id);
+			basicPredictionConsistencyChecks(clock.now(), predictions);
+
+			clock.advance_to(predictions.wake_up_time_ns);
+			u_pc_mark_point(upc, U_TIMING_POINT_WAKE_UP, predictions.frame_id, clock.now());
+			clock.advance(shortDrawDelay);
+			u_pc_mark_point(upc, U_TIMING_POINT_SUBMIT_END, predictions.frame_id, clock.now());
+			int64_t gpu_start_ns = clock.now();
+			clock.advance(shortGpuTime);
+			u_pc_info_gpu(upc, predictions.frame_id, gpu_start_ns, clock.now(), clock.now());
+
+			// Hand over to the encoder at the desired present time.
+			CHECK(clock.now() <= predictions.desired_present_time_ns);
+			clock.advance_to(predictions.desired_present_time_ns);
+			int64_t present_ns = clock.now();
+			u_pc_stream_info_encode(upc, predictions.frame_id, present_ns,
+			                        present_ns + unanoseconds(encodeTime).count());
+			u_pc_stream_info_latency(upc, predictions.frame_id, unanoseconds(latency).count());
+		}
+
+		// Should have converged on the real pipeline latency, not the defaults.
+		int64_t offset_ns = predictions.predicted_display_time_ns - predictions.desired_present_time_ns;
+		CHECK(offset_ns >= unanoseconds(encodeTime + latency).count());
+		CHECK(offset_ns < unanoseconds(encodeTime + latency + 1ms).count());
+	}
+	SECTION("Learns the present interval")
+	{
+		// The streamer runs a bit slower than the nominal period.
+		constexpr auto period = 17ms;
+
+		int64_t phase_ns = clock.now() + unanoseconds(5ms).count();
+		CompositorPredictions predictions;
+		for (int i = 0; i < 50; ++i) {
+			// Same phase given twice with some noise, and sometimes a skipped one.
+			u_pc_update_vblank_from_display_control(upc, phase_ns);
+			u_pc_update_vblank_from_display_control(upc, phase_ns + 1000);
+			phase_ns += unanoseconds(period).count() * (i % 10 == 9 ? 2 : 1);
+
+			u_pc_predict(upc, clock.now(), &predictions.frame_id, &predictions.wake_up_time_ns,
+			             &predictions.desired_present_time_ns, &predictions.present_slop_ns,
+			             &predictions.predicted_display_time_ns, &predictions.predicted_display_period_ns,
+			             &predictions.min_display_period_ns);
+			basicPredictionConsistencyChecks(clock.now(), predictions);
+			clock.advance_to(predictions.desired_present_time_ns);
+		}
+
+		CHECK(predictions.predicted_display_period_ns > unanoseconds(period - 100us).count());
+		CHECK(predictions.predicted_display_period_ns < unanoseconds(period + 100us).count());
+	}
+	u_pc_destroy(&upc);
+}
@@ -0,0 +1,473 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief m_relation_history interpolation/prediction modes, concurrency tests and benchmarks.
+ *
+ * Benchmarks are hidden, run them with `tests_relation_history "[benchmark]"`.
+ */
+
+#include <math/m_api.h>
+#include <math/m_relation_history.h>
+#include <util/u_time.h>
+
+#include "catch_amalgamated.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+// Half a millisecond, about what an IMU driven tracker pushes at.
+constexpr int64_t kPushPeriodNs = U_TIME_1MS_IN_NS / 2;
+constexpr int64_t kStartNs = 20 * (int64_t)U_TIME_1S_IN_NS;
+
+xrt_space_relation
+make_relation(int64_t timestamp_ns)
+{
+	xrt_space_relation relation = XRT_SPACE_RELATION_ZERO;
+	relation.relation_flags = (xrt_space_relation_flags)( //
+	    XRT_SPACE_RELATION_POSITION_TRACKED_BIT |         //
+	    XRT_SPACE_RELATION_POSITION_VALID_BIT |           //
+	    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT |      //
+	    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT);        //
+
+	// Encode the timestamp in the pose so readers can check what they got.
+	double t_s = time_ns_to_s(timestamp_ns - kStartNs);
+	relation.pose.position.x = (float)t_s;
+	relation.pose.position.y = (float)-t_s;
+	return relation;
+}
+
+m_relation_history *
+create(bool single_writer)
+{
+	m_relation_history *rh = nullptr;
+	if (single_writer) {
+		m_relation_history_create_single_writer(&rh);
+	} else {
+		m_relation_history_create(&rh);
+	}
+	return rh;
+}
+
+struct ContendedResult
+{
+	double pushes_per_s;
+	double gets_per_s;
+	uint64_t torn;
+};
+
+/*!
+ * One writer pushing as fast as it can while @p readers threads query
+ * around the newest pose, like compositor and IPC threads do.
+ */
+ContendedResult
+run_contended(bool single_writer, uint32_t readers, std::chrono::milliseconds duration)
+{
+	m_relation_history *rh = create(single_writer);
+
+	std::atomic<bool> running{true};
+	std::atomic<int64_t> newest_ns{0};
+	std::atomic<uint64_t> total_gets{0};
+	std::atomic<uint64_t> torn{0};
+	uint64_t pushes = 0;
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 0; i < readers; i++) {
+		threads.emplace_back([&] {
+			uint64_t gets = 0;
+			while (running.load(std::memory_order_relaxed)) {
+				int64_t at_ns = newest_ns.load(std::memory_order_relaxed) - kPushPeriodNs / 2;
+				if (at_ns <= kStartNs) {
+					continue;
+				}
+
+				xrt_space_relation out = XRT_SPACE_RELATION_ZERO;
+				m_relation_history_get(rh, at_ns, &out);
+				gets++;
+
+				// Both components are written together, a mismatch means a torn read.
+				if (out.pose.position.x != -out.pose.position.y) {
+					torn.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+			total_gets.fetch_add(gets);
+		});
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	int64_t ts = kStartNs;
+	while (std::chrono::steady_clock::now() - start < duration) {
+		for (int i = 0; i < 64; i++) {
+			ts += kPushPeriodNs;
+			xrt_space_relation relation = make_relation(ts);
+			m_relation_history_push(rh, &relation, ts);
+			pushes++;
+		}
+		newest_ns.store(ts, std::memory_order_relaxed);
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	running = false;
+	for (auto &t : threads) {
+		t.join();
+	}
+
+	m_relation_history_destroy(&rh);
+
+	return {pushes / elapsed, total_gets.load() / elapsed, torn.load()};
+}
+
+constexpr xrt_space_relation_flags kAllFlags = (xrt_space_relation_flags)( //
+    XRT_SPACE_RELATION_POSITION_TRACKED_BIT |                                 //
+    XRT_SPACE_RELATION_POSITION_VALID_BIT |                                   //
+    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT |                              //
+    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT |                                //
+    XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT |                            //
+    XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT);                           //
+
+/*!
+ * Something head like: slow large yaw, faster small nods and a bit of
+ * swaying, ground truth and exact derivatives at any time.
+ */
+xrt_space_relation
+head_motion(double t)
+{
+	struct Wave
+	{
+		double amplitude, hz, phase;
+
+		double
+		value(double t) const
+		{
+			return amplitude * std::sin(2 * M_PI * hz * t + phase);
+		}
+
+		double
+		derivative(double t) const
+		{
+			return amplitude * 2 * M_PI * hz * std::cos(2 * M_PI * hz * t + phase);
+		}
+	};
+
+	const Wave yaw[] = {{1.0, 0.25, 0}, {0.25, 1.1, 1}};
+	const Wave pitch[] = {{0.35, 0.5, 2}, {0.05, 2.3, 0}};
+	const Wave pos_x[] = {{0.10, 0.4, 0}, {0.02, 1.7, 3}};
+	const Wave pos_y[] = {{0.03, 0.9, 1}};
+	const Wave pos_z[] = {{0.08, 0.3, 2}};
+
+	auto sum = [&](const auto &waves, bool derivative) {
+		double ret = 0;
+		for (const Wave &w : waves) {
+			ret += derivative ? w.derivative(t) : w.value(t);
+		}
+		return ret;
+	};
+
+	xrt_space_relation rel = XRT_SPACE_RELATION_ZERO;
+	rel.relation_flags = kAllFlags;
+	rel.pose.position = {(float)sum(pos_x, false), 1.6f + (float)sum(pos_y, false), (float)sum(pos_z, false)};
+	rel.linear_velocity = {(float)sum(pos_x, true), (float)sum(pos_y, true), (float)sum(pos_z, true)};
+
+	// Yaw around world Y, then pitch around the local X.
+	double y = sum(yaw, false);
+	double p = sum(pitch, false);
+	xrt_quat q_yaw = {0, (float)std::sin(y / 2), 0, (float)std::cos(y / 2)};
+	xrt_quat q_pitch = {(float)std::sin(p / 2), 0, 0, (float)std::cos(p / 2)};
+	math_quat_rotate(&q_yaw, &q_pitch, &rel.pose.orientation);
+
+	// World space angular velocity, yaw rate around Y plus the pitch rate around the yawed X axis.
+	xrt_vec3 pitch_axis = {1, 0, 0};
+	math_quat_rotate_vec3(&q_yaw, &pitch_axis, &pitch_axis);
+	double dy = sum(yaw, true);
+	double dp = sum(pitch, true);
+	rel.angular_velocity = {(float)(pitch_axis.x * dp), (float)(dy + pitch_axis.y * dp),
+	                        (float)(pitch_axis.z * dp)};
+
+	return rel;
+}
+
+double
+position_error(const xrt_space_relation &a, const xrt_space_relation &b)
+{
+	xrt_vec3 d = {a.pose.position.x - b.pose.position.x, a.pose.position.y - b.pose.position.y,
+	              a.pose.position.z - b.pose.position.z};
+	return std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+}
+
+double
+angle_error(const xrt_space_relation &a, const xrt_space_relation &b)
+{
+	const xrt_quat &qa = a.pose.orientation;
+	const xrt_quat &qb = b.pose.orientation;
+	double dot = std::abs(qa.x * qb.x + qa.y * qb.y + qa.z * qb.z + qa.w * qb.w);
+	return 2 * std::acos(std::min(1.0, dot));
+}
+
+struct ReplayNoise
+{
+	double position_m;
+	double orientation_rad;
+	double linear_velocity_m_s;
+	double angular_velocity_rad_s;
+	double timestamp_jitter_s;
+};
+
+struct ReplayError
+{
+	double position_rms_mm;
+	double angle_rms_deg;
+};
+
+/*!
+ * Replays @p duration_s of noisy head motion sampled at @p hz into a
+ * history, at every sample asks for the pose @p horizon_s ahead, or for
+ * a negative horizon that far between the last two samples, and compares
+ * it against the ground truth. Timestamp jitter only goes into the pushed
+ * timestamps, queries and ground truth use the real sample times.
+ */
+ReplayError
+replay(m_relation_history *rh, double hz, double duration_s, double horizon_s, const ReplayNoise &noise)
+{
+	std::mt19937 rng(1234);
+	std::normal_distribution<double> normal;
+	auto jitter = [&](float v, double sigma) { return (float)(v + normal(rng) * sigma); };
+
+	double pos_sq = 0;
+	double angle_sq = 0;
+	uint32_t count = 0;
+
+	uint32_t num_samples = (uint32_t)(duration_s * hz);
+	for (uint32_t i = 0; i < num_samples; i++) {
+		// The motion is sampled on time, only the timestamp given with it is off.
+		double t = 1 + i / hz;
+		double stamp_s = t + normal(rng) * noise.timestamp_jitter_s;
+		xrt_space_relation sample = head_motion(t);
+
+		xrt_vec3 &p = sample.pose.position;
+		p = {jitter(p.x, noise.position_m), jitter(p.y, noise.position_m), jitter(p.z, noise.position_m)};
+
+		xrt_vec3 &lv = sample.linear_velocity;
+		lv = {jitter(lv.x, noise.linear_velocity_m_s), jitter(lv.y, noise.linear_velocity_m_s),
+		      jitter(lv.z, noise.linear_velocity_m_s)};
+
+		xrt_vec3 &av = sample.angular_velocity;
+		av = {jitter(av.x, noise.angular_velocity_rad_s), jitter(av.y, noise.angular_velocity_rad_s),
+		      jitter(av.z, noise.angular_velocity_rad_s)};
+
+		xrt_vec3 rot_noise = {jitter(0, noise.orientation_rad / 2), jitter(0, noise.orientation_rad / 2),
+		                      jitter(0, noise.orientation_rad / 2)};
+		xrt_quat q_noise;
+		math_quat_exp(&rot_noise, &q_noise);
+		math_quat_rotate(&q_noise, &sample.pose.orientation, &sample.pose.orientation);
+
+		int64_t ts = (int64_t)(stamp_s * U_TIME_1S_IN_NS);
+		m_relation_history_push(rh, &sample, ts);
+
+		// Let the predictors fill up first.
+		if (i < 32) {
+			continue;
+		}
+
+		double at_s = horizon_s >= 0 ? t + horizon_s : t + horizon_s / hz;
+		xrt_space_relation out = XRT_SPACE_RELATION_ZERO;
+		m_relation_history_get(rh, (int64_t)(at_s * U_TIME_1S_IN_NS), &out);
+
+		xrt_space_relation truth = head_motion(at_s);
+		pos_sq += std::pow(position_error(out, truth), 2);
+		angle_sq += std::pow(angle_error(out, truth), 2);
+		count++;
+	}
+
+	return {std::sqrt(pos_sq / count) * 1000, std::sqrt(angle_sq / count) * 180 / M_PI};
+}
+
+} // namespace
+
+
+TEST_CASE("m_relation_history_modes")
+{
+	m_relation_history *rh = create(GENERATE(false, true));
+	constexpr int64_t kStepNs = 100 * U_TIME_1MS_IN_NS;
+
+	SECTION("Hermite interpolation follows velocities")
+	{
+		// Constant acceleration and constant spin, with exact velocities.
+		const xrt_vec3 accel = {1.f, -2.f, 0.5f};
+		const xrt_vec3 omega = {0.f, 2.f, 0.f};
+		auto truth = [&](double t) {
+			xrt_space_relation rel = XRT_SPACE_RELATION_ZERO;
+			rel.relation_flags = kAllFlags;
+			rel.pose.position = {(float)(0.5 * accel.x * t * t), (float)(0.5 * accel.y * t * t),
+			                     (float)(0.5 * accel.z * t * t)};
+			rel.linear_velocity = {(float)(accel.x * t), (float)(accel.y * t), (float)(accel.z * t)};
+			rel.angular_velocity = omega;
+			xrt_vec3 half_rot = {0.f, (float)(omega.y * t / 2), 0.f};
+			math_quat_exp(&half_rot, &rel.pose.orientation);
+			return rel;
+		};
+
+		for (int i = 0; i < 2; i++) {
+			xrt_space_relation rel = truth(i * time_ns_to_s(kStepNs));
+			m_relation_history_push(rh, &rel, kStartNs + i * kStepNs);
+		}
+
+		int64_t at_ns = kStartNs + kStepNs / 3;
+		xrt_space_relation expected = truth(time_ns_to_s(kStepNs / 3));
+
+		xrt_space_relation linear = XRT_SPACE_RELATION_ZERO;
+		CHECK(m_relation_history_get(rh, at_ns, &linear) == M_RELATION_HISTORY_RESULT_INTERPOLATED);
+
+		m_relation_history_set_interpolation(rh, M_RELATION_HISTORY_INTERPOLATION_HERMITE);
+		xrt_space_relation hermite = XRT_SPACE_RELATION_ZERO;
+		CHECK(m_relation_history_get(rh, at_ns, &hermite) == M_RELATION_HISTORY_RESULT_INTERPOLATED);
+
+		CHECK(position_error(linear, expected) > 1e-3);
+		CHECK(position_error(hermite, expected) < 1e-5);
+		CHECK(angle_error(hermite, expected) < 1e-4);
+		CHECK(hermite.linear_velocity.x == Catch::Approx(expected.linear_velocity.x).margin(1e-4));
+		CHECK(hermite.linear_velocity.y == Catch::Approx(expected.linear_velocity.y).margin(1e-4));
+	}
+
+	SECTION("Least squares prediction without velocities")
+	{
+		// Constant velocity motion, but only poses are reported.
+		const xrt_vec3 velocity = {0.5f, 0.f, -0.25f};
+		const float yaw_rate = 1.f;
+		auto truth = [&](double t) {
+			xrt_space_relation rel = XRT_SPACE_RELATION_ZERO;
+			rel.relation_flags = (xrt_space_relation_flags)(XRT_SPACE_RELATION_POSITION_VALID_BIT |
+			                                                 XRT_SPACE_RELATION_ORIENTATION_VALID_BIT);
+			rel.pose.position = {(float)(velocity.x * t), 0.f, (float)(velocity.z * t)};
+			xrt_vec3 half_rot = {0.f, (float)(yaw_rate * t / 2), 0.f};
+			math_quat_exp(&half_rot, &rel.pose.orientation);
+			return rel;
+		};
+
+		constexpr int64_t kSampleNs = 10 * U_TIME_1MS_IN_NS;
+		for (int i = 0; i < 10; i++) {
+			xrt_space_relation rel = truth(i * time_ns_to_s(kSampleNs));
+			m_relation_history_push(rh, &rel, kStartNs + i * kSampleNs);
+		}
+
+		int64_t at_ns = kStartNs + 9 * kSampleNs + 50 * U_TIME_1MS_IN_NS;
+		xrt_space_relation expected = truth(time_ns_to_s(at_ns - kStartNs));
+
+		// The last sample has no velocity so it can't go anywhere.
+		xrt_space_relation last = XRT_SPACE_RELATION_ZERO;
+		CHECK(m_relation_history_get(rh, at_ns, &last) == M_RELATION_HISTORY_RESULT_PREDICTED);
+		CHECK(position_error(last, expected) > 0.02);
+
+		m_relation_history_set_prediction(rh, M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES, 8);
+		xrt_space_relation lsq = XRT_SPACE_RELATION_ZERO;
+		CHECK(m_relation_history_get(rh, at_ns, &lsq) == M_RELATION_HISTORY_RESULT_PREDICTED);
+		CHECK(position_error(lsq, expected) < 1e-4);
+		CHECK(angle_error(lsq, expected) < 1e-3);
+		CHECK((lsq.relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT) != 0);
+		CHECK(lsq.linear_velocity.x == Catch::Approx(velocity.x).margin(1e-3));
+		CHECK(lsq.angular_velocity.y == Catch::Approx(yaw_rate).margin(1e-3));
+	}
+
+	SECTION("Least squares needs a few samples")
+	{
+		m_relation_history_set_prediction(rh, M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES, 8);
+
+		xrt_space_relation rel = head_motion(0);
+		m_relation_history_push(rh, &rel, kStartNs);
+
+		// Falls back to the single sample prediction.
+		xrt_space_relation out = XRT_SPACE_RELATION_ZERO;
+		xrt_space_relation expected = XRT_SPACE_RELATION_ZERO;
+		m_relation_history_set_prediction(rh, M_RELATION_HISTORY_PREDICTION_LAST_SAMPLE, 0);
+		m_relation_history_get(rh, kStartNs + kStepNs, &expected);
+		m_relation_history_set_prediction(rh, M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES, 8);
+		CHECK(m_relation_history_get(rh, kStartNs + kStepNs, &out) == M_RELATION_HISTORY_RESULT_PREDICTED);
+		CHECK(position_error(out, expected) == 0);
+		CHECK(angle_error(out, expected) < 1e-3);
+	}
+
+	m_relation_history_destroy(&rh);
+}
+
+TEST_CASE("m_relation_history_accuracy_benchmark", "[.][benchmark]")
+{
+	const ReplayNoise noise = {
+	    0.0002,              // 0.2mm position
+	    0.05 * M_PI / 180,   // 0.05 degree orientation
+	    0.02,                // 2cm/s linear velocity
+	    1.0 * M_PI / 180,    // 1 degree/s angular velocity
+	    0.0002,              // 0.2ms timestamp jitter
+	};
+	constexpr double kHz = 90;
+	constexpr double kDurationS = 60;
+
+	struct Mode
+	{
+		const char *name;
+		m_relation_history_interpolation interpolation;
+		m_relation_history_prediction prediction;
+		uint32_t samples;
+	};
+	const Mode modes[] = {
+	    {"linear/last_sample", M_RELATION_HISTORY_INTERPOLATION_LINEAR,
+	     M_RELATION_HISTORY_PREDICTION_LAST_SAMPLE, 0},
+	    {"hermite/least_squares_4", M_RELATION_HISTORY_INTERPOLATION_HERMITE,
+	     M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES, 4},
+	    {"hermite/least_squares_6", M_RELATION_HISTORY_INTERPOLATION_HERMITE,
+	     M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES, 6},
+	    {"hermite/least_squares_8", M_RELATION_HISTORY_INTERPOLATION_HERMITE,
+	     M_RELATION_HISTORY_PREDICTION_LEAST_SQUARES, 8},
+	};
+
+	// Negative horizons are fractions of a sample period between the last two samples.
+	const double horizons[] = {-0.5, 0.010, 0.030, 0.050};
+
+	std::cout << "mode,horizon_ms,position_rms_mm,angle_rms_deg\n";
+	for (const Mode &mode : modes) {
+		for (double horizon : horizons) {
+			m_relation_history *rh = nullptr;
+			m_relation_history_create(&rh);
+			m_relation_history_set_interpolation(rh, mode.interpolation);
+			m_relation_history_set_prediction(rh, mode.prediction, mode.samples);
+
+			ReplayError err = replay(rh, kHz, kDurationS, horizon, noise);
+			m_relation_history_destroy(&rh);
+
+			double horizon_ms = horizon >= 0 ? horizon * 1000 : horizon / kHz * 1000;
+			std::cout << mode.name << "," << horizon_ms << "," << err.position_rms_mm << ","
+			          << err.angle_rms_deg << "\n";
+			CHECK(std::isfinite(err.position_rms_mm));
+		}
+	}
+}
+
+TEST_CASE("m_relation_history_single_writer_concurrent")
+{
+	// Short run, just to check that readers never see torn or mixed entries.
+	auto result = run_contended(true, 4, std::chrono::milliseconds(200));
+	CHECK(result.torn == 0);
+	CHECK(result.gets_per_s > 0);
+}
+
+TEST_CASE("m_relation_history_contended_benchmark", "[.][benchmark]")
+{
+	uint32_t max_readers = std::max(2u, std::thread::hardware_concurrency() - 1);
+
+	std::cout << "readers,mode,pushes/s,gets/s\n";
+	for (uint32_t readers = 1; readers <= max_readers; readers *= 2) {
+		for (bool single_writer : {false, true}) {
+			auto result = run_contended(single_writer, readers, std::chrono::milliseconds(1000));
+			CHECK(result.torn == 0);
+
+			std::cout << readers << "," << (single_writer ? "single_writer" : "mutex") << ","
+			          << (uint64_t)result.pushes_per_s << "," << (uint64_t)result.gets_per_s << "\n";
+		}
+	}
+}
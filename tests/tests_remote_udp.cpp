@@ -0,0 +1,262 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Remote driver UDP transport tests.
+ */
+
+#include "remote/r_interface.h"
+
+#include "xrt/xrt_device.h"
+#include "xrt/xrt_space.h"
+#include "xrt/xrt_system.h"
+
+#include "os/os_time.h"
+
+#include "catch_amalgamated.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+static r_remote_data
+make_data(uint32_t i)
+{
+	r_remote_data data = {};
+	data.header = R_HEADER_VALUE;
+	data.head.center.orientation.w = 1.0f;
+	data.head.center.position.y = 1.6f + (float)i * 0.001f;
+	data.left.active = true;
+	data.left.pose.orientation.w = 1.0f;
+	data.left.pose.position.x = (float)i * 0.01f;
+	data.right.active = true;
+	data.right.pose.orientation.w = 1.0f;
+	data.right.trigger_value.x = (float)(i % 7) / 7.0f;
+	return data;
+}
+
+static bool
+equal(const r_remote_data &a, const r_remote_data &b)
+{
+	return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static std::vector<uint8_t>
+encode(r_udp_encoder &enc, const r_remote_data &data)
+{
+	std::vector<uint8_t> packet(R_UDP_MAX_PACKET_SIZE);
+	size_t size = r_udp_encode(&enc, &data, packet.data(), packet.size());
+	REQUIRE(size > 0);
+	packet.resize(size);
+	return packet;
+}
+
+TEST_CASE("r_udp_codec")
+{
+	r_udp_encoder enc = {};
+	r_udp_encoder_init(&enc, 1);
+	r_udp_decoder dec = {};
+	r_remote_data out = {};
+
+	SECTION("Deltas are smaller than keyframes and decode exactly")
+	{
+		for (uint32_t i = 0; i < 3 * R_UDP_KEYFRAME_INTERVAL; i++) {
+			r_remote_data data = make_data(i);
+			std::vector<uint8_t> packet = encode(enc, data);
+
+			if (i % R_UDP_KEYFRAME_INTERVAL == 0) {
+				CHECK(packet.size() == sizeof(r_udp_packet_header) + sizeof(r_remote_data));
+			} else {
+				CHECK(packet.size() < sizeof(r_remote_data) / 2);
+			}
+
+			REQUIRE(r_udp_decode(&dec, packet.data(), packet.size(), &out));
+			CHECK(equal(out, data));
+		}
+
+		CHECK(dec.received == 3 * R_UDP_KEYFRAME_INTERVAL);
+		CHECK(dec.lost == 0);
+		CHECK(dec.dropped == 0);
+	}
+
+	SECTION("Lost packets don't corrupt the following ones")
+	{
+		std::mt19937 rng(42);
+		uint32_t count = 10 * R_UDP_KEYFRAME_INTERVAL;
+		uint32_t last_decoded = 0;
+		bool all_equal = true;
+
+		for (uint32_t i = 0; i < count; i++) {
+			r_remote_data data = make_data(i);
+			std::vector<uint8_t> packet = encode(enc, data);
+
+			// First one always arrives, then a third are lost.
+			if (i != 0 && rng() % 3 == 0) {
+				continue;
+			}
+
+			if (r_udp_decode(&dec, packet.data(), packet.size(), &out)) {
+				all_equal = all_equal && equal(out, data);
+				last_decoded = i;
+			}
+		}
+
+		CHECK(all_equal);
+		CHECK(dec.received + dec.lost == last_decoded + 1);
+		CHECK(dec.lost > 0);
+
+		// Only deltas relative to lost keyframes are dropped.
+		CHECK(dec.dropped < count / 3);
+	}
+
+	SECTION("Late and duplicated packets are dropped")
+	{
+		std::vector<uint8_t> first = encode(enc, make_data(0));
+		std::vector<uint8_t> second = encode(enc, make_data(1));
+		std::vector<uint8_t> third = encode(enc, make_data(2));
+
+		REQUIRE(r_udp_decode(&dec, first.data(), first.size(), &out));
+		REQUIRE(r_udp_decode(&dec, third.data(), third.size(), &out));
+		CHECK_FALSE(r_udp_decode(&dec, second.data(), second.size(), &out));
+		CHECK_FALSE(r_udp_decode(&dec, third.data(), third.size(), &out));
+
+		// Still holds the newest.
+		CHECK(equal(out, make_data(2)));
+		CHECK(dec.lost == 1);
+		CHECK(dec.dropped == 2);
+	}
+
+	SECTION("A new session starts over")
+	{
+		for (uint32_t i = 0; i < 10; i++) {
+			std::vector<uint8_t> packet = encode(enc, make_data(i));
+			REQUIRE(r_udp_decode(&dec, packet.data(), packet.size(), &out));
+		}
+
+		r_udp_encoder_init(&enc, 2);
+		std::vector<uint8_t> packet = encode(enc, make_data(100));
+		REQUIRE(r_udp_decode(&dec, packet.data(), packet.size(), &out));
+		CHECK(equal(out, make_data(100)));
+	}
+
+	SECTION("Malformed packets are dropped")
+	{
+		std::vector<uint8_t> key = encode(enc, make_data(0));
+		std::vector<uint8_t> delta = encode(enc, make_data(1));
+
+		CHECK_FALSE(r_udp_decode(&dec, key.data(), sizeof(r_udp_packet_header) - 1, &out));
+		CHECK_FALSE(r_udp_decode(&dec, key.data(), key.size() - 1, &out));
+
+		std::vector<uint8_t> bad_header = key;
+		bad_header[0] ^= 0xff;
+		CHECK_FALSE(r_udp_decode(&dec, bad_header.data(), bad_header.size(), &out));
+
+		REQUIRE(r_udp_decode(&dec, key.data(), key.size(), &out));
+		CHECK_FALSE(r_udp_decode(&dec, delta.data(), delta.size() - 1, &out));
+		REQUIRE(r_udp_decode(&dec, delta.data(), delta.size(), &out));
+		CHECK(equal(out, make_data(1)));
+	}
+}
+
+TEST_CASE("r_udp_loopback")
+{
+	// Read once by the remote driver.
+	setenv("REMOTE_UDP", "1", 1);
+
+	const uint16_t port = 4242 + 1000 + (uint16_t)(getpid() % 1000);
+
+	xrt_system_devices *xsysd = nullptr;
+	xrt_space_overseer *xso = nullptr;
+	REQUIRE(r_create_devices(port, 2, nullptr, &xsysd, &xso) == XRT_SUCCESS);
+
+	// The hub starts listening on its own thread.
+	r_remote_connection rc = {};
+	int ret = -1;
+	for (int i = 0; i < 100 && ret != 0; i++) {
+		ret = r_remote_connection_init(&rc, "localhost", port);
+		if (ret != 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+	REQUIRE(ret == 0);
+	REQUIRE(rc.udp_fd >= 0);
+
+	// The hub always starts by sending the reset and latest data over the stream.
+	r_remote_data reset = {};
+	REQUIRE(r_remote_connection_read_one(&rc, &reset) == 0);
+	REQUIRE(r_remote_connection_read_one(&rc, &reset) == 0);
+
+	xrt_device *left = xsysd->static_roles.hand_tracking.left;
+	REQUIRE(left != nullptr);
+
+	r_remote_data data = make_data(0);
+
+	// Keep sending, packets sent before the hub's UDP thread is up are lost.
+	bool received = false;
+	for (uint32_t i = 1; i < 1000 && !received; i++) {
+		data = make_data(i);
+		data.left.linear_velocity.x = 1.0f;
+		REQUIRE(r_remote_connection_write_one(&rc, &data) == 0);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		// A packet a bit late is predicted forward a little, 1m/s for a few ms.
+		xrt_space_relation rel = {};
+		REQUIRE(xrt_device_get_tracked_pose(left, XRT_INPUT_INDEX_GRIP_POSE, 0, &rel) == XRT_SUCCESS);
+		received = fabsf(rel.pose.position.x - data.left.pose.position.x) < 0.005f;
+	}
+	CHECK(received);
+
+	// Data that is on time is not predicted towards the asked for time.
+	xrt_space_relation rel = {};
+	int64_t at_ns = os_monotonic_get_ns() + 50 * U_TIME_1MS_IN_NS;
+	REQUIRE(xrt_device_get_tracked_pose(left, XRT_INPUT_INDEX_GRIP_POSE, at_ns, &rel) == XRT_SUCCESS);
+	CHECK(rel.pose.position.x < data.left.pose.position.x + 0.01f);
+
+	// Once packets stop arriving it is predicted over the time they are late.
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	REQUIRE(xrt_device_get_tracked_pose(left, XRT_INPUT_INDEX_GRIP_POSE, at_ns, &rel) == XRT_SUCCESS);
+	CHECK(rel.pose.position.x >= data.left.pose.position.x + 0.02f);
+	CHECK(rel.pose.position.x <= data.left.pose.position.x + 0.1f + 0.001f);
+
+	// Packets from anybody but the connected peer are ignored, 127.0.0.2 is also loopback.
+	int other_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	REQUIRE(other_fd >= 0);
+
+	sockaddr_in other_addr = {};
+	other_addr.sin_family = AF_INET;
+	inet_pton(AF_INET, "127.0.0.2", &other_addr.sin_addr);
+	REQUIRE(bind(other_fd, (sockaddr *)&other_addr, sizeof(other_addr)) == 0);
+
+	sockaddr_in hub_addr = {};
+	hub_addr.sin_family = AF_INET;
+	hub_addr.sin_port = htons(port);
+	inet_pton(AF_INET, "127.0.0.1", &hub_addr.sin_addr);
+
+	r_udp_encoder other_enc;
+	r_udp_encoder_init(&other_enc, 1234);
+	r_remote_data other = make_data(500);
+	std::vector<uint8_t> packet = encode(other_enc, other);
+	REQUIRE(sendto(other_fd, packet.data(), packet.size(), 0, (sockaddr *)&hub_addr, sizeof(hub_addr)) ==
+	        (ssize_t)packet.size());
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	REQUIRE(xrt_device_get_tracked_pose(left, XRT_INPUT_INDEX_GRIP_POSE, 0, &rel) == XRT_SUCCESS);
+	CHECK(rel.pose.position.x < other.left.pose.position.x - 1.0f);
+
+	close(other_fd);
+	close(rc.udp_fd);
+	close(rc.fd);
+
+	xrt_space_overseer_destroy(&xso);
+	xrt_system_devices_destroy(&xsysd);
+}
@@ -0,0 +1,303 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Space overseer tests and benchmarks.
+ *
+ * Run the benchmarks with `tests_space_overseer "[benchmark]"`.
+ */
+
+#include "xrt/xrt_device.h"
+#include "xrt/xrt_session.h"
+#include "xrt/xrt_space.h"
+#include "xrt/xrt_tracking.h"
+
+#include "math/m_api.h"
+#include "math/m_space.h"
+
+#include "util/u_space_overseer.h"
+
+#include "catch_amalgamated.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+static constexpr uint32_t kSpaceCount = 64;
+
+static const xrt_input_name kNames[] = {
+    XRT_INPUT_INDEX_GRIP_POSE,
+    XRT_INPUT_INDEX_AIM_POSE,
+    XRT_INPUT_GENERIC_PALM_POSE,
+};
+
+struct MockDevice
+{
+	xrt_device base = {};
+	uint32_t calls = 0;
+	float x = 0.0f;
+};
+
+static xrt_pose
+device_pose(const MockDevice &md, xrt_input_name name, int64_t at_timestamp_ns)
+{
+	xrt_pose pose = XRT_POSE_IDENTITY;
+	pose.position.x = md.x + (float)name * 0.001f;
+	pose.position.y = 1.0f + (float)(at_timestamp_ns % 1000) * 0.001f;
+	pose.orientation = {0.0f, 0.38268343f, 0.0f, 0.92387953f};
+	return pose;
+}
+
+static xrt_result_t
+mock_get_tracked_pose(xrt_device *xdev,
+                      xrt_input_name name,
+                      int64_t at_timestamp_ns,
+                      xrt_space_relation *out_relation)
+{
+	MockDevice *md = (MockDevice *)xdev;
+	md->calls++;
+
+	out_relation->pose = device_pose(*md, name, at_timestamp_ns);
+	out_relation->linear_velocity = {};
+	out_relation->angular_velocity = {};
+	out_relation->relation_flags = (xrt_space_relation_flags)(
+	    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_POSITION_VALID_BIT |
+	    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT);
+
+	return XRT_SUCCESS;
+}
+
+static xrt_result_t
+ignore_event(xrt_session_event_sink *xses, const xrt_session_event *xse)
+{
+	return XRT_SUCCESS;
+}
+
+struct Fixture
+{
+	xrt_session_event_sink broadcast = {ignore_event};
+	xrt_tracking_origin origin = {};
+	MockDevice head;
+	MockDevice controller;
+	u_space_overseer *uso = nullptr;
+	xrt_space_overseer *xso = nullptr;
+
+	std::vector<xrt_space *> spaces;
+	std::vector<xrt_pose> offsets;
+
+	Fixture()
+	{
+		origin.initial_offset = XRT_POSE_IDENTITY;
+		origin.initial_offset.position = {0.5f, 0.0f, -1.0f};
+
+		for (MockDevice *md : {&head, &controller}) {
+			md->base.tracking_origin = &origin;
+			md->base.get_tracked_pose = mock_get_tracked_pose;
+		}
+		controller.x = 0.25f;
+
+		uso = u_space_overseer_create(&broadcast);
+		xso = (xrt_space_overseer *)uso;
+
+		xrt_device *xdevs[] = {&head.base, &controller.base};
+		xrt_pose local_offset = XRT_POSE_IDENTITY;
+		local_offset.position.y = 1.6f;
+		u_space_overseer_legacy_setup(uso, xdevs, 2, &head.base, &local_offset, false, false);
+
+		// Like an app with a lot of action spaces with different offsets.
+		for (uint32_t i = 0; i < kSpaceCount; i++) {
+			xrt_space *xs = nullptr;
+			xrt_space_overseer_create_pose_space(xso, &controller.base, kNames[i % 3], &xs);
+			spaces.push_back(xs);
+
+			xrt_pose offset = XRT_POSE_IDENTITY;
+			offset.position.z = (float)i * 0.01f;
+			offsets.push_back(offset);
+		}
+	}
+
+	~Fixture()
+	{
+		for (xrt_space *&xs : spaces) {
+			xrt_space_reference(&xs, nullptr);
+		}
+		xrt_space_overseer_destroy(&xso);
+	}
+
+	//! Independently computed pose of space @p i in local space.
+	xrt_pose
+	expected(uint32_t i, int64_t at_timestamp_ns, const xrt_pose &origin_offset, const xrt_pose &local_offset)
+	{
+		xrt_pose pose = device_pose(controller, kNames[i % 3], at_timestamp_ns);
+		math_pose_transform(&pose, &offsets[i], &pose);
+		math_pose_transform(&origin_offset, &pose, &pose);
+
+		xrt_pose inv_local;
+		math_pose_invert(&local_offset, &inv_local);
+		math_pose_transform(&inv_local, &pose, &pose);
+		return pose;
+	}
+};
+
+static bool
+pose_near(const xrt_pose &a, const xrt_pose &b)
+{
+	const float e = 0.0001f;
+	float dot = math_quat_dot(&a.orientation, &b.orientation);
+	return fabsf(a.position.x - b.position.x) < e && fabsf(a.position.y - b.position.y) < e &&
+	       fabsf(a.position.z - b.position.z) < e && fabsf(fabsf(dot) - 1.0f) < e;
+}
+
+TEST_CASE("u_space_overseer_locate_spaces")
+{
+	Fixture f;
+	xrt_pose identity = XRT_POSE_IDENTITY;
+	std::vector<xrt_space_relation> rels(kSpaceCount);
+
+	xrt_pose origin_offset = f.origin.initial_offset;
+	xrt_pose local_offset = XRT_POSE_IDENTITY;
+	local_offset.position.y = 1.6f;
+
+	auto check_all = [&](int64_t at_ns) {
+		xrt_result_t xret = xrt_space_overseer_locate_spaces(f.xso, f.xso->semantic.local, &identity, at_ns,
+		                                                     f.spaces.data(), kSpaceCount, f.offsets.data(),
+		                                                     rels.data());
+		REQUIRE(xret == XRT_SUCCESS);
+
+		bool all_near = true;
+		for (uint32_t i = 0; i < kSpaceCount; i++) {
+			xrt_pose expected = f.expected(i, at_ns, origin_offset, local_offset);
+			all_near = all_near && pose_near(rels[i].pose, expected);
+
+			// Single locates go through the same path.
+			xrt_space_relation rel = {};
+			xrt_space_overseer_locate_space(f.xso, f.xso->semantic.local, &identity, at_ns, f.spaces[i],
+			                                &f.offsets[i], &rel);
+			all_near = all_near && pose_near(rel.pose, rels[i].pose);
+		}
+		CHECK(all_near);
+	};
+
+	SECTION("Matches the relation chain")
+	{
+		check_all(100);
+		check_all(200);
+	}
+
+	SECTION("Each device pose is only queried once per timestamp")
+	{
+		f.controller.calls = 0;
+		REQUIRE(xrt_space_overseer_locate_spaces(f.xso, f.xso->semantic.local, &identity, 300, f.spaces.data(),
+		                                         kSpaceCount, f.offsets.data(), rels.data()) == XRT_SUCCESS);
+		CHECK(f.controller.calls == 3);
+	}
+
+	SECTION("Device poses are shared between locate calls")
+	{
+		auto locate_one_by_one = [&](int64_t at_ns) {
+			for (uint32_t i = 0; i < kSpaceCount; i++) {
+				xrt_space_overseer_locate_space(f.xso, f.xso->semantic.local, &identity, at_ns,
+				                                f.spaces[i], &f.offsets[i], &rels[i]);
+			}
+		};
+
+		f.controller.calls = 0;
+		locate_one_by_one(310);
+		CHECK(f.controller.calls == 3);
+
+		// Same timestamp is answered from the cache.
+		REQUIRE(xrt_space_overseer_locate_spaces(f.xso, f.xso->semantic.local, &identity, 310, f.spaces.data(),
+		                                         kSpaceCount, f.offsets.data(), rels.data()) == XRT_SUCCESS);
+		CHECK(f.controller.calls == 3);
+
+		// A new timestamp asks the device again.
+		locate_one_by_one(320);
+		CHECK(f.controller.calls == 6);
+
+		// Changing an offset empties the cache.
+		xrt_pose origin = f.origin.initial_offset;
+		REQUIRE(xrt_space_overseer_set_tracking_origin_offset(f.xso, &f.origin, &origin) == XRT_SUCCESS);
+		locate_one_by_one(320);
+		CHECK(f.controller.calls == 9);
+
+		// So does creating a space.
+		xrt_space *xs = nullptr;
+		xrt_space_overseer_create_pose_space(f.xso, &f.controller.base, kNames[0], &xs);
+		locate_one_by_one(320);
+		CHECK(f.controller.calls == 12);
+		xrt_space_reference(&xs, nullptr);
+	}
+
+	SECTION("New device data is picked up")
+	{
+		check_all(400);
+		f.controller.x = 2.0f;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		check_all(400);
+	}
+
+	SECTION("Changed offsets are used at once")
+	{
+		check_all(500);
+
+		origin_offset.position.x = -3.0f;
+		REQUIRE(xrt_space_overseer_set_tracking_origin_offset(f.xso, &f.origin, &origin_offset) == XRT_SUCCESS);
+		check_all(500);
+
+		local_offset.position.z = 2.0f;
+		REQUIRE(xrt_space_overseer_set_reference_space_offset(f.xso, XRT_SPACE_REFERENCE_TYPE_LOCAL,
+		                                                      &local_offset) == XRT_SUCCESS);
+		check_all(500);
+	}
+
+	SECTION("Destroyed and recreated spaces")
+	{
+		check_all(600);
+
+		for (uint32_t i = 0; i < kSpaceCount; i++) {
+			xrt_space_reference(&f.spaces[i], nullptr);
+			xrt_input_name name = kNames[(i + 1) % 3];
+			xrt_space_overseer_create_pose_space(f.xso, &f.controller.base, name, &f.spaces[i]);
+		}
+
+		// Same timestamp, the new spaces use different inputs.
+		REQUIRE(xrt_space_overseer_locate_spaces(f.xso, f.xso->semantic.local, &identity, 600, f.spaces.data(),
+		                                         kSpaceCount, f.offsets.data(), rels.data()) == XRT_SUCCESS);
+		bool all_near = true;
+		for (uint32_t i = 0; i < kSpaceCount; i++) {
+			xrt_pose pose = device_pose(f.controller, kNames[(i + 1) % 3], 600);
+			math_pose_transform(&pose, &f.offsets[i], &pose);
+			math_pose_transform(&origin_offset, &pose, &pose);
+			pose.position.y -= 1.6f;
+			all_near = all_near && pose_near(rels[i].pose, pose);
+		}
+		CHECK(all_near);
+	}
+}
+
+TEST_CASE("u_space_overseer_benchmark", "[.][benchmark]")
+{
+	Fixture f;
+	xrt_pose identity = XRT_POSE_IDENTITY;
+	std::vector<xrt_space_relation> rels(kSpaceCount);
+	int64_t at_ns = 0;
+
+	BENCHMARK("locate_spaces " + std::to_string(kSpaceCount) + " spaces")
+	{
+		// New timestamp each time, like a new frame.
+		at_ns++;
+		return xrt_space_overseer_locate_spaces(f.xso, f.xso->semantic.local, &identity, at_ns, f.spaces.data(),
+		                                        kSpaceCount, f.offsets.data(), rels.data());
+	};
+
+	BENCHMARK("locate_space " + std::to_string(kSpaceCount) + " times")
+	{
+		at_ns++;
+		for (uint32_t i = 0; i < kSpaceCount; i++) {
+			xrt_space_overseer_locate_space(f.xso, f.xso->semantic.local, &identity, at_ns, f.spaces[i],
+			                                &f.offsets[i], &rels[i]);
+		}
+		return rels[0].pose.position.x;
+	};
+}
@@ -10,8 +10,11 @@
 
 #include "catch_amalgamated.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <thread>
 #include <chrono>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -130,3 +133,209 @@ TEST_CASE("TaskCollection")
 		CHECK(calledA[2]);
 	}
 }
+
+TEST_CASE("u_worker_group")
+{
+	SECTION("More tasks than threads and queue slots")
+	{
+		u_worker_thread_pool *pool = u_worker_thread_pool_create(3, 4, "Test");
+		REQUIRE(pool != nullptr);
+		u_worker_group *group = u_worker_group_create(pool);
+
+		std::atomic<uint32_t> count{0};
+		const uint32_t task_count = 10000;
+
+		for (uint32_t i = 0; i < task_count; i++) {
+			u_worker_group_push(
+			    group, [](void *ptr) { static_cast<std::atomic<uint32_t> *>(ptr)->fetch_add(1); }, &count);
+		}
+		u_worker_group_wait_all(group);
+
+		CHECK(count == task_count);
+
+		u_worker_group_reference(&group, nullptr);
+		u_worker_thread_pool_reference(&pool, nullptr);
+	}
+
+	SECTION("Tasks pushing tasks")
+	{
+		struct Context
+		{
+			u_worker_group *group;
+			std::atomic<uint32_t> count{0};
+		} ctx;
+
+		u_worker_thread_pool *pool = u_worker_thread_pool_create(2, 3, "Test");
+		REQUIRE(pool != nullptr);
+		ctx.group = u_worker_group_create(pool);
+
+		auto leaf = [](void *ptr) { static_cast<Context *>(ptr)->count.fetch_add(1); };
+		auto parent = [](void *ptr) {
+			auto *c = static_cast<Context *>(ptr);
+			for (int i = 0; i < 16; i++) {
+				u_worker_group_push(
+				    c->group, [](void *p) { static_cast<Context *>(p)->count.fetch_add(1); }, c);
+			}
+		};
+
+		for (int i = 0; i < 64; i++) {
+			u_worker_group_push(ctx.group, parent, &ctx);
+			u_worker_group_push(ctx.group, leaf, &ctx);
+		}
+		u_worker_group_wait_all(ctx.group);
+
+		CHECK(ctx.count == 64 * 17);
+
+		u_worker_group_reference(&ctx.group, nullptr);
+		u_worker_thread_pool_reference(&pool, nullptr);
+	}
+
+	SECTION("Waiting only runs tasks of its own group")
+	{
+		struct Context
+		{
+			std::atomic<bool> blocking{false};
+			std::atomic<bool> release{false};
+			std::thread::id ran_on;
+		} ctx;
+
+		// One permit, so the blocking task keeps the other task in the queue.
+		u_worker_thread_pool *pool = u_worker_thread_pool_create(1, 2, "Test");
+		REQUIRE(pool != nullptr);
+		u_worker_group *other = u_worker_group_create(pool);
+		u_worker_group *group = u_worker_group_create(pool);
+
+		auto block = [](void *ptr) {
+			auto *c = static_cast<Context *>(ptr);
+			c->blocking = true;
+			while (!c->release) {
+				std::this_thread::yield();
+			}
+		};
+		u_worker_group_push(other, block, &ctx);
+		while (!ctx.blocking) {
+			std::this_thread::yield();
+		}
+
+		u_worker_group_push(
+		    other, [](void *ptr) { static_cast<Context *>(ptr)->ran_on = std::this_thread::get_id(); }, &ctx);
+
+		std::atomic<uint32_t> count{0};
+		u_worker_group_push(
+		    group, [](void *ptr) { static_cast<std::atomic<uint32_t> *>(ptr)->fetch_add(1); }, &count);
+		u_worker_group_wait_all(group);
+		CHECK(count == 1);
+
+		ctx.release = true;
+		u_worker_group_wait_all(other);
+		CHECK(ctx.ran_on != std::this_thread::get_id());
+
+		u_worker_group_reference(&group, nullptr);
+		u_worker_group_reference(&other, nullptr);
+		u_worker_thread_pool_reference(&pool, nullptr);
+	}
+
+	SECTION("Many threads")
+	{
+		SharedThreadPool pool{31, 32, "Test"};
+		SharedThreadGroup group{pool};
+
+		std::atomic<uint32_t> count{0};
+		std::vector<TaskCollection::Functor> funcs(16, [&] { count.fetch_add(1); });
+		TaskCollection collection{group, funcs};
+		collection.waitAll();
+
+		CHECK(count == 16);
+	}
+}
+
+
+/*
+ *
+ * Benchmarks, run with "[benchmark]".
+ *
+ */
+
+static void
+bench_nop(void *ptr)
+{
+	static_cast<std::atomic<uint32_t> *>(ptr)->fetch_add(1, std::memory_order_relaxed);
+}
+
+TEST_CASE("u_worker_throughput", "[.][benchmark]")
+{
+	const uint32_t thread_count = std::max(2u, std::thread::hardware_concurrency());
+	u_worker_thread_pool *pool = u_worker_thread_pool_create(thread_count - 1, thread_count, "Bench");
+	REQUIRE(pool != nullptr);
+	u_worker_group *group = u_worker_group_create(pool);
+
+	// Like hand tracking, a small batch of tiny tasks per frame.
+	for (uint32_t batch : {8u, 32u, 256u}) {
+		std::atomic<uint32_t> count{0};
+		const uint32_t frames = 20000;
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t f = 0; f < frames; f++) {
+			for (uint32_t i = 0; i < batch; i++) {
+				u_worker_group_push(group, bench_nop, &count);
+			}
+			u_worker_group_wait_all(group);
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		REQUIRE(count == frames * batch);
+
+		double ns = std::chrono::duration<double, std::nano>(end - start).count();
+		printf("threads %2u batch %3u: %8.1f ns/task %9.1f ns/batch\n", thread_count, batch,
+		       ns / (frames * batch), ns / frames);
+	}
+
+	u_worker_group_reference(&group, nullptr);
+	u_worker_thread_pool_reference(&pool, nullptr);
+}
+
+TEST_CASE("u_worker_latency", "[.][benchmark]")
+{
+	const uint32_t thread_count = std::max(2u, std::thread::hardware_concurrency());
+	u_worker_thread_pool *pool = u_worker_thread_pool_create(thread_count - 1, thread_count, "Bench");
+	REQUIRE(pool != nullptr);
+	u_worker_group *group = u_worker_group_create(pool);
+
+	struct Sample
+	{
+		std::chrono::steady_clock::time_point started;
+		std::atomic<bool> picked_up{false};
+	} sample;
+
+	// Time from push until a worker starts the task, with idle workers.
+	std::vector<double> latencies;
+	for (int i = 0; i < 2000; i++) {
+		std::this_thread::sleep_for(100us);
+		sample.picked_up = false;
+
+		auto pushed = std::chrono::steady_clock::now();
+		u_worker_group_push(
+		    group,
+		    [](void *ptr) {
+			    auto *s = static_cast<Sample *>(ptr);
+			    s->started = std::chrono::steady_clock::now();
+			    s->picked_up.store(true, std::memory_order_release);
+		    },
+		    &sample);
+
+		// Waiting would run the task on this thread, so only wait once a worker has it.
+		while (!sample.picked_up.load(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+		u_worker_group_wait_all(group);
+
+		latencies.push_back(std::chrono::duration<double, std::micro>(sample.started - pushed).count());
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	printf("push to start: p50 %6.2f us p99 %6.2f us\n", latencies[latencies.size() / 2],
+	       latencies[latencies.size() * 99 / 100]);
+
+	u_worker_group_reference(&group, nullptr);
+	u_worker_thread_pool_reference(&pool, nullptr);
+}